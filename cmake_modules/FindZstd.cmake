@@ -0,0 +1,17 @@
+find_path(Zstd_INCLUDE_DIR zstd.h)
+
+find_library(Zstd_LIBRARY NAMES zstd
+  DOC "The Zstandard compression library")
+
+mark_as_advanced(Zstd_INCLUDE_DIR
+  Zstd_LIBRARY)
+
+include(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(Zstd DEFAULT_MSG
+  Zstd_LIBRARY Zstd_INCLUDE_DIR)
+
+set(Zstd_FOUND ${ZSTD_FOUND})
+if(Zstd_FOUND)
+  set(Zstd_INCLUDE_DIRS ${Zstd_INCLUDE_DIR})
+  set(Zstd_LIBRARIES    ${Zstd_LIBRARY})
+endif()
@@ -0,0 +1,307 @@
+// Copyright 2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GOBY_ACOMMS_BUFFER_DETAIL_KINETIC_TOURNAMENT_H
+#define GOBY_ACOMMS_BUFFER_DETAIL_KINETIC_TOURNAMENT_H
+
+#include <algorithm> // for min
+#include <cmath>     // for nextafter
+#include <cstddef>   // for size_t
+#include <limits>    // for numeric_limits
+#include <queue>     // for priority_queue
+#include <tuple>     // for tie
+#include <utility>   // for pair
+#include <vector>    // for vector
+
+namespace goby
+{
+namespace acomms
+{
+namespace detail
+{
+/// \brief Kinetic tournament tree over priorities that grow linearly with time
+///
+/// Each active slot has the priority value_base * (t - anchor) / ttl (see DynamicSubBuffer::top_value()). Every match in the tree stores its winner and the time (certificate) at which the loser will overtake it, so advance() only replays the matches whose certificates have expired or whose slots have changed. The maximum at a given time is then the root, and the next best slots are found by a best-first search (best_first()). Ties are won by the lower slot number.
+///
+/// Times are in microseconds on any consistent scale. Time is expected to move forward; moving it backwards rebuilds the tree.
+class KineticTournament
+{
+  public:
+    using slot_type = std::size_t;
+
+    /// \brief Allocate a new (inactive) slot
+    slot_type add()
+    {
+        if (!free_.empty())
+        {
+            auto slot = free_.back();
+            free_.pop_back();
+            slots_[slot] = Slot();
+            slots_[slot].in_use = true;
+            return slot;
+        }
+
+        if (slots_.size() == capacity_)
+        {
+            capacity_ = std::max<std::size_t>(1, 2 * capacity_);
+            rebuild_ = true;
+        }
+        slots_.emplace_back();
+        slots_.back().in_use = true;
+        return slots_.size() - 1;
+    }
+
+    /// \brief Release a slot for reuse
+    void remove(slot_type slot)
+    {
+        set(slot, false, 0, 1, 0);
+        slots_[slot].in_use = false;
+        free_.push_back(slot);
+    }
+
+    /// \brief Set the parameters of a slot, taking effect at the next call to advance()
+    ///
+    /// \param active false to exclude this slot from the tournament (e.g. empty subbuffer)
+    void set(slot_type slot, bool active, double value_base, double ttl, double anchor)
+    {
+        auto& s = slots_[slot];
+        s.active = active;
+        s.value_base = value_base;
+        s.ttl = ttl;
+        s.anchor = anchor;
+        mark_dirty(slot);
+    }
+
+    /// \brief Exclude a slot from the tournament (until the next call to set()), keeping its parameters for value()
+    void deactivate(slot_type slot)
+    {
+        slots_[slot].active = false;
+        mark_dirty(slot);
+    }
+
+    /// \brief Bring the tree up to time t
+    void advance(double t)
+    {
+        if (rebuild_ || t < time_)
+        {
+            rebuild(t);
+            return;
+        }
+
+        time_ = t;
+        if (!nodes_.empty() && nodes_[root].next_event <= t)
+            expire(root, t);
+
+        for (auto slot : dirty_)
+        {
+            slots_[slot].dirty = false;
+            auto n = capacity_ + slot;
+            set_leaf(n);
+            for (n /= 2; n >= root; n /= 2) play(n, t);
+        }
+        dirty_.clear();
+    }
+
+    /// \brief Priority of a slot at time t
+    double value(slot_type slot, double t) const
+    {
+        const auto& s = slots_[slot];
+        return s.value_base * (t - s.anchor) / s.ttl;
+    }
+
+    /// \brief Is this slot taking part in the tournament?
+    bool active(slot_type slot) const { return slots_[slot].active; }
+
+    /// \brief Visit the active slots of one or more tournaments from the highest to the lowest priority at time t
+    ///
+    /// Each tournament must already have been advanced to t. Visiting k slots costs O(k log n).
+    /// \param tournaments Tournaments to search. Ties between tournaments are won by the earlier one in this vector.
+    /// \param visit Called as visit(tournament_index, slot, value); return true to stop the search.
+    template <typename Visitor>
+    static void best_first(const std::vector<const KineticTournament*>& tournaments, double t,
+                           Visitor visit)
+    {
+        struct Candidate
+        {
+            double value;
+            std::size_t tournament;
+            slot_type slot;
+            std::size_t node;
+            bool operator<(const Candidate& c) const
+            {
+                // priority_queue pops the "largest": highest value, then lowest tournament index and slot
+                if (value != c.value)
+                    return value < c.value;
+                return std::tie(tournament, slot) > std::tie(c.tournament, c.slot);
+            }
+        };
+
+        std::priority_queue<Candidate> frontier;
+        auto push = [&](std::size_t i, std::size_t node) {
+            const auto& k = *tournaments[i];
+            int winner = k.nodes_[node].winner;
+            if (winner >= 0)
+                frontier.push({k.value(winner, t), i, static_cast<slot_type>(winner), node});
+        };
+
+        for (std::size_t i = 0, n = tournaments.size(); i < n; ++i)
+        {
+            if (!tournaments[i]->nodes_.empty())
+                push(i, root);
+        }
+
+        while (!frontier.empty())
+        {
+            auto c = frontier.top();
+            frontier.pop();
+            if (c.node >= tournaments[c.tournament]->capacity_)
+            {
+                if (visit(c.tournament, c.slot, c.value))
+                    return;
+            }
+            else
+            {
+                push(c.tournament, 2 * c.node);
+                push(c.tournament, 2 * c.node + 1);
+            }
+        }
+    }
+
+  private:
+    static constexpr std::size_t root{1};
+    static constexpr double never{std::numeric_limits<double>::infinity()};
+
+    struct Slot
+    {
+        bool in_use{false};
+        bool active{false};
+        bool dirty{false};
+        double value_base{0};
+        double ttl{1};
+        double anchor{0};
+    };
+
+    struct Node
+    {
+        // winning slot of this subtree, or -1 if no slot in it is active
+        int winner{-1};
+        // time at which the loser of this match overtakes the winner
+        double expiry{never};
+        // earliest expiry in this subtree
+        double next_event{never};
+    };
+
+    void mark_dirty(slot_type slot)
+    {
+        auto& s = slots_[slot];
+        if (!s.dirty)
+        {
+            s.dirty = true;
+            dirty_.push_back(slot);
+        }
+    }
+
+    void rebuild(double t)
+    {
+        time_ = t;
+        rebuild_ = false;
+        for (auto slot : dirty_) slots_[slot].dirty = false;
+        dirty_.clear();
+
+        nodes_.assign(2 * capacity_, Node());
+        for (auto n = capacity_, end = 2 * capacity_; n < end; ++n) set_leaf(n);
+        for (auto n = capacity_ - 1; n >= root && n < capacity_; --n) play(n, t);
+    }
+
+    void set_leaf(std::size_t n)
+    {
+        auto slot = n - capacity_;
+        nodes_[n].winner = (slot < slots_.size() && slots_[slot].active) ? slot : -1;
+    }
+
+    // replay every match in the subtree of n whose certificate expired by t (requires nodes_[n].next_event <= t)
+    void expire(std::size_t n, double t)
+    {
+        if (n >= capacity_)
+            return;
+        for (auto child : {2 * n, 2 * n + 1})
+        {
+            if (nodes_[child].next_event <= t)
+                expire(child, t);
+        }
+        play(n, t);
+    }
+
+    // decide the match at internal node n at time t from its children's winners
+    void play(std::size_t n, double t)
+    {
+        const auto& left = nodes_[2 * n];
+        const auto& right = nodes_[2 * n + 1];
+        auto& node = nodes_[n];
+
+        node.expiry = never;
+        if (left.winner < 0 || right.winner < 0)
+        {
+            node.winner = left.winner < 0 ? right.winner : left.winner;
+        }
+        else
+        {
+            int winner = left.winner, loser = right.winner;
+            double v_winner = value(winner, t), v_loser = value(loser, t);
+            // left slots are always lower numbered, so the left wins ties
+            if (v_loser > v_winner)
+            {
+                std::swap(winner, loser);
+                std::swap(v_winner, v_loser);
+            }
+            node.winner = winner;
+
+            double r_winner = slots_[winner].value_base / slots_[winner].ttl;
+            double r_loser = slots_[loser].value_base / slots_[loser].ttl;
+            if (r_loser > r_winner)
+            {
+                node.expiry = t + (v_winner - v_loser) / (r_loser - r_winner);
+                // a tie at t won by the winner: the loser takes over immediately afterwards
+                if (!(node.expiry > t))
+                    node.expiry = std::nextafter(t, never);
+            }
+        }
+        node.next_event = std::min({node.expiry, left.next_event, right.next_event});
+    }
+
+    std::vector<Slot> slots_;
+    std::vector<slot_type> free_;
+    std::vector<slot_type> dirty_;
+
+    // heap-ordered tree: nodes_[1] is the root, the leaf for slot s is nodes_[capacity_ + s]
+    std::vector<Node> nodes_;
+    std::size_t capacity_{0};
+    bool rebuild_{false};
+    double time_{-never};
+};
+
+} // namespace detail
+} // namespace acomms
+} // namespace goby
+
+#endif
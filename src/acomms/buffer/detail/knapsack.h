@@ -0,0 +1,85 @@
+// Copyright 2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GOBY_ACOMMS_BUFFER_DETAIL_KNAPSACK_H
+#define GOBY_ACOMMS_BUFFER_DETAIL_KNAPSACK_H
+
+#include <cstddef> // for size_t
+#include <vector>  // for vector
+
+namespace goby
+{
+namespace acomms
+{
+namespace detail
+{
+/// \brief Solve the 0/1 knapsack problem exactly by dynamic programming over the capacity
+///
+/// Uses sizes.size() * (capacity + 1) cells of working memory (one byte each), plus one row of doubles.
+/// \param sizes Size of each item
+/// \param weights Weight (value) of each item; items with weight <= 0 are never chosen
+/// \param capacity Maximum total size of the chosen items
+/// \return Indices (ascending) of the items that maximize the total weight
+inline std::vector<std::size_t> knapsack(const std::vector<std::size_t>& sizes,
+                                         const std::vector<double>& weights, std::size_t capacity)
+{
+    const auto n = sizes.size();
+    const auto row = capacity + 1;
+
+    // best[c]: best weight with total size <= c using the items considered so far
+    std::vector<double> best(row, 0);
+    // taken[i * row + c]: item i improves best[c]
+    std::vector<char> taken(n * row, 0);
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        if (sizes[i] > capacity || !(weights[i] > 0))
+            continue;
+        for (std::size_t c = capacity + 1; c-- > sizes[i];)
+        {
+            double with = best[c - sizes[i]] + weights[i];
+            if (with > best[c])
+            {
+                best[c] = with;
+                taken[i * row + c] = 1;
+            }
+        }
+    }
+
+    std::vector<std::size_t> chosen;
+    for (std::size_t i = n, c = capacity; i-- > 0;)
+    {
+        if (taken[i * row + c])
+        {
+            chosen.push_back(i);
+            c -= sizes[i];
+        }
+    }
+    return std::vector<std::size_t>(chosen.rbegin(), chosen.rend());
+}
+
+} // namespace detail
+} // namespace acomms
+} // namespace goby
+
+#endif
@@ -0,0 +1,207 @@
+// Copyright 2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GOBY_ACOMMS_BUFFER_DETAIL_SPILL_STORE_H
+#define GOBY_ACOMMS_BUFFER_DETAIL_SPILL_STORE_H
+
+#include <algorithm> // for max
+#include <cerrno>    // for errno
+#include <cstddef>   // for size_t
+#include <cstdlib>   // for mkstemp
+#include <cstring>   // for memcpy, strerror
+#include <map>       // for map
+#include <string>    // for string
+#include <utility>   // for move, make_pair
+#include <vector>    // for vector
+
+#include <fcntl.h>    // for posix_fallocate
+#include <sys/mman.h> // for mmap, munmap
+#include <unistd.h>   // for close, unlink
+
+#include "goby/exception.h"
+
+namespace goby
+{
+namespace acomms
+{
+namespace detail
+{
+/// \brief Append-only store of byte strings in memory-mapped segment files
+///
+/// Records are appended to the current segment until it is full, then a new segment is started. A segment is deleted once all of its records have been released (the current segment is rewound instead). Segment files are unlinked as soon as they are created, so they never outlive the process. Written pages are backed by the file, so the kernel can write them back and evict them, unlike heap memory.
+class SpillStore
+{
+  public:
+    /// \brief Location of a record in the store
+    struct Handle
+    {
+        std::size_t segment;
+        std::size_t offset;
+        std::size_t size;
+    };
+
+    /// \param directory Directory for the segment files (should be on persistent storage, not tmpfs)
+    /// \param segment_bytes Size of each segment file (a larger record gets a segment of its own size)
+    SpillStore(std::string directory, std::size_t segment_bytes)
+        : directory_(std::move(directory)), segment_bytes_(std::max<std::size_t>(segment_bytes, 1))
+    {
+    }
+
+    ~SpillStore()
+    {
+        for (auto& segment_p : segments_) unmap(segment_p.second);
+    }
+
+    SpillStore(const SpillStore&) = delete;
+    SpillStore& operator=(const SpillStore&) = delete;
+
+    /// \brief Append a record
+    /// \throw goby::Exception If a segment file cannot be created (including if there is no space for it)
+    Handle append(const std::string& bytes)
+    {
+        auto it = segments_.find(current_);
+        if (it == segments_.end() || it->second.end + bytes.size() > it->second.capacity)
+            it = create_segment(std::max(segment_bytes_, bytes.size()));
+
+        auto& segment = it->second;
+        Handle handle{it->first, segment.end, bytes.size()};
+        if (!bytes.empty())
+            std::memcpy(segment.base + segment.end, bytes.data(), bytes.size());
+        segment.end += bytes.size();
+        ++segment.records;
+        bytes_ += bytes.size();
+        return handle;
+    }
+
+    /// \brief Read a record that has not been released
+    std::string read(const Handle& handle) const
+    {
+        const auto& segment = segments_.at(handle.segment);
+        return std::string(segment.base + handle.offset, handle.size);
+    }
+
+    /// \brief Release a record; its bytes are reclaimed when the rest of its segment is released
+    void release(const Handle& handle)
+    {
+        auto it = segments_.find(handle.segment);
+        if (it == segments_.end())
+            return;
+
+        bytes_ -= handle.size;
+        auto& segment = it->second;
+        if (--segment.records > 0)
+            return;
+
+        if (it->first == current_)
+        {
+            segment.end = 0;
+        }
+        else
+        {
+            unmap(segment);
+            segments_.erase(it);
+        }
+    }
+
+    /// \brief Total size of the records that have not been released
+    std::size_t bytes() const { return bytes_; }
+
+    /// \brief Number of segment files
+    std::size_t segments() const { return segments_.size(); }
+
+  private:
+    struct Segment
+    {
+        char* base{nullptr};
+        std::size_t capacity{0};
+        // append offset
+        std::size_t end{0};
+        // records not yet released
+        std::size_t records{0};
+    };
+
+    std::map<std::size_t, Segment>::iterator create_segment(std::size_t capacity)
+    {
+        std::string path = directory_ + "/goby_dynamic_buffer_spill_XXXXXX";
+        std::vector<char> path_buf(path.begin(), path.end());
+        path_buf.push_back('\0');
+
+        int fd = mkstemp(path_buf.data());
+        if (fd < 0)
+            throw(goby::Exception("Failed to create spill segment in " + directory_ + ": " +
+                                  std::strerror(errno)));
+        // the mapping keeps the file alive until it is unmapped
+        unlink(path_buf.data());
+
+        // allocate the blocks now: writing to a hole in a sparse file (ftruncate) raises SIGBUS if the disk is full
+        int error = posix_fallocate(fd, 0, capacity);
+        if (error != 0)
+        {
+            close(fd);
+            throw(goby::Exception("Failed to allocate spill segment in " + directory_ + ": " +
+                                  std::strerror(error)));
+        }
+
+        void* map = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        error = errno;
+        close(fd);
+        if (map == MAP_FAILED)
+            throw(goby::Exception("Failed to map spill segment in " + directory_ + ": " +
+                                  std::strerror(error)));
+
+        // the previous segment is no longer appended to, so delete it if already empty
+        auto previous = segments_.find(current_);
+        if (previous != segments_.end() && previous->second.records == 0)
+        {
+            unmap(previous->second);
+            segments_.erase(previous);
+        }
+
+        current_ = next_segment_++;
+        Segment segment;
+        segment.base = static_cast<char*>(map);
+        segment.capacity = capacity;
+        return segments_.insert(std::make_pair(current_, segment)).first;
+    }
+
+    static void unmap(Segment& segment)
+    {
+        if (segment.base)
+            munmap(segment.base, segment.capacity);
+        segment.base = nullptr;
+    }
+
+    std::string directory_;
+    std::size_t segment_bytes_;
+
+    std::map<std::size_t, Segment> segments_;
+    std::size_t current_{0};
+    std::size_t next_segment_{1};
+    std::size_t bytes_{0};
+};
+
+} // namespace detail
+} // namespace acomms
+} // namespace goby
+
+#endif
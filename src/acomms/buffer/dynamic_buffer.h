@@ -24,12 +24,22 @@
 #ifndef GOBY_ACOMMS_BUFFER_DYNAMIC_BUFFER_H
 #define GOBY_ACOMMS_BUFFER_DYNAMIC_BUFFER_H
 
+#include <algorithm>
 #include <deque>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <set>
 #include <type_traits>
 #include <unordered_map>
 #include <vector>
 
+#include <boost/optional.hpp>
+
 #include "goby/acomms/acomms_constants.h"
+#include "goby/acomms/buffer/detail/kinetic_tournament.h"
+#include "goby/acomms/buffer/detail/knapsack.h"
+#include "goby/acomms/buffer/detail/spill_store.h"
 #include "goby/acomms/protobuf/buffer.pb.h"
 #include "goby/exception.h"
 #include "goby/time/convert.h"
@@ -61,6 +71,18 @@ class DynamicBufferNoDataException : public goby::Exception
 
 template <typename Container> size_t data_size(const Container& c) { return c.size(); }
 
+/// \brief Serialize a value so that DynamicBuffer can spill it to disk (overload this and spill_parse() for data types that are not containers of bytes, as with data_size())
+template <typename Container> std::string spill_serialize(const Container& c)
+{
+    return std::string(c.begin(), c.end());
+}
+
+/// \brief Parse a value serialized by spill_serialize()
+template <typename Container> void spill_parse(const std::string& bytes, Container* c)
+{
+    *c = Container(bytes.begin(), bytes.end());
+}
+
 /// Represents a time-dependent priority queue for a single group of messages (e.g. for a single DCCL ID)
 template <typename T, typename Clock = goby::time::SteadyClock> class DynamicSubBuffer
 {
@@ -163,30 +185,71 @@ template <typename T, typename Clock = goby::time::SteadyClock> class DynamicSub
     Value& top(typename Clock::time_point reference = Clock::now(),
                typename Clock::duration ack_timeout = std::chrono::microseconds(0))
     {
-        for (auto& datum_pair : data_)
+        auto value = try_top(reference, ack_timeout);
+        if (!value)
+            throw(DynamicBufferNoDataException("DynamicSubBuffer::top() found no data"));
+        return *value;
+    }
+
+    /// \brief Same as top() but returns an empty optional instead of throwing if there is no data to (re)send
+    boost::optional<Value&>
+    try_top(typename Clock::time_point reference = Clock::now(),
+            typename Clock::duration ack_timeout = std::chrono::microseconds(0))
+    {
+        auto it = first_available(reference, ack_timeout);
+        if (it == data_.end())
+            return boost::none;
+
+        page_in(*it);
+        last_access_ = reference;
+        it->last_sent = last_access_;
+        return it->value;
+    }
+
+    /// \brief Returns the values that haven't been sent within ack_timeout, in the order top() would return them
+    ///
+    /// \param max_count Maximum number of values to return
+    std::vector<Value>
+    available_values(typename Clock::time_point reference = Clock::now(),
+                     typename Clock::duration ack_timeout = std::chrono::microseconds(0),
+                     size_type max_count = std::numeric_limits<size_type>::max()) const
+    {
+        std::vector<Value> values;
+        for (const auto& datum : data_)
         {
-            auto& datum_last_access = datum_pair.first;
-            if (datum_last_access == zero_point_ || datum_last_access + ack_timeout < reference)
+            if (values.size() >= max_count)
+                break;
+            if (available(datum, reference, ack_timeout))
+                values.push_back(loaded(datum));
+        }
+        return values;
+    }
+
+    /// \brief Mark a value as sent at the reference time, as if it had been returned by top()
+    ///
+    /// \return true if the value was found, false if the value was not found
+    bool mark_sent(const Value& value, typename Clock::time_point reference = Clock::now())
+    {
+        for (auto& datum : data_)
+        {
+            if (matches(datum, value))
             {
                 last_access_ = reference;
-                datum_last_access = last_access_;
-                return datum_pair.second;
+                datum.last_sent = reference;
+                return true;
             }
         }
-        throw(DynamicBufferNoDataException("DynamicSubBuffer::top() found no data"));
+        return false;
     }
 
     /// \brief Returns the size (in bytes) of the top of the queue that hasn't been sent within ack_timeout
     size_t top_size(typename Clock::time_point reference = Clock::now(),
                     typename Clock::duration ack_timeout = std::chrono::microseconds(0)) const
     {
-        for (const auto& datum_pair : data_)
-        {
-            const auto& datum_last_access = datum_pair.first;
-            if (datum_last_access == zero_point_ || datum_last_access + ack_timeout < reference)
-                return data_size(datum_pair.second.data);
-        }
-        throw(DynamicBufferNoDataException("DynamicSubBuffer::top_size() found no data"));
+        auto it = first_available(reference, ack_timeout);
+        if (it == data_.end())
+            throw(DynamicBufferNoDataException("DynamicSubBuffer::top_size() found no data"));
+        return it->bytes;
     }
 
     /// \brief returns true if all messages have been sent within ack_timeout of the reference provided and thus none are available for resending yet
@@ -194,13 +257,7 @@ template <typename T, typename Clock = goby::time::SteadyClock> class DynamicSub
     all_waiting_for_ack(typename Clock::time_point reference = Clock::now(),
                         typename Clock::duration ack_timeout = std::chrono::microseconds(0)) const
     {
-        for (const auto& datum_pair : data_)
-        {
-            const auto& datum_last_access = datum_pair.first;
-            if (datum_last_access == zero_point_ || datum_last_access + ack_timeout < reference)
-                return false;
-        }
-        return true;
+        return first_available(reference, ack_timeout) == data_.end();
     }
 
     enum class ValueResult
@@ -229,12 +286,12 @@ template <typename T, typename Clock = goby::time::SteadyClock> class DynamicSub
         else if (in_blackout(reference)) // in blackout
             return std::make_pair(-std::numeric_limits<double>::infinity(),
                                   ValueResult::IN_BLACKOUT);
-        else if (all_waiting_for_ack(reference, ack_timeout)) // all messages waiting for ack
+
+        auto top_it = first_available(reference, ack_timeout);
+        if (top_it == data_.end()) // all messages waiting for ack
             return std::make_pair(-std::numeric_limits<double>::infinity(),
                                   ValueResult::ALL_MESSAGES_WAITING_FOR_ACK);
-        else if (
-            top_size(reference, ack_timeout) >
-            max_bytes) // check if the top message size is greater than max_bytes - assumes !ALL_MESSAGES_WAITING_FOR_ACK so must go after that check
+        else if (top_it->bytes > max_bytes) // check if the top message is larger than max_bytes
             return std::make_pair(-std::numeric_limits<double>::infinity(),
                                   ValueResult::NEXT_MESSAGE_TOO_LARGE);
 
@@ -258,6 +315,37 @@ template <typename T, typename Clock = goby::time::SteadyClock> class DynamicSub
 
         return reference <= (last_access_ + blackout);
     }
+
+    /// \brief Returns the end of the blackout following the last access (in_blackout() is false for any reference after this time)
+    typename Clock::time_point blackout_end() const
+    {
+        return last_access_ +
+               goby::time::convert_duration<typename Clock::duration>(
+                   cfg_.blackout_time_with_units());
+    }
+
+    /// \brief Returns the time after which the first value becomes available to resend (all_waiting_for_ack() is false for any reference after this time)
+    ///
+    /// \throw DynamicBufferNoDataException Buffer is empty
+    typename Clock::time_point ack_wait_end(
+        typename Clock::duration ack_timeout = std::chrono::microseconds(0)) const
+    {
+        if (data_.empty())
+            throw(DynamicBufferNoDataException("DynamicSubBuffer::ack_wait_end() found no data"));
+
+        auto end = Clock::time_point::max();
+        for (const auto& datum : data_)
+        {
+            if (datum.last_sent == zero_point_)
+                return zero_point_;
+            end = std::min(end, datum.last_sent + ack_timeout);
+        }
+        return end;
+    }
+
+    /// \brief Returns the time of the last access (last call to top())
+    typename Clock::time_point last_access() const { return last_access_; }
+
     /// \brief Returns if this queue is empty
     bool empty() const { return data_.empty(); }
 
@@ -265,7 +353,11 @@ template <typename T, typename Clock = goby::time::SteadyClock> class DynamicSub
     size_type size() const { return data_.size(); }
 
     /// \brief Pop the value on the top of the queue
-    void pop() { data_.pop_front(); }
+    void pop()
+    {
+        forget(data_.front());
+        data_.pop_front();
+    }
 
     /// \brief Push a value to the queue
     ///
@@ -276,14 +368,16 @@ template <typename T, typename Clock = goby::time::SteadyClock> class DynamicSub
     {
         std::vector<Value> exceeded;
 
+        Datum datum{zero_point_, Value({reference, t}), data_size(t), boost::none};
+        resident_bytes_ += datum.bytes;
         if (cfg_.newest_first())
-            data_.push_front(std::make_pair(zero_point_, Value({reference, t})));
+            data_.push_front(std::move(datum));
         else
-            data_.push_back(std::make_pair(zero_point_, Value({reference, t})));
+            data_.push_back(std::move(datum));
 
         while (data_.size() > cfg_.max_queue())
         {
-            exceeded.push_back(data_.back().second);
+            exceeded.push_back(take(data_.back()));
             data_.pop_back();
         }
         return exceeded;
@@ -299,17 +393,17 @@ template <typename T, typename Clock = goby::time::SteadyClock> class DynamicSub
         auto ttl = goby::time::convert_duration<typename Clock::duration>(cfg_.ttl_with_units());
         if (cfg_.newest_first())
         {
-            while (!data_.empty() && reference > (data_.back().second.push_time + ttl))
+            while (!data_.empty() && reference > (data_.back().value.push_time + ttl))
             {
-                expired.push_back(data_.back().second);
+                expired.push_back(take(data_.back()));
                 data_.pop_back();
             }
         }
         else
         {
-            while (!data_.empty() && reference > (data_.front().second.push_time + ttl))
+            while (!data_.empty() && reference > (data_.front().value.push_time + ttl))
             {
-                expired.push_back(data_.front().second);
+                expired.push_back(take(data_.front()));
                 data_.pop_front();
             }
         }
@@ -326,29 +420,157 @@ template <typename T, typename Clock = goby::time::SteadyClock> class DynamicSub
 
         for (auto it = data_.begin(), end = data_.end(); it != end; ++it)
         {
-            const auto& datum_pair = it->second;
-            if (datum_pair == value)
+            if (matches(*it, value))
             {
+                forget(*it);
                 data_.erase(it);
                 return true;
             }
 
             // if these are true, we're not going to find it so stop looking
-            if (cfg_.newest_first() && datum_pair.push_time < value.push_time)
+            const auto& push_time = it->value.push_time;
+            if (cfg_.newest_first() && push_time < value.push_time)
                 break;
-            else if (!cfg_.newest_first() && datum_pair.push_time > value.push_time)
+            else if (!cfg_.newest_first() && push_time > value.push_time)
                 break;
         }
         return false;
     }
 
+    /// \brief Store the data of values that are not in use on disk (see DynamicBuffer::enable_spill())
+    ///
+    /// \param store Spill store shared by the subbuffers of a DynamicBuffer
+    void set_spill(std::shared_ptr<detail::SpillStore> store) { spill_ = std::move(store); }
+
+    /// \brief Move values from the end of the queue (those top() would return last) to the spill store until at least max_bytes of data have been moved (or all of it has)
+    ///
+    /// Spilled values are read back when top() reaches them; all other methods behave as if they had never been spilled.
+    /// \return Bytes of data moved to the spill store
+    /// \throw goby::Exception If the spill store cannot be written
+    size_t spill(size_t max_bytes)
+    {
+        size_t spilled_bytes = 0;
+        if (!spill_)
+            return spilled_bytes;
+
+        for (auto it = data_.rbegin(), end = data_.rend();
+             it != end && spilled_bytes < max_bytes && resident_bytes_ > 0; ++it)
+        {
+            if (it->spilled)
+                continue;
+            it->spilled = spill_->append(spill_serialize(it->value.data));
+            it->value.data = T();
+            resident_bytes_ -= it->bytes;
+            spilled_bytes += it->bytes;
+        }
+        return spilled_bytes;
+    }
+
+    /// \brief Bytes of data held in memory (that is, not spilled)
+    size_t resident_bytes() const { return resident_bytes_; }
+
+    /// \brief Release the spilled values from the spill store (before discarding this subbuffer)
+    void release_spill()
+    {
+        for (auto& datum : data_)
+        {
+            if (datum.spilled)
+                release(datum);
+        }
+    }
+
   private:
+    struct Datum
+    {
+        // time of the last send (top()), or zero_point_ if never sent
+        typename Clock::time_point last_sent;
+        // value.data is empty while spilled
+        Value value;
+        // data_size(value.data), whether or not spilled
+        size_t bytes;
+        boost::optional<detail::SpillStore::Handle> spilled;
+    };
+    using container_type = std::deque<Datum>;
+
+    // first value that has never been sent or was last sent more than ack_timeout before reference
+    typename container_type::iterator first_available(typename Clock::time_point reference,
+                                                      typename Clock::duration ack_timeout)
+    {
+        auto it = data_.begin();
+        while (it != data_.end() && !available(*it, reference, ack_timeout)) ++it;
+        return it;
+    }
+    typename container_type::const_iterator
+    first_available(typename Clock::time_point reference,
+                    typename Clock::duration ack_timeout) const
+    {
+        auto it = data_.begin();
+        while (it != data_.end() && !available(*it, reference, ack_timeout)) ++it;
+        return it;
+    }
+    bool available(const Datum& datum, typename Clock::time_point reference,
+                   typename Clock::duration ack_timeout) const
+    {
+        return datum.last_sent == zero_point_ || datum.last_sent + ack_timeout < reference;
+    }
+
+    // copy of the value, read from the spill store if needed
+    Value loaded(const Datum& datum) const
+    {
+        Value value = datum.value;
+        if (datum.spilled)
+            spill_parse(spill_->read(*datum.spilled), &value.data);
+        return value;
+    }
+
+    // bring a spilled value back into memory
+    void page_in(Datum& datum)
+    {
+        if (!datum.spilled)
+            return;
+        spill_parse(spill_->read(*datum.spilled), &datum.value.data);
+        release(datum);
+        resident_bytes_ += datum.bytes;
+    }
+
+    // the value of a datum about to be removed from data_
+    Value take(Datum& datum)
+    {
+        page_in(datum);
+        resident_bytes_ -= datum.bytes;
+        return std::move(datum.value);
+    }
+
+    // account for a datum about to be removed from data_ without reading it
+    void forget(Datum& datum)
+    {
+        if (datum.spilled)
+            release(datum);
+        else
+            resident_bytes_ -= datum.bytes;
+    }
+
+    void release(Datum& datum)
+    {
+        spill_->release(*datum.spilled);
+        datum.spilled = boost::none;
+    }
+
+    bool matches(const Datum& datum, const Value& value) const
+    {
+        // compare push times first so that spilled values are only read for likely matches
+        return datum.value.push_time == value.push_time &&
+               (datum.spilled ? loaded(datum) == value : datum.value == value);
+    }
+
     goby::acomms::protobuf::DynamicBufferConfig cfg_;
 
-    // pair of last send -> value
-    std::deque<std::pair<typename Clock::time_point, Value>> data_;
+    container_type data_;
     typename Clock::time_point last_access_{Clock::now()};
 
+    std::shared_ptr<detail::SpillStore> spill_;
+    size_t resident_bytes_{0};
+
     typename Clock::time_point zero_point_{std::chrono::seconds(0)};
 };
 
@@ -400,7 +622,23 @@ template <typename T, typename Clock = goby::time::SteadyClock> class DynamicBuf
         if (sub_.count(dest_id) && sub_.at(dest_id).count(sub_id))
             throw(goby::Exception("Subbuffer ID: " + sub_id + " already exists."));
 
-        sub_[dest_id].insert(std::make_pair(sub_id, DynamicSubBuffer<T, Clock>(cfgs)));
+        auto& subbuffer =
+            sub_[dest_id].insert(std::make_pair(sub_id, DynamicSubBuffer<T, Clock>(cfgs)))
+                .first->second;
+        subbuffer.set_spill(spill_);
+
+        auto& index = priority_[dest_id];
+        auto slot = index.tournament.add();
+        index.slots[sub_id] = slot;
+        if (slot >= index.ids.size())
+        {
+            index.ids.resize(slot + 1);
+            index.parked.resize(slot + 1);
+            index.resident.resize(slot + 1);
+        }
+        index.ids[slot] = sub_id;
+        index.resident[slot] = 0;
+        reindex(dest_id, sub_id);
     }
 
     /// \brief Replace an existing subbuffer with the given configuration (any messages in the subbuffer will be erased)
@@ -447,7 +685,10 @@ template <typename T, typename Clock = goby::time::SteadyClock> class DynamicBuf
     {
         auto it = sub_[dest_id].find(sub_id);
         if (it != sub_[dest_id].end())
+        {
             it->second.update(cfgs);
+            reindex(dest_id, sub_id);
+        }
         else
             create(dest_id, sub_id, cfgs);
     }
@@ -458,7 +699,23 @@ template <typename T, typename Clock = goby::time::SteadyClock> class DynamicBuf
     /// \param sub_id An identifier for this subbuffer
     void remove(modem_id_type dest_id, const subbuffer_id_type& sub_id)
     {
-        sub_[dest_id].erase(sub_id);
+        auto sub_it = sub_[dest_id].find(sub_id);
+        if (sub_it != sub_[dest_id].end())
+        {
+            sub_it->second.release_spill();
+            sub_[dest_id].erase(sub_it);
+        }
+
+        auto& index = priority_[dest_id];
+        auto it = index.slots.find(sub_id);
+        if (it != index.slots.end())
+        {
+            index.tournament.remove(it->second);
+            index.parked[it->second] = boost::none;
+            resident_bytes_ -= index.resident[it->second];
+            index.resident[it->second] = 0;
+            index.slots.erase(it);
+        }
     }
 
     /// \brief Push a new message to the buffer
@@ -469,12 +726,67 @@ template <typename T, typename Clock = goby::time::SteadyClock> class DynamicBuf
     std::vector<Value> push(const Value& fvt)
     {
         std::vector<Value> exceeded;
-        auto sub_exceeded = sub(fvt.modem_id, fvt.subbuffer_id).push(fvt.data, fvt.push_time);
+        auto sub_exceeded =
+            existing_sub(fvt.modem_id, fvt.subbuffer_id).push(fvt.data, fvt.push_time);
         for (const auto& e : sub_exceeded)
             exceeded.push_back({fvt.modem_id, fvt.subbuffer_id, e.push_time, e.data});
+        reindex(fvt.modem_id, fvt.subbuffer_id);
+        if (spilling_)
+            enforce_memory_budget();
         return exceeded;
     }
 
+    /// \brief Configuration for spilling values to disk
+    struct SpillConfig
+    {
+        /// Directory for the segment files (these are unlinked on creation, so nothing is left behind)
+        std::string directory;
+        /// Maximum bytes of value data (data_size()) held in memory before the lowest priority values are spilled
+        std::size_t memory_budget{8 << 20};
+        /// Size of each segment file
+        std::size_t segment_bytes{16 << 20};
+    };
+
+    /// \brief Bound the memory used by the values in this buffer by spilling the lowest priority values to memory-mapped segment files
+    ///
+    /// When a push() takes the data held in memory over memory_budget, values are moved to an append-only spill store until the data in memory is down to three quarters of the budget. Values are taken from the lowest priority subbuffers first (at the current time), and within a subbuffer from those top() would return last. A spilled value is read back when it is next returned by top(), fill() or pack() (so the budget can be exceeded by these until the next push()); erase(), expire() and the other methods behave as if values were never spilled.
+    ///
+    /// If the spill store cannot be written (e.g. the directory does not exist or the disk is full), a warning is logged, the values not yet spilled stay in memory and spilling is disabled (spilling() returns false).
+    void enable_spill(const SpillConfig& cfg)
+    {
+        spill_cfg_ = cfg;
+        spilling_ = true;
+        spill_ = std::make_shared<detail::SpillStore>(cfg.directory, cfg.segment_bytes);
+        for (auto& sub_id_p : sub_)
+        {
+            for (auto& sub_p : sub_id_p.second) sub_p.second.set_spill(spill_);
+        }
+        enforce_memory_budget();
+    }
+
+    /// \brief Bytes of value data held in memory (the sum of data_size() for the values that are not spilled)
+    std::size_t resident_bytes() const
+    {
+        // subbuffers changed through sub() are not accounted for until their next reindex()
+        std::size_t bytes = resident_bytes_;
+        for (const auto& stale : stale_)
+        {
+            if (sub_.count(stale.first) && sub_.at(stale.first).count(stale.second))
+            {
+                const auto& index = priority_.at(stale.first);
+                bytes += sub_.at(stale.first).at(stale.second).resident_bytes();
+                bytes -= index.resident[index.slots.at(stale.second)];
+            }
+        }
+        return bytes;
+    }
+
+    /// \brief Is spilling enabled (enable_spill() has been called and the spill store has not failed)?
+    bool spilling() const { return spilling_; }
+
+    /// \brief Bytes of value data in the spill store (zero if enable_spill() has not been called)
+    std::size_t spilled_bytes() const { return spill_ ? spill_->bytes() : 0; }
+
     /// \brief Is this buffer empty (that is, are all subbuffers empty)?
     bool empty() const
     {
@@ -503,94 +815,173 @@ template <typename T, typename Clock = goby::time::SteadyClock> class DynamicBuf
 
     /// \brief Returns the top value in a priority contest between all subbuffers
     ///
+    /// The subbuffers are visited in priority order (using a kinetic tournament tree for each destination), so only the leading candidates that are not eligible are examined before the winner is found. A subbuffer found in blackout or with all its values waiting for ack is left out of the contests until the end of its blackout or ack wait (or until it is changed), so it is only examined once.
     /// \param dest_id Modem id for this packet (can be QUERY_DESTINATION_ID to query all possible destinations)
     /// \param max_bytes Maximum number of bytes in the returned message
     /// \param ack_timeout Duration to wait before resending a value
     /// \return Value with the highest priority (DynamicSubBuffer::top_value()) of all the subbuffers
+    /// \throw DynamicBufferNoDataException No subbuffer has a value to (re)send
     Value top(modem_id_type dest_id = goby::acomms::QUERY_DESTINATION_ID,
               size_type max_bytes = std::numeric_limits<size_type>::max(),
               typename Clock::duration ack_timeout = std::chrono::microseconds(0))
     {
-        using goby::glog;
-
-        glog.is_debug1() &&
-            glog << group(glog_priority_group_) << "Starting priority contest (dest: "
-                 << (dest_id == goby::acomms::QUERY_DESTINATION_ID ? std::string("?")
-                                                                   : std::to_string(dest_id))
-                 << ", max_bytes: " << max_bytes << "):" << std::endl;
-
-        typename std::unordered_map<subbuffer_id_type, DynamicSubBuffer<T, Clock>>::iterator
-            winning_sub;
-        double winning_value = -std::numeric_limits<double>::infinity();
-
-        auto now = Clock::now();
-
         if (dest_id != goby::acomms::QUERY_DESTINATION_ID && !sub_.count(dest_id))
             throw(DynamicBufferNoDataException(
                 "DynamicBuffer::top() has no queues with this destination"));
 
-        // if QUERY_DESTINATION_ID, search all subbuffers, otherwise just search the ones that were specified by dest_id
-        for (auto sub_id_it = (dest_id == goby::acomms::QUERY_DESTINATION_ID) ? sub_.begin()
-                                                                              : sub_.find(dest_id),
-                  sub_id_end = (dest_id == goby::acomms::QUERY_DESTINATION_ID)
-                                   ? sub_.end()
-                                   : ++sub_.find(dest_id);
-             sub_id_it != sub_id_end; ++sub_id_it)
-        {
-            for (auto sub_it = sub_id_it->second.begin(), sub_end = sub_id_it->second.end();
-                 sub_it != sub_end; ++sub_it)
-            {
-                double value;
-                typename DynamicSubBuffer<T, Clock>::ValueResult result;
-                std::tie(value, result) = sub_it->second.top_value(now, max_bytes, ack_timeout);
+        auto value = try_top(dest_id, max_bytes, ack_timeout);
+        if (!value)
+            throw(DynamicBufferNoDataException(
+                "DynamicBuffer::top() has no queue with a winning value"));
+        return *value;
+    }
 
-                std::string value_or_reason;
-                switch (result)
-                {
-                    case DynamicSubBuffer<T, Clock>::ValueResult::VALUE_PROVIDED:
-                        value_or_reason = std::to_string(value);
-                        break;
+    /// \brief Same as top() but returns an empty optional instead of throwing if no subbuffer has a value to (re)send
+    boost::optional<Value>
+    try_top(modem_id_type dest_id = goby::acomms::QUERY_DESTINATION_ID,
+            size_type max_bytes = std::numeric_limits<size_type>::max(),
+            typename Clock::duration ack_timeout = std::chrono::microseconds(0))
+    {
+        return contest(dest_id, max_bytes, ack_timeout, Clock::now());
+    }
 
-                    case DynamicSubBuffer<T, Clock>::ValueResult::EMPTY:
-                        value_or_reason = "empty";
-                        break;
+    /// \brief Returns the values to send in a frame of max_bytes, in one call
+    ///
+    /// Equivalent to calling top() with the bytes remaining in the frame until no more values fit (or are available). All the values are for the same destination (the destination of the first value if dest_id is QUERY_DESTINATION_ID). The values are taken at a single reference time, at which a subbuffer that has just been accessed is in blackout (DynamicSubBuffer::in_blackout()); as successive calls to top() would be at later times, a subbuffer with a blackout_time of zero can give several values to the frame.
+    /// \param dest_id Modem id for this frame (can be QUERY_DESTINATION_ID to query all possible destinations)
+    /// \param max_bytes Size of the frame
+    /// \param ack_timeout Duration to wait before resending a value
+    /// \return Values in priority order (empty if no subbuffer has a value to (re)send). The sum of their data sizes is no more than max_bytes.
+    std::vector<Value> fill(modem_id_type dest_id, size_type max_bytes,
+                            typename Clock::duration ack_timeout = std::chrono::microseconds(0))
+    {
+        std::vector<Value> values;
+        auto now = Clock::now();
+        while (max_bytes > 0)
+        {
+            auto value = contest(dest_id, max_bytes, ack_timeout, now, true);
+            if (!value)
+                break;
 
-                    case DynamicSubBuffer<T, Clock>::ValueResult::IN_BLACKOUT:
-                        value_or_reason = "blackout";
-                        break;
+            // each value returned is marked as sent at "now", so it is not available again at this reference time (even with a zero ack_timeout): this terminates
+            dest_id = value->modem_id;
+            max_bytes -= data_size(value->data);
+            values.push_back(std::move(*value));
+        }
+        return values;
+    }
 
-                    case DynamicSubBuffer<T, Clock>::ValueResult::NEXT_MESSAGE_TOO_LARGE:
-                        value_or_reason = "too large";
-                        break;
+    /// \brief Limits on the work done by pack()
+    struct PackingBudget
+    {
+        /// Maximum number of values considered (the highest priority values available)
+        size_type max_candidates{64};
+        /// Maximum number of dynamic programming cells (candidates x (frame bytes + 1)) summed over all frames
+        std::size_t max_cells{1 << 20};
+    };
 
-                    case DynamicSubBuffer<T, Clock>::ValueResult::ALL_MESSAGES_WAITING_FOR_ACK:
-                        value_or_reason = "ack wait";
-                        break;
-                }
+    /// \brief Result of pack()
+    struct Packing
+    {
+        /// Values for each frame
+        std::vector<std::vector<Value>> frames;
+        /// Number of frames packed in priority order (like fill()) because the budget did not allow an exact solution
+        int greedy_frames{0};
+    };
 
-                glog.is_debug1() && glog << group(glog_priority_group_) << "\t" << sub_it->first
-                                         << " [dest: " << sub_id_it->first
-                                         << ", n: " << sub_it->second.size()
-                                         << "]: " << value_or_reason << std::endl;
+    /// \brief Chooses the values to send in num_frames frames of max_frame_bytes, maximizing the priority-weighted bytes sent
+    ///
+    /// Unlike fill(), which takes the highest priority value that fits the remaining bytes, this solves a knapsack problem for each frame (in turn) over the highest priority values available, so that the space left at the end of each frame is used by the best combination of smaller values. A value is weighted by its size times its subbuffer's priority (DynamicSubBuffer::top_value()); values beyond the first of each subbuffer are weighted as if that subbuffer had just been accessed. As with fill(), a subbuffer with a nonzero blackout_time gives at most one value per call. The chosen values are marked as sent (as top() would).
+    /// \param dest_id Modem id for these frames (can be QUERY_DESTINATION_ID, in which case the destination of the highest priority value is used)
+    /// \param max_frame_bytes Size of each frame
+    /// \param num_frames Number of frames
+    /// \param ack_timeout Duration to wait before resending a value
+    /// \param budget Bounds on the computation; frames beyond the budget are filled in priority order
+    Packing pack(modem_id_type dest_id, size_type max_frame_bytes, int num_frames,
+                 typename Clock::duration ack_timeout = std::chrono::microseconds(0),
+                 const PackingBudget& budget = PackingBudget())
+    {
+        Packing packing;
+        auto now = Clock::now();
+        auto candidates = prioritized_candidates(dest_id, max_frame_bytes, ack_timeout,
+                                                 budget.max_candidates, now);
+
+        // values sent at priority zero still count for their bytes
+        double max_priority = 0;
+        for (const auto& c : candidates) max_priority = std::max(max_priority, c.second);
+        const double floor = 1e-6 * (max_priority + 1);
+
+        const std::size_t cells_per_frame =
+            budget.max_cells / static_cast<std::size_t>(std::max(num_frames, 1));
+        std::vector<bool> used(candidates.size(), false);
+        for (int frame = 0; frame < num_frames; ++frame)
+        {
+            std::vector<std::size_t> index;
+            for (std::size_t i = 0, n = candidates.size(); i < n; ++i)
+            {
+                if (!used[i])
+                    index.push_back(i);
+            }
 
-                if (value > winning_value)
+            // largest number of (highest priority) candidates that fit the budget
+            std::size_t max_items =
+                cells_per_frame / (static_cast<std::size_t>(max_frame_bytes) + 1);
+            std::vector<std::size_t> chosen;
+            if (max_items >= 2 || index.size() <= max_items)
+            {
+                if (index.size() > max_items)
+                    index.resize(max_items);
+                std::vector<std::size_t> sizes;
+                std::vector<double> weights;
+                for (auto i : index)
                 {
-                    winning_value = value;
-                    winning_sub = sub_it;
-                    dest_id = sub_id_it->first;
+                    auto bytes = data_size(candidates[i].first.data);
+                    sizes.push_back(bytes);
+                    weights.push_back((std::max(candidates[i].second, 0.0) + floor) * bytes);
+                }
+                for (auto k : detail::knapsack(sizes, weights, max_frame_bytes))
+                    chosen.push_back(index[k]);
+            }
+            else
+            {
+                ++packing.greedy_frames;
+                size_type remaining = max_frame_bytes;
+                for (auto i : index)
+                {
+                    auto bytes = data_size(candidates[i].first.data);
+                    if (bytes <= remaining)
+                    {
+                        chosen.push_back(i);
+                        remaining -= bytes;
+                    }
                 }
             }
-        }
 
-        if (winning_value == -std::numeric_limits<double>::infinity())
-            throw(DynamicBufferNoDataException(
-                "DynamicBuffer::top() has no queue with a winning value"));
+            // send in priority order
+            std::sort(chosen.begin(), chosen.end());
+            packing.frames.emplace_back();
+            for (auto i : chosen)
+            {
+                used[i] = true;
+                mark_sent(candidates[i].first, now);
+                packing.frames.back().push_back(candidates[i].first);
+            }
+        }
 
-        const auto& top_p = winning_sub->second.top(now, ack_timeout);
-        glog.is_debug1() && glog << group(glog_priority_group_) << "Winner: " << winning_sub->first
-                                 << " (" << data_size(top_p.data) << "B)" << std::endl;
+        return packing;
+    }
 
-        return {dest_id, winning_sub->first, top_p.push_time, top_p.data};
+    /// \brief Mark a value as sent at the reference time, as if it had been returned by top()
+    ///
+    /// \return true if the value was found, false if the value was not found
+    /// \throw goby::Exception If subbuffer doesn't exist
+    bool mark_sent(const Value& value, typename Clock::time_point reference = Clock::now())
+    {
+        bool found = existing_sub(value.modem_id, value.subbuffer_id)
+                         .mark_sent({value.push_time, value.data}, reference);
+        if (found)
+            reindex(value.modem_id, value.subbuffer_id);
+        return found;
     }
 
     /// \brief Erase a value
@@ -600,7 +991,11 @@ template <typename T, typename Clock = goby::time::SteadyClock> class DynamicBuf
     /// \throw goby::Exception If subbuffer doesn't exist
     bool erase(const Value& value)
     {
-        return sub(value.modem_id, value.subbuffer_id).erase({value.push_time, value.data});
+        bool erased =
+            existing_sub(value.modem_id, value.subbuffer_id).erase({value.push_time, value.data});
+        if (erased)
+            reindex(value.modem_id, value.subbuffer_id);
+        return erased;
     }
 
     /// \brief Erase any values that have exceeded their time-to-live
@@ -617,6 +1012,8 @@ template <typename T, typename Clock = goby::time::SteadyClock> class DynamicBuf
                 auto sub_expired = sub_p.second.expire(now);
                 for (const auto& e : sub_expired)
                     expired.push_back({sub_id_p.first, sub_p.first, e.push_time, e.data});
+                if (!sub_expired.empty())
+                    reindex(sub_id_p.first, sub_p.first);
             }
         }
         return expired;
@@ -624,8 +1021,331 @@ template <typename T, typename Clock = goby::time::SteadyClock> class DynamicBuf
 
     /// \brief Reference a given subbuffer
     ///
+    /// Changes made through this reference are picked up by the next call to top()
     /// \throw goby::Exception If subbuffer doesn't exist
     DynamicSubBuffer<T, Clock>& sub(modem_id_type dest_id, const subbuffer_id_type& sub_id)
+    {
+        auto& subbuffer = existing_sub(dest_id, sub_id);
+        stale_.emplace(dest_id, sub_id);
+        return subbuffer;
+    }
+
+    /// \brief Reference a given subbuffer without allowing changes (so the priority index is left as it is)
+    ///
+    /// \throw goby::Exception If subbuffer doesn't exist
+    const DynamicSubBuffer<T, Clock>& sub(modem_id_type dest_id,
+                                          const subbuffer_id_type& sub_id) const
+    {
+        return existing_sub(dest_id, sub_id);
+    }
+
+  private:
+    // spill the lowest priority values until the data in memory is below the low water mark
+    void enforce_memory_budget()
+    {
+        reindex_stale();
+        if (resident_bytes_ <= spill_cfg_.memory_budget)
+            return;
+
+        // spill a quarter of the budget beyond what is needed, so the next pushes don't spill
+        const std::size_t target = spill_cfg_.memory_budget - spill_cfg_.memory_budget / 4;
+
+        struct Candidate
+        {
+            double priority;
+            modem_id_type dest_id;
+            const subbuffer_id_type* sub_id;
+        };
+        std::vector<Candidate> candidates;
+        double t = index_time(Clock::now());
+        for (const auto& index_p : priority_)
+        {
+            const auto& subs = sub_.at(index_p.first);
+            for (const auto& slot_p : index_p.second.slots)
+            {
+                if (!subs.at(slot_p.first).empty())
+                    candidates.push_back({index_p.second.tournament.value(slot_p.second, t),
+                                          index_p.first, &slot_p.first});
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const Candidate& a, const Candidate& b) {
+                      return std::tie(a.priority, a.dest_id, *a.sub_id) <
+                             std::tie(b.priority, b.dest_id, *b.sub_id);
+                  });
+
+        for (const auto& c : candidates)
+        {
+            if (resident_bytes_ <= target)
+                break;
+            try
+            {
+                sub_.at(c.dest_id).at(*c.sub_id).spill(resident_bytes_ - target);
+            }
+            catch (const goby::Exception& e)
+            {
+                // the value being spilled is only cleared once it is written, so nothing is lost
+                account(c.dest_id, *c.sub_id);
+                spilling_ = false;
+                goby::glog.is_warn() &&
+                    goby::glog << group(glog_priority_group_) << "Failed to spill values ("
+                               << e.what()
+                               << "); spilling is disabled and values are kept in memory"
+                               << std::endl;
+                return;
+            }
+            account(c.dest_id, *c.sub_id);
+        }
+    }
+
+    struct Winner
+    {
+        modem_id_type dest_id;
+        const subbuffer_id_type* sub_id;
+        DynamicSubBuffer<T, Clock>* sub;
+    };
+
+    // priority contest at time "now" - see top(); if repeat, subbuffers with no blackout_time accessed at "now" may win again - see fill()
+    boost::optional<Value> contest(modem_id_type dest_id, size_type max_bytes,
+                                   typename Clock::duration ack_timeout,
+                                   typename Clock::time_point now, bool repeat = false)
+    {
+        using goby::glog;
+
+        auto winner = find_winner(dest_id, max_bytes, ack_timeout, now, repeat);
+        if (!winner)
+            return boost::none;
+
+        const auto& top_p = *winner->sub->try_top(now, ack_timeout);
+        glog.is_debug1() && glog << group(glog_priority_group_) << "Winner: " << *winner->sub_id
+                                 << " (" << data_size(top_p.data) << "B)" << std::endl;
+
+        // last access has changed
+        reindex(winner->dest_id, *winner->sub_id);
+
+        return Value{winner->dest_id, *winner->sub_id, top_p.push_time, top_p.data};
+    }
+
+    // highest priority subbuffer that has a value to (re)send at time "now"
+    boost::optional<Winner> find_winner(modem_id_type dest_id, size_type max_bytes,
+                                        typename Clock::duration ack_timeout,
+                                        typename Clock::time_point now, bool repeat = false)
+    {
+        using goby::glog;
+
+        glog.is_debug1() &&
+            glog << group(glog_priority_group_) << "Starting priority contest (dest: "
+                 << (dest_id == goby::acomms::QUERY_DESTINATION_ID ? std::string("?")
+                                                                   : std::to_string(dest_id))
+                 << ", max_bytes: " << max_bytes << "):" << std::endl;
+
+        if (dest_id != goby::acomms::QUERY_DESTINATION_ID && !sub_.count(dest_id))
+            return boost::none;
+
+        reindex_stale();
+        wake(now, ack_timeout);
+
+        // if QUERY_DESTINATION_ID, search all subbuffers, otherwise just search the ones that were specified by dest_id
+        double t = index_time(now);
+        std::vector<modem_id_type> dests;
+        std::vector<const detail::KineticTournament*> tournaments;
+        auto add_destination = [&](modem_id_type id, PriorityIndex& index) {
+            index.tournament.advance(t);
+            dests.push_back(id);
+            tournaments.push_back(&index.tournament);
+        };
+        if (dest_id == goby::acomms::QUERY_DESTINATION_ID)
+        {
+            for (auto& index_p : priority_) add_destination(index_p.first, index_p.second);
+        }
+        else
+        {
+            add_destination(dest_id, priority_[dest_id]);
+        }
+
+        boost::optional<Winner> winner;
+        // subbuffers that cannot send until a later time, parked after the search (which reads the tournaments)
+        std::vector<Wakeup> parks;
+        detail::KineticTournament::best_first(
+            tournaments, t, [&](std::size_t i, detail::KineticTournament::slot_type slot, double) {
+                const auto& sub_id = priority_.at(dests[i]).ids[slot];
+                auto& subbuffer = sub_.at(dests[i]).at(sub_id);
+
+                double value;
+                typename DynamicSubBuffer<T, Clock>::ValueResult result;
+                std::tie(value, result) = subbuffer.top_value(now, max_bytes, ack_timeout);
+
+                // only in blackout because it was accessed at this reference time, so it can give another value
+                if (repeat && result == DynamicSubBuffer<T, Clock>::ValueResult::IN_BLACKOUT &&
+                    no_blackout(subbuffer) && subbuffer.last_access() == now)
+                {
+                    if (subbuffer.all_waiting_for_ack(now, ack_timeout))
+                        result = DynamicSubBuffer<T, Clock>::ValueResult::ALL_MESSAGES_WAITING_FOR_ACK;
+                    else if (subbuffer.top_size(now, ack_timeout) > max_bytes)
+                        result = DynamicSubBuffer<T, Clock>::ValueResult::NEXT_MESSAGE_TOO_LARGE;
+                    else
+                    {
+                        value = 0;
+                        result = DynamicSubBuffer<T, Clock>::ValueResult::VALUE_PROVIDED;
+                    }
+                }
+
+                if (glog.is_debug1())
+                {
+                    std::string value_or_reason;
+                    switch (result)
+                    {
+                        case DynamicSubBuffer<T, Clock>::ValueResult::VALUE_PROVIDED:
+                            value_or_reason = std::to_string(value);
+                            break;
+
+                        case DynamicSubBuffer<T, Clock>::ValueResult::EMPTY:
+                            value_or_reason = "empty";
+                            break;
+
+                        case DynamicSubBuffer<T, Clock>::ValueResult::IN_BLACKOUT:
+                            value_or_reason = "blackout";
+                            break;
+
+                        case DynamicSubBuffer<T, Clock>::ValueResult::NEXT_MESSAGE_TOO_LARGE:
+                            value_or_reason = "too large";
+                            break;
+
+                        case DynamicSubBuffer<T, Clock>::ValueResult::ALL_MESSAGES_WAITING_FOR_ACK:
+                            value_or_reason = "ack wait";
+                            break;
+                    }
+
+                    glog << group(glog_priority_group_) << "\t" << sub_id
+                         << " [dest: " << dests[i] << ", n: " << subbuffer.size()
+                         << "]: " << value_or_reason << std::endl;
+                }
+
+                switch (result)
+                {
+                    case DynamicSubBuffer<T, Clock>::ValueResult::VALUE_PROVIDED:
+                        winner = Winner{dests[i], &sub_id, &subbuffer};
+                        return true;
+
+                    case DynamicSubBuffer<T, Clock>::ValueResult::IN_BLACKOUT:
+                        parks.push_back({subbuffer.blackout_end(), dests[i], slot});
+                        return false;
+
+                    case DynamicSubBuffer<T, Clock>::ValueResult::ALL_MESSAGES_WAITING_FOR_ACK:
+                        parks.push_back({subbuffer.ack_wait_end(ack_timeout), dests[i], slot});
+                        return false;
+
+                    default: return false;
+                }
+            });
+
+        for (const auto& park : parks)
+        {
+            auto& index = priority_.at(park.dest_id);
+            index.tournament.deactivate(park.slot);
+            index.parked[park.slot] = park.time;
+            wakeups_.push(park);
+        }
+
+        return winner;
+    }
+
+    // return the parked subbuffers that can send at time "now" to the priority index
+    void wake(typename Clock::time_point now, typename Clock::duration ack_timeout)
+    {
+        // the ack waits were computed for a different ack_timeout, or time has gone backwards
+        bool wake_all = ack_timeout != parked_ack_timeout_ || now < last_wake_;
+        parked_ack_timeout_ = ack_timeout;
+        last_wake_ = now;
+
+        while (!wakeups_.empty() && (wake_all || wakeups_.top().time < now))
+        {
+            auto wakeup = wakeups_.top();
+            wakeups_.pop();
+
+            // ignore wakeups superseded by reindex() (the subbuffer changed) or remove()
+            auto& index = priority_.at(wakeup.dest_id);
+            const auto& parked = index.parked[wakeup.slot];
+            if (parked && *parked == wakeup.time)
+                reindex(wakeup.dest_id, index.ids[wakeup.slot]);
+        }
+    }
+
+    // up to max_count available values (and their priority) for a single destination, highest priority subbuffer first
+    std::vector<std::pair<Value, double>>
+    prioritized_candidates(modem_id_type dest_id, size_type max_bytes,
+                           typename Clock::duration ack_timeout, size_type max_count,
+                           typename Clock::time_point now)
+    {
+        std::vector<std::pair<Value, double>> candidates;
+
+        // use the destination of the winner of the priority contest
+        if (dest_id == goby::acomms::QUERY_DESTINATION_ID)
+        {
+            auto winner = find_winner(dest_id, max_bytes, ack_timeout, now);
+            if (!winner)
+                return candidates;
+            dest_id = winner->dest_id;
+        }
+        else if (!sub_.count(dest_id))
+        {
+            return candidates;
+        }
+
+        reindex_stale();
+        wake(now, ack_timeout);
+
+        auto& index = priority_[dest_id];
+        double t = index_time(now);
+        index.tournament.advance(t);
+        detail::KineticTournament::best_first(
+            {&index.tournament}, t,
+            [&](std::size_t, detail::KineticTournament::slot_type slot, double priority) {
+                const auto& sub_id = index.ids[slot];
+                const auto& subbuffer = sub_.at(dest_id).at(sub_id);
+                if (subbuffer.in_blackout(now))
+                    return false;
+
+                // as in fill(), only a subbuffer without blackout_time can give more than one value
+                size_type max_values = no_blackout(subbuffer) ? max_count - candidates.size() : 1;
+                bool first = true;
+                for (const auto& v : subbuffer.available_values(now, ack_timeout, max_values))
+                {
+                    if (data_size(v.data) > max_bytes)
+                        continue;
+                    // after the first value is sent, the priority of this subbuffer drops to zero
+                    candidates.push_back(std::make_pair(
+                        Value{dest_id, sub_id, v.push_time, v.data}, first ? priority : 0.0));
+                    first = false;
+                }
+                return candidates.size() >= max_count;
+            });
+        return candidates;
+    }
+
+    // a subbuffer with a blackout_time of zero can give several values at one reference time (see fill())
+    static bool no_blackout(const DynamicSubBuffer<T, Clock>& subbuffer)
+    {
+        return subbuffer.blackout_end() == subbuffer.last_access();
+    }
+
+    void reindex_stale()
+    {
+        for (const auto& stale : stale_)
+        {
+            if (sub_.count(stale.first) && sub_.at(stale.first).count(stale.second))
+                reindex(stale.first, stale.second);
+        }
+        stale_.clear();
+    }
+
+    DynamicSubBuffer<T, Clock>& existing_sub(modem_id_type dest_id, const subbuffer_id_type& sub_id)
+    {
+        return const_cast<DynamicSubBuffer<T, Clock>&>(
+            static_cast<const DynamicBuffer&>(*this).existing_sub(dest_id, sub_id));
+    }
+    const DynamicSubBuffer<T, Clock>& existing_sub(modem_id_type dest_id,
+                                                   const subbuffer_id_type& sub_id) const
     {
         if (!sub_.count(dest_id) || !sub_.at(dest_id).count(sub_id))
             throw(goby::Exception("Subbuffer ID: " + sub_id +
@@ -633,10 +1353,78 @@ template <typename T, typename Clock = goby::time::SteadyClock> class DynamicBuf
         return sub_.at(dest_id).at(sub_id);
     }
 
-  private:
+    // time scale used by the priority index
+    static double index_time(typename Clock::time_point t)
+    {
+        return std::chrono::duration<double, std::micro>(t.time_since_epoch()).count();
+    }
+
+    // update the priority index after a change to this subbuffer
+    void reindex(modem_id_type dest_id, const subbuffer_id_type& sub_id)
+    {
+        auto& index = priority_.at(dest_id);
+        const auto& subbuffer = sub_.at(dest_id).at(sub_id);
+        double ttl = goby::time::convert_duration<std::chrono::microseconds>(
+                         subbuffer.cfg().ttl_with_units())
+                         .count();
+        auto slot = index.slots.at(sub_id);
+        index.tournament.set(slot, !subbuffer.empty(), subbuffer.cfg().value_base(), ttl,
+                             index_time(subbuffer.last_access()));
+        index.parked[slot] = boost::none;
+        account(dest_id, sub_id);
+    }
+
+    // update resident_bytes_ after a change to this subbuffer
+    void account(modem_id_type dest_id, const subbuffer_id_type& sub_id)
+    {
+        auto& index = priority_.at(dest_id);
+        auto& accounted = index.resident[index.slots.at(sub_id)];
+        resident_bytes_ -= accounted;
+        accounted = sub_.at(dest_id).at(sub_id).resident_bytes();
+        resident_bytes_ += accounted;
+    }
+
     // destination -> subbuffer id (group/type) -> subbuffer
     std::map<modem_id_type, std::unordered_map<subbuffer_id_type, DynamicSubBuffer<T, Clock>>> sub_;
 
+    // priorities of the non-empty subbuffers for each destination, so that top() only needs to look at the leading candidates
+    struct PriorityIndex
+    {
+        detail::KineticTournament tournament;
+        std::unordered_map<subbuffer_id_type, detail::KineticTournament::slot_type> slots;
+        // slot -> subbuffer id
+        std::vector<subbuffer_id_type> ids;
+        // slot -> time after which a subbuffer left out of the tournament (in blackout or waiting for ack) can send again
+        std::vector<boost::optional<typename Clock::time_point>> parked;
+        // slot -> DynamicSubBuffer::resident_bytes() as of the last reindex()
+        std::vector<std::size_t> resident;
+    };
+    std::map<modem_id_type, PriorityIndex> priority_;
+
+    // parked subbuffers, earliest wakeup first
+    struct Wakeup
+    {
+        typename Clock::time_point time;
+        modem_id_type dest_id;
+        detail::KineticTournament::slot_type slot;
+        bool operator>(const Wakeup& w) const { return time > w.time; }
+    };
+    std::priority_queue<Wakeup, std::vector<Wakeup>, std::greater<Wakeup>> wakeups_;
+    // ack_timeout used for the parked ack waits
+    typename Clock::duration parked_ack_timeout_{Clock::duration::zero()};
+    typename Clock::time_point last_wake_{};
+
+    // subbuffers referenced through sub() since the last top()
+    std::set<std::pair<modem_id_type, subbuffer_id_type>> stale_;
+
+    // shared by all the subbuffers; null unless enable_spill() has been called
+    std::shared_ptr<detail::SpillStore> spill_;
+    SpillConfig spill_cfg_;
+    // enable_spill() has been called and the spill store has not failed since
+    bool spilling_{false};
+    // sum of PriorityIndex::resident, kept up to date by reindex()
+    std::size_t resident_bytes_{0};
+
     std::string glog_priority_group_;
     static std::atomic<int> count_;
 
@@ -383,7 +383,7 @@ bool goby::acomms::Queue::get_priority_values(double* priority,
     *last_send_time = last_send_time_;
 
     // no messages left to send
-    if (messages_.size() <= waiting_for_ack_.size())
+    if (!has_data_to_send())
         return false;
 
     protobuf::QueuedMessageMeta& next_msg = next_message_it()->meta;
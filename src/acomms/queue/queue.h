@@ -103,6 +103,9 @@ class Queue
 
     size_t size() const { return messages_.size(); }
 
+    // true if at least one message is not waiting for an ack
+    bool has_data_to_send() const { return messages_.size() > waiting_for_ack_.size(); }
+
     boost::posix_time::ptime last_send_time() const { return last_send_time_; }
 
     boost::posix_time::ptime newest_msg_time() const
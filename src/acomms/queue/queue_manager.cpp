@@ -29,6 +29,7 @@
 #include <ostream>  // for operat...
 #include <vector>   // for vector
 
+#include <boost/date_time/posix_time/conversion.hpp>          // for from_t...
 #include <boost/date_time/posix_time/posix_time_duration.hpp> // for micros...
 #include <boost/date_time/posix_time/ptime.hpp>               // for ptime
 #include <boost/date_time/time.hpp>                           // for base_time
@@ -53,6 +54,15 @@ using namespace goby::util::logger;
 
 int goby::acomms::QueueManager::count_ = 0;
 
+namespace
+{
+// time scale of QueueManager::priority_: microseconds since the UNIX epoch
+double priority_time(const boost::posix_time::ptime& t)
+{
+    return (t - boost::posix_time::from_time_t(0)).total_microseconds();
+}
+} // namespace
+
 goby::acomms::QueueManager::QueueManager()
     : packet_dest_(BROADCAST_ID), codec_(goby::acomms::DCCLCodec::get())
 {
@@ -105,6 +115,7 @@ void goby::acomms::QueueManager::add_queue(
                                 << " with: " << queue_cfg.ShortDebugString() << std::endl;
 
         queues_.find(dccl_id)->second->set_cfg(queue_cfg);
+        reindex(queues_.find(dccl_id)->second.get());
         return;
     }
 
@@ -122,6 +133,7 @@ void goby::acomms::QueueManager::add_queue(
 
         Queue& new_q = *((new_q_pair.first)->second);
 
+        reindex(&new_q);
         qsize(&new_q);
 
         glog.is(DEBUG1) && glog << group(glog_out_group_) << "Added new queue: \n"
@@ -136,6 +148,9 @@ void goby::acomms::QueueManager::do_work()
         std::vector<std::shared_ptr<google::protobuf::Message>> expired_msgs =
             queue.second->expire();
 
+        if (!expired_msgs.empty())
+            reindex(queue.second.get());
+
         for (const std::shared_ptr<google::protobuf::Message>& expire : expired_msgs)
         {
             signal_expire(*expire);
@@ -169,6 +184,7 @@ void goby::acomms::QueueManager::push_message(const google::protobuf::Message& d
     else
         queues_.find(dccl_id)->second->push_message(new_dccl_msg);
 
+    reindex(queues_[dccl_id].get());
     qsize(queues_[dccl_id].get());
 }
 
@@ -179,6 +195,7 @@ void goby::acomms::QueueManager::flush_queue(const protobuf::QueueFlush& flush)
     if (it != queues_.end())
     {
         it->second->flush();
+        reindex(it->second.get());
         glog.is(DEBUG1) && glog << group(glog_out_group_) << msg_string(it->second->descriptor())
                                 << ": flushed queue" << std::endl;
         qsize(it->second.get());
@@ -313,6 +330,9 @@ void goby::acomms::QueueManager::handle_modem_data_request(protobuf::ModemTransm
                     qsize(winning_queue); // notify change in queue size
                 }
 
+                // give_data() and pop_message() change the priority and sendable messages
+                reindex(winning_queue);
+
                 // if an ack been set, do not unset these
                 if (packet_ack_ == false)
                     packet_ack_ = next_user_frame.meta.ack_requested();
@@ -514,7 +534,9 @@ void goby::acomms::QueueManager::clear_packet(const protobuf::ModemTransmission&
 {
     for (auto it = waiting_for_ack_.begin(), end = waiting_for_ack_.end(); it != end;)
     {
-        if (it->second->clear_ack_queue(message.frame_start()))
+        bool ack_queue_empty = it->second->clear_ack_queue(message.frame_start());
+        reindex(it->second);
+        if (ack_queue_empty)
             waiting_for_ack_.erase(it++);
         else
             ++it;
@@ -539,15 +561,17 @@ goby::acomms::QueueManager::find_next_sender(const protobuf::ModemTransmission&
                             << data.size() << "/" << request_msg.max_frame_bytes() << "B"
                             << std::endl;
 
-    for (auto& queue : queues_)
+    // encode on demand
+    for (unsigned dccl_id : manip_manager_.ids(protobuf::ON_DEMAND))
     {
-        Queue& q = *(queue.second);
+        auto it = queues_.find(dccl_id);
+        if (it == queues_.end())
+            continue;
+        Queue& q = *(it->second);
 
-        // encode on demand
-        if (manip_manager_.has(codec_->id(q.descriptor()), protobuf::ON_DEMAND) &&
-            (!q.size() || q.newest_msg_time() + boost::posix_time::microseconds(static_cast<long>(
-                                                    cfg_.on_demand_skew_seconds() * 1e6)) <
-                              time::SystemClock::now<boost::posix_time::ptime>()))
+        if (!q.size() || q.newest_msg_time() + boost::posix_time::microseconds(static_cast<long>(
+                                                   cfg_.on_demand_skew_seconds() * 1e6)) <
+                             time::SystemClock::now<boost::posix_time::ptime>())
         {
             auto new_msg = dccl::DynamicProtobufManager::new_protobuf_message<
                 std::shared_ptr<google::protobuf::Message> >(q.descriptor());
@@ -556,21 +580,39 @@ goby::acomms::QueueManager::find_next_sender(const protobuf::ModemTransmission&
             if (new_msg->IsInitialized())
                 push_message(*new_msg);
         }
+    }
 
-        double priority;
-        boost::posix_time::ptime last_send_time;
-        if (q.get_priority_values(&priority, &last_send_time, request_msg, data))
-        {
-            // no winner, better winner, or equal & older winner
-            if ((!winning_queue || priority > winning_priority ||
-                 (priority == winning_priority && last_send_time < winning_last_send_time)))
+    double now = priority_time(time::SystemClock::now<boost::posix_time::ptime>());
+    priority_.advance(now);
+
+    // visit queues with data from the highest priority down; the first that can send this frame
+    // wins, except that an equal priority with an older last_send_time (or a lower DCCL ID) is better
+    unsigned winning_dccl_id = 0;
+    detail::KineticTournament::best_first(
+        {&priority_}, now,
+        [&](std::size_t /*tournament*/, detail::KineticTournament::slot_type slot, double value) {
+            if (winning_queue && value < winning_priority)
+                return true;
+
+            unsigned dccl_id = priority_ids_[slot];
+            Queue& q = *queues_.find(dccl_id)->second;
+
+            double priority;
+            boost::posix_time::ptime last_send_time;
+            if (q.get_priority_values(&priority, &last_send_time, request_msg, data))
             {
-                winning_priority = priority;
-                winning_last_send_time = last_send_time;
-                winning_queue = &q;
+                // no winner, or equal & older winner
+                if (!winning_queue || last_send_time < winning_last_send_time ||
+                    (last_send_time == winning_last_send_time && dccl_id < winning_dccl_id))
+                {
+                    winning_priority = value;
+                    winning_last_send_time = last_send_time;
+                    winning_dccl_id = dccl_id;
+                    winning_queue = &q;
+                }
             }
-        }
-    }
+            return false;
+        });
 
     glog.is(DEBUG1) && glog << group(glog_priority_group_) << "\t"
                             << "all other queues have no messages" << std::endl;
@@ -627,6 +669,7 @@ void goby::acomms::QueueManager::process_modem_ack(const protobuf::ModemTransmis
                 }
                 else
                 {
+                    reindex(q);
                     qsize(q);
                     signal_ack(ack_msg, *removed_msg);
                     if (network_ack_src_ids_.count(meta_from_msg(*removed_msg).src()))
@@ -812,6 +855,25 @@ void goby::acomms::QueueManager::process_cfg()
     }
 }
 
+void goby::acomms::QueueManager::reindex(Queue* q)
+{
+    unsigned dccl_id = codec_->id(q->descriptor());
+    auto it = priority_slots_.find(dccl_id);
+    if (it == priority_slots_.end())
+    {
+        auto slot = priority_.add();
+        it = priority_slots_.insert(std::make_pair(dccl_id, slot)).first;
+        if (priority_ids_.size() <= slot)
+            priority_ids_.resize(slot + 1);
+        priority_ids_[slot] = dccl_id;
+    }
+
+    // same units as Queue::get_priority_values: (now - last_send_time) / ttl * value_base
+    const protobuf::QueuedMessageEntry& opts = q->queue_message_options();
+    priority_.set(it->second, q->has_data_to_send(), opts.value_base(), opts.ttl() * 1e6,
+                  priority_time(q->last_send_time()));
+}
+
 void goby::acomms::QueueManager::qsize(Queue* q)
 {
     protobuf::QueueSize size;
@@ -32,16 +32,18 @@
 #include <set>     // for set
 #include <string>  // for string, operator+
 #include <utility> // for pair, make_pair
+#include <vector>  // for vector
 
 #include <boost/signals2/signal.hpp>    // for signal
 #include <google/protobuf/descriptor.h> // for Descriptor
 #include <google/protobuf/message.h>    // for Message
 
-#include "goby/acomms/dccl/dccl.h"               // for DCCLCodec
-#include "goby/acomms/protobuf/manipulator.pb.h" // for Manipulator
-#include "goby/acomms/protobuf/network_ack.pb.h" // for NetworkAck, Netwo...
-#include "goby/acomms/protobuf/queue.pb.h"       // for QueuedMessageEntr...
-#include "goby/util/as.h"                        // for as
+#include "goby/acomms/buffer/detail/kinetic_tournament.h" // for KineticTournament
+#include "goby/acomms/dccl/dccl.h"                         // for DCCLCodec
+#include "goby/acomms/protobuf/manipulator.pb.h"           // for Manipulator
+#include "goby/acomms/protobuf/network_ack.pb.h"           // for NetworkAck, Netwo...
+#include "goby/acomms/protobuf/queue.pb.h"                 // for QueuedMessageEntr...
+#include "goby/util/as.h"                                  // for as
 
 #include "queue.h"           // for Queue
 #include "queue_exception.h" // for QueueException
@@ -240,6 +242,9 @@ class QueueManager
 
     void qsize(Queue* q);
 
+    // updates the priority index for this %queue; call after anything that changes its messages, acks, last send time or configuration
+    void reindex(Queue* q);
+
     // finds the %queue with the highest priority
     Queue* find_next_sender(const protobuf::ModemTransmission& message, const std::string& data,
                             bool first_user_frame);
@@ -262,6 +267,14 @@ class QueueManager
     int modem_id_;
     std::map<unsigned, std::shared_ptr<Queue> > queues_;
 
+    // index of every %queue's priority (see Queue::get_priority_values) so that find_next_sender()
+    // only visits queues from the highest priority down until it finds one that can send
+    detail::KineticTournament priority_;
+    // maps DCCL ID onto slot in priority_
+    std::map<unsigned, detail::KineticTournament::slot_type> priority_slots_;
+    // maps slot in priority_ onto DCCL ID
+    std::vector<unsigned> priority_ids_;
+
     // map frame number onto %queue pointer that contains
     // the data for this ack
     std::multimap<unsigned, Queue*> waiting_for_ack_;
@@ -295,6 +308,7 @@ class QueueManager
         void add(unsigned id, goby::acomms::protobuf::Manipulator manip)
         {
             manips_.insert(std::make_pair(id, manip));
+            ids_[manip].insert(id);
         }
 
         bool has(unsigned id, goby::acomms::protobuf::Manipulator manip) const
@@ -312,12 +326,25 @@ class QueueManager
             return false;
         }
 
-        void clear() { manips_.clear(); }
+        // DCCL IDs of all the queues with this manipulator
+        std::set<unsigned> ids(goby::acomms::protobuf::Manipulator manip) const
+        {
+            auto it = ids_.find(manip);
+            return it == ids_.end() ? std::set<unsigned>() : it->second;
+        }
+
+        void clear()
+        {
+            manips_.clear();
+            ids_.clear();
+        }
 
       private:
         // manipulator multimap (no_encode, no_decode, etc)
         // maps DCCL ID (unsigned) onto Manipulator enumeration (xml_config.proto)
         std::multimap<unsigned, goby::acomms::protobuf::Manipulator> manips_;
+        // reverse of manips_: maps Manipulator onto DCCL IDs
+        std::map<goby::acomms::protobuf::Manipulator, std::set<unsigned> > ids_;
     };
 
     ManipulatorManager manip_manager_;
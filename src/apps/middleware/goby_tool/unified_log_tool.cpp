@@ -21,10 +21,18 @@
 // You should have received a copy of the GNU General Public License
 // along with Goby.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <fstream> // for ifstream
+#include <iostream> // for cout
+
 #include "goby/middleware/application/tool.h"
+#include "goby/middleware/log/log_index.h"
+#include "goby/middleware/log/protobuf_log_plugin.h"
+#include "goby/middleware/marshalling/detail/dynamic_protobuf_prototypes.h"
 
 #include "unified_log_tool.h"
 
+using goby::glog;
+
 goby::apps::middleware::UnifiedLogTool::UnifiedLogTool()
 {
     goby::middleware::ToolHelper tool_helper(
@@ -41,6 +49,12 @@ goby::apps::middleware::UnifiedLogTool::UnifiedLogTool()
                 {
                     switch (action_for_help)
                     {
+                        case goby::apps::middleware::protobuf::UnifiedLogToolConfig::index:
+                            tool_helper.help<goby::apps::middleware::LogIndexTool,
+                                             goby::apps::middleware::LogIndexToolConfigurator>(
+                                action_for_help);
+                            break;
+
                         default:
                             throw(goby::Exception(
                                 "Help was expected to be handled by external tool"));
@@ -49,6 +63,11 @@ goby::apps::middleware::UnifiedLogTool::UnifiedLogTool()
                 }
                 break;
 
+            case goby::apps::middleware::protobuf::UnifiedLogToolConfig::index:
+                tool_helper.run_subtool<goby::apps::middleware::LogIndexTool,
+                                        goby::apps::middleware::LogIndexToolConfigurator>();
+                break;
+
             default:
                 throw(goby::Exception("Action was expected to be handled by external tool"));
                 break;
@@ -57,3 +76,27 @@ goby::apps::middleware::UnifiedLogTool::UnifiedLogTool()
 
     quit(0);
 }
+
+goby::apps::middleware::LogIndexTool::LogIndexTool()
+{
+    for (const auto& input_file : app_cfg().input_file())
+    {
+        std::ifstream log(input_file.c_str());
+        if (!log.is_open())
+            glog.is_die() && glog << "Could not open input_file: " << input_file << std::endl;
+
+        // recognize the Protobuf file descriptors written by goby_logger as metadata
+        goby::middleware::log::LogEntry::reset();
+        goby::middleware::detail::DynamicProtobufPrototypes::reset_dynamic_protobuf_manager();
+        goby::middleware::log::ProtobufPlugin pb_plugin(true);
+        pb_plugin.register_read_hooks(log);
+
+        std::string index_file = goby::middleware::log::LogIndex::path(input_file);
+        auto entries =
+            goby::middleware::log::LogIndex::build(log, index_file, app_cfg().block_size());
+        std::cout << "Indexed " << entries << " entries of " << input_file << " to "
+                  << index_file << std::endl;
+    }
+
+    quit(0);
+}
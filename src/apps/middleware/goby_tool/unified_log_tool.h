@@ -25,6 +25,7 @@
 #define GOBY_APPS_MIDDLEWARE_GOBY_TOOL_UNIFIED_LOG_TOOL_H
 
 #include "goby/apps/middleware/goby_tool/log.pb.h"
+#include "goby/middleware/application/configuration_reader.h"
 #include "goby/middleware/application/interface.h"
 
 namespace goby
@@ -46,6 +47,30 @@ class UnifiedLogTool : public goby::middleware::Application<protobuf::UnifiedLog
   private:
 };
 
+class LogIndexToolConfigurator
+    : public goby::middleware::ProtobufConfigurator<protobuf::LogIndexToolConfig>
+{
+  public:
+    LogIndexToolConfigurator(int argc, char* argv[])
+        : goby::middleware::ProtobufConfigurator<protobuf::LogIndexToolConfig>(argc, argv)
+    {
+        auto& cfg = mutable_cfg();
+        if (!cfg.app().glog_config().has_tty_verbosity())
+            cfg.mutable_app()->mutable_glog_config()->set_tty_verbosity(
+                goby::util::protobuf::GLogConfig::WARN);
+    }
+};
+
+class LogIndexTool : public goby::middleware::Application<protobuf::LogIndexToolConfig>
+{
+  public:
+    LogIndexTool();
+    ~LogIndexTool() override {}
+
+  private:
+    void run() override { assert(false); }
+};
+
 } // namespace middleware
 } // namespace apps
 } // namespace goby
@@ -21,10 +21,11 @@
 // You should have received a copy of the GNU General Public License
 // along with Goby.  If not, see <http://www.gnu.org/licenses/>.
 
-#include <cstdlib>  // for exit
-#include <dlfcn.h>  // for dlopen
-#include <iostream> // for operat...
-#include <memory>   // for shared...
+#include <cstdlib>        // for exit
+#include <dlfcn.h>        // for dlopen
+#include <iostream>       // for operat...
+#include <memory>         // for shared...
+#include <sys/resource.h> // for getrusage
 
 #include "goby/middleware/application/configuration_reader.h" // for Config...
 #include "goby/middleware/application/interface.h"            // for run
@@ -48,11 +49,16 @@ namespace hdf5
 class WriterApp : public goby::middleware::Application<goby::middleware::protobuf::HDF5Config>
 {
   public:
-    WriterApp() : writer_(app_cfg().output_file())
+    WriterApp()
+        : writer_(app_cfg().output_file(), true, app_cfg().has_memory_budget_mb(),
+                  app_cfg().chunk_length(), app_cfg().has_compression_level(),
+                  app_cfg().compression_level(),
+                  static_cast<std::size_t>(app_cfg().memory_budget_mb()) * 1024 * 1024)
     {
         load();
         collect();
         write();
+        report();
         quit();
     }
 
@@ -60,6 +66,7 @@ class WriterApp : public goby::middleware::Application<goby::middleware::protobu
     void load();
     void collect();
     void write() { writer_.write(); }
+    void report();
     void run() override {}
 
   private:
@@ -100,6 +107,14 @@ void goby::middleware::hdf5::WriterApp::collect()
     }
 }
 
+void goby::middleware::hdf5::WriterApp::report()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    glog.is(VERBOSE) && glog << "Peak memory: " << usage.ru_maxrss / 1024 << " MiB, "
+                             << writer_.statistics() << std::endl;
+}
+
 int main(int argc, char* argv[])
 {
     // load plugin driver from environmental variable GOBY_HDF5_PLUGIN
@@ -28,19 +28,26 @@
 #include <memory>                          // for unique...
 #include <ostream>                         // for operat...
 #include <regex>
-#include <string>  // for operat...
-#include <utility> // for pair
-#include <vector>  // for vector
+#include <sstream>        // for ostringstream
+#include <string>         // for operat...
+#include <sys/resource.h> // for getrusage
+#include <thread>         // for thread
+#include <utility>        // for pair
+#include <vector>         // for vector
 
 #include <boost/filesystem.hpp> // for path
 
 #include "goby/middleware/application/configuration_reader.h" // for Config...
+#include "goby/middleware/log/arrow/arrow.h"                   // for Writer
 #include "goby/middleware/application/interface.h"            // for run
 #include "goby/middleware/group.h"                            // for operat...
 #include "goby/middleware/log/dccl_log_plugin.h"              // for DCCLPl...
+#include "goby/middleware/log/detail/ordered_pipeline.h"      // for Ordere...
 #include "goby/middleware/log/json_log_plugin.h"
 #include "goby/middleware/log/log_entry.h"               // for LogEntry
+#include "goby/middleware/log/log_index.h"               // for LogIndex
 #include "goby/middleware/log/log_plugin.h"              // for LogPlugin
+#include "goby/middleware/log/log_reader.h"              // for LogReader
 #include "goby/middleware/marshalling/interface.h"       // for Marsha...
 #include "goby/middleware/protobuf/log_tool_config.pb.h" // for LogToo...
 #include "goby/util/debug_logger/flex_ostream.h"         // for operat...
@@ -79,19 +86,44 @@ class LogTool : public goby::middleware::Application<protobuf::LogToolConfig>
     LogTool();
     ~LogTool() override
     {
+        pipeline_.reset();
+
 #ifdef HAS_HDF5
         if (app_cfg().format() == protobuf::LogToolConfig::HDF5)
+        {
             h5_writer_->write();
 
+            struct rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            glog.is_verbose() && glog << "Peak memory: " << usage.ru_maxrss / 1024 << " MiB, "
+                                      << h5_writer_->statistics() << std::endl;
+        }
+
         // need to clear these objects before protobuf shutdown or else we get an invalid pointer error
         h5_writer_.reset();
 #endif
 
+        if (arrow_writer_)
+        {
+            arrow_writer_->close();
+            glog.is_verbose() && glog << arrow_writer_->statistics() << std::endl;
+            arrow_writer_.reset();
+        }
+
         dccl::DynamicProtobufManager::protobuf_shutdown();
         for (void* handle : dl_handles_) dlclose(handle);
     }
 
   private:
+    // result of converting one log entry
+    struct Converted
+    {
+        // DEBUG_TEXT or JSON output
+        std::string text;
+        // HDF5 or ARROW output
+        std::vector<goby::middleware::HDF5ProtobufEntry> entries;
+    };
+
     std::string create_output_filename()
     {
         if (app_cfg().has_output_file())
@@ -107,11 +139,20 @@ class LogTool : public goby::middleware::Application<protobuf::LogToolConfig>
                 case protobuf::LogToolConfig::DEBUG_TEXT: output_file += ".txt"; break;
                 case protobuf::LogToolConfig::HDF5: output_file += ".h5"; break;
                 case protobuf::LogToolConfig::JSON: output_file += ".json"; break;
+                case protobuf::LogToolConfig::ARROW: output_file += "_arrow"; break;
             }
             return output_file;
         }
     }
-    bool check_regexes(const goby::middleware::log::LogEntry& log_entry);
+    bool check_regexes(const goby::middleware::log::LogEntry& log_entry)
+    {
+        return check_regexes(log_entry.type(), log_entry.group());
+    }
+    bool check_regexes(const std::string& type, const std::string& group);
+
+    // decode the entry using its plugin; thread-safe as long as no metadata entries are being read
+    void convert(goby::middleware::log::LogEntry& log_entry, Converted* converted);
+    void write(Converted& converted);
 
     // never gets called
     void run() override {}
@@ -124,6 +165,9 @@ class LogTool : public goby::middleware::Application<protobuf::LogToolConfig>
     std::map<int, std::unique_ptr<goby::middleware::log::LogPlugin>> plugins_;
 
     std::ifstream f_in_;
+    // used instead of f_in_ to read the log if set
+    std::unique_ptr<goby::middleware::log::LogReader> reader_;
+    std::unique_ptr<goby::middleware::log::LogIndex> index_;
     std::string output_file_path_;
 
     std::ofstream f_out_;
@@ -136,6 +180,12 @@ class LogTool : public goby::middleware::Application<protobuf::LogToolConfig>
 #ifdef HAS_HDF5
     std::unique_ptr<goby::middleware::hdf5::Writer> h5_writer_;
 #endif
+    std::unique_ptr<goby::middleware::arrow::Writer> arrow_writer_;
+
+    // converts entries on app_cfg().threads() threads if more than one
+    std::unique_ptr<
+        goby::middleware::log::detail::OrderedPipeline<goby::middleware::log::LogEntry, Converted>>
+        pipeline_;
 };
 } // namespace middleware
 } // namespace apps
@@ -173,9 +223,14 @@ goby::apps::middleware::LogTool::LogTool()
             h5_writer_ = std::make_unique<goby::middleware::hdf5::Writer>(
                 output_file_path_, app_cfg().write_hdf5_zero_length_dim(),
                 app_cfg().has_hdf5_chunk_length(), app_cfg().hdf5_chunk_length(),
-                app_cfg().has_hdf5_compression_level(), app_cfg().hdf5_compression_level());
+                app_cfg().has_hdf5_compression_level(), app_cfg().hdf5_compression_level(),
+                static_cast<std::size_t>(app_cfg().hdf5_memory_budget_mb()) * 1024 * 1024);
             break;
 #endif
+        case protobuf::LogToolConfig::ARROW:
+            arrow_writer_ = std::make_unique<goby::middleware::arrow::Writer>(
+                output_file_path_, app_cfg().arrow_batch_rows());
+            break;
         default:
             glog.is_die() &&
                 glog << "Format: " << protobuf::LogToolConfig::OutputFormat_Name(app_cfg().format())
@@ -203,94 +258,113 @@ goby::apps::middleware::LogTool::LogTool()
 
     for (auto& p : plugins_) p.second->register_read_hooks(f_in_);
 
+    int threads = app_cfg().threads() == 0 ? std::thread::hardware_concurrency()
+                                           : app_cfg().threads();
+    if (threads > 1)
+    {
+        glog.is_verbose() && glog << "Converting entries using " << threads << " threads"
+                                  << std::endl;
+        goby::glog.set_lock_action(goby::util::logger_lock::lock);
+
+        // entries are read on this thread, converted on the worker threads, and written in order
+        // by the pipeline's consumer thread
+        const int entries_per_thread = 64;
+        pipeline_ = std::make_unique<decltype(pipeline_)::element_type>(
+            threads, threads * entries_per_thread,
+            [this](goby::middleware::log::LogEntry& log_entry, Converted& converted)
+            {
+                try
+                {
+                    convert(log_entry, &converted);
+                }
+                catch (std::exception& e)
+                {
+                    glog.is_warn() && glog << "Error converting entry (scheme: "
+                                           << log_entry.scheme() << ", group: " << log_entry.group()
+                                           << ", type: " << log_entry.type() << "): " << e.what()
+                                           << std::endl;
+                }
+            },
+            [this](Converted& converted) { write(converted); });
+
+        // metadata (e.g. Protobuf file descriptors) changes the state used by the plugins, so wait
+        // until the entries before it have been converted, which also ensures that the entries
+        // after it are converted with it loaded
+        for (auto& hook : goby::middleware::log::LogEntry::filter_hook)
+        {
+            auto original = hook.second;
+            hook.second = [this, original](const std::vector<unsigned char>& data)
+            {
+                pipeline_->drain();
+                original(data);
+            };
+        }
+    }
+
+    if (app_cfg().use_mmap())
+    {
+        try
+        {
+            reader_ = std::make_unique<goby::middleware::log::LogReader>(app_cfg().input_file());
+        }
+        catch (goby::middleware::log::LogException& e)
+        {
+            glog.is_warn() && glog << e.what() << ", reading as a stream instead" << std::endl;
+        }
+    }
+
+    if (app_cfg().use_index() &&
+        (app_cfg().has_type_regex() || app_cfg().has_group_regex() ||
+         app_cfg().has_exclude_type_regex() || app_cfg().has_exclude_group_regex()))
+    {
+        // skip the parts of the log without any entries that will be converted
+        index_ = goby::middleware::log::LogIndex::load(app_cfg().input_file());
+        if (index_)
+            index_->set_filter([this](const goby::middleware::log::LogIndex::Key& key)
+                               { return check_regexes(key.type, key.group); });
+    }
+
     bool file_has_entries = false;
+    // reused so that reading entries using reader_ doesn't allocate
+    goby::middleware::log::LogEntry log_entry;
     while (true)
     {
         try
         {
-            goby::middleware::log::LogEntry log_entry;
-            log_entry.parse(&f_in_);
+            if (index_ && !(reader_ ? index_->next(*reader_) : index_->next(f_in_)))
+            {
+                glog.is_verbose() && glog << "No further entries match" << std::endl;
+                file_has_entries = file_has_entries || !index_->blocks().empty();
+                break;
+            }
+
+            if (reader_)
+            {
+                if (!reader_->next(&log_entry))
+                {
+                    glog.is_verbose() && glog << "EOF reached" << std::endl;
+                    break;
+                }
+            }
+            else
+            {
+                log_entry.parse(&f_in_);
+            }
             file_has_entries = true;
 
             if (!check_regexes(log_entry))
                 continue;
 
-            try
+            if (pipeline_)
             {
-                auto plugin = plugins_.find(log_entry.scheme());
-                if (plugin == plugins_.end())
-                    throw(goby::middleware::log::LogException("No plugin available for scheme: " +
-                                                              std::to_string(log_entry.scheme())));
-
-                switch (app_cfg().format())
-                {
-                    case protobuf::LogToolConfig::DEBUG_TEXT:
-                    {
-                        auto debug_text_msg = plugin->second->debug_text_message(log_entry);
-                        f_out_ << log_entry.scheme() << " | " << log_entry.group() << " | "
-                               << log_entry.type() << " | "
-                               << goby::time::convert<boost::posix_time::ptime>(
-                                      log_entry.timestamp())
-                               << " | " << debug_text_msg << std::endl;
-                        break;
-                    }
-                    case protobuf::LogToolConfig::HDF5:
-                    {
-#ifdef HAS_HDF5
-                        auto h5_entries = plugin->second->hdf5_entry(log_entry);
-                        for (const auto& entry : h5_entries) h5_writer_->add_entry(entry);
-#endif
-                        break;
-                    }
-                    case protobuf::LogToolConfig::JSON:
-                    {
-                        std::shared_ptr<nlohmann::json> j = plugin->second->json_message(log_entry);
-                        (*j)["_scheme_"] = log_entry.scheme();
-                        (*j)["_utime_"] =
-                            goby::time::convert<goby::time::MicroTime>(log_entry.timestamp())
-                                .value();
-                        (*j)["_strtime_"] = goby::time::str(log_entry.timestamp());
-                        (*j)["_group_"] = log_entry.group();
-                        (*j)["_type_"] = log_entry.type();
-                        f_out_ << j->dump() << std::endl;
-                        break;
-                    }
-                }
+                // copies own their data, rather than referring to reader_'s mapping
+                pipeline_->push(log_entry);
             }
-
-            catch (goby::middleware::log::LogException& e)
+            else
             {
-                glog.is_warn() && glog << "Failed to parse message (scheme: " << log_entry.scheme()
-                                       << ", group: " << log_entry.group()
-                                       << ", type: " << log_entry.type() << std::endl;
-
-                switch (app_cfg().format())
-                {
-                    case protobuf::LogToolConfig::DEBUG_TEXT:
-                        f_out_ << log_entry.scheme() << " | " << log_entry.group() << " | "
-                               << log_entry.type() << " | "
-                               << goby::time::convert<boost::posix_time::ptime>(
-                                      log_entry.timestamp())
-                               << " | "
-                               << "Unable to parse message of " << log_entry.data().size()
-                               << " bytes. Reason: " << e.what() << std::endl;
-                        break;
-                    case protobuf::LogToolConfig::HDF5:
-                        // nothing useful to write to the HDF5 file
-                        break;
-
-                    case protobuf::LogToolConfig::JSON:
-                        auto j = std::make_shared<nlohmann::json>();
-                        (*j)["_scheme_"] = log_entry.scheme();
-                        (*j)["_utime_"] =
-                            goby::time::convert<goby::time::MicroTime>(log_entry.timestamp())
-                                .value();
-                        (*j)["_strtime_"] = goby::time::str(log_entry.timestamp());
-                        (*j)["_group_"] = log_entry.group();
-                        (*j)["_type_"] = log_entry.type();
-                        (*j)["_error_"] = "Could not parse message";
-                        break;
-                }
+                Converted converted;
+                convert(log_entry, &converted);
+                write(converted);
             }
         }
         catch (goby::middleware::log::LogException& e)
@@ -309,6 +383,9 @@ goby::apps::middleware::LogTool::LogTool()
         }
     }
 
+    if (pipeline_)
+        pipeline_->finish();
+
     if (!file_has_entries)
         glog.is_warn() &&
             glog
@@ -326,36 +403,33 @@ goby::apps::middleware::LogTool::LogTool()
     quit();
 }
 
-bool goby::apps::middleware::LogTool::check_regexes(
-    const goby::middleware::log::LogEntry& log_entry)
+bool goby::apps::middleware::LogTool::check_regexes(const std::string& type,
+                                                    const std::string& group)
 {
-    if (app_cfg().has_type_regex() && !std::regex_match(log_entry.type(), type_regex_))
+    if (app_cfg().has_type_regex() && !std::regex_match(type, type_regex_))
     {
-        glog.is_debug2() && glog << "Excluding type: " << log_entry.type()
+        glog.is_debug2() && glog << "Excluding type: " << type
                                  << " as it does not match regex: \"" << app_cfg().type_regex()
                                  << "\"" << std::endl;
         return false;
     }
-    if (app_cfg().has_group_regex() &&
-        !std::regex_match(static_cast<std::string>(log_entry.group()), group_regex_))
+    if (app_cfg().has_group_regex() && !std::regex_match(group, group_regex_))
     {
-        glog.is_debug2() && glog << "Excluding group: " << log_entry.group()
+        glog.is_debug2() && glog << "Excluding group: " << group
                                  << " as it does not match regex: \"" << app_cfg().group_regex()
                                  << "\"" << std::endl;
         return false;
     }
-    if (app_cfg().has_exclude_type_regex() &&
-        std::regex_match(log_entry.type(), exclude_type_regex_))
+    if (app_cfg().has_exclude_type_regex() && std::regex_match(type, exclude_type_regex_))
     {
-        glog.is_debug2() && glog << "Excluding type: " << log_entry.type()
+        glog.is_debug2() && glog << "Excluding type: " << type
                                  << " as it matches exclusion regex: \""
                                  << app_cfg().exclude_type_regex() << "\"" << std::endl;
         return false;
     }
-    if (app_cfg().has_exclude_group_regex() &&
-        std::regex_match(static_cast<std::string>(log_entry.group()), exclude_group_regex_))
+    if (app_cfg().has_exclude_group_regex() && std::regex_match(group, exclude_group_regex_))
     {
-        glog.is_debug2() && glog << "Excluding group: " << log_entry.group()
+        glog.is_debug2() && glog << "Excluding group: " << group
                                  << " as it matches exclusion regex: \""
                                  << app_cfg().exclude_group_regex() << "\"" << std::endl;
         return false;
@@ -363,3 +437,97 @@ bool goby::apps::middleware::LogTool::check_regexes(
 
     return true;
 }
+
+void goby::apps::middleware::LogTool::convert(goby::middleware::log::LogEntry& log_entry,
+                                              Converted* converted)
+{
+    try
+    {
+        auto plugin = plugins_.find(log_entry.scheme());
+        if (plugin == plugins_.end())
+            throw(goby::middleware::log::LogException("No plugin available for scheme: " +
+                                                      std::to_string(log_entry.scheme())));
+
+        switch (app_cfg().format())
+        {
+            case protobuf::LogToolConfig::DEBUG_TEXT:
+            {
+                auto debug_text_msg = plugin->second->debug_text_message(log_entry);
+                std::ostringstream ss;
+                ss << log_entry.scheme() << " | " << log_entry.group() << " | " << log_entry.type()
+                   << " | " << goby::time::convert<boost::posix_time::ptime>(log_entry.timestamp())
+                   << " | " << debug_text_msg << "\n";
+                converted->text = ss.str();
+                break;
+            }
+            case protobuf::LogToolConfig::HDF5:
+            case protobuf::LogToolConfig::ARROW:
+            {
+                converted->entries = plugin->second->hdf5_entry(log_entry);
+                break;
+            }
+            case protobuf::LogToolConfig::JSON:
+            {
+                std::shared_ptr<nlohmann::json> j = plugin->second->json_message(log_entry);
+                (*j)["_scheme_"] = log_entry.scheme();
+                (*j)["_utime_"] =
+                    goby::time::convert<goby::time::MicroTime>(log_entry.timestamp()).value();
+                (*j)["_strtime_"] = goby::time::str(log_entry.timestamp());
+                (*j)["_group_"] = log_entry.group();
+                (*j)["_type_"] = log_entry.type();
+                converted->text = j->dump() + "\n";
+                break;
+            }
+        }
+    }
+
+    catch (goby::middleware::log::LogException& e)
+    {
+        glog.is_warn() && glog << "Failed to parse message (scheme: " << log_entry.scheme()
+                               << ", group: " << log_entry.group() << ", type: " << log_entry.type()
+                               << std::endl;
+
+        switch (app_cfg().format())
+        {
+            case protobuf::LogToolConfig::DEBUG_TEXT:
+            {
+                std::ostringstream ss;
+                ss << log_entry.scheme() << " | " << log_entry.group() << " | " << log_entry.type()
+                   << " | " << goby::time::convert<boost::posix_time::ptime>(log_entry.timestamp())
+                   << " | "
+                   << "Unable to parse message of " << log_entry.data().size()
+                   << " bytes. Reason: " << e.what() << "\n";
+                converted->text = ss.str();
+                break;
+            }
+            case protobuf::LogToolConfig::HDF5:
+            case protobuf::LogToolConfig::ARROW:
+                // nothing useful to write to the HDF5 or Arrow files
+                break;
+
+            case protobuf::LogToolConfig::JSON:
+                auto j = std::make_shared<nlohmann::json>();
+                (*j)["_scheme_"] = log_entry.scheme();
+                (*j)["_utime_"] =
+                    goby::time::convert<goby::time::MicroTime>(log_entry.timestamp()).value();
+                (*j)["_strtime_"] = goby::time::str(log_entry.timestamp());
+                (*j)["_group_"] = log_entry.group();
+                (*j)["_type_"] = log_entry.type();
+                (*j)["_error_"] = "Could not parse message";
+                break;
+        }
+    }
+}
+
+void goby::apps::middleware::LogTool::write(Converted& converted)
+{
+    if (!converted.text.empty())
+        f_out_ << converted.text << std::flush;
+
+#ifdef HAS_HDF5
+    if (h5_writer_)
+        for (const auto& entry : converted.entries) h5_writer_->add_entry(entry);
+#endif
+    if (arrow_writer_)
+        for (const auto& entry : converted.entries) arrow_writer_->add_entry(entry);
+}
@@ -28,12 +28,14 @@
 #include <csignal>       // for sigaction
 #include <dlfcn.h>       // for dlclose
 #include <fcntl.h>       // for S_IRGRP
-#include <fstream>       // for operat...
 #include <functional>    // for _Bind
+#include <future>        // for async, future
 #include <map>           // for operat...
+#include <sstream>       // for ostringstream
 #include <string>        // for allocator
 #include <sys/stat.h>    // for chmod
 #include <thread>        // for thread
+#include <unistd.h>      // for access
 #include <unordered_map> // for operat...
 #include <vector>        // for vector
 
@@ -45,9 +47,11 @@
 #include "goby/middleware/application/configuration_reader.h" // for Config...
 #include "goby/middleware/application/interface.h"            // for run
 #include "goby/middleware/group.h"                            // for operat...
+#include "goby/middleware/log/compression.h"               // for compres...
 #include "goby/middleware/log/dccl_log_plugin.h"              // for DCCLPl...
 #include "goby/middleware/log/groups.h"
 #include "goby/middleware/log/log_entry.h"           // for LogEntry
+#include "goby/middleware/log/log_writer.h"          // for LogWriter
 #include "goby/middleware/log/protobuf_log_plugin.h" // for Protob...
 #include "goby/middleware/marshalling/interface.h"   // for Marsha...
 #include "goby/middleware/protobuf/logger.pb.h"
@@ -74,8 +78,12 @@ class Logger : public goby::zeromq::SingleThreadApplication<protobuf::LoggerConf
     Logger()
         : goby::zeromq::SingleThreadApplication<protobuf::LoggerConfig>(1 *
                                                                         boost::units::si::hertz),
-          log_file_base_(std::string(cfg().log_dir() + "/" + cfg().interprocess().platform()))
+          log_file_base_(std::string(cfg().log_dir() + "/" + cfg().interprocess().platform())),
+          writer_options_(writer_options())
     {
+        // logs are only tagged with a version that may contain compressed blocks if they do
+        goby::middleware::log::LogEntry::set_compressed_blocks(
+            writer_options_.compression != goby::middleware::log::Compression::NONE);
         open_log();
 
         logging_ = cfg().log_at_startup();
@@ -128,10 +136,10 @@ class Logger : public goby::zeromq::SingleThreadApplication<protobuf::LoggerConf
                         break;
 
                     case goby::middleware::protobuf::LoggerRequest::ROTATE_LOG:
-                        glog.is_verbose() && glog << "Log rotated" << std::endl;
+                        glog.is_verbose() && glog << "Rotating log" << std::endl;
                         if (log_is_open())
-                            close_log();
-                        if (!log_is_open())
+                            rotate_log();
+                        else
                             open_log();
                         break;
                 }
@@ -140,7 +148,10 @@ class Logger : public goby::zeromq::SingleThreadApplication<protobuf::LoggerConf
 
     ~Logger() override
     {
-        close_log();
+        if (log_is_open())
+            close_log();
+        // waits for logs being closed in the background
+        closing_.clear();
 
         for (void* handle : dl_handles_) dlclose(handle);
     }
@@ -148,30 +159,101 @@ class Logger : public goby::zeromq::SingleThreadApplication<protobuf::LoggerConf
     static std::atomic<bool> do_quit;
 
   private:
-    void open_log()
+    // a log file opened in the background by rotate_log()
+    struct NextLog
     {
-        pb_plugin_.reset(new goby::middleware::log::ProtobufPlugin);
-        dccl_plugin_.reset(new goby::middleware::log::DCCLPlugin);
+        std::unique_ptr<goby::middleware::log::LogWriter> writer;
+        std::string path;
+    };
+
+    goby::middleware::log::LogWriter::Options writer_options()
+    {
+        goby::middleware::log::LogWriter::Options options;
+        const auto& writer_cfg = cfg().writer();
+        options.queue_size = writer_cfg.queue_size();
+        options.block_size = writer_cfg.block_size();
+        options.flush_interval =
+            std::chrono::milliseconds(static_cast<long>(writer_cfg.flush_interval() * 1000));
+        options.fsync_interval =
+            std::chrono::milliseconds(static_cast<long>(writer_cfg.fsync_interval() * 1000));
+        options.index_block_size = writer_cfg.write_index() ? writer_cfg.index_block_size() : 0;
+        options.compression =
+            static_cast<goby::middleware::log::Compression>(writer_cfg.compression());
+        options.compression_level = writer_cfg.compression_level();
+        options.compression_block_size = writer_cfg.compression_block_size();
+        options.preallocate = static_cast<std::uint64_t>(writer_cfg.has_preallocate_mb()
+                                                             ? writer_cfg.preallocate_mb()
+                                                             : cfg().rotate().max_size_mb()) *
+                              bytes_per_mb;
+        if (!goby::middleware::log::compression_available(options.compression))
+        {
+            glog.is_warn() && glog << "Log compression "
+                                   << goby::middleware::log::compression_name(options.compression)
+                                   << " is not available in this build of Goby, writing the log "
+                                      "uncompressed"
+                                   << std::endl;
+            options.compression = goby::middleware::log::Compression::NONE;
+        }
+        return options;
+    }
 
+    std::string new_log_path()
+    {
         std::string timestamp =
             cfg().omit().file_timestamp() ? "" : std::string("_") + goby::time::file_str();
-        log_file_path_ = log_file_base_ + timestamp + ".goby";
-        log_.reset(new std::ofstream(log_file_path_.c_str(), std::ofstream::binary));
+        return log_file_base_ + timestamp + ".goby";
+    }
 
-        if (!log_->is_open())
+    void open_log()
+    {
+        std::string path = new_log_path();
+        std::unique_ptr<goby::middleware::log::LogWriter> writer;
+        try
+        {
+            writer.reset(new goby::middleware::log::LogWriter(path, writer_options_));
+        }
+        catch (const goby::middleware::log::LogException& e)
+        {
             glog.is_die() && glog << "Failed to open log in directory: " << cfg().log_dir()
-                                  << std::endl;
-        else
-            glog.is_verbose() && glog << "Logging to: " << log_file_path_ << std::endl;
+                                  << ": " << e.what() << std::endl;
+        }
+        update_symlink(path);
+        start_log(std::move(writer), path);
+    }
+
+    // write entries to writer from now on
+    void start_log(std::unique_ptr<goby::middleware::log::LogWriter> writer,
+                   const std::string& path)
+    {
+        // each log has its own group and type index entries and Protobuf file descriptors, so that it can be read on its own
+        goby::middleware::log::LogEntry::reset();
+        pb_plugin_.reset(new goby::middleware::log::ProtobufPlugin);
+        dccl_plugin_.reset(new goby::middleware::log::DCCLPlugin);
 
-        pb_plugin_->register_write_hooks(*log_);
-        dccl_plugin_->register_write_hooks(*log_);
+        log_ = std::move(writer);
+        log_file_path_ = path;
+        glog.is_verbose() && glog << "Logging to: " << log_file_path_ << std::endl;
+        reported_dropped_ = 0;
+        health_bytes_written_ = 0;
+        health_dropped_entries_ = 0;
+
+        // entries (and metadata written by the plugins) are serialized here, and then queued for the writer thread
+        staging_.str(std::string());
+        pb_plugin_->register_write_hooks(staging_);
+        dccl_plugin_->register_write_hooks(staging_);
+
+        rotate_time_ = std::chrono::steady_clock::now() +
+                       std::chrono::milliseconds(
+                           static_cast<long>(cfg().rotate().interval() * 1000));
+    }
 
+    void update_symlink(const std::string& path)
+    {
         if (!cfg().omit().latest_symlink())
         {
             std::string file_symlink = log_file_base_ + "_latest.goby";
             remove(file_symlink.c_str());
-            int result = symlink(realpath(log_file_path_.c_str(), NULL), file_symlink.c_str());
+            int result = symlink(realpath(path.c_str(), NULL), file_symlink.c_str());
             if (result != 0)
                 glog.is_warn() &&
                     glog << "Cannot create symlink to latest file. Continuing onwards anyway"
@@ -179,33 +261,179 @@ class Logger : public goby::zeromq::SingleThreadApplication<protobuf::LoggerConf
         }
     }
 
+    void set_read_only(const std::string& path)
+    {
+        chmod(path.c_str(), S_IRUSR | S_IRGRP);
+        if (cfg().writer().write_index())
+            chmod(goby::middleware::log::LogIndex::path(path).c_str(), S_IRUSR | S_IRGRP);
+    }
+
     void close_log()
     {
+        discard_next_log();
+
         glog.is_verbose() && glog << "Closing log at: " << log_file_path_ << std::endl;
         log_->close();
+        report_dropped();
         log_.reset();
         goby::middleware::log::LogEntry::reset();
 
         pb_plugin_.reset();
         dccl_plugin_.reset();
 
-        // set read only
-        chmod(log_file_path_.c_str(), S_IRUSR | S_IRGRP);
+        set_read_only(log_file_path_);
+    }
+
+    // open the next log in the background, so that writing entries is not held up by the filesystem (switch_log() switches to it once open)
+    void rotate_log()
+    {
+        if (next_log_.valid())
+            return;
+
+        next_log_ = std::async(std::launch::async,
+                               [this]()
+                               {
+                                   NextLog next;
+                                   next.path = new_log_path();
+                                   // don't overwrite a log written earlier (e.g. within the same second)
+                                   const std::string stem =
+                                       next.path.substr(0, next.path.rfind(".goby"));
+                                   for (int i = 1; access(next.path.c_str(), F_OK) == 0; ++i)
+                                       next.path = stem + "_" + std::to_string(i) + ".goby";
+                                   next.writer.reset(new goby::middleware::log::LogWriter(
+                                       next.path, writer_options_));
+                                   return next;
+                               });
+    }
+
+    // switch to the log opened by rotate_log(), if it is ready
+    void switch_log()
+    {
+        if (!next_log_.valid() ||
+            next_log_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+
+        NextLog next;
+        try
+        {
+            next = next_log_.get();
+        }
+        catch (const goby::middleware::log::LogException& e)
+        {
+            glog.is_warn() && glog << "Failed to open next log (continuing to write to "
+                                   << log_file_path_ << "): " << e.what() << std::endl;
+            rotate_retry_time_ = std::chrono::steady_clock::now() + rotate_retry_interval;
+            return;
+        }
+
+        report_dropped();
+        glog.is_verbose() && glog << "Log rotated" << std::endl;
+
+        // here rather than in the close task below, as those may finish out of order
+        update_symlink(next.path);
+
+        // finish writing the current log in the background
+        closing_.push_back(std::async(std::launch::async,
+                                      [this, previous = std::move(log_),
+                                       previous_path = log_file_path_]()
+                                      {
+                                          previous->close();
+                                          set_read_only(previous_path);
+                                      }));
+
+        start_log(std::move(next.writer), next.path);
+    }
+
+    // close and remove a log opened by rotate_log() that was not switched to
+    void discard_next_log()
+    {
+        if (!next_log_.valid())
+            return;
+
+        try
+        {
+            NextLog next = next_log_.get();
+            next.writer->close();
+            remove(next.path.c_str());
+            remove(goby::middleware::log::LogIndex::path(next.path).c_str());
+        }
+        catch (const goby::middleware::log::LogException&)
+        {
+            // it could not be opened, so there is nothing to remove
+        }
+    }
+
+    bool rotation_due()
+    {
+        const auto& rotate = cfg().rotate();
+        if (next_log_.valid() || (rotate.max_size_mb() == 0 && rotate.interval() <= 0))
+            return false;
+
+        auto now = std::chrono::steady_clock::now();
+        bool due = (rotate.max_size_mb() > 0 &&
+                    log_->statistics().bytes_written >=
+                        static_cast<std::uint64_t>(rotate.max_size_mb()) * bytes_per_mb) ||
+                   (rotate.interval() > 0 && now >= rotate_time_);
+        return due && now >= rotate_retry_time_;
     }
 
     void log(const std::vector<unsigned char>& data, int scheme, const std::string& type,
              const goby::middleware::Group& group);
     void loop() override
     {
+        if (log_is_open())
+        {
+            log_->flush_pending();
+            report_dropped();
+
+            switch_log();
+            if (logging_ && rotation_due())
+                rotate_log();
+        }
+
+        // logs closed in the background
+        for (auto it = closing_.begin(); it != closing_.end();)
+        {
+            if (it->wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+                it = closing_.erase(it);
+            else
+                ++it;
+        }
+
         if (do_quit)
             quit();
     }
+
+    void health(goby::middleware::protobuf::ThreadHealth& health) override;
+
+    void report_dropped()
+    {
+        auto dropped = log_->statistics().dropped_entries;
+        if (dropped > reported_dropped_)
+        {
+            glog.is_warn() && glog << "Dropped " << dropped - reported_dropped_
+                                   << " entries as the log writer queue was full" << std::endl;
+            reported_dropped_ = dropped;
+        }
+    }
+
     bool log_is_open() { return log_.get() != nullptr; }
 
   private:
+    static constexpr std::uint64_t bytes_per_mb{1024 * 1024};
+    static constexpr std::chrono::seconds rotate_retry_interval{10};
+
     std::string log_file_base_;
+    goby::middleware::log::LogWriter::Options writer_options_;
     std::string log_file_path_;
-    std::unique_ptr<std::ofstream> log_;
+    std::unique_ptr<goby::middleware::log::LogWriter> log_;
+    std::ostringstream staging_;
+    std::uint64_t reported_dropped_{0};
+
+    // for computing bytes per second in health()
+    std::uint64_t health_bytes_written_{0};
+    std::uint64_t health_dropped_entries_{0};
+    std::chrono::steady_clock::time_point health_time_{std::chrono::steady_clock::now()};
 
     std::vector<void*> dl_handles_;
 
@@ -213,12 +441,20 @@ class Logger : public goby::zeromq::SingleThreadApplication<protobuf::LoggerConf
     std::unique_ptr<goby::middleware::log::DCCLPlugin> dccl_plugin_;
 
     bool logging_{true};
+
+    // automatic rotation (see rotation_due())
+    std::chrono::steady_clock::time_point rotate_time_;
+    std::chrono::steady_clock::time_point rotate_retry_time_;
+    std::future<NextLog> next_log_;
+    std::vector<std::future<void>> closing_;
 };
 } // namespace zeromq
 } // namespace apps
 } // namespace goby
 
 std::atomic<bool> goby::apps::zeromq::Logger::do_quit{false};
+constexpr std::uint64_t goby::apps::zeromq::Logger::bytes_per_mb;
+constexpr std::chrono::seconds goby::apps::zeromq::Logger::rotate_retry_interval;
 
 int main(int argc, char* argv[])
 {
@@ -264,5 +500,50 @@ void goby::apps::zeromq::Logger::log(const std::vector<unsigned char>& data, int
                              << type << ", " << group << "]" << std::endl;
 
     goby::middleware::log::LogEntry entry(data, scheme, type, group);
-    entry.serialize(&*log_);
+    entry.serialize(&staging_);
+
+    std::string bytes = staging_.str();
+    staging_.str(std::string());
+    log_->write(bytes, entry);
+
+    switch_log();
+    if (rotation_due())
+        rotate_log();
+}
+
+void goby::apps::zeromq::Logger::health(goby::middleware::protobuf::ThreadHealth& health)
+{
+    goby::zeromq::SingleThreadApplication<protobuf::LoggerConfig>::health(health);
+    if (!log_is_open())
+        return;
+
+    auto stats = log_->statistics();
+    auto now = std::chrono::steady_clock::now();
+    auto dt = std::chrono::duration<double>(now - health_time_).count();
+
+    auto& logger_health = *health.MutableExtension(goby::middleware::protobuf::logger);
+    logger_health.set_log_file(log_file_path_);
+    logger_health.set_queue_depth(stats.queue_depth);
+    logger_health.set_queue_capacity(stats.queue_capacity);
+    if (dt > 0)
+        logger_health.set_bytes_per_second((stats.bytes_written - health_bytes_written_) / dt);
+    logger_health.set_bytes_written(stats.bytes_written);
+    logger_health.set_entries_written(stats.entries_written);
+    logger_health.set_dropped_entries(stats.dropped_entries);
+    logger_health.set_write_errors(stats.write_errors);
+
+    if (stats.write_errors > 0)
+    {
+        health.set_state(goby::middleware::protobuf::HEALTH__FAILED);
+        health.set_error_message("Errors writing to log file");
+    }
+    else if (stats.dropped_entries > health_dropped_entries_)
+    {
+        health.set_state(goby::middleware::protobuf::HEALTH__DEGRADED);
+        health.set_error_message("Log entries dropped as the disk could not keep up");
+    }
+
+    health_bytes_written_ = stats.bytes_written;
+    health_dropped_entries_ = stats.dropped_entries;
+    health_time_ = now;
 }
@@ -21,10 +21,20 @@
 // You should have received a copy of the GNU General Public License
 // along with Goby.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <chrono>  // for steady_clock
+#include <limits>  // for numeric_limits
+#include <queue>   // for priority_queue
+#include <tuple>   // for tuple
+#include <utility> // for move
+
 #include "goby/middleware/marshalling/protobuf.h"
 
 #include "goby/middleware/log/dccl_log_plugin.h" // for DCCLPl...
+#include "goby/middleware/log/groups.h"          // for playback_request
 #include "goby/middleware/log/log_entry.h"       // for LogEntry
+#include "goby/middleware/log/log_index.h"       // for LogIndex
+#include "goby/middleware/protobuf/logger.pb.h"  // for PlaybackRequest
+#include "goby/time/simulation.h"                // for SimulatorSettings
 #include "goby/zeromq/application/single_thread.h"
 #include "goby/zeromq/protobuf/interprocess_config.pb.h"
 #include "goby/zeromq/protobuf/logger_config.pb.h"
@@ -41,13 +51,10 @@ namespace zeromq
 class Playback : public goby::zeromq::SingleThreadApplication<protobuf::PlaybackConfig>
 {
   public:
+    // loop() waits (using poll()) until each entry is due, so is called as often as it returns
     Playback()
-        : goby::zeromq::SingleThreadApplication<protobuf::PlaybackConfig>(100 *
-                                                                          boost::units::si::hertz),
-          f_in_(cfg().input_file().c_str()),
-          playback_start_(goby::time::SystemClock::now() +
-                          goby::time::convert_duration<goby::time::SystemClock::duration>(
-                              cfg().playback_start_delay_with_units())),
+        : goby::zeromq::SingleThreadApplication<protobuf::PlaybackConfig>(
+              std::numeric_limits<double>::infinity() * boost::units::si::hertz),
           group_regex_(cfg().group_regex()),
           internal_group_regex_("goby::zeromq::_internal_.*")
     {
@@ -62,20 +69,62 @@ class Playback : public goby::zeromq::SingleThreadApplication<protobuf::Playback
             dl_handles_.push_back(lib_handle);
         }
 
+        sources_.emplace_back(new Source(cfg().input_file(), 0));
+        for (const auto& file : cfg().merge_file())
+            sources_.emplace_back(new Source(file, sources_.size()));
+
         plugins_[goby::middleware::MarshallingScheme::PROTOBUF] =
             std::make_unique<goby::middleware::log::ProtobufPlugin>();
         plugins_[goby::middleware::MarshallingScheme::DCCL] =
             std::make_unique<goby::middleware::log::DCCLPlugin>();
 
-        for (auto& p : plugins_) p.second->register_read_hooks(f_in_);
+        for (auto& p : plugins_) p.second->register_read_hooks(sources_.front()->in);
+
+        // the start of the log(s) is the first entry of any of them
+        log_origin_ = goby::time::SystemClock::time_point::max();
+        for (auto& source : sources_)
+        {
+            if (!source->in.is_open())
+                glog.is_die() && glog << "Failed to open log: " << source->file << std::endl;
+
+            if (cfg().use_index())
+                source->index = goby::middleware::log::LogIndex::load(source->file);
+
+            read_entry(*source);
+            if (!source->done)
+            {
+                source->has_entries = true;
+                source->first_offset = source->next.offset();
+                log_origin_ = std::min(log_origin_, source->next.timestamp());
+            }
+        }
 
-        read_next_entry();
-        log_start_ = next_log_entry_.timestamp() +
-                     goby::time::convert_duration<goby::time::SystemClock::duration>(
-                         cfg().start_from_offset_with_units());
+        log_anchor_ = log_origin_ + goby::time::convert_duration<goby::time::SystemClock::duration>(
+                                        cfg().start_from_offset_with_units());
 
-        // skip to desired start
-        while (next_log_entry_.timestamp() < log_start_) read_next_entry();
+        for (auto& source : sources_)
+        {
+            if (source->index)
+            {
+                // skip blocks containing only entries that won't be played back
+                source->index->set_filter(
+                    [this](const goby::middleware::log::LogIndex::Key& key)
+                    { return !is_filtered(key.scheme, key.group, key.type); });
+            }
+
+            // skip to desired start
+            if (!source->done)
+                seek(*source, log_anchor_);
+        }
+        reorder();
+
+        wall_anchor_ = std::chrono::steady_clock::now() +
+                       goby::time::convert_duration<goby::time::SystemClock::duration>(
+                           cfg().playback_start_delay_with_units());
+
+        interprocess().subscribe<goby::middleware::groups::playback_request>(
+            [this](const goby::middleware::protobuf::PlaybackRequest& request)
+            { handle_request(request); });
     }
 
     ~Playback() override
@@ -84,71 +133,265 @@ class Playback : public goby::zeromq::SingleThreadApplication<protobuf::Playback
     }
 
   private:
+    // a log being played back
+    struct Source
+    {
+        Source(std::string file_name, int source_order)
+            : file(std::move(file_name)), in(file.c_str()), order(source_order)
+        {
+        }
+
+        std::string file;
+        std::ifstream in;
+        std::unique_ptr<goby::middleware::log::LogIndex> index;
+        // state of LogEntry::parse() for this log
+        goby::middleware::log::LogEntry::ReadState state;
+        goby::middleware::log::LogEntry next;
+        bool has_entries{false};
+        // offset of the first entry, to seek back to without an index
+        std::uint64_t first_offset{0};
+        // position in the configuration (input_file first), to order entries with the same timestamp
+        int order;
+        bool done{false};
+    };
+
+    // makes the state of LogEntry::parse() that of the source while in scope
+    class Reading
+    {
+      public:
+        Reading(Source& source) : source_(source)
+        {
+            goby::middleware::log::LogEntry::swap_read_state(source_.state);
+        }
+        ~Reading() { goby::middleware::log::LogEntry::swap_read_state(source_.state); }
+
+      private:
+        Source& source_;
+    };
+
+    // orders the queue of sources so that the one whose next entry is earliest is on top
+    struct Later
+    {
+        bool operator()(const Source* a, const Source* b) const
+        {
+            return std::make_tuple(a->next.timestamp(), a->order) >
+                   std::make_tuple(b->next.timestamp(), b->order);
+        }
+    };
+
     void loop() override
     {
-        while (is_time_to_publish())
+        auto now = std::chrono::steady_clock::now();
+        while (!paused_ && !queue_.empty() && due_time(queue_.top()->next) <= now)
+        {
+            Source* source = queue_.top();
+            queue_.pop();
+
+            const auto& entry = source->next;
+            glog.is_verbose() && glog << "Playing back: " << entry.scheme() << " | "
+                                      << entry.group() << " | " << entry.type() << " | "
+                                      << goby::time::convert<boost::posix_time::ptime>(
+                                             entry.timestamp())
+                                      << std::endl;
+
+            std::vector<char> data(entry.data().begin(), entry.data().end());
+            interprocess().publish_serialized(entry.type(), entry.scheme(), data, entry.group());
+
+            read_next_entry(*source);
+            if (!source->done)
+                queue_.push(source);
+        }
+
+        if (queue_.empty())
+        {
+            glog.is_verbose() && glog << "No further entries to play back" << std::endl;
+            quit();
+            return;
+        }
+
+        // handle any requests until the next entry is due
+        if (paused_)
+            interprocess().poll();
+        else
+            interprocess().poll(due_time(queue_.top()->next));
+    }
+
+    void handle_request(const goby::middleware::protobuf::PlaybackRequest& request)
+    {
+        auto now = std::chrono::steady_clock::now();
+
+        // continue from the current position in the log, so that any changes apply from now
+        if (!paused_ && now > wall_anchor_)
         {
-            // playback the entry
-            if (!is_filtered())
+            log_anchor_ = log_time(now);
+            wall_anchor_ = now;
+        }
+
+        if (request.has_seek_to())
+        {
+            auto time = log_origin_ +
+                        goby::time::convert_duration<goby::time::SystemClock::duration>(
+                            request.seek_to() * boost::units::si::seconds);
+            glog.is_verbose() && glog << "Seeking to "
+                                      << goby::time::convert<boost::posix_time::ptime>(time)
+                                      << std::endl;
+            for (auto& source : sources_) seek(*source, time);
+            reorder();
+            log_anchor_ = time;
+            wall_anchor_ = std::max(now, wall_anchor_);
+        }
+
+        if (request.has_rate())
+        {
+            if (request.rate() > 0)
             {
-                glog.is_verbose() && glog << "Playing back: " << next_log_entry_.scheme() << " | "
-                                          << next_log_entry_.group() << " | "
-                                          << next_log_entry_.type() << " | "
-                                          << goby::time::convert<boost::posix_time::ptime>(
-                                                 next_log_entry_.timestamp())
-                                          << std::endl;
+                glog.is_verbose() && glog << "Playback rate: " << request.rate() << std::endl;
+                rate_ = request.rate();
+            }
+            else
+            {
+                glog.is_warn() && glog << "Ignoring invalid playback rate: " << request.rate()
+                                       << std::endl;
+            }
+        }
 
-                std::vector<char> data(next_log_entry_.data().begin(),
-                                       next_log_entry_.data().end());
+        if (request.has_requested_state())
+        {
+            bool pause =
+                request.requested_state() == goby::middleware::protobuf::PlaybackRequest::PAUSE;
+            if (paused_ && !pause)
+                wall_anchor_ = std::max(now, wall_anchor_);
+            paused_ = pause;
+            glog.is_verbose() && glog << (paused_ ? "Playback paused" : "Playback resumed")
+                                      << std::endl;
+        }
+    }
+
+    // playback rate, also accounting for any simulation warp
+    double speed() const
+    {
+        return goby::time::SimulatorSettings::using_sim_time
+                   ? rate_ * goby::time::SimulatorSettings::warp_factor
+                   : rate_;
+    }
 
-                interprocess().publish_serialized(next_log_entry_.type(), next_log_entry_.scheme(),
-                                                  data, next_log_entry_.group());
+    // wall time at which entry is to be played back
+    std::chrono::steady_clock::time_point
+    due_time(const goby::middleware::log::LogEntry& entry) const
+    {
+        return wall_anchor_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                  (entry.timestamp() - log_anchor_) / speed());
+    }
+
+    // time in the log being played back at wall time now (after wall_anchor_)
+    goby::time::SystemClock::time_point log_time(std::chrono::steady_clock::time_point now) const
+    {
+        return log_anchor_ + std::chrono::duration_cast<goby::time::SystemClock::duration>(
+                                 (now - wall_anchor_) * speed());
+    }
+
+    // position source so that its next entry is the first to be played back at or after time
+    void seek(Source& source, goby::time::SystemClock::time_point time)
+    {
+        if (!source.has_entries)
+            return;
+
+        bool backward = source.done || time < source.next.timestamp();
+        if (source.index)
+        {
+            // seek to the block containing time
+            const auto& block = source.index->blocks()[source.index->find_block(time)];
+            if (backward || block.offset() > source.next.offset())
+            {
+                {
+                    Reading reading(source);
+                    source.in.clear();
+                    source.index->seek(source.in, block.offset());
+                }
+                source.done = false;
+                read_next_entry(source);
             }
+        }
+        else if (backward)
+        {
+            // read again from the first entry
+            {
+                Reading reading(source);
+                source.in.clear();
+                goby::middleware::log::LogEntry::seek(&source.in, source.first_offset);
+            }
+            source.done = false;
+            read_next_entry(source);
+        }
+
+        if (!source.done && is_filtered(source.next))
+            read_next_entry(source);
+        while (!source.done && source.next.timestamp() < time) read_next_entry(source);
+    }
 
-            // read the next entry
-            read_next_entry();
+    void reorder()
+    {
+        queue_ = decltype(queue_)();
+        for (auto& source : sources_)
+        {
+            if (!source->done)
+                queue_.push(source.get());
         }
+    }
 
-        if (do_quit_)
-            quit();
+    // read the next entry to be played back
+    void read_next_entry(Source& source)
+    {
+        do read_entry(source);
+        while (!source.done && is_filtered(source.next));
     }
 
-    void read_next_entry()
+    void read_entry(Source& source)
     {
+        Reading reading(source);
         try
         {
-            next_log_entry_.parse(&f_in_);
+            if (source.index && !source.index->next(source.in))
+            {
+                glog.is_verbose() && glog << "No further entries to play back in " << source.file
+                                          << std::endl;
+                source.done = true;
+                return;
+            }
+
+            source.next.parse(&source.in);
         }
         catch (goby::middleware::log::LogException& e)
         {
-            glog.is_warn() && glog << "Exception processing input log (will attempt to continue): "
-                                   << e.what() << std::endl;
+            glog.is_warn() && glog << "Exception processing input log " << source.file
+                                   << " (will attempt to continue): " << e.what() << std::endl;
         }
         catch (std::exception& e)
         {
-            if (!f_in_.eof())
-                glog.is_warn() && glog << "Error processing input log: " << e.what() << std::endl;
+            if (!source.in.eof())
+                glog.is_warn() && glog << "Error processing input log " << source.file << ": "
+                                       << e.what() << std::endl;
             else
-                glog.is_verbose() && glog << "Reached EOF" << std::endl;
-            do_quit_ = true;
+                glog.is_verbose() && glog << "Reached EOF of " << source.file << std::endl;
+            source.done = true;
         }
     }
 
-    bool is_time_to_publish()
+    bool is_filtered(const goby::middleware::log::LogEntry& entry)
     {
-        if (do_quit_)
-            return false;
-
-        auto now = goby::time::SystemClock::now();
-        auto dt_log = next_log_entry_.timestamp() - log_start_;
-        auto dt_wall = now - playback_start_;
-        // as much wall time has elapsed (modified by rate) as log time
-        return (dt_wall * cfg().rate()) >= dt_log;
+        // heterogeneous lookup, so the group string is only copied for a new key
+        std::tuple<int, const char*, const std::string&> key(entry.scheme(), entry.group().c_str(),
+                                                             entry.type());
+        auto it = filtered_.find(key);
+        if (it == filtered_.end())
+            it = filtered_
+                     .emplace(key, is_filtered(entry.scheme(), entry.group(), entry.type()))
+                     .first;
+        return it->second;
     }
 
-    bool is_filtered()
+    bool is_filtered(int scheme, const std::string& group, const std::string& type)
     {
-        std::string group = next_log_entry_.group();
         bool internal_group_is_filtered = std::regex_match(group, internal_group_regex_);
 
         // check regex and type_filters
@@ -159,10 +402,10 @@ class Playback : public goby::zeromq::SingleThreadApplication<protobuf::Playback
         bool type_is_filtered = true;
         if (!type_regex_.empty())
         {
-            auto it_p = type_regex_.equal_range(next_log_entry_.scheme());
+            auto it_p = type_regex_.equal_range(scheme);
             for (auto it = it_p.first; it != it_p.second; ++it)
             {
-                if (std::regex_match(next_log_entry_.type(), it->second))
+                if (std::regex_match(type, it->second))
                     type_is_filtered = false;
             }
         }
@@ -182,18 +425,25 @@ class Playback : public goby::zeromq::SingleThreadApplication<protobuf::Playback
     // scheme to plugin
     std::map<int, std::unique_ptr<goby::middleware::log::LogPlugin>> plugins_;
 
-    std::ifstream f_in_;
+    std::vector<std::unique_ptr<Source>> sources_;
+    // sources with entries remaining, by their next entry
+    std::priority_queue<Source*, std::vector<Source*>, Later> queue_;
 
-    goby::middleware::log::LogEntry next_log_entry_;
+    // time of the first entry of all the sources
+    goby::time::SystemClock::time_point log_origin_;
 
-    goby::time::SystemClock::time_point log_start_;
-    goby::time::SystemClock::time_point playback_start_;
+    // log_anchor_ (in the log) is played back at wall_anchor_, and later entries after the difference in time divided by speed()
+    goby::time::SystemClock::time_point log_anchor_;
+    std::chrono::steady_clock::time_point wall_anchor_;
+    double rate_{cfg().rate()};
+    bool paused_{false};
 
     std::regex group_regex_;
     std::regex internal_group_regex_;
     std::multimap<int, std::regex> type_regex_;
 
-    bool do_quit_{false};
+    // result of is_filtered() for each (scheme, group, type) read, so that the regexes are only evaluated once for each
+    std::map<std::tuple<int, std::string, std::string>, bool, std::less<>> filtered_;
 };
 } // namespace zeromq
 } // namespace apps
@@ -26,6 +26,7 @@
 #define GOBY_MIDDLEWARE_GROUP_H
 
 #include <cstdint>
+#include <cstring>
 #include <limits>
 #include <memory>
 #include <string>
@@ -56,6 +57,8 @@ namespace middleware
 /// // For use on all layers (string and numeric)
 /// constexpr goby::middleware::Group example_status{"status", 2};
 /// \endcode
+///
+/// The hash of the group is computed once on construction (at compile time for \c constexpr instances), so that lookups using Group as a key do not allocate.
 class Group
 {
   public:
@@ -68,10 +71,16 @@ class Group
                                                        1};
 
     /// \brief Construct a group with a (C-style) string and possibly a numeric value (when this Group will be used on intervehicle and outer layers).
-    constexpr Group(const char* c, std::uint32_t i = invalid_numeric_group) : c_(c), i_(i) {}
+    constexpr Group(const char* c, std::uint32_t i = invalid_numeric_group)
+        : c_(c), i_(i), hash_(compute_hash(c, i))
+    {
+    }
 
     /// \brief Construct a group with only a numeric value
-    constexpr Group(std::uint32_t i = invalid_numeric_group) : i_(i) {}
+    constexpr Group(std::uint32_t i = invalid_numeric_group)
+        : i_(i), hash_(compute_hash(nullptr, i))
+    {
+    }
 
     /// \brief Access the group's numeric value
     constexpr std::uint32_t numeric() const { return i_; }
@@ -79,6 +88,9 @@ class Group
     /// \brief Access the group's string value as a C string
     constexpr const char* c_str() const { return c_; }
 
+    /// \brief Precomputed hash of the string and numeric values
+    constexpr std::uint64_t hash() const { return hash_; }
+
     /// \brief Access the group's string value as a C++ string
     operator std::string() const
     {
@@ -96,19 +108,57 @@ class Group
     }
 
   protected:
-    void set_c_str(const char* c) { c_ = c; }
+    void set_c_str(const char* c)
+    {
+        c_ = c;
+        hash_ = compute_hash(c_, i_);
+    }
+
+  private:
+    // FNV-1a (64 bit) over the string, followed by the four bytes of the numeric value
+    static constexpr std::uint64_t compute_hash(const char* c, std::uint32_t i)
+    {
+        std::uint64_t h = 0xcbf29ce484222325ull;
+        if (c != nullptr)
+        {
+            for (; *c != '\0'; ++c)
+            {
+                h ^= static_cast<unsigned char>(*c);
+                h *= 0x100000001b3ull;
+            }
+        }
+        for (int b = 0; b < 4; ++b)
+        {
+            h ^= (i >> (8 * b)) & 0xFF;
+            h *= 0x100000001b3ull;
+        }
+        return h;
+    }
 
   private:
     const char* c_{nullptr};
     std::uint32_t i_{invalid_numeric_group};
+    std::uint64_t hash_{0};
 };
 
 inline bool operator==(const Group& a, const Group& b)
 {
+    if (a.numeric() != b.numeric())
+        return false;
+
     if (a.c_str() != nullptr && b.c_str() != nullptr)
-        return (std::string(a.c_str()) == std::string(b.c_str())) && (a.numeric() == b.numeric());
+    {
+        // same literal, or copies of the same DynamicGroup
+        if (a.c_str() == b.c_str())
+            return true;
+        if (a.hash() != b.hash())
+            return false;
+        return std::strcmp(a.c_str(), b.c_str()) == 0;
+    }
     else
-        return a.numeric() == b.numeric();
+    {
+        return true;
+    }
 }
 
 inline bool operator!=(const Group& a, const Group& b) { return !(a == b); }
@@ -116,12 +166,14 @@ inline bool operator!=(const Group& a, const Group& b) { return !(a == b); }
 inline std::ostream& operator<<(std::ostream& os, const Group& g) { return (os << std::string(g)); }
 
 /// \brief Implementation of Group for dynamic (run-time) instantiations. Use Group directly for static (compile-time) instantiations.
+///
+/// Copies share the string storage (and so the c_str() pointer), which is released with the last copy. A Group sliced from a DynamicGroup is only valid while the DynamicGroup (or a copy of it) exists.
 class DynamicGroup : public Group
 {
   public:
     /// \brief Construct a group with a string and possibly a numeric value (when this Group will be used on intervehicle and outer layers).
     DynamicGroup(const std::string& s, std::uint32_t i = Group::invalid_numeric_group)
-        : Group(i), s_(new std::string(s))
+        : Group(i), s_(std::make_shared<const std::string>(s))
     {
         Group::set_c_str(s_->c_str());
     }
@@ -129,8 +181,12 @@ class DynamicGroup : public Group
     /// \brief Construct a group with a numeric value only
     DynamicGroup(std::uint32_t i) : Group(i) {}
 
+    // copy (no move), so the source's c_str() stays valid
+    DynamicGroup(const DynamicGroup&) = default;
+    DynamicGroup& operator=(const DynamicGroup&) = default;
+
   private:
-    std::unique_ptr<const std::string> s_;
+    std::shared_ptr<const std::string> s_;
 };
 
 } // namespace middleware
@@ -142,7 +198,8 @@ template <> struct hash<goby::middleware::Group>
 {
     size_t operator()(const goby::middleware::Group& group) const noexcept
     {
-        return std::hash<std::string>{}(std::string(group));
+        std::uint64_t h = group.hash();
+        return static_cast<size_t>(h ^ (h >> 32));
     }
 };
 } // namespace std
@@ -0,0 +1,773 @@
+// Copyright 2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm> // for find, max
+#include <cerrno>    // for errno, EEXIST
+#include <cstring>   // for memcpy, strerror
+#include <fstream>   // for ofstream
+#include <limits>    // for numeric_limits
+#include <vector>    // for vector
+
+#include <sys/stat.h> // for mkdir
+
+#include <dccl/dynamic_protobuf_manager.h> // for DynamicProtob...
+#include <google/protobuf/descriptor.h>    // for FieldDescriptor
+#include <google/protobuf/message.h>       // for Message, Reflection
+
+#include "goby/exception.h"
+#include "goby/util/dccl_compat.h"
+#include "goby/util/debug_logger.h"
+
+#include "arrow.h"
+#include "detail/flatbuffer_builder.h"
+
+using goby::glog;
+using goby::middleware::arrow::detail::FlatBufferBuilder;
+
+constexpr std::size_t goby::middleware::arrow::Writer::default_batch_rows;
+
+namespace
+{
+// Arrow IPC format constants (see Schema.fbs, Message.fbs and File.fbs of the Arrow format)
+constexpr std::int16_t metadata_version_v5{4};
+constexpr std::int16_t endianness_little{0};
+constexpr std::uint8_t message_header_schema{1};
+constexpr std::uint8_t message_header_record_batch{3};
+constexpr std::int16_t precision_single{1};
+constexpr std::int16_t precision_double{2};
+constexpr std::int16_t time_unit_microsecond{2};
+constexpr std::uint32_t continuation_marker{0xFFFFFFFF};
+const std::string file_magic{"ARROW1"};
+
+enum TypeId : std::uint8_t
+{
+    TYPE_INT = 2,
+    TYPE_FLOATING_POINT = 3,
+    TYPE_BINARY = 4,
+    TYPE_UTF8 = 5,
+    TYPE_BOOL = 6,
+    TYPE_TIMESTAMP = 10,
+    TYPE_LIST = 12,
+    TYPE_STRUCT = 13
+};
+
+// FlatBuffers structs
+struct FieldNode
+{
+    std::int64_t length;
+    std::int64_t null_count;
+};
+
+struct Buffer
+{
+    std::int64_t offset;
+    std::int64_t length;
+};
+
+struct Block
+{
+    std::int64_t offset;
+    std::int32_t metadata_length;
+    std::int32_t padding;
+    std::int64_t body_length;
+};
+
+// a batch is written before batch_rows is reached if the int32 offsets of a string, bytes or list column reach this
+constexpr std::int64_t max_batch_offset{256 * 1024 * 1024};
+// limit of those offsets
+constexpr std::int64_t max_offset{std::numeric_limits<std::int32_t>::max()};
+
+// Arrow buffers (and messages) are padded to a multiple of 8 bytes
+std::size_t padding(std::size_t size) { return (8 - size % 8) % 8; }
+
+template <typename T> void append_bytes(std::string& s, T value)
+{
+    s.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// whether the field can be unset (rather than having its default value), including proto3 optional fields
+bool has_presence(const google::protobuf::FieldDescriptor* field_desc)
+{
+#if GOOGLE_PROTOBUF_VERSION >= 3012000
+    return field_desc->has_presence();
+#else
+    return field_desc->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE ||
+           field_desc->containing_oneof() != nullptr ||
+           field_desc->file()->syntax() == google::protobuf::FileDescriptor::SYNTAX_PROTO2;
+#endif
+}
+
+std::vector<const google::protobuf::FieldDescriptor*>
+fields(const google::protobuf::Descriptor* desc)
+{
+    std::vector<const google::protobuf::FieldDescriptor*> fields;
+    for (int i = 0, n = desc->field_count(); i < n; ++i) fields.push_back(desc->field(i));
+
+    std::vector<const google::protobuf::FieldDescriptor*> extensions;
+    google::protobuf::DescriptorPool::generated_pool()->FindAllExtensions(desc, &extensions);
+
+#ifdef DCCL_VERSION_4_1_OR_NEWER
+    dccl::DynamicProtobufManager::user_descriptor_pool_call(
+        &google::protobuf::DescriptorPool::FindAllExtensions, desc, &extensions);
+#else
+    dccl::DynamicProtobufManager::user_descriptor_pool().FindAllExtensions(desc, &extensions);
+#endif
+
+    fields.insert(fields.end(), extensions.begin(), extensions.end());
+    return fields;
+}
+
+// encapsulated IPC message: continuation marker, metadata size, and the (padded) Message flatbuffer
+std::string message(FlatBufferBuilder& fbb, std::uint8_t header_type,
+                    FlatBufferBuilder::Offset header, std::int64_t body_length)
+{
+    fbb.start_table();
+    fbb.add_scalar<std::int16_t>(0, metadata_version_v5);
+    fbb.add_scalar<std::uint8_t>(1, header_type);
+    fbb.add_offset(2, header);
+    fbb.add_scalar<std::int64_t>(3, body_length);
+    std::string metadata = fbb.finish(fbb.end_table());
+    metadata.append(padding(metadata.size()), '\0');
+
+    std::string bytes;
+    append_bytes(bytes, continuation_marker);
+    append_bytes(bytes, static_cast<std::int32_t>(metadata.size()));
+    return bytes + metadata;
+}
+
+// group names may contain '/', so are percent-encoded (as are '%' and a leading '.', so that "." and
+// ".." aren't special); an empty group is "%"
+std::string directory_name(const std::string& group)
+{
+    if (group.empty())
+        return "%";
+
+    std::string name;
+    for (std::size_t i = 0, n = group.size(); i < n; ++i)
+    {
+        char c = group[i];
+        if (c == '/' || c == '%' || (c == '.' && i == 0))
+        {
+            const char* hex = "0123456789ABCDEF";
+            name += '%';
+            name += hex[(c >> 4) & 0xF];
+            name += hex[c & 0xF];
+        }
+        else
+        {
+            name += c;
+        }
+    }
+    return name;
+}
+
+void make_directory(const std::string& path)
+{
+    if (mkdir(path.c_str(), 0777) != 0 && errno != EEXIST)
+        throw(goby::Exception("Failed to create directory " + path + ": " + std::strerror(errno)));
+}
+} // namespace
+
+// values of one column (and its children) for the record batch being built
+struct goby::middleware::arrow::Writer::Column
+{
+    enum class Type
+    {
+        BOOL,
+        INT32,
+        INT64,
+        UINT32,
+        UINT64,
+        FLOAT,
+        DOUBLE,
+        UTF8,
+        BINARY,
+        TIMESTAMP,
+        LIST,
+        STRUCT
+    };
+
+    Column(std::string n, Type t, bool null = true) : name(std::move(n)), type(t), nullable(null)
+    {
+        clear();
+    }
+
+    // column for field_desc, where parents are the message types containing it
+    static Column make(const google::protobuf::FieldDescriptor* field_desc,
+                       std::vector<const google::protobuf::Descriptor*>& parents);
+
+    void append_field(const google::protobuf::Message& msg);
+    void append_null();
+
+    void add_to_batch(std::vector<FieldNode>& nodes, std::vector<Buffer>& buffers,
+                      std::string& body) const;
+    // largest offset of this column or its children (the size of the data of UTF8 and BINARY, the
+    // number of items of LIST)
+    std::int64_t largest_offset() const
+    {
+        std::int64_t largest = offsets.back();
+        for (const auto& child : children) largest = std::max(largest, child.largest_offset());
+        return largest;
+    }
+    FlatBufferBuilder::Offset field(FlatBufferBuilder& fbb) const;
+    void clear();
+
+    std::string name;
+    Type type;
+    bool nullable;
+    // field whose values are written to this column (nullptr for _utime_ and _scheme_)
+    const google::protobuf::FieldDescriptor* field_desc{nullptr};
+    // recursive message written as text
+    bool text{false};
+    // children of a STRUCT, or the item of a LIST
+    std::vector<Column> children;
+
+    std::int64_t length{0};
+    std::int64_t null_count{0};
+    std::vector<std::uint8_t> validity;
+    // fixed width values, bits for BOOL, or data of UTF8 and BINARY
+    std::vector<std::uint8_t> values;
+    // UTF8, BINARY and LIST
+    std::vector<std::int32_t> offsets;
+
+    template <typename T> void append_value(T value)
+    {
+        auto bytes = reinterpret_cast<const std::uint8_t*>(&value);
+        values.insert(values.end(), bytes, bytes + sizeof(value));
+        append_validity(true);
+    }
+
+  private:
+    void append(const google::protobuf::Message& msg, int index);
+    void append_bool(bool value)
+    {
+        if (length % 8 == 0)
+            values.push_back(0);
+        if (value)
+            values.back() |= 1 << (length % 8);
+        append_validity(true);
+    }
+    void append_bytes(const std::string& bytes)
+    {
+        if (static_cast<std::int64_t>(values.size() + bytes.size()) > max_offset)
+            throw(goby::Exception("Data of column " + name +
+                                  " exceeds the 2 GiB limit of an Arrow record batch"));
+        values.insert(values.end(), bytes.begin(), bytes.end());
+        offsets.push_back(values.size());
+        append_validity(true);
+    }
+    void append_validity(bool valid)
+    {
+        if (length % 8 == 0)
+            validity.push_back(0);
+        if (valid)
+            validity.back() |= 1 << (length % 8);
+        else
+            ++null_count;
+        ++length;
+    }
+
+    std::size_t width() const
+    {
+        switch (type)
+        {
+            case Type::INT32:
+            case Type::UINT32:
+            case Type::FLOAT: return 4;
+            case Type::INT64:
+            case Type::UINT64:
+            case Type::DOUBLE:
+            case Type::TIMESTAMP: return 8;
+            default: return 0;
+        }
+    }
+};
+
+// file for one group and type
+struct goby::middleware::arrow::Writer::File
+{
+    std::string path;
+    std::string group;
+    const google::protobuf::Descriptor* desc{nullptr};
+    // instance of desc's message, for messages of the same type from a different descriptor pool
+    std::unique_ptr<google::protobuf::Message> prototype;
+
+    // _utime_, _scheme_, then a column for each field
+    std::vector<Column> columns;
+    // rows in the record batch being built
+    std::int64_t rows{0};
+
+    // bytes written
+    std::uint64_t offset{0};
+    std::vector<Block> record_batches;
+
+    FlatBufferBuilder::Offset schema(FlatBufferBuilder& fbb) const;
+};
+
+goby::middleware::arrow::Writer::Column goby::middleware::arrow::Writer::Column::make(
+    const google::protobuf::FieldDescriptor* field_desc,
+    std::vector<const google::protobuf::Descriptor*>& parents)
+{
+    using google::protobuf::FieldDescriptor;
+
+    Type value_type = Type::STRUCT;
+    bool value_text = false;
+    switch (field_desc->cpp_type())
+    {
+        case FieldDescriptor::CPPTYPE_INT32: value_type = Type::INT32; break;
+        case FieldDescriptor::CPPTYPE_INT64: value_type = Type::INT64; break;
+        case FieldDescriptor::CPPTYPE_UINT32: value_type = Type::UINT32; break;
+        case FieldDescriptor::CPPTYPE_UINT64: value_type = Type::UINT64; break;
+        case FieldDescriptor::CPPTYPE_FLOAT: value_type = Type::FLOAT; break;
+        case FieldDescriptor::CPPTYPE_DOUBLE: value_type = Type::DOUBLE; break;
+        case FieldDescriptor::CPPTYPE_BOOL: value_type = Type::BOOL; break;
+        case FieldDescriptor::CPPTYPE_ENUM: value_type = Type::UTF8; break;
+        case FieldDescriptor::CPPTYPE_STRING:
+            value_type =
+                field_desc->type() == FieldDescriptor::TYPE_BYTES ? Type::BINARY : Type::UTF8;
+            break;
+        case FieldDescriptor::CPPTYPE_MESSAGE:
+            if (std::find(parents.begin(), parents.end(), field_desc->message_type()) !=
+                parents.end())
+            {
+                value_type = Type::UTF8;
+                value_text = true;
+            }
+            break;
+    }
+
+    std::string field_name = field_desc->is_extension() ? field_desc->full_name() : field_desc->name();
+    Column value(field_desc->is_repeated() ? "item" : field_name, value_type);
+    value.field_desc = field_desc;
+    value.text = value_text;
+
+    if (value_type == Type::STRUCT)
+    {
+        parents.push_back(field_desc->message_type());
+        for (const auto* child_desc : fields(field_desc->message_type()))
+            value.children.push_back(make(child_desc, parents));
+        parents.pop_back();
+    }
+
+    if (!field_desc->is_repeated())
+        return value;
+
+    Column list(field_name, Type::LIST);
+    list.field_desc = field_desc;
+    list.children.push_back(std::move(value));
+    return list;
+}
+
+void goby::middleware::arrow::Writer::Column::append_field(const google::protobuf::Message& msg)
+{
+    const auto* refl = msg.GetReflection();
+    if (field_desc->is_repeated())
+    {
+        auto& item = children.front();
+        for (int i = 0, n = refl->FieldSize(msg, field_desc); i < n; ++i) item.append(msg, i);
+        offsets.push_back(item.length);
+        append_validity(true);
+    }
+    else if (has_presence(field_desc) && !refl->HasField(msg, field_desc))
+    {
+        append_null();
+    }
+    else
+    {
+        append(msg, -1);
+    }
+}
+
+// append the value of field_desc in msg (index of a repeated field, or -1)
+void goby::middleware::arrow::Writer::Column::append(const google::protobuf::Message& msg,
+                                                      int index)
+{
+    using google::protobuf::FieldDescriptor;
+
+    const auto* refl = msg.GetReflection();
+    const bool repeated = index >= 0;
+    switch (field_desc->cpp_type())
+    {
+        case FieldDescriptor::CPPTYPE_INT32:
+            append_value(repeated ? refl->GetRepeatedInt32(msg, field_desc, index)
+                                  : refl->GetInt32(msg, field_desc));
+            break;
+        case FieldDescriptor::CPPTYPE_INT64:
+            append_value(repeated ? refl->GetRepeatedInt64(msg, field_desc, index)
+                                  : refl->GetInt64(msg, field_desc));
+            break;
+        case FieldDescriptor::CPPTYPE_UINT32:
+            append_value(repeated ? refl->GetRepeatedUInt32(msg, field_desc, index)
+                                  : refl->GetUInt32(msg, field_desc));
+            break;
+        case FieldDescriptor::CPPTYPE_UINT64:
+            append_value(repeated ? refl->GetRepeatedUInt64(msg, field_desc, index)
+                                  : refl->GetUInt64(msg, field_desc));
+            break;
+        case FieldDescriptor::CPPTYPE_FLOAT:
+            append_value(repeated ? refl->GetRepeatedFloat(msg, field_desc, index)
+                                  : refl->GetFloat(msg, field_desc));
+            break;
+        case FieldDescriptor::CPPTYPE_DOUBLE:
+            append_value(repeated ? refl->GetRepeatedDouble(msg, field_desc, index)
+                                  : refl->GetDouble(msg, field_desc));
+            break;
+        case FieldDescriptor::CPPTYPE_BOOL:
+            append_bool(repeated ? refl->GetRepeatedBool(msg, field_desc, index)
+                                 : refl->GetBool(msg, field_desc));
+            break;
+        case FieldDescriptor::CPPTYPE_ENUM:
+        {
+            int number = repeated ? refl->GetRepeatedEnumValue(msg, field_desc, index)
+                                  : refl->GetEnumValue(msg, field_desc);
+            const auto* value_desc = field_desc->enum_type()->FindValueByNumber(number);
+            append_bytes(value_desc ? value_desc->name() : std::to_string(number));
+            break;
+        }
+        case FieldDescriptor::CPPTYPE_STRING:
+        {
+            std::string scratch;
+            append_bytes(repeated
+                             ? refl->GetRepeatedStringReference(msg, field_desc, index, &scratch)
+                             : refl->GetStringReference(msg, field_desc, &scratch));
+            break;
+        }
+        case FieldDescriptor::CPPTYPE_MESSAGE:
+        {
+            const auto& sub_msg = repeated ? refl->GetRepeatedMessage(msg, field_desc, index)
+                                           : refl->GetMessage(msg, field_desc);
+            if (text)
+            {
+                append_bytes(sub_msg.ShortDebugString());
+            }
+            else
+            {
+                for (auto& child : children) child.append_field(sub_msg);
+                append_validity(true);
+            }
+            break;
+        }
+    }
+}
+
+void goby::middleware::arrow::Writer::Column::append_null()
+{
+    switch (type)
+    {
+        case Type::BOOL:
+            if (length % 8 == 0)
+                values.push_back(0);
+            break;
+        case Type::UTF8:
+        case Type::BINARY:
+        case Type::LIST: offsets.push_back(offsets.back()); break;
+        case Type::STRUCT:
+            for (auto& child : children) child.append_null();
+            break;
+        default: values.insert(values.end(), width(), 0); break;
+    }
+    append_validity(false);
+}
+
+void goby::middleware::arrow::Writer::Column::add_to_batch(std::vector<FieldNode>& nodes,
+                                                            std::vector<Buffer>& buffers,
+                                                            std::string& body) const
+{
+    auto add_buffer = [&](const void* data, std::size_t size) {
+        buffers.push_back({static_cast<std::int64_t>(body.size()), static_cast<std::int64_t>(size)});
+        body.append(static_cast<const char*>(data), size);
+        body.append(padding(size), '\0');
+    };
+
+    nodes.push_back({length, null_count});
+    // the validity bitmap may be omitted if there are no nulls
+    add_buffer(validity.data(), null_count ? validity.size() : 0);
+
+    switch (type)
+    {
+        case Type::STRUCT:
+            for (const auto& child : children) child.add_to_batch(nodes, buffers, body);
+            break;
+        case Type::LIST:
+            add_buffer(offsets.data(), offsets.size() * sizeof(std::int32_t));
+            children.front().add_to_batch(nodes, buffers, body);
+            break;
+        case Type::UTF8:
+        case Type::BINARY:
+            add_buffer(offsets.data(), offsets.size() * sizeof(std::int32_t));
+            add_buffer(values.data(), values.size());
+            break;
+        default: add_buffer(values.data(), values.size()); break;
+    }
+}
+
+// Field table of the schema
+FlatBufferBuilder::Offset
+goby::middleware::arrow::Writer::Column::field(FlatBufferBuilder& fbb) const
+{
+    std::vector<FlatBufferBuilder::Offset> child_fields;
+    for (const auto& child : children) child_fields.push_back(child.field(fbb));
+    auto children_vector = fbb.create_vector(child_fields);
+    auto name_string = fbb.create_string(name);
+    FlatBufferBuilder::Offset timezone_string =
+        type == Type::TIMESTAMP ? fbb.create_string("UTC") : 0;
+
+    std::uint8_t type_id = TYPE_STRUCT;
+    fbb.start_table();
+    switch (type)
+    {
+        case Type::BOOL: type_id = TYPE_BOOL; break;
+        case Type::INT32:
+        case Type::INT64:
+        case Type::UINT32:
+        case Type::UINT64:
+            type_id = TYPE_INT;
+            fbb.add_scalar<std::int32_t>(0, width() * 8);
+            fbb.add_scalar<std::uint8_t>(1, type == Type::INT32 || type == Type::INT64);
+            break;
+        case Type::FLOAT:
+        case Type::DOUBLE:
+            type_id = TYPE_FLOATING_POINT;
+            fbb.add_scalar<std::int16_t>(0, type == Type::FLOAT ? precision_single
+                                                                : precision_double);
+            break;
+        case Type::UTF8: type_id = TYPE_UTF8; break;
+        case Type::BINARY: type_id = TYPE_BINARY; break;
+        case Type::TIMESTAMP:
+            type_id = TYPE_TIMESTAMP;
+            fbb.add_scalar<std::int16_t>(0, time_unit_microsecond);
+            fbb.add_offset(1, timezone_string);
+            break;
+        case Type::LIST: type_id = TYPE_LIST; break;
+        case Type::STRUCT: type_id = TYPE_STRUCT; break;
+    }
+    auto type_table = fbb.end_table();
+
+    fbb.start_table();
+    fbb.add_offset(0, name_string);
+    fbb.add_scalar<std::uint8_t>(1, nullable);
+    fbb.add_scalar<std::uint8_t>(2, type_id);
+    fbb.add_offset(3, type_table);
+    fbb.add_offset(5, children_vector);
+    return fbb.end_table();
+}
+
+void goby::middleware::arrow::Writer::Column::clear()
+{
+    length = 0;
+    null_count = 0;
+    validity.clear();
+    values.clear();
+    offsets.assign(1, 0);
+    for (auto& child : children) child.clear();
+}
+
+FlatBufferBuilder::Offset
+goby::middleware::arrow::Writer::File::schema(FlatBufferBuilder& fbb) const
+{
+    std::vector<FlatBufferBuilder::Offset> fields;
+    for (const auto& column : columns) fields.push_back(column.field(fbb));
+    auto fields_vector = fbb.create_vector(fields);
+
+    std::vector<FlatBufferBuilder::Offset> metadata;
+    for (const auto& key_value : {std::make_pair("goby.group", group),
+                                  std::make_pair("goby.type", desc->full_name())})
+    {
+        auto key = fbb.create_string(key_value.first);
+        auto value = fbb.create_string(key_value.second);
+        fbb.start_table();
+        fbb.add_offset(0, key);
+        fbb.add_offset(1, value);
+        metadata.push_back(fbb.end_table());
+    }
+    auto metadata_vector = fbb.create_vector(metadata);
+
+    fbb.start_table();
+    fbb.add_scalar<std::int16_t>(0, endianness_little);
+    fbb.add_offset(1, fields_vector);
+    fbb.add_offset(2, metadata_vector);
+    return fbb.end_table();
+}
+
+goby::middleware::arrow::Writer::Writer(std::string output_dir, std::size_t batch_rows)
+    : output_dir_(std::move(output_dir)), batch_rows_(std::max<std::size_t>(batch_rows, 1))
+{
+    make_directory(output_dir_);
+}
+
+goby::middleware::arrow::Writer::~Writer()
+{
+    try
+    {
+        close();
+    }
+    catch (const std::exception& e)
+    {
+        glog.is_warn() && glog << "Failed to close Arrow files: " << e.what() << std::endl;
+    }
+}
+
+void goby::middleware::arrow::Writer::add_entry(const goby::middleware::HDF5ProtobufEntry& entry)
+{
+    const auto* desc = entry.msg->GetDescriptor();
+    File& f = file(entry.channel, *entry.msg);
+
+    const google::protobuf::Message* msg = entry.msg.get();
+    std::unique_ptr<google::protobuf::Message> reparsed;
+    if (desc != f.desc)
+    {
+        reparsed.reset(f.prototype->New());
+        reparsed->ParseFromString(entry.msg->SerializeAsString());
+        msg = reparsed.get();
+    }
+
+    f.columns[0].append_value<std::int64_t>(entry.time.value());
+    f.columns[1].append_value<std::int32_t>(entry.scheme);
+    for (auto it = f.columns.begin() + 2, end = f.columns.end(); it != end; ++it)
+        it->append_field(*msg);
+
+    ++f.rows;
+    // the data actually appended rather than the serialized size, as text (e.g. of recursive
+    // messages and enumeration names) can be much larger
+    bool full = f.rows >= static_cast<std::int64_t>(batch_rows_);
+    for (auto it = f.columns.begin() + 2, end = f.columns.end(); !full && it != end; ++it)
+        full = it->largest_offset() >= max_batch_offset;
+    if (full)
+        write_batch(f);
+}
+
+void goby::middleware::arrow::Writer::close()
+{
+    for (auto& file_p : files_) write_footer(*file_p.second);
+    files_.clear();
+}
+
+goby::middleware::arrow::Writer::File&
+goby::middleware::arrow::Writer::file(const std::string& group,
+                                      const google::protobuf::Message& msg)
+{
+    const auto* desc = msg.GetDescriptor();
+    auto key = std::make_pair(group, desc->full_name());
+    auto it = files_.find(key);
+    if (it != files_.end())
+        return *it->second;
+
+    std::string dir = output_dir_ + "/" + directory_name(group);
+    make_directory(dir);
+
+    auto f = std::make_unique<File>();
+    f->path = dir + "/" + desc->full_name() + ".arrow";
+    f->group = group;
+    f->desc = desc;
+    f->prototype.reset(msg.New());
+
+    f->columns.emplace_back("_utime_", Column::Type::TIMESTAMP, false);
+    f->columns.emplace_back("_scheme_", Column::Type::INT32, false);
+    std::vector<const google::protobuf::Descriptor*> parents{desc};
+    for (const auto* field_desc : fields(desc))
+        f->columns.push_back(Column::make(field_desc, parents));
+
+    FlatBufferBuilder fbb;
+    auto schema = f->schema(fbb);
+    write(*f, file_magic + std::string(2, '\0') + message(fbb, message_header_schema, schema, 0));
+    ++statistics_.files;
+
+    return *files_.insert(std::make_pair(key, std::move(f))).first->second;
+}
+
+void goby::middleware::arrow::Writer::write_batch(File& f)
+{
+    if (f.rows == 0)
+        return;
+
+    std::vector<FieldNode> nodes;
+    std::vector<Buffer> buffers;
+    std::string body;
+    for (const auto& column : f.columns) column.add_to_batch(nodes, buffers, body);
+
+    FlatBufferBuilder fbb;
+    auto nodes_vector = fbb.create_vector(nodes);
+    auto buffers_vector = fbb.create_vector(buffers);
+    fbb.start_table();
+    fbb.add_scalar<std::int64_t>(0, f.rows);
+    fbb.add_offset(1, nodes_vector);
+    fbb.add_offset(2, buffers_vector);
+    std::string metadata = message(fbb, message_header_record_batch, fbb.end_table(), body.size());
+
+    f.record_batches.push_back({static_cast<std::int64_t>(f.offset),
+                                static_cast<std::int32_t>(metadata.size()), 0,
+                                static_cast<std::int64_t>(body.size())});
+    write(f, metadata, body);
+
+    ++statistics_.record_batches;
+    statistics_.rows += f.rows;
+    for (auto& column : f.columns) column.clear();
+    f.rows = 0;
+}
+
+void goby::middleware::arrow::Writer::write_footer(File& f)
+{
+    write_batch(f);
+
+    // end-of-stream marker
+    std::string bytes;
+    append_bytes(bytes, continuation_marker);
+    append_bytes(bytes, std::int32_t(0));
+
+    FlatBufferBuilder fbb;
+    auto schema = f.schema(fbb);
+    auto dictionaries_vector = fbb.create_vector(std::vector<Block>());
+    auto record_batches_vector = fbb.create_vector(f.record_batches);
+    fbb.start_table();
+    fbb.add_scalar<std::int16_t>(0, metadata_version_v5);
+    fbb.add_offset(1, schema);
+    fbb.add_offset(2, dictionaries_vector);
+    fbb.add_offset(3, record_batches_vector);
+    std::string footer = fbb.finish(fbb.end_table());
+
+    bytes += footer;
+    append_bytes(bytes, static_cast<std::int32_t>(footer.size()));
+    bytes += file_magic;
+    write(f, bytes);
+}
+
+void goby::middleware::arrow::Writer::write(File& f, const std::string& bytes,
+                                            const std::string& body)
+{
+    // reopened for each write so that the number of files is not limited by open file descriptors
+    std::ofstream out(f.path, std::ios::binary | (f.offset == 0 ? std::ios::trunc : std::ios::app));
+    out.write(bytes.data(), bytes.size());
+    out.write(body.data(), body.size());
+    out.close();
+    if (!out)
+        throw(goby::Exception("Failed to write " + f.path));
+
+    f.offset += bytes.size() + body.size();
+    statistics_.bytes += bytes.size() + body.size();
+}
+
+std::ostream& goby::middleware::arrow::operator<<(std::ostream& os, const Writer::Statistics& stats)
+{
+    return os << "files: " << stats.files << ", record batches: " << stats.record_batches
+              << ", rows: " << stats.rows << ", bytes: " << stats.bytes;
+}
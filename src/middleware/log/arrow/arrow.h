@@ -0,0 +1,103 @@
+// Copyright 2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GOBY_MIDDLEWARE_LOG_ARROW_ARROW_H
+#define GOBY_MIDDLEWARE_LOG_ARROW_ARROW_H
+
+#include <cstddef> // for size_t
+#include <cstdint> // for uint64_t
+#include <map>     // for map
+#include <memory>  // for unique_ptr
+#include <ostream> // for ostream
+#include <string>  // for string
+#include <utility> // for pair
+
+#include "goby/middleware/log/hdf5/hdf5_plugin.h" // for HDF5ProtobufEntry
+
+namespace goby
+{
+namespace middleware
+{
+/// \brief Writing Protobuf messages to Apache Arrow files
+namespace arrow
+{
+/// \brief Writes Protobuf messages (e.g. decoded from a .goby log by goby_log_tool) to Apache Arrow IPC files (also known as Feather version 2), one for each group and message type, which can be loaded directly by pyarrow, pandas, polars, R, MATLAB, etc.
+///
+/// The columns are derived from the message Descriptor: _utime_ (time of the message in microseconds since the UNIX epoch, as a UTC timestamp), _scheme_, and one for each field and extension of the message. Scalar fields are written as the corresponding Arrow type (enumerations as the name of the value), embedded messages as structs, and repeated fields as lists. Fields that are not set (and so have presence) are null. Recursive messages are written as text where they recur.
+///
+/// Rows are written in record batches of batch_rows messages (or fewer, if the data of a string, bytes or list column reaches 256 MiB, as Arrow offsets are 32-bit), so at most one batch of each group and type is held in memory.
+class Writer
+{
+  public:
+    struct Statistics
+    {
+        std::uint64_t files{0};
+        std::uint64_t record_batches{0};
+        std::uint64_t rows{0};
+        std::uint64_t bytes{0};
+    };
+
+    /// \param output_dir Directory to write the files to (as output_dir/group/type.arrow, where '/', '%' and a leading '.' of the group are percent-encoded, e.g. "nav/gps" is written to output_dir/nav%2Fgps), created if it does not exist
+    /// \param batch_rows Number of messages of each group and type in each record batch
+    /// \throw goby::Exception if output_dir cannot be created
+    Writer(std::string output_dir, std::size_t batch_rows = default_batch_rows);
+    ~Writer();
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    /// \throw goby::Exception if a file cannot be written, or a single column of a record batch would exceed 2 GiB
+    void add_entry(const goby::middleware::HDF5ProtobufEntry& entry);
+
+    /// \brief Write the remaining messages and finish the files. Called by the destructor (logging any errors) if not called before.
+    /// \throw goby::Exception if a file cannot be written
+    void close();
+
+    Statistics statistics() const { return statistics_; }
+
+    static constexpr std::size_t default_batch_rows{65536};
+
+  private:
+    struct Column;
+    struct File;
+
+    File& file(const std::string& group, const google::protobuf::Message& msg);
+    void write_batch(File& f);
+    void write_footer(File& f);
+    void write(File& f, const std::string& bytes, const std::string& body = std::string());
+
+  private:
+    std::string output_dir_;
+    std::size_t batch_rows_;
+    // (group, type name) to file
+    std::map<std::pair<std::string, std::string>, std::unique_ptr<File>> files_;
+    Statistics statistics_;
+};
+
+std::ostream& operator<<(std::ostream& os, const Writer::Statistics& stats);
+
+} // namespace arrow
+} // namespace middleware
+} // namespace goby
+
+#endif
@@ -0,0 +1,196 @@
+// Copyright 2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GOBY_MIDDLEWARE_LOG_ARROW_DETAIL_FLATBUFFER_BUILDER_H
+#define GOBY_MIDDLEWARE_LOG_ARROW_DETAIL_FLATBUFFER_BUILDER_H
+
+#include <algorithm> // for max
+#include <cstddef>   // for size_t
+#include <cstdint>   // for uint32_t, int32_t, uint16_t
+#include <cstring>   // for memcpy, memset
+#include <string>    // for string
+#include <utility>   // for pair
+#include <vector>    // for vector
+
+namespace goby
+{
+namespace middleware
+{
+namespace arrow
+{
+namespace detail
+{
+/// \brief Minimal builder for FlatBuffers (https://flatbuffers.dev), as used for the metadata of Arrow IPC files, so that they can be written without depending on the FlatBuffers or Arrow libraries.
+///
+/// Like the FlatBuffers library, the buffer is built back to front (children before the tables that refer to them), and objects are referred to by their distance from the end of the buffer. Only one table may be built at a time. Scalars are written in host byte order, so this must only be used on little-endian hosts.
+class FlatBufferBuilder
+{
+  public:
+    using Offset = std::uint32_t;
+
+    FlatBufferBuilder() : buf_(1024), head_(buf_.size()) {}
+
+    std::size_t size() const { return buf_.size() - head_; }
+
+    template <typename T> void push(T value)
+    {
+        align(sizeof(T));
+        prepend(&value, sizeof(T));
+    }
+
+    /// \brief Push a reference to an object already in the buffer
+    void push_offset(Offset object)
+    {
+        align(sizeof(Offset));
+        Offset value = size() + sizeof(Offset) - object;
+        prepend(&value, sizeof(value));
+    }
+
+    Offset create_string(const std::string& s)
+    {
+        pre_align(s.size() + 1, sizeof(Offset));
+        prepend_zeros(1);
+        prepend(s.data(), s.size());
+        push<std::uint32_t>(s.size());
+        return size();
+    }
+
+    Offset create_vector(const std::vector<Offset>& objects)
+    {
+        pre_align(objects.size() * sizeof(Offset), sizeof(Offset));
+        for (auto it = objects.rbegin(), end = objects.rend(); it != end; ++it) push_offset(*it);
+        push<std::uint32_t>(objects.size());
+        return size();
+    }
+
+    /// \brief Create a vector of structs (or scalars), which must already have the FlatBuffers layout
+    template <typename T> Offset create_vector(const std::vector<T>& values)
+    {
+        const std::size_t bytes = values.size() * sizeof(T);
+        pre_align(bytes, sizeof(Offset));
+        pre_align(bytes, alignof(T));
+        prepend(values.data(), bytes);
+        push<std::uint32_t>(values.size());
+        return size();
+    }
+
+    void start_table()
+    {
+        fields_.clear();
+        table_start_ = size();
+    }
+
+    template <typename T> void add_scalar(int id, T value)
+    {
+        push(value);
+        fields_.emplace_back(id, size());
+    }
+
+    void add_offset(int id, Offset object)
+    {
+        push_offset(object);
+        fields_.emplace_back(id, size());
+    }
+
+    Offset end_table()
+    {
+        // to be replaced by the offset to the vtable
+        push<std::int32_t>(0);
+        const Offset table = size();
+
+        int max_id = -1;
+        for (const auto& field : fields_) max_id = std::max(max_id, field.first);
+        std::vector<std::uint16_t> vtable(max_id + 1, 0);
+        for (const auto& field : fields_) vtable[field.first] = table - field.second;
+
+        for (auto it = vtable.rbegin(), end = vtable.rend(); it != end; ++it) push(*it);
+        push<std::uint16_t>(table - table_start_);
+        push<std::uint16_t>((vtable.size() + 2) * sizeof(std::uint16_t));
+
+        // the vtable precedes the table
+        const std::int32_t vtable_offset = size() - table;
+        std::memcpy(&buf_[buf_.size() - table], &vtable_offset, sizeof(vtable_offset));
+        fields_.clear();
+        return table;
+    }
+
+    /// \return the finished buffer, with \c root as its root table
+    std::string finish(Offset root)
+    {
+        pre_align(sizeof(Offset), min_align_);
+        push_offset(root);
+        return std::string(buf_.data() + head_, size());
+    }
+
+  private:
+    // pad so that the buffer is aligned to alignment once len more bytes are prepended
+    void pre_align(std::size_t len, std::size_t alignment)
+    {
+        min_align_ = std::max(min_align_, alignment);
+        prepend_zeros((alignment - (size() + len) % alignment) % alignment);
+    }
+    void align(std::size_t alignment) { pre_align(0, alignment); }
+
+    void prepend(const void* data, std::size_t len)
+    {
+        reserve(len);
+        head_ -= len;
+        if (len)
+            std::memcpy(&buf_[head_], data, len);
+    }
+
+    void prepend_zeros(std::size_t len)
+    {
+        reserve(len);
+        head_ -= len;
+        if (len)
+            std::memset(&buf_[head_], 0, len);
+    }
+
+    void reserve(std::size_t len)
+    {
+        if (head_ >= len)
+            return;
+        const std::size_t used = size();
+        std::vector<char> buf(std::max(2 * buf_.size(), used + len));
+        std::memcpy(buf.data() + buf.size() - used, buf_.data() + head_, used);
+        head_ = buf.size() - used;
+        buf_.swap(buf);
+    }
+
+  private:
+    std::vector<char> buf_;
+    // index in buf_ of the start of the buffer
+    std::size_t head_;
+    std::size_t min_align_{1};
+
+    // table being built: (field id, object) for each field added
+    std::vector<std::pair<int, Offset>> fields_;
+    Offset table_start_{0};
+};
+} // namespace detail
+} // namespace arrow
+} // namespace middleware
+} // namespace goby
+
+#endif
@@ -0,0 +1,150 @@
+// Copyright 2016-2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "compression.h"
+
+#include <algorithm> // for copy
+
+#ifdef HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAS_ZSTD
+#include <zstd.h>
+#endif
+
+#include "goby/middleware/log/log_entry.h" // for LogException
+
+using goby::middleware::log::Compression;
+using goby::middleware::log::LogException;
+
+bool goby::middleware::log::compression_available(Compression compression)
+{
+    switch (compression)
+    {
+        case Compression::NONE: return true;
+#ifdef HAS_ZLIB
+        case Compression::ZLIB: return true;
+#endif
+#ifdef HAS_ZSTD
+        case Compression::ZSTD: return true;
+#endif
+        default: return false;
+    }
+}
+
+std::string goby::middleware::log::compression_name(Compression compression)
+{
+    switch (compression)
+    {
+        case Compression::NONE: return "none";
+        case Compression::ZLIB: return "zlib";
+        case Compression::ZSTD: return "zstd";
+    }
+    return "unknown (" + std::to_string(static_cast<int>(compression)) + ")";
+}
+
+void goby::middleware::log::compress(Compression compression, int level, const char* data,
+                                     std::size_t size, std::string* out)
+{
+    switch (compression)
+    {
+        case Compression::NONE: out->assign(data, size); return;
+
+#ifdef HAS_ZLIB
+        case Compression::ZLIB:
+        {
+            uLongf out_size = compressBound(size);
+            out->resize(out_size);
+            int result = compress2(reinterpret_cast<Bytef*>(&(*out)[0]), &out_size,
+                                   reinterpret_cast<const Bytef*>(data), size,
+                                   level < 0 ? Z_DEFAULT_COMPRESSION : level);
+            if (result != Z_OK)
+                throw(LogException("zlib compression failed: " + std::to_string(result)));
+            out->resize(out_size);
+            return;
+        }
+#endif
+
+#ifdef HAS_ZSTD
+        case Compression::ZSTD:
+        {
+            out->resize(ZSTD_compressBound(size));
+            std::size_t out_size = ZSTD_compress(&(*out)[0], out->size(), data, size,
+                                                 level < 0 ? ZSTD_CLEVEL_DEFAULT : level);
+            if (ZSTD_isError(out_size))
+                throw(LogException(std::string("zstd compression failed: ") +
+                                   ZSTD_getErrorName(out_size)));
+            out->resize(out_size);
+            return;
+        }
+#endif
+
+        default: break;
+    }
+    throw(LogException("Compression " + compression_name(compression) +
+                       " is not available (was Goby compiled with it enabled?)"));
+}
+
+void goby::middleware::log::decompress(Compression compression, const char* data,
+                                       std::size_t size, char* out, std::size_t out_size)
+{
+    switch (compression)
+    {
+        case Compression::NONE:
+            if (size != out_size)
+                throw(LogException("Uncompressed block size mismatch"));
+            std::copy(data, data + size, out);
+            return;
+
+#ifdef HAS_ZLIB
+        case Compression::ZLIB:
+        {
+            uLongf actual_size = out_size;
+            int result = uncompress(reinterpret_cast<Bytef*>(out), &actual_size,
+                                    reinterpret_cast<const Bytef*>(data), size);
+            if (result != Z_OK || actual_size != out_size)
+                throw(LogException("zlib decompression failed: " + std::to_string(result)));
+            return;
+        }
+#endif
+
+#ifdef HAS_ZSTD
+        case Compression::ZSTD:
+        {
+            std::size_t actual_size = ZSTD_decompress(out, out_size, data, size);
+            if (ZSTD_isError(actual_size))
+                throw(LogException(std::string("zstd decompression failed: ") +
+                                   ZSTD_getErrorName(actual_size)));
+            if (actual_size != out_size)
+                throw(LogException("zstd decompression failed: size mismatch"));
+            return;
+        }
+#endif
+
+        default: break;
+    }
+    throw(LogException("Cannot read block compressed with " + compression_name(compression) +
+                       " (was Goby compiled with it enabled?)"));
+}
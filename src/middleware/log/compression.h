@@ -0,0 +1,69 @@
+// Copyright 2016-2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef GOBY_MIDDLEWARE_LOG_COMPRESSION_H
+#define GOBY_MIDDLEWARE_LOG_COMPRESSION_H
+
+#include <cstddef> // for size_t
+#include <cstdint> // for uint8_t
+#include <string>  // for string
+
+namespace goby
+{
+namespace middleware
+{
+namespace log
+{
+/// \brief Compression algorithm of a compressed block in a .goby log (version 4 or newer)
+enum class Compression : std::uint8_t
+{
+    NONE = 0,
+    ZLIB = 1,
+    ZSTD = 2
+};
+
+/// \return true if Goby was compiled with support for \c compression
+bool compression_available(Compression compression);
+
+/// \return Name of \c compression (e.g. "zlib")
+std::string compression_name(Compression compression);
+
+/// \brief Compress \c size bytes of \c data, replacing the contents of \c out
+///
+/// \param level Compression level (specific to the algorithm), or -1 for the default
+/// \throw LogException if \c compression is not available or fails
+void compress(Compression compression, int level, const char* data, std::size_t size,
+              std::string* out);
+
+/// \brief Decompress \c size bytes of \c data into exactly \c out_size bytes at \c out
+///
+/// \throw LogException if \c compression is not available, or \c data is not valid or does not decompress to \c out_size bytes
+void decompress(Compression compression, const char* data, std::size_t size, char* out,
+                std::size_t out_size);
+
+} // namespace log
+} // namespace middleware
+} // namespace goby
+
+#endif
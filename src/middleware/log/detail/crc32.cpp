@@ -0,0 +1,199 @@
+// Copyright 2017-2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "crc32.h"
+
+#include <cstring> // for memcpy
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define GOBY_CRC32_ARM
+#include <arm_acle.h>
+#elif defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define GOBY_CRC32_PCLMUL
+#include <immintrin.h>
+#endif
+
+namespace
+{
+// reflected form of the IEEE 802.3 polynomial 0x04C11DB7
+constexpr std::uint32_t polynomial{0xEDB88320};
+
+struct Tables
+{
+    Tables()
+    {
+        for (std::uint32_t i = 0; i < 256; ++i)
+        {
+            std::uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? (c >> 1) ^ polynomial : c >> 1;
+            t[0][i] = c;
+        }
+        for (std::uint32_t i = 0; i < 256; ++i)
+        {
+            for (int k = 1; k < 8; ++k) t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+        }
+    }
+    std::uint32_t t[8][256];
+};
+
+const Tables& tables()
+{
+    static const Tables tables;
+    return tables;
+}
+
+// c is the inverted CRC (as are the other implementations below)
+std::uint32_t crc32_bytes(std::uint32_t c, const unsigned char* p, std::size_t n)
+{
+    const auto& t = tables().t;
+    while (n--) c = (c >> 8) ^ t[0][(c ^ *p++) & 0xFF];
+    return c;
+}
+
+std::uint32_t crc32_slice8(std::uint32_t c, const unsigned char* p, std::size_t n)
+{
+    const auto& t = tables().t;
+    for (; n >= 8; n -= 8, p += 8)
+    {
+        // assembled bytewise so this is correct regardless of host byte order
+        std::uint32_t lo = c ^ (std::uint32_t(p[0]) | std::uint32_t(p[1]) << 8 |
+                                std::uint32_t(p[2]) << 16 | std::uint32_t(p[3]) << 24);
+        std::uint32_t hi = std::uint32_t(p[4]) | std::uint32_t(p[5]) << 8 |
+                           std::uint32_t(p[6]) << 16 | std::uint32_t(p[7]) << 24;
+        c = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+            t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    }
+    return crc32_bytes(c, p, n);
+}
+
+#ifdef GOBY_CRC32_ARM
+std::uint32_t crc32_arm(std::uint32_t c, const unsigned char* p, std::size_t n)
+{
+    for (; n >= 8; n -= 8, p += 8)
+    {
+        std::uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        c = __crc32d(c, v);
+    }
+    for (; n > 0; --n, ++p) c = __crc32b(c, *p);
+    return c;
+}
+#endif
+
+#ifdef GOBY_CRC32_PCLMUL
+// Folding with carry-less multiplication as described in Gopal et al., "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction" (Intel, 2009), using the constants for the bit-reflected IEEE polynomial given there.
+#define GOBY_CRC32_TARGET __attribute__((target("pclmul,sse4.1")))
+
+GOBY_CRC32_TARGET inline __m128i load(const unsigned char* p)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+// x * k(lo) ^ x * k(hi) ^ y
+GOBY_CRC32_TARGET inline __m128i fold(__m128i x, __m128i k, __m128i y)
+{
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), y),
+                         _mm_clmulepi64_si128(x, k, 0x11));
+}
+
+// Requires n >= 64 and n a multiple of 16
+GOBY_CRC32_TARGET std::uint32_t crc32_pclmul(std::uint32_t c, const unsigned char* p,
+                                             std::size_t n)
+{
+    alignas(16) static const std::uint64_t k1k2[] = {0x0154442bd4, 0x01c6e41596};
+    alignas(16) static const std::uint64_t k3k4[] = {0x01751997d0, 0x00ccaa009e};
+    alignas(16) static const std::uint64_t k5k0[] = {0x0163cd6124, 0x0000000000};
+    alignas(16) static const std::uint64_t poly[] = {0x01db710641, 0x01f7011641};
+
+    __m128i x1 = _mm_xor_si128(load(p), _mm_cvtsi32_si128(static_cast<int>(c)));
+    __m128i x2 = load(p + 16), x3 = load(p + 32), x4 = load(p + 48);
+    p += 64;
+    n -= 64;
+
+    // fold four 128 bit lanes in parallel
+    __m128i k = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+    for (; n >= 64; n -= 64, p += 64)
+    {
+        x1 = fold(x1, k, load(p));
+        x2 = fold(x2, k, load(p + 16));
+        x3 = fold(x3, k, load(p + 32));
+        x4 = fold(x4, k, load(p + 48));
+    }
+
+    // fold the lanes together, then any remaining 128 bit blocks
+    k = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+    x1 = fold(x1, k, x2);
+    x1 = fold(x1, k, x3);
+    x1 = fold(x1, k, x4);
+    for (; n >= 16; n -= 16, p += 16) x1 = fold(x1, k, load(p));
+
+    // fold 128 bits to 64 bits
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    __m128i x = _mm_clmulepi64_si128(x1, k, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x);
+
+    k = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+    x = _mm_srli_si128(x1, 4);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x00), x);
+
+    // Barrett reduction to 32 bits
+    k = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+    x = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x10);
+    x = _mm_clmulepi64_si128(_mm_and_si128(x, mask32), k, 0x00);
+    x1 = _mm_xor_si128(x1, x);
+
+    return static_cast<std::uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+bool have_pclmul()
+{
+    static const bool have = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+    return have;
+}
+#endif
+} // namespace
+
+std::uint32_t goby::middleware::log::detail::crc32(std::uint32_t crc, const void* data,
+                                                   std::size_t size)
+{
+    auto p = static_cast<const unsigned char*>(data);
+    std::uint32_t c = ~crc;
+
+#if defined(GOBY_CRC32_ARM)
+    c = crc32_arm(c, p, size);
+#else
+#if defined(GOBY_CRC32_PCLMUL)
+    // setting up the fold isn't worthwhile for small entries
+    if (size >= 64 && have_pclmul())
+    {
+        std::size_t n = size & ~std::size_t(15);
+        c = crc32_pclmul(c, p, n);
+        p += n;
+        size -= n;
+    }
+#endif
+    c = crc32_slice8(c, p, size);
+#endif
+
+    return ~c;
+}
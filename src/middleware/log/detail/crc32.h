@@ -0,0 +1,61 @@
+// Copyright 2017-2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GOBY_MIDDLEWARE_LOG_DETAIL_CRC32_H
+#define GOBY_MIDDLEWARE_LOG_DETAIL_CRC32_H
+
+#include <cstddef> // for size_t
+#include <cstdint> // for uint32_t
+
+namespace goby
+{
+namespace middleware
+{
+namespace log
+{
+namespace detail
+{
+/// \brief Update the CRC-32 (IEEE 802.3, as boost::crc_32_type and zlib's crc32()) \c crc with \c size bytes from \c data
+///
+/// Uses the ARMv8 CRC32 instructions or x86 carry-less multiplication (PCLMULQDQ) when available, otherwise a slicing-by-8 table.
+/// \param crc Previous result (or 0 for the first call)
+/// \return CRC of all bytes processed so far
+std::uint32_t crc32(std::uint32_t crc, const void* data, std::size_t size);
+
+/// \brief Incremental CRC-32, interchangeable with boost::crc_32_type for the uses in LogEntry
+class CRC32
+{
+  public:
+    void process_bytes(const void* data, std::size_t size) { crc_ = crc32(crc_, data, size); }
+    std::uint32_t checksum() const { return crc_; }
+
+  private:
+    std::uint32_t crc_{0};
+};
+
+} // namespace detail
+} // namespace log
+} // namespace middleware
+} // namespace goby
+
+#endif
@@ -0,0 +1,197 @@
+// Copyright 2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GOBY_MIDDLEWARE_LOG_DETAIL_ORDERED_PIPELINE_H
+#define GOBY_MIDDLEWARE_LOG_DETAIL_ORDERED_PIPELINE_H
+
+#include <algorithm>          // for max
+#include <condition_variable> // for condition_variable
+#include <cstddef>            // for size_t
+#include <cstdint>            // for uint64_t
+#include <functional>         // for function
+#include <memory>             // for unique_ptr
+#include <mutex>              // for mutex, unique_lock
+#include <thread>             // for thread
+#include <utility>            // for move
+#include <vector>             // for vector
+
+namespace goby
+{
+namespace middleware
+{
+namespace log
+{
+namespace detail
+{
+/// \brief Processes items on a pool of worker threads, passing the results to a single consumer thread in the order the items were pushed
+///
+/// Used to decode log entries in parallel while writing the output in log order.
+/// \tparam In Item type (must be default constructible and move assignable)
+/// \tparam Out Result type (must be default constructible and move assignable)
+template <typename In, typename Out> class OrderedPipeline
+{
+  public:
+    /// \param workers Number of worker threads calling \c process (at least one)
+    /// \param max_in_flight Maximum number of items pushed but not yet consumed; push() blocks beyond this
+    /// \param process Called on a worker thread for each item (must not throw)
+    /// \param consume Called on the consumer thread with each result, in order (must not throw)
+    OrderedPipeline(int workers, std::size_t max_in_flight, std::function<void(In&, Out&)> process,
+                    std::function<void(Out&)> consume)
+        : slots_(std::max<std::size_t>(max_in_flight, 1)),
+          process_(std::move(process)),
+          consume_(std::move(consume))
+    {
+        for (int i = 0, n = std::max(workers, 1); i < n; ++i)
+            workers_.emplace_back([this]() { work_loop(); });
+        consumer_ = std::thread([this]() { consume_loop(); });
+    }
+
+    ~OrderedPipeline() { finish(); }
+
+    OrderedPipeline(const OrderedPipeline&) = delete;
+    OrderedPipeline& operator=(const OrderedPipeline&) = delete;
+
+    /// \brief Queue \c in for processing, blocking while the pipeline is full
+    void push(In in)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_cv_.wait(lock, [this]() { return pushed_ - consumed_ < slots_.size(); });
+
+        Slot& slot = slots_[pushed_ % slots_.size()];
+        slot.in = std::move(in);
+        slot.done = false;
+        ++pushed_;
+        work_cv_.notify_one();
+    }
+
+    /// \brief Wait until every item pushed so far has been consumed
+    void drain()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_cv_.wait(lock, [this]() { return consumed_ == pushed_; });
+    }
+
+    /// \brief Wait for all items to be consumed and stop the threads. Called by the destructor if not called before.
+    void finish()
+    {
+        if (!consumer_.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        work_cv_.notify_all();
+        done_cv_.notify_all();
+
+        for (auto& worker : workers_) worker.join();
+        consumer_.join();
+    }
+
+  private:
+    struct Slot
+    {
+        In in;
+        Out out;
+        bool done{false};
+    };
+
+    void work_loop()
+    {
+        for (;;)
+        {
+            std::uint64_t seq;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                work_cv_.wait(lock, [this]() { return started_ < pushed_ || stopping_; });
+                if (started_ == pushed_)
+                    return;
+                seq = started_++;
+            }
+
+            // slots aren't reused until consumed, so no lock is needed to use this one
+            Slot& slot = slots_[seq % slots_.size()];
+            process_(slot.in, slot.out);
+            slot.in = In();
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            slot.done = true;
+            if (seq == consumed_)
+                done_cv_.notify_one();
+        }
+    }
+
+    void consume_loop()
+    {
+        for (;;)
+        {
+            Slot* slot;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                done_cv_.wait(lock,
+                              [this]()
+                              {
+                                  return (consumed_ < pushed_ &&
+                                          slots_[consumed_ % slots_.size()].done) ||
+                                         (stopping_ && consumed_ == pushed_);
+                              });
+                if (consumed_ == pushed_)
+                    return;
+                slot = &slots_[consumed_ % slots_.size()];
+            }
+
+            consume_(slot->out);
+            slot->out = Out();
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++consumed_;
+            space_cv_.notify_all();
+        }
+    }
+
+  private:
+    std::vector<Slot> slots_;
+    std::function<void(In&, Out&)> process_;
+    std::function<void(Out&)> consume_;
+
+    std::mutex mutex_;
+    // worker: items to process; consumer: next result done; producer: space or drained
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    std::condition_variable space_cv_;
+    // items pushed, started by a worker, and consumed (each a sequence number of the next such item)
+    std::uint64_t pushed_{0};
+    std::uint64_t started_{0};
+    std::uint64_t consumed_{0};
+    bool stopping_{false};
+
+    std::vector<std::thread> workers_;
+    std::thread consumer_;
+};
+
+} // namespace detail
+} // namespace log
+} // namespace middleware
+} // namespace goby
+
+#endif
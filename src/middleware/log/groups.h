@@ -34,6 +34,7 @@ namespace middleware
 namespace groups
 {
 constexpr goby::middleware::Group logger_request{"goby::logger::request"};
+constexpr goby::middleware::Group playback_request{"goby::playback::request"};
 
 } // namespace groups
 } // namespace middleware
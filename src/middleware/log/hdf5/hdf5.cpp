@@ -21,8 +21,9 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with Goby.  If not, see <http://www.gnu.org/licenses/>.
 
-#include <cstddef> // for size_t
-#include <cstdint> // for uint64_t, int...
+#include <algorithm> // for copy, max, sort
+#include <cstddef>   // for size_t
+#include <cstdint>   // for uint64_t, int...
 
 #include <boost/algorithm/string/classification.hpp>   // for is_any_ofF
 #include <boost/algorithm/string/predicate_facade.hpp> // for predicate_facade
@@ -39,6 +40,12 @@
 #include "hdf5.h"
 #include "hdf5_plugin.h" // for HDF5ProtobufE...
 
+#if GOOGLE_PROTOBUF_VERSION < 3004000
+#define SpaceUsedLong SpaceUsed
+#endif
+
+constexpr hsize_t goby::middleware::hdf5::Writer::default_streaming_chunk_length;
+
 size_t
 goby::middleware::hdf5::Channel::add_message(const goby::middleware::HDF5ProtobufEntry& entry)
 {
@@ -88,7 +95,7 @@ goby::middleware::hdf5::GroupFactory::GroupWrapper::fetch_group(std::deque<std::
 
 goby::middleware::hdf5::Writer::Writer(const std::string& output_file, bool write_zero_length_dim,
                                        bool use_chunks, hsize_t chunk_length, bool use_compression,
-                                       int compression_level)
+                                       int compression_level, std::size_t memory_budget)
     : h5file_(output_file, H5F_ACC_TRUNC),
       group_factory_(h5file_),
       write_zero_length_dim_(write_zero_length_dim),
@@ -96,8 +103,30 @@ goby::middleware::hdf5::Writer::Writer(const std::string& output_file, bool writ
       chunk_length_(chunk_length),
       use_compression_(use_compression),
       compression_level_(compression_level),
-      final_write_(false)
+      final_write_(false),
+      memory_budget_(memory_budget)
 {
+    if (memory_budget_ > 0)
+    {
+        // datasets must be extensible to be written in pieces
+        use_chunks_ = true;
+        if (chunk_length_ == 0)
+            chunk_length_ = default_streaming_chunk_length;
+        flush_thread_ = std::thread([this]() { flush_loop(); });
+    }
+}
+
+goby::middleware::hdf5::Writer::~Writer()
+{
+    if (flush_thread_.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(flush_mutex_);
+            flush_stop_ = true;
+        }
+        flush_cv_.notify_all();
+        flush_thread_.join();
+    }
 }
 
 void goby::middleware::hdf5::Writer::add_entry(goby::middleware::HDF5ProtobufEntry entry)
@@ -116,17 +145,165 @@ void goby::middleware::hdf5::Writer::add_entry(goby::middleware::HDF5ProtobufEnt
         it = itpair.first;
     }
 
+    if (memory_budget_ > 0)
+    {
+        rethrow_flush_error();
+
+        auto bytes = entry_bytes(entry);
+        it->second.add_message(entry);
+        it->second.bytes += bytes;
+        memory_used_ += bytes;
+
+        {
+            std::lock_guard<std::mutex> lock(flush_mutex_);
+            statistics_.peak_memory =
+                std::max(statistics_.peak_memory, memory_used_ + flush_bytes_);
+        }
+
+        // the other half of the budget is for the entries being written
+        if (memory_used_ >= memory_budget_ / 2)
+            flush_largest_channels();
+        return;
+    }
+
     auto channel_size = it->second.add_message(entry);
 
     if (use_chunks_ && channel_size >= chunk_length_)
         write_channel_chunk_and_clear(it->second);
 }
 
+std::size_t
+goby::middleware::hdf5::Writer::entry_bytes(const goby::middleware::HDF5ProtobufEntry& entry)
+{
+    // node of the MessageCollection::entries multimap
+    constexpr std::size_t node_bytes = 4 * sizeof(void*) + sizeof(std::uint64_t);
+    return node_bytes + sizeof(entry) + entry.channel.capacity() +
+           (entry.msg ? entry.msg->SpaceUsedLong() : 0);
+}
+
+void goby::middleware::hdf5::Writer::flush_largest_channels()
+{
+    std::vector<Channel*> channels;
+    for (auto& channel : channels_)
+    {
+        if (channel.second.bytes > 0)
+            channels.push_back(&channel.second);
+    }
+    std::sort(channels.begin(), channels.end(),
+              [](const Channel* a, const Channel* b) { return a->bytes > b->bytes; });
+
+    // leave room for entries to be added while these are written
+    FlushJob job;
+    for (auto* channel : channels)
+    {
+        if (job.bytes > 0 && memory_used_ <= memory_budget_ / 4)
+            break;
+
+        for (auto& collection : channel->entries)
+        {
+            if (collection.second.entries.empty())
+                continue;
+            job.collections.emplace_back(collection.second.name, channel->group);
+            job.collections.back().entries.swap(collection.second.entries);
+            job.entries += job.collections.back().entries.size();
+        }
+        job.bytes += channel->bytes;
+        memory_used_ -= channel->bytes;
+        channel->bytes = 0;
+    }
+
+    glog.is_debug1() && glog << "Writing " << job.entries << " entries (" << job.bytes
+                             << " bytes) in the background" << std::endl;
+
+    std::unique_lock<std::mutex> lock(flush_mutex_);
+    // wait for the background thread to catch up rather than exceed the budget
+    flush_cv_.wait(lock,
+                   [&]()
+                   {
+                       return flush_bytes_ == 0 || flush_bytes_ + job.bytes <= memory_budget_ / 2 ||
+                              flush_error_;
+                   });
+    job.queued = std::chrono::steady_clock::now();
+    flush_bytes_ += job.bytes;
+    ++statistics_.flushes;
+    flush_queue_.push_back(std::move(job));
+    flush_cv_.notify_all();
+}
+
+void goby::middleware::hdf5::Writer::flush_loop()
+{
+    for (;;)
+    {
+        FlushJob job;
+        {
+            std::unique_lock<std::mutex> lock(flush_mutex_);
+            flush_cv_.wait(lock, [this]() { return flush_stop_ || !flush_queue_.empty(); });
+            if (flush_queue_.empty())
+                return;
+            job = std::move(flush_queue_.front());
+            flush_queue_.pop_front();
+        }
+
+        try
+        {
+            // once writing has failed, discard the remaining entries
+            if (!flush_error_)
+            {
+                for (const auto& collection : job.collections)
+                    write_message_collection(collection);
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(flush_mutex_);
+            flush_error_ = std::current_exception();
+        }
+        job.collections.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(flush_mutex_);
+            auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - job.queued);
+            statistics_.entries_flushed += job.entries;
+            statistics_.max_flush_latency = std::max(statistics_.max_flush_latency, latency);
+            statistics_.total_flush_latency += latency;
+            flush_bytes_ -= job.bytes;
+        }
+        flush_cv_.notify_all();
+    }
+}
+
+void goby::middleware::hdf5::Writer::wait_for_flush()
+{
+    std::unique_lock<std::mutex> lock(flush_mutex_);
+    flush_cv_.wait(lock, [this]() { return flush_queue_.empty() && flush_bytes_ == 0; });
+}
+
+void goby::middleware::hdf5::Writer::rethrow_flush_error()
+{
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    if (flush_error_)
+        std::rethrow_exception(flush_error_);
+}
+
+goby::middleware::hdf5::Writer::Statistics goby::middleware::hdf5::Writer::statistics() const
+{
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    return statistics_;
+}
+
 void goby::middleware::hdf5::Writer::write(bool final_write)
 {
     if (final_write_)
         throw(goby::Exception("write() called after final_write = true"));
 
+    if (memory_budget_ > 0)
+    {
+        // the background thread is idle after this, so this thread can use the file
+        wait_for_flush();
+        rethrow_flush_error();
+    }
+
     final_write_ = final_write;
     for (const auto& channel : channels_) write_channel(channel.second);
 }
@@ -157,27 +334,46 @@ void goby::middleware::hdf5::Writer::write_channel_chunk_and_clear(
 void goby::middleware::hdf5::Writer::write_message_collection(
     const goby::middleware::hdf5::MessageCollection& message_collection)
 {
+    // all entries may have been written in previous chunks
+    if (message_collection.entries.empty())
+        return;
+
     const auto& group = message_collection.group;
     glog.is_verbose() && glog << "Writing HDF5 group: " << group << std::endl;
-    write_time(group, message_collection);
-    write_scheme(group, message_collection);
-
-    auto write_field = [&, this](const google::protobuf::FieldDescriptor* field_desc) {
-        std::vector<const google::protobuf::Message*> messages;
-        for (const auto& entry : message_collection.entries)
-        { messages.push_back(entry.second.msg.get()); }
-        std::vector<hsize_t> hs;
-        hs.push_back(messages.size());
-        write_field_selector(group, field_desc, messages, hs);
-    };
 
     const google::protobuf::Descriptor* desc =
         message_collection.entries.begin()->second.msg->GetDescriptor();
-    for (int i = 0, n = desc->field_count(); i < n; ++i)
+
+    MessagePlan& plan = plans_[group];
+    if (plan.desc != desc)
     {
-        const google::protobuf::FieldDescriptor* field_desc = desc->field(i);
-        write_field(field_desc);
+        plan.desc = desc;
+        plan.columns = compile(desc, group);
     }
+    if (!plan.group)
+        plan.group = &group_factory_.fetch_group(group);
+
+    write_time(plan, message_collection);
+    write_scheme(plan, message_collection);
+
+    std::vector<const google::protobuf::Message*> messages;
+    messages.reserve(message_collection.entries.size());
+    for (const auto& entry : message_collection.entries) messages.push_back(entry.second.msg.get());
+
+    std::vector<hsize_t> hs;
+    hs.push_back(messages.size());
+    for (auto& column : plan.columns) write_column(column, messages, hs);
+}
+
+const std::vector<const google::protobuf::FieldDescriptor*>&
+goby::middleware::hdf5::Writer::fields(const google::protobuf::Descriptor* desc)
+{
+    auto it = fields_.find(desc);
+    if (it != fields_.end())
+        return it->second;
+
+    std::vector<const google::protobuf::FieldDescriptor*> fields;
+    for (int i = 0, n = desc->field_count(); i < n; ++i) fields.push_back(desc->field(i));
 
     std::vector<const google::protobuf::FieldDescriptor*> extensions;
     google::protobuf::DescriptorPool::generated_pool()->FindAllExtensions(desc, &extensions);
@@ -189,14 +385,100 @@ void goby::middleware::hdf5::Writer::write_message_collection(
     dccl::DynamicProtobufManager::user_descriptor_pool().FindAllExtensions(desc, &extensions);
 #endif
 
-    for (auto field_desc : extensions) { write_field(field_desc); }
+    fields.insert(fields.end(), extensions.begin(), extensions.end());
+    return fields_.insert(std::make_pair(desc, std::move(fields))).first->second;
+}
+
+std::vector<goby::middleware::hdf5::Writer::Column>
+goby::middleware::hdf5::Writer::compile(const google::protobuf::Descriptor* desc,
+                                        const std::string& group_path)
+{
+    glog.is_debug1() && glog << "Compiling columns for " << desc->full_name() << " in HDF5 group "
+                             << group_path << std::endl;
+
+    std::vector<Column> columns;
+    for (auto field_desc : fields(desc))
+    {
+        ColumnWriter write = nullptr;
+        switch (field_desc->cpp_type())
+        {
+            case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
+                if (field_desc->message_type()->full_name() ==
+                    "google.protobuf.FileDescriptorProto")
+                    glog.is_warn() && glog << "Omitting google.protobuf.FileDescriptorProto"
+                                           << std::endl;
+                else
+                    write = &Writer::write_embedded_message;
+                break;
+
+            case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+                write = &Writer::write_enum_field;
+                break;
+
+            case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
+                write = &Writer::write_field<std::int32_t>;
+                break;
+
+            case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
+                write = &Writer::write_field<std::int64_t>;
+                break;
+
+            case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
+                write = &Writer::write_field<std::uint32_t>;
+                break;
+
+            case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
+                write = &Writer::write_field<std::uint64_t>;
+                break;
+
+            case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+                write = &Writer::write_field<unsigned char>;
+                break;
+
+            case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+                write = &Writer::write_field<std::string>;
+                break;
+
+            case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+                write = &Writer::write_field<float>;
+                break;
+
+            case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
+                write = &Writer::write_field<double>;
+                break;
+        }
+
+        if (write)
+            columns.emplace_back(field_desc, group_path, write);
+    }
+    return columns;
+}
+
+void goby::middleware::hdf5::Writer::write_column(
+    Column& column, const std::vector<const google::protobuf::Message*>& messages,
+    std::vector<hsize_t>& hs)
+{
+    glog.is_debug1() && glog << "Writing HDF5 group: " << column.group_path << std::endl;
+    glog.is_debug1() && glog << "Writing field \"" << column.field_desc->name()
+                             << "\" (size: " << dim_str(hs) << ")" << std::endl;
+
+    (this->*column.write)(column, messages, hs);
 }
 
 void goby::middleware::hdf5::Writer::write_embedded_message(
-    const std::string& group, const google::protobuf::FieldDescriptor* field_desc,
-    const std::vector<const google::protobuf::Message*> messages, std::vector<hsize_t>& hs)
+    Column& column, const std::vector<const google::protobuf::Message*>& messages,
+    std::vector<hsize_t>& hs)
 {
-    const google::protobuf::Descriptor* sub_desc = field_desc->message_type();
+    const google::protobuf::FieldDescriptor* field_desc = column.field_desc;
+    if (!column.children_compiled)
+    {
+        column.children = compile(field_desc->message_type(),
+                                  column.group_path + "/" +
+                                      (field_desc->is_extension() ? field_desc->full_name()
+                                                                  : field_desc->name()));
+        column.children_compiled = true;
+    }
+
     if (field_desc->is_repeated())
     {
         int max_field_size = 0;
@@ -213,179 +495,87 @@ void goby::middleware::hdf5::Writer::write_embedded_message(
 
         hs.push_back(max_field_size);
 
-        auto write_field = [&, this](const google::protobuf::FieldDescriptor* sub_field_desc) {
-            std::vector<const google::protobuf::Message*> sub_messages(
-                messages.size() * max_field_size, (const google::protobuf::Message*)nullptr);
+        std::vector<const google::protobuf::Message*> sub_messages(
+            messages.size() * max_field_size, (const google::protobuf::Message*)nullptr);
 
-            bool has_submessages = false;
-            for (unsigned i = 0, n = messages.size(); i < n; ++i)
+        bool has_submessages = false;
+        for (unsigned i = 0, n = messages.size(); i < n; ++i)
+        {
+            if (messages[i])
             {
-                if (messages[i])
+                const google::protobuf::Reflection* refl = messages[i]->GetReflection();
+                int field_size = refl->FieldSize(*messages[i], field_desc);
+
+                for (int j = 0; j < field_size; ++j)
                 {
-                    const google::protobuf::Reflection* refl = messages[i]->GetReflection();
-                    int field_size = refl->FieldSize(*messages[i], field_desc);
-
-                    for (int j = 0; j < field_size; ++j)
-                    {
-                        const google::protobuf::Message& sub_msg =
-                            refl->GetRepeatedMessage(*messages[i], field_desc, j);
-                        sub_messages[i * max_field_size + j] = &sub_msg;
-                    }
-                    has_submessages = true;
+                    const google::protobuf::Message& sub_msg =
+                        refl->GetRepeatedMessage(*messages[i], field_desc, j);
+                    sub_messages[i * max_field_size + j] = &sub_msg;
                 }
+                has_submessages = true;
             }
+        }
 
-            if (has_submessages) // don't recurse unless one or more message requires it
-                write_field_selector(
-                    group + "/" +
-                        (field_desc->is_extension() ? field_desc->full_name() : field_desc->name()),
-                    sub_field_desc, sub_messages, hs);
-        };
-
-        for (int i = 0, n = sub_desc->field_count(); i < n; ++i)
+        // don't recurse unless one or more message requires it
+        if (has_submessages)
         {
-            const google::protobuf::FieldDescriptor* sub_field_desc = sub_desc->field(i);
-            write_field(sub_field_desc);
+            for (auto& child : column.children) write_column(child, sub_messages, hs);
         }
 
-        std::vector<const google::protobuf::FieldDescriptor*> extensions;
-        google::protobuf::DescriptorPool::generated_pool()->FindAllExtensions(sub_desc,
-                                                                              &extensions);
-#ifdef DCCL_VERSION_4_1_OR_NEWER
-        dccl::DynamicProtobufManager::user_descriptor_pool_call(
-            &google::protobuf::DescriptorPool::FindAllExtensions, sub_desc, &extensions);
-#else
-        dccl::DynamicProtobufManager::user_descriptor_pool().FindAllExtensions(sub_desc,
-                                                                               &extensions);
-
-#endif
-        for (auto sub_field_desc : extensions) { write_field(sub_field_desc); }
-
         hs.pop_back();
     }
     else
     {
-        auto write_field = [&, this](const google::protobuf::FieldDescriptor* sub_field_desc) {
-            std::vector<const google::protobuf::Message*> sub_messages;
-
-            bool has_submessages = false;
+        std::vector<const google::protobuf::Message*> sub_messages;
+        sub_messages.reserve(messages.size());
 
-            for (auto message : messages)
+        bool has_submessages = false;
+        for (auto message : messages)
+        {
+            if (message)
             {
-                if (message)
-                {
-                    const google::protobuf::Reflection* refl = message->GetReflection();
-                    const google::protobuf::Message& sub_msg =
-                        refl->GetMessage(*message, field_desc);
-                    sub_messages.push_back(&sub_msg);
-                    has_submessages = true;
-                }
-                else
-                {
-                    sub_messages.push_back(nullptr);
-                }
+                const google::protobuf::Reflection* refl = message->GetReflection();
+                const google::protobuf::Message& sub_msg = refl->GetMessage(*message, field_desc);
+                sub_messages.push_back(&sub_msg);
+                has_submessages = true;
             }
+            else
+            {
+                sub_messages.push_back(nullptr);
+            }
+        }
 
-            if (has_submessages)
-                write_field_selector(
-                    group + "/" +
-                        (field_desc->is_extension() ? field_desc->full_name() : field_desc->name()),
-                    sub_field_desc, sub_messages, hs);
-        };
-
-        for (int i = 0, n = sub_desc->field_count(); i < n; ++i)
+        if (has_submessages)
         {
-            const google::protobuf::FieldDescriptor* sub_field_desc = sub_desc->field(i);
-            write_field(sub_field_desc);
+            for (auto& child : column.children) write_column(child, sub_messages, hs);
         }
-
-        std::vector<const google::protobuf::FieldDescriptor*> extensions;
-        google::protobuf::DescriptorPool::generated_pool()->FindAllExtensions(sub_desc,
-                                                                              &extensions);
-#ifdef DCCL_VERSION_4_1_OR_NEWER
-        dccl::DynamicProtobufManager::user_descriptor_pool_call(
-            &google::protobuf::DescriptorPool::FindAllExtensions, sub_desc, &extensions);
-#else
-        dccl::DynamicProtobufManager::user_descriptor_pool().FindAllExtensions(sub_desc,
-                                                                               &extensions);
-#endif
-        for (auto sub_field_desc : extensions) { write_field(sub_field_desc); }
     }
 }
 
-void goby::middleware::hdf5::Writer::write_field_selector(
-    const std::string& group, const google::protobuf::FieldDescriptor* field_desc,
-    const std::vector<const google::protobuf::Message*>& messages, std::vector<hsize_t>& hs)
+void goby::middleware::hdf5::Writer::write_enum_field(
+    Column& column, const std::vector<const google::protobuf::Message*>& messages,
+    std::vector<hsize_t>& hs)
 {
-    glog.is_debug1() && glog << "Writing HDF5 group: " << group << std::endl;
-    glog.is_debug1() && glog << "Writing field \"" << field_desc->name()
-                             << "\" (size: " << dim_str(hs) << ")" << std::endl;
-
-    switch (field_desc->cpp_type())
+    // google uses int for the enum value type, we'll assume that's an int32 here
+    write_field<std::int32_t>(column, messages, hs);
+    if (!column.enum_attributes_written)
     {
-        case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
-            if (field_desc->message_type()->full_name() == "google.protobuf.FileDescriptorProto")
-                glog.is_warn() && glog << "Omitting google.protobuf.FileDescriptorProto"
-                                       << std::endl;
-            else
-                write_embedded_message(group, field_desc, messages, hs);
-            break;
-
-        case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
-        {
-            // google uses int for the enum value type, we'll assume that's an int32 here
-            write_field<std::int32_t>(group, field_desc, messages, hs);
-            write_enum_attributes(group, field_desc);
-            break;
-        }
-
-        case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
-            write_field<std::int32_t>(group, field_desc, messages, hs);
-            break;
-
-        case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
-            write_field<std::int64_t>(group, field_desc, messages, hs);
-            break;
-
-        case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
-            write_field<std::uint32_t>(group, field_desc, messages, hs);
-            break;
-
-        case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
-            write_field<std::uint64_t>(group, field_desc, messages, hs);
-            break;
-
-        case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
-            write_field<unsigned char>(group, field_desc, messages, hs);
-            break;
-
-        case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
-            write_field<std::string>(group, field_desc, messages, hs);
-            break;
-
-        case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
-            write_field<float>(group, field_desc, messages, hs);
-            break;
-
-        case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
-            write_field<double>(group, field_desc, messages, hs);
-            break;
+        write_enum_attributes(column);
+        column.enum_attributes_written = true;
     }
 }
 
-void goby::middleware::hdf5::Writer::write_enum_attributes(
-    const std::string& group, const google::protobuf::FieldDescriptor* field_desc)
+void goby::middleware::hdf5::Writer::write_enum_attributes(Column& column)
 {
     // write enum names and values to attributes
-    H5::Group& grp = group_factory_.fetch_group(group);
-    H5::DataSet ds = grp.openDataSet(field_desc->name());
+    H5::DataSet& ds = column.dataset.dataset;
 
     const char* enum_names_attr_name = "enum_names";
     const char* enum_values_attr_name = "enum_values";
     if (ds.attrExists(enum_names_attr_name) && ds.attrExists(enum_values_attr_name))
         return;
 
-    const google::protobuf::EnumDescriptor* enum_desc = field_desc->enum_type();
+    const google::protobuf::EnumDescriptor* enum_desc = column.field_desc->enum_type();
 
     std::vector<const char*> names(enum_desc->value_count(), (const char*)nullptr);
     std::vector<std::int32_t> values(enum_desc->value_count(), 0);
@@ -418,13 +608,15 @@ void goby::middleware::hdf5::Writer::write_enum_attributes(
 }
 
 void goby::middleware::hdf5::Writer::write_time(
-    const std::string& group, const goby::middleware::hdf5::MessageCollection& message_collection)
+    MessagePlan& plan, const goby::middleware::hdf5::MessageCollection& message_collection)
 {
     glog.is_debug1() && glog << "Writing time (size: " << message_collection.entries.size() << ")"
                              << std::endl;
 
-    std::vector<std::uint64_t> utime(message_collection.entries.size(), 0);
-    std::vector<double> datenum(message_collection.entries.size(), 0);
+    std::vector<std::uint64_t>& utime = buffer<std::uint64_t>();
+    std::vector<double>& datenum = buffer<double>();
+    utime.assign(message_collection.entries.size(), 0);
+    datenum.assign(message_collection.entries.size(), 0);
     int i = 0;
     for (const auto& entry : message_collection.entries)
     {
@@ -441,17 +633,18 @@ void goby::middleware::hdf5::Writer::write_time(
 
     std::vector<hsize_t> hs;
     hs.push_back(message_collection.entries.size());
-    write_vector(group, "_utime_", utime, hs, (std::uint64_t)0);
-    write_vector(group, "_datenum_", datenum, hs, (double)0);
+    write_vector(*plan.group, plan.utime, "_utime_", utime, hs, (std::uint64_t)0);
+    write_vector(*plan.group, plan.datenum, "_datenum_", datenum, hs, (double)0);
 }
 
 void goby::middleware::hdf5::Writer::write_scheme(
-    const std::string& group, const goby::middleware::hdf5::MessageCollection& message_collection)
+    MessagePlan& plan, const goby::middleware::hdf5::MessageCollection& message_collection)
 {
     glog.is_debug1() && glog << "Writing scheme (size: " << message_collection.entries.size() << ")"
                              << std::endl;
 
-    std::vector<int> scheme(message_collection.entries.size(), 0);
+    std::vector<std::int32_t>& scheme = buffer<std::int32_t>();
+    scheme.assign(message_collection.entries.size(), 0);
     int i = 0;
     for (const auto& entry : message_collection.entries)
     {
@@ -461,19 +654,58 @@ void goby::middleware::hdf5::Writer::write_scheme(
 
     std::vector<hsize_t> hs;
     hs.push_back(message_collection.entries.size());
-    write_vector(group, "_scheme_", scheme, hs, (int)0);
+    write_vector(*plan.group, plan.scheme, "_scheme_", scheme, hs, (std::int32_t)0);
+}
+
+void goby::middleware::hdf5::Writer::open_dataset(H5::Group& grp, DataSetCache& ds,
+                                                  const std::string& dataset_name)
+{
+    if (!grp.exists(dataset_name))
+        return;
+
+    ds.dataset = grp.openDataSet(dataset_name);
+    H5::DataSpace existing_space(ds.dataset.getSpace());
+    ds.dims.resize(existing_space.getSimpleExtentNdims());
+    existing_space.getSimpleExtentDims(ds.dims.data());
+    ds.opened = true;
 }
 
-void goby::middleware::hdf5::Writer::write_vector(const std::string& group,
+H5::DataSpace goby::middleware::hdf5::Writer::extend_dataset(DataSetCache& ds,
+                                                             const std::vector<hsize_t>& hs)
+{
+    const std::vector<hsize_t>& existing_hs = ds.dims;
+    glog.is_debug2() && glog << "Existing dimensions are: " << dim_str(existing_hs) << std::endl;
+
+    // new size is larger of the existing or new vectors, except for the last dimension which is the sum
+    std::vector<hsize_t> new_size(hs.size(), 0);
+    for (int i = 0, n = new_size.size(); i < n; ++i) new_size[i] = std::max(hs[i], existing_hs[i]);
+    new_size.front() = existing_hs.front() + hs.front();
+
+    glog.is_debug2() && glog << "Extending dimensions to: " << dim_str(new_size) << std::endl;
+    ds.dataset.extend(new_size.data());
+
+    H5::DataSpace filespace(ds.dataset.getSpace());
+    std::vector<hsize_t> offset(hs.size(), 0);
+    offset.front() = existing_hs.front();
+
+    glog.is_debug2() && glog << "Selecting offset of: " << dim_str(offset) << std::endl;
+
+    filespace.selectHyperslab(H5S_SELECT_SET, hs.data(), offset.data());
+    ds.dims = std::move(new_size);
+    return filespace;
+}
+
+void goby::middleware::hdf5::Writer::write_vector(H5::Group& grp, DataSetCache& ds,
+                                                  DataSetCache& size_ds,
                                                   const std::string& dataset_name,
                                                   const std::vector<std::string>& data,
                                                   const std::vector<hsize_t>& hs_outer,
                                                   const std::string& default_value)
 {
-    std::vector<char> data_char;
     std::vector<hsize_t> hs = hs_outer;
 
-    std::vector<std::uint32_t> sizes;
+    std::vector<std::uint32_t>& sizes = buffer<std::uint32_t>();
+    sizes.clear();
     size_t max_size = 0;
     for (const auto& i : data)
     {
@@ -483,22 +715,29 @@ void goby::middleware::hdf5::Writer::write_vector(const std::string& group,
     }
 
     char fill_value = '\0';
-    for (auto d : data)
-    {
-        d.resize(max_size, fill_value);
-        for (char c : d) data_char.push_back(c);
-    }
+    std::vector<char>& data_char = string_data_;
+    data_char.assign(data.size() * max_size, fill_value);
+    for (std::size_t i = 0, n = data.size(); i < n; ++i)
+        std::copy(data[i].begin(), data[i].end(), data_char.begin() + i * max_size);
     hs.push_back(max_size);
 
     glog.is_debug1() && glog << "Writing string field \"" << dataset_name
                              << "\" (size: " << dim_str(hs) << ")" << std::endl;
 
-    auto maxhs = hs;
-    H5::DSetCreatPropList prop;
-    H5::Group& grp = group_factory_.fetch_group(group);
-    bool ds_exists = grp.exists(dataset_name);
-    if (!ds_exists)
+    if (!ds.opened)
+        open_dataset(grp, ds, dataset_name);
+
+    if (ds.opened)
+    {
+        H5::DataSpace memspace(hs.size(), hs.data());
+        H5::DataSpace filespace = extend_dataset(ds, hs);
+        if (data_char.size())
+            ds.dataset.write(&data_char[0], H5::PredType::NATIVE_CHAR, memspace, filespace);
+    }
+    else
     {
+        auto maxhs = hs;
+        H5::DSetCreatPropList prop;
         if (use_chunks_ && !final_write_)
         {
             // all dimensions may change
@@ -527,68 +766,53 @@ void goby::middleware::hdf5::Writer::write_vector(const std::string& group,
             if (use_compression_)
                 prop.setDeflate(compression_level_);
         }
-    }
-
-    std::unique_ptr<H5::DataSpace> dataspace;
-    if (data_char.size() || write_zero_length_dim_)
-        dataspace = std::make_unique<H5::DataSpace>(hs.size(), hs.data(), maxhs.data());
-    else
-        dataspace = std::make_unique<H5::DataSpace>(H5S_NULL);
-
-    H5::DataSet dataset =
-        ds_exists ? grp.openDataSet(dataset_name)
-                  : grp.createDataSet(dataset_name, H5::PredType::NATIVE_CHAR, *dataspace, prop);
-
-    if (ds_exists)
-    {
-        H5::DataSpace existing_space(dataset.getSpace());
-        std::vector<hsize_t> existing_hs(existing_space.getSimpleExtentNdims());
-        existing_space.getSimpleExtentDims(&existing_hs[0]);
-        glog.is_debug2() && glog << "Existing dimensions are: " << dim_str(existing_hs)
-                                 << std::endl;
-
-        std::vector<hsize_t> new_size(hs.size(), 0);
-        for (int i = 0, n = new_size.size(); i < n; ++i)
-            new_size[i] = std::max(hs[i], existing_hs[i]);
-
-        new_size.front() = hs.front() + existing_hs.front();
-
-        glog.is_debug2() && glog << "Extending dimensions to: " << dim_str(new_size) << std::endl;
-        dataset.extend(new_size.data());
-
-        auto& memspace = dataspace;
-        H5::DataSpace filespace(dataset.getSpace());
-        std::vector<hsize_t> offset(hs.size(), 0);
-        offset.front() += existing_hs.front();
 
-        glog.is_debug2() && glog << "Selecting offset of: " << dim_str(offset) << std::endl;
+        std::unique_ptr<H5::DataSpace> dataspace;
+        if (data_char.size() || write_zero_length_dim_)
+            dataspace = std::make_unique<H5::DataSpace>(hs.size(), hs.data(), maxhs.data());
+        else
+            dataspace = std::make_unique<H5::DataSpace>(H5S_NULL);
 
-        filespace.selectHyperslab(H5S_SELECT_SET, hs.data(), offset.data());
+        ds.dataset = grp.createDataSet(dataset_name, H5::PredType::NATIVE_CHAR, *dataspace, prop);
+        ds.opened = true;
+        ds.dims = hs;
         if (data_char.size())
-            dataset.write(&data_char[0], H5::PredType::NATIVE_CHAR, *memspace, filespace);
-    }
-    else
-    {
-        if (data_char.size())
-            dataset.write(&data_char[0], H5::PredType::NATIVE_CHAR);
+            ds.dataset.write(&data_char[0], H5::PredType::NATIVE_CHAR);
     }
 
     glog.is_debug1() && glog << "Writing string size field \"" << dataset_name + "_size"
                              << "\" (size: " << dim_str(hs_outer) << ")" << std::endl;
 
-    write_vector(group, dataset_name + "_size", sizes, hs_outer, std::uint32_t(0),
+    write_vector(grp, size_ds, dataset_name + "_size", sizes, hs_outer, std::uint32_t(0),
                  static_cast<std::uint32_t>(0) /* use empty value of 0 not uint32 max */);
 
-    const char* default_value_attr_name = "default_value";
-    if (!dataset.attrExists(default_value_attr_name))
+    if (!ds.attributes_written)
     {
-        const int rank = 1;
-        hsize_t att_hs[] = {1};
-        H5::DataSpace att_space(rank, att_hs, att_hs);
-        H5::StrType att_datatype(H5::PredType::C_S1, default_value.size() + 1);
-        H5::Attribute att =
-            dataset.createAttribute(default_value_attr_name, att_datatype, att_space);
-        const H5std_string& strbuf(default_value);
-        att.write(att_datatype, strbuf);
+        const char* default_value_attr_name = "default_value";
+        if (!ds.dataset.attrExists(default_value_attr_name))
+        {
+            const int rank = 1;
+            hsize_t att_hs[] = {1};
+            H5::DataSpace att_space(rank, att_hs, att_hs);
+            H5::StrType att_datatype(H5::PredType::C_S1, default_value.size() + 1);
+            H5::Attribute att =
+                ds.dataset.createAttribute(default_value_attr_name, att_datatype, att_space);
+            const H5std_string& strbuf(default_value);
+            att.write(att_datatype, strbuf);
+        }
+        ds.attributes_written = true;
+    }
+}
+
+std::ostream& goby::middleware::hdf5::operator<<(std::ostream& os, const Writer::Statistics& stats)
+{
+    os << "peak memory of entries held: " << stats.peak_memory / 1024 << " KiB";
+    if (stats.flushes > 0)
+    {
+        os << ", background writes: " << stats.flushes << " (" << stats.entries_flushed
+           << " entries), flush latency: mean "
+           << stats.total_flush_latency.count() / stats.flushes / 1000.0 << " ms, max "
+           << stats.max_flush_latency.count() / 1000.0 << " ms";
     }
+    return os;
 }
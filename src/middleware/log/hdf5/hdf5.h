@@ -24,14 +24,21 @@
 #ifndef GOBY_MIDDLEWARE_LOG_HDF5_HDF5_H
 #define GOBY_MIDDLEWARE_LOG_HDF5_HDF5_H
 
-#include <algorithm> // for max
-#include <cstdint>   // for uint64_t
-#include <deque>     // for deque
-#include <map>       // for map, multimap
-#include <memory>    // for shared_ptr
-#include <string>    // for string
-#include <utility>   // for move
-#include <vector>    // for vector
+#include <algorithm>          // for max
+#include <chrono>             // for microseconds, steady_clock
+#include <condition_variable> // for condition_variable
+#include <cstdint>            // for uint64_t
+#include <deque>              // for deque
+#include <exception>          // for exception_ptr
+#include <map>                // for map, multimap
+#include <memory>             // for shared_ptr
+#include <mutex>              // for mutex
+#include <ostream>            // for ostream
+#include <string>             // for string
+#include <thread>             // for thread
+#include <tuple>              // for tuple, get
+#include <utility>            // for move
+#include <vector>             // for vector
 
 #include <H5Cpp.h>
 #include <google/protobuf/descriptor.h> // for FieldDescriptor
@@ -72,6 +79,9 @@ struct Channel
 
     // message name -> hdf5::Message
     std::map<std::string, MessageCollection> entries;
+
+    // estimated memory used by the entries (only counted when streaming, see Writer)
+    std::size_t bytes{0};
 };
 
 // keeps track of HDF5 groups for us, and creates them as needed
@@ -107,50 +117,177 @@ class GroupFactory
 class Writer
 {
   public:
+    struct Statistics
+    {
+        /// \brief Largest estimated memory used by the entries held, including those waiting to be written by the background thread (streaming only)
+        std::size_t peak_memory{0};
+        /// \brief Number of times that entries were handed to the background thread, and the number of entries written by it
+        std::uint64_t flushes{0};
+        std::uint64_t entries_flushed{0};
+        /// \brief Time from entries being handed to the background thread until they were written
+        std::chrono::microseconds max_flush_latency{0};
+        std::chrono::microseconds total_flush_latency{0};
+    };
+
+    /// \param memory_budget If non-zero, stream the entries to the file rather than holding them all until write(): when the estimated memory used by the entries held reaches memory_budget bytes, the entries of the largest channels are written (as chunks of extensible datasets) by a background thread while add_entry() continues. This implies use_chunks (with a chunk_length of default_streaming_chunk_length if zero).
     Writer(const std::string& output_file, bool write_zero_length_dim = true,
            bool use_chunks = false, hsize_t chunk_length = 0, bool use_compression = false,
-           int compression_level = 0);
+           int compression_level = 0, std::size_t memory_budget = 0);
+    ~Writer();
 
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    /// \throw goby::Exception (or H5::Exception) if writing in the background failed
     void add_entry(goby::middleware::HDF5ProtobufEntry entry);
 
     void write(bool final_write = true);
 
+    Statistics statistics() const;
+
+    static constexpr hsize_t default_streaming_chunk_length{1000};
+
   private:
+    // HDF5 dataset, kept open so that writing further chunks to it doesn't need to look it up again
+    struct DataSetCache
+    {
+        bool opened{false};
+        H5::DataSet dataset;
+        // current extent
+        std::vector<hsize_t> dims;
+        bool attributes_written{false};
+    };
+
+    struct Column;
+    using ColumnWriter =
+        void (Writer::*)(Column& column,
+                         const std::vector<const google::protobuf::Message*>& messages,
+                         std::vector<hsize_t>& hs);
+
+    // plan for writing a field (and, for embedded messages, its fields) of a MessageCollection
+    struct Column
+    {
+        Column(const google::protobuf::FieldDescriptor* f, std::string g, ColumnWriter w)
+            : field_desc(f), group_path(std::move(g)), write(w)
+        {
+        }
+
+        const google::protobuf::FieldDescriptor* field_desc;
+        // group containing the field's dataset (fetched when first written)
+        std::string group_path;
+        H5::Group* group{nullptr};
+        ColumnWriter write;
+
+        DataSetCache dataset;
+        // sizes of strings
+        DataSetCache size_dataset;
+        bool enum_attributes_written{false};
+
+        // columns of an embedded message's fields, compiled when first written (as messages may
+        // be recursive)
+        bool children_compiled{false};
+        std::vector<Column> children;
+    };
+
+    // columns for a MessageCollection, compiled when it is first written
+    struct MessagePlan
+    {
+        const google::protobuf::Descriptor* desc{nullptr};
+        H5::Group* group{nullptr};
+        DataSetCache utime;
+        DataSetCache datenum;
+        DataSetCache scheme;
+        std::vector<Column> columns;
+    };
+
+    // chunk of entries written by the background thread
+    struct FlushJob
+    {
+        std::vector<MessageCollection> collections;
+        std::size_t bytes{0};
+        std::size_t entries{0};
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    // estimated memory used by entry once added to a channel
+    static std::size_t entry_bytes(const goby::middleware::HDF5ProtobufEntry& entry);
+    // hand the entries of the largest channels to the background thread
+    void flush_largest_channels();
+    void flush_loop();
+    // wait until the background thread has written everything handed to it, so that this thread
+    // can use the file
+    void wait_for_flush();
+    void rethrow_flush_error();
+
     void write_channel(const goby::middleware::hdf5::Channel& channel);
     void write_channel_chunk_and_clear(goby::middleware::hdf5::Channel& channel);
     void
     write_message_collection(const goby::middleware::hdf5::MessageCollection& message_collection);
-    void write_time(const std::string& group,
+    void write_time(MessagePlan& plan,
                     const goby::middleware::hdf5::MessageCollection& message_collection);
-    void write_scheme(const std::string& group,
+    void write_scheme(MessagePlan& plan,
                       const goby::middleware::hdf5::MessageCollection& message_collection);
 
-    void write_field_selector(const std::string& group,
-                              const google::protobuf::FieldDescriptor* field_desc,
-                              const std::vector<const google::protobuf::Message*>& messages,
-                              std::vector<hsize_t>& hs);
+    // fields and extensions of desc, in the order they are written
+    const std::vector<const google::protobuf::FieldDescriptor*>&
+    fields(const google::protobuf::Descriptor* desc);
+    std::vector<Column> compile(const google::protobuf::Descriptor* desc,
+                                const std::string& group_path);
+
+    void write_column(Column& column, const std::vector<const google::protobuf::Message*>& messages,
+                      std::vector<hsize_t>& hs);
 
-    void write_enum_attributes(const std::string& group,
-                               const google::protobuf::FieldDescriptor* field_desc);
+    void write_enum_field(Column& column,
+                          const std::vector<const google::protobuf::Message*>& messages,
+                          std::vector<hsize_t>& hs);
+    void write_enum_attributes(Column& column);
 
     template <typename T>
-    void write_field(const std::string& group, const google::protobuf::FieldDescriptor* field_desc,
-                     const std::vector<const google::protobuf::Message*>& messages,
+    void write_field(Column& column, const std::vector<const google::protobuf::Message*>& messages,
                      std::vector<hsize_t>& hs);
 
-    void write_embedded_message(const std::string& group,
-                                const google::protobuf::FieldDescriptor* field_desc,
-                                const std::vector<const google::protobuf::Message*> messages,
+    void write_embedded_message(Column& column,
+                                const std::vector<const google::protobuf::Message*>& messages,
                                 std::vector<hsize_t>& hs);
 
+    H5::Group& column_group(Column& column)
+    {
+        if (!column.group)
+            column.group = &group_factory_.fetch_group(column.group_path);
+        return *column.group;
+    }
+
     template <typename T>
-    void write_vector(const std::string& group, const std::string dataset_name,
+    void write_column_vector(Column& column, const std::vector<T>& data,
+                             const std::vector<hsize_t>& hs, const T& default_value)
+    {
+        write_vector(column_group(column), column.dataset, column.field_desc->name(), data, hs,
+                     default_value);
+    }
+
+    void write_column_vector(Column& column, const std::vector<std::string>& data,
+                             const std::vector<hsize_t>& hs, const std::string& default_value)
+    {
+        write_vector(column_group(column), column.dataset, column.size_dataset,
+                     column.field_desc->name(), data, hs, default_value);
+    }
+
+    template <typename T>
+    void write_vector(H5::Group& grp, DataSetCache& ds, const std::string& dataset_name,
                       const std::vector<T>& data, const std::vector<hsize_t>& hs,
                       const T& default_value, T empty_value = retrieve_empty_value<T>());
 
-    void write_vector(const std::string& group, const std::string& dataset_name,
-                      const std::vector<std::string>& data, const std::vector<hsize_t>& hs,
-                      const std::string& default_value);
+    void write_vector(H5::Group& grp, DataSetCache& ds, DataSetCache& size_ds,
+                      const std::string& dataset_name, const std::vector<std::string>& data,
+                      const std::vector<hsize_t>& hs, const std::string& default_value);
+
+    // opens the dataset if it exists (but isn't in the cache yet)
+    void open_dataset(H5::Group& grp, DataSetCache& ds, const std::string& dataset_name);
+    // extends an existing dataset by hs, returning the space to write the new data to
+    H5::DataSpace extend_dataset(DataSetCache& ds, const std::vector<hsize_t>& hs);
+
+    // reused for the values of each field
+    template <typename T> std::vector<T>& buffer() { return std::get<std::vector<T>>(buffers_); }
 
     std::string dim_str(const std::vector<hsize_t>& hs)
     {
@@ -171,14 +308,46 @@ class Writer
     bool use_compression_;
     int compression_level_;
     bool final_write_;
+
+    // streaming
+    std::size_t memory_budget_;
+    // estimated memory used by the entries in channels_
+    std::size_t memory_used_{0};
+    std::thread flush_thread_;
+    mutable std::mutex flush_mutex_;
+    std::condition_variable flush_cv_;
+    std::deque<FlushJob> flush_queue_;
+    // estimated memory used by the entries handed to the background thread and not yet written
+    std::size_t flush_bytes_{0};
+    bool flush_stop_{false};
+    std::exception_ptr flush_error_;
+    Statistics statistics_;
+
+    // message collection group -> plan
+    std::map<std::string, MessagePlan> plans_;
+    // cache of fields()
+    std::map<const google::protobuf::Descriptor*,
+             std::vector<const google::protobuf::FieldDescriptor*>>
+        fields_;
+
+    std::tuple<std::vector<std::int32_t>, std::vector<std::int64_t>, std::vector<std::uint32_t>,
+               std::vector<std::uint64_t>, std::vector<unsigned char>, std::vector<std::string>,
+               std::vector<float>, std::vector<double>>
+        buffers_;
+    std::vector<char> string_data_;
 };
 
 template <typename T>
-void Writer::write_field(const std::string& group,
-                         const google::protobuf::FieldDescriptor* field_desc,
+void Writer::write_field(Column& column,
                          const std::vector<const google::protobuf::Message*>& messages,
                          std::vector<hsize_t>& hs)
 {
+    const google::protobuf::FieldDescriptor* field_desc = column.field_desc;
+    std::vector<T>& values = buffer<T>();
+
+    T default_value;
+    retrieve_default_value(&default_value, field_desc);
+
     if (field_desc->is_repeated())
     {
         // pass one to figure out field size
@@ -196,7 +365,7 @@ void Writer::write_field(const std::string& group,
 
         hs.push_back(max_field_size);
 
-        std::vector<T> values(messages.size() * max_field_size, retrieve_empty_value<T>());
+        values.assign(messages.size() * max_field_size, retrieve_empty_value<T>());
 
         for (unsigned i = 0, n = messages.size(); i < n; ++i)
         {
@@ -210,16 +379,13 @@ void Writer::write_field(const std::string& group,
             }
         }
 
-        T default_value;
-        retrieve_default_value(&default_value, field_desc);
-
-        write_vector(group, field_desc->name(), values, hs, default_value);
+        write_column_vector(column, values, hs, default_value);
 
         hs.pop_back();
     }
     else
     {
-        std::vector<T> values(messages.size(), retrieve_empty_value<T>());
+        values.assign(messages.size(), retrieve_empty_value<T>());
         for (unsigned i = 0, n = messages.size(); i < n; ++i)
         {
             if (messages[i])
@@ -229,26 +395,29 @@ void Writer::write_field(const std::string& group,
             }
         }
 
-        T default_value;
-        retrieve_default_value(&default_value, field_desc);
-
-        write_vector(group, field_desc->name(), values, hs, default_value);
+        write_column_vector(column, values, hs, default_value);
     }
 }
 
 template <typename T>
-void Writer::write_vector(const std::string& group, const std::string dataset_name,
+void Writer::write_vector(H5::Group& grp, DataSetCache& ds, const std::string& dataset_name,
                           const std::vector<T>& data, const std::vector<hsize_t>& hs,
                           const T& default_value, T empty_value)
 {
-    std::unique_ptr<H5::DataSpace> dataspace;
-    H5::Group& grp = group_factory_.fetch_group(group);
+    if (!ds.opened)
+        open_dataset(grp, ds, dataset_name);
 
-    auto maxhs = hs;
-    H5::DSetCreatPropList prop;
-    bool ds_exists = grp.exists(dataset_name);
-    if (!ds_exists)
+    if (ds.opened)
+    {
+        H5::DataSpace memspace(hs.size(), hs.data());
+        H5::DataSpace filespace = extend_dataset(ds, hs);
+        if (data.size())
+            ds.dataset.write(&data[0], predicate<T>(), memspace, filespace);
+    }
+    else
     {
+        auto maxhs = hs;
+        H5::DSetCreatPropList prop;
         if (use_chunks_ && !final_write_)
         {
             // all dimensions may change
@@ -269,63 +438,37 @@ void Writer::write_vector(const std::string& group, const std::string dataset_na
             if (use_compression_)
                 prop.setDeflate(compression_level_);
         }
-        
-    }
 
-    if (data.size() || write_zero_length_dim_)
-        dataspace = std::make_unique<H5::DataSpace>(hs.size(), hs.data(), maxhs.data());
-    else
-        dataspace = std::make_unique<H5::DataSpace>(H5S_NULL);
-
-    H5::DataSet dataset = ds_exists
-                              ? grp.openDataSet(dataset_name)
-                              : grp.createDataSet(dataset_name, predicate<T>(), *dataspace, prop);
-
-    if (ds_exists)
-    {
-        H5::DataSpace existing_space(dataset.getSpace());
-        std::vector<hsize_t> existing_hs(existing_space.getSimpleExtentNdims());
-        existing_space.getSimpleExtentDims(&existing_hs[0]);
-        glog.is_debug2() && glog << "Existing dimensions are: " << dim_str(existing_hs)
-                                 << std::endl;
-
-        // new size is larger of the existing or new vectors, except for the last dimension which is the sum
-        std::vector<hsize_t> new_size(hs.size(), 0);
-        for (int i = 0, n = new_size.size(); i < n; ++i)
-            new_size[i] = std::max(hs[i], existing_hs[i]);
-        new_size.front() = existing_hs.front() + hs.front();
-
-        glog.is_debug2() && glog << "Extending dimensions to: " << dim_str(new_size) << std::endl;
-        dataset.extend(new_size.data());
-
-        auto& memspace = dataspace;
-        H5::DataSpace filespace(dataset.getSpace());
-        std::vector<hsize_t> offset(hs.size(), 0);
-        offset.front() = existing_hs.front();
-
-        glog.is_debug2() && glog << "Selecting offset of: " << dim_str(offset) << std::endl;
+        std::unique_ptr<H5::DataSpace> dataspace;
+        if (data.size() || write_zero_length_dim_)
+            dataspace = std::make_unique<H5::DataSpace>(hs.size(), hs.data(), maxhs.data());
+        else
+            dataspace = std::make_unique<H5::DataSpace>(H5S_NULL);
 
-        filespace.selectHyperslab(H5S_SELECT_SET, hs.data(), offset.data());
+        ds.dataset = grp.createDataSet(dataset_name, predicate<T>(), *dataspace, prop);
+        ds.opened = true;
+        ds.dims = hs;
         if (data.size())
-            dataset.write(&data[0], predicate<T>(), *memspace, filespace);
-    }
-    else
-    {
-        if (data.size())
-            dataset.write(&data[0], predicate<T>());
+            ds.dataset.write(&data[0], predicate<T>());
     }
 
-    const char* default_value_attr_name = "default_value";
-    if (!dataset.attrExists(default_value_attr_name))
+    if (!ds.attributes_written)
     {
-        const int rank = 1;
-        hsize_t att_hs[] = {1};
-        H5::DataSpace att_space(rank, att_hs, att_hs);
-        H5::Attribute att =
-            dataset.createAttribute(default_value_attr_name, predicate<T>(), att_space);
-        att.write(predicate<T>(), &default_value);
+        const char* default_value_attr_name = "default_value";
+        if (!ds.dataset.attrExists(default_value_attr_name))
+        {
+            const int rank = 1;
+            hsize_t att_hs[] = {1};
+            H5::DataSpace att_space(rank, att_hs, att_hs);
+            H5::Attribute att =
+                ds.dataset.createAttribute(default_value_attr_name, predicate<T>(), att_space);
+            att.write(predicate<T>(), &default_value);
+        }
+        ds.attributes_written = true;
     }
 }
+std::ostream& operator<<(std::ostream& os, const Writer::Statistics& stats);
+
 } // namespace hdf5
 } // namespace middleware
 } // namespace goby
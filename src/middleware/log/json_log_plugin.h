@@ -51,7 +51,8 @@ class JSONPlugin : public LogPlugin
 
     void register_read_hooks(const std::ifstream& in_log_file) override {}
 
-    void register_write_hooks(std::ofstream& out_log_file) override {}
+    using LogPlugin::register_write_hooks;
+    void register_write_hooks(std::ostream& out_log_file) override {}
 
     std::shared_ptr<nlohmann::json> parse_message(LogEntry& log_entry)
     {
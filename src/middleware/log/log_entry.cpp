@@ -26,6 +26,8 @@
 #include <algorithm>                             // for copy, max
 #include <boost/iterator/iterator_facade.hpp>    // for operator!=, iter...
 #include <boost/multi_index/sequenced_index.hpp> // for operator==
+#include <streambuf>                             // for streambuf
+#include <utility>                               // for swap
 
 #include "goby/middleware/marshalling/interface.h" // for MarshallingScheme
 #include "goby/time/convert.h"
@@ -38,11 +40,78 @@ enum VersionFeatures
     VERSION_ADD_TYPE_GROUP_HOOKS = 2,
     VERSION_ADD_VERSION_NUMBER = 2,
     VERSION_ADD_SCHEME_TO_GROUP_TYPE_MAPPING = 2,
-    VERSION_ADD_TIMESTAMP = 3
+    VERSION_ADD_TIMESTAMP = 3,
+    VERSION_ADD_COMPRESSED_BLOCKS = goby::middleware::log::LogEntry::compressed_block_version
 };
 
 using goby::middleware::log::LogEntry;
 
+namespace goby
+{
+namespace middleware
+{
+namespace log
+{
+namespace detail
+{
+// read area over the entries of a decompressed block, so that parse() can read them as it does the log itself
+class BlockBuffer : public std::streambuf
+{
+  public:
+    std::string& bytes() { return bytes_; }
+    void rewind() { setg(&bytes_[0], &bytes_[0], &bytes_[0] + bytes_.size()); }
+    bool exhausted() { return gptr() == egptr(); }
+
+  protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                     std::ios_base::openmode /*which*/) override
+    {
+        off_type pos = off;
+        if (dir == std::ios_base::cur)
+            pos += gptr() - eback();
+        else if (dir == std::ios_base::end)
+            pos += egptr() - eback();
+
+        if (pos < 0 || pos > egptr() - eback())
+            return pos_type(off_type(-1));
+        setg(eback(), eback() + pos, egptr());
+        return pos_type(pos);
+    }
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+    {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+
+  private:
+    std::string bytes_;
+};
+
+// the compressed block being read by parse()
+struct ReadBlock
+{
+    ReadBlock() { entries.exceptions(std::ios::failbit | std::ios::badbit | std::ios::eofbit); }
+
+    // stream the block was read from (nullptr if none)
+    std::istream* source{nullptr};
+    std::istream::pos_type start{0};
+    std::istream::pos_type end{0};
+    std::string compressed;
+    BlockBuffer buffer;
+    std::istream entries{&buffer};
+};
+
+} // namespace detail
+} // namespace log
+} // namespace middleware
+} // namespace goby
+
+namespace
+{
+// swapped with those of LogEntry::ReadState when reading several logs
+std::unique_ptr<goby::middleware::log::detail::ReadBlock>
+    current_block(new goby::middleware::log::detail::ReadBlock);
+} // namespace
+
 std::map<int, boost::bimap<std::string, goby::middleware::log::uint<LogEntry::group_bytes_>::type>>
     LogEntry::groups_;
 std::map<int, boost::bimap<std::string, goby::middleware::log::uint<LogEntry::type_bytes_>::type>>
@@ -62,19 +131,46 @@ goby::middleware::log::uint<LogEntry::version_bytes_>::type
     LogEntry::version_(LogEntry::invalid_version);
 
 int LogEntry::current_version_(LogEntry::compiled_current_version);
+bool LogEntry::compressed_blocks_(false);
 
-void LogEntry::parse_version(std::istream* s)
+std::uint64_t LogEntry::metadata_entries_read_(0);
+
+const std::string LogEntry::magic_{"GBY3"};
+const std::string LogEntry::block_magic_{"GBYZ"};
+
+LogEntry::ReadState::ReadState() : block_(new detail::ReadBlock) {}
+LogEntry::ReadState::~ReadState() = default;
+
+void LogEntry::swap_read_state(ReadState& state)
 {
-    version_ = read_one<uint<version_bytes_>::type>(s);
+    std::swap(groups_, state.groups_);
+    std::swap(types_, state.types_);
+    std::swap(version_, state.version_);
+    std::swap(current_block, state.block_);
+}
 
-    // Original file format didn't have a version, so "GB" would be the version bytes
-    // (first two characters of the magic word)
-    if (version_ == string_to_netint<decltype(version_)>(magic_))
+void LogEntry::parse_version(std::istream* s)
+{
+    if (!set_version(read_one<uint<version_bytes_>::type>(s)))
     {
-        version_ = 1;
         // rewind
         s->seekg(s->tellg() - std::streamoff(version_bytes_));
     }
+}
+
+bool LogEntry::set_version(uint<version_bytes_>::type version)
+{
+    bool has_version = true;
+    version_ = version;
+
+    // Original file format didn't have a version, so "GBY3" would be the version bytes
+    // (the magic word of the first entry)
+    if (version_ ==
+        bytes_to_netint<decltype(version_)>(reinterpret_cast<const unsigned char*>(magic_.data())))
+    {
+        version_ = 1;
+        has_version = false;
+    }
     else if (version_ > current_version_)
     {
         glog.is_warn() && glog << "Version 0x" << std::hex << version_
@@ -84,6 +180,101 @@ void LogEntry::parse_version(std::istream* s)
     }
 
     glog.is_verbose() && glog << "File version is " << version_ << std::endl;
+    return has_version;
+}
+
+std::size_t LogEntry::fixed_field_size()
+{
+    std::size_t size = scheme_bytes_ + group_bytes_ + type_bytes_ + crc_bytes_;
+    if (version_ >= VERSION_ADD_TIMESTAMP)
+        size += timestamp_bytes_;
+    return size;
+}
+
+void LogEntry::add_index_entry(uint<scheme_bytes_>::type scheme,
+                               uint<group_bytes_>::type group_index,
+                               uint<type_bytes_>::type type_index, const unsigned char* data,
+                               std::size_t size)
+{
+    int legacy_scheme = goby::middleware::MarshallingScheme::NULL_SCHEME;
+
+    if (version_ >= VERSION_ADD_SCHEME_TO_GROUP_TYPE_MAPPING && size < scheme_bytes_)
+        throw(log::LogException("Invalid index entry of " + std::to_string(size) + " bytes"));
+
+    ++metadata_entries_read_;
+
+    if (scheme == scheme_group_index_)
+    {
+        if (version_ < VERSION_ADD_SCHEME_TO_GROUP_TYPE_MAPPING)
+        {
+            std::string group(data, data + size);
+
+            // The first type of .goby files that used a single mapping of type/group
+            // string for all schemes. This worked fine unless the two schemes are in use that had a common type name.
+            glog.is_debug1() && glog << "Mapping group [" << group << "] to index: " << group_index
+                                     << std::endl;
+
+            groups_[legacy_scheme].left.insert({group, group_index});
+        }
+        else
+        {
+            auto group_scheme = bytes_to_netint<uint<scheme_bytes_>::type>(data);
+
+            std::string group(data + scheme_bytes_, data + size);
+            glog.is_debug1() && glog << "For scheme [" << group_scheme << "], mapping group ["
+                                     << group << "] to index: " << group_index << std::endl;
+            groups_[group_scheme].left.insert({group, group_index});
+
+            if (new_group_hook[group_scheme])
+                new_group_hook[group_scheme](goby::middleware::DynamicGroup(group));
+        }
+    }
+    else if (scheme == scheme_type_index_)
+    {
+        if (version_ < VERSION_ADD_SCHEME_TO_GROUP_TYPE_MAPPING)
+        {
+            std::string type(data, data + size);
+            glog.is_debug1() && glog << "Mapping type [" << type << "] to index: " << type_index
+                                     << std::endl;
+            types_[legacy_scheme].left.insert({type, type_index});
+        }
+        else
+        {
+            auto type_scheme = bytes_to_netint<uint<scheme_bytes_>::type>(data);
+
+            std::string type(data + scheme_bytes_, data + size);
+            glog.is_debug1() && glog << "For scheme [" << type_scheme << "], mapping type ["
+                                     << type << "] to index: " << type_index << std::endl;
+            types_[type_scheme].left.insert({type, type_index});
+
+            if (new_type_hook[type_scheme])
+                new_type_hook[type_scheme](type);
+        }
+    }
+}
+
+const std::string* LogEntry::find_group(int scheme, uint<group_bytes_>::type group_index)
+{
+    if (version_ < VERSION_ADD_SCHEME_TO_GROUP_TYPE_MAPPING)
+        scheme = goby::middleware::MarshallingScheme::NULL_SCHEME;
+
+    auto scheme_it = groups_.find(scheme);
+    if (scheme_it == groups_.end())
+        return nullptr;
+    auto it = scheme_it->second.right.find(group_index);
+    return it == scheme_it->second.right.end() ? nullptr : &it->second;
+}
+
+const std::string* LogEntry::find_type(int scheme, uint<type_bytes_>::type type_index)
+{
+    if (version_ < VERSION_ADD_SCHEME_TO_GROUP_TYPE_MAPPING)
+        scheme = goby::middleware::MarshallingScheme::NULL_SCHEME;
+
+    auto scheme_it = types_.find(scheme);
+    if (scheme_it == types_.end())
+        return nullptr;
+    auto it = scheme_it->second.right.find(type_index);
+    return it == scheme_it->second.right.end() ? nullptr : &it->second;
 }
 
 void LogEntry::parse(std::istream* s)
@@ -97,28 +288,102 @@ void LogEntry::parse(std::istream* s)
     auto old_except_mask = s->exceptions();
     s->exceptions(std::ios::failbit | std::ios::badbit | std::ios::eofbit);
 
-    int legacy_scheme = goby::middleware::MarshallingScheme::NULL_SCHEME;
+    mapped_data_ = nullptr;
+    mapped_size_ = 0;
 
-    uint<scheme_bytes_>::type scheme(0);
+    // the rest of a compressed block is only read if the stream is still where the block ended
+    if (current_block->source && (current_block->source != s || s->tellg() != current_block->end))
+        discard_block();
 
-    bool filter_matched = false;
-    do {
-        char next_char = s->peek();
-        if (next_char != magic_[0])
+    for (;;)
+    {
+        uint<scheme_bytes_>::type scheme(0);
+        uint<group_bytes_>::type group_index(0);
+        uint<type_bytes_>::type type_index(0);
+        if (!read_entry(s, &scheme, &group_index, &type_index))
+            continue;
+
+        if (scheme == scheme_group_index_ || scheme == scheme_type_index_)
+        {
+            add_index_entry(scheme, group_index, type_index, data_.data(), data_.size());
+            data_.clear();
+            continue;
+        }
+
+        scheme_ = scheme;
+
+        if (const auto* type = find_type(scheme, type_index))
+        {
+            type_ = *type;
+        }
+        else
+        {
+            type_ = "_unknown" + std::to_string(type_index) + "_";
+            glog.is(WARN) && glog << "No type entry in file for type index: " << type_index
+                                  << std::endl;
+        }
+
+        std::string group;
+        if (const auto* g = find_group(scheme, group_index))
+        {
+            group = *g;
+        }
+        else
         {
-            glog.is(WARN) && glog << "Next byte [0x" << std::hex
-                                  << (static_cast<int>(next_char) & 0xFF) << std::dec
-                                  << "] is not the start of the expected magic word [" << magic_
-                                  << "]. Seeking until next magic word." << std::endl;
+            group = "_unknown" + std::to_string(group_index) + "_";
+            glog.is(WARN) && glog << "No group entry in file for group index: " << group_index
+                                  << std::endl;
         }
 
-        std::string magic_read(magic_.size(), '\0');
-        int discarded = 0;
+        group_ = goby::middleware::DynamicGroup(group);
+
+        LogFilter filt{scheme_, group, type_};
+        auto filter_it = filter_hook.find(filt);
+        if (filter_it == filter_hook.end())
+            break;
+
+        ++metadata_entries_read_;
+        filter_it->second(data_);
+    }
+
+    s->exceptions(old_except_mask);
+}
 
+bool LogEntry::read_entry(std::istream* s, uint<scheme_bytes_>::type* scheme,
+                          uint<group_bytes_>::type* group_index,
+                          uint<type_bytes_>::type* type_index)
+{
+    using namespace goby::util::logger;
+    using goby::glog;
+
+    std::istream* in = s;
+    if (current_block->source)
+    {
+        if (current_block->buffer.exhausted())
+            discard_block();
+        else
+            in = &current_block->entries;
+    }
+
+    const bool blocks_allowed = (in == s && version_ >= VERSION_ADD_COMPRESSED_BLOCKS);
+
+    char next_char = in->peek();
+    if (next_char != magic_[0])
+    {
+        glog.is(WARN) && glog << "Next byte [0x" << std::hex << (static_cast<int>(next_char) & 0xFF)
+                              << std::dec << "] is not the start of the expected magic word ["
+                              << magic_ << "]. Seeking until next magic word." << std::endl;
+    }
+
+    std::string magic_read(magic_.size(), '\0');
+    int discarded = 0;
+
+    try
+    {
         for (;;)
         {
-            s->read(&magic_read[0], magic_.size());
-            if (magic_read == magic_)
+            in->read(&magic_read[0], magic_.size());
+            if (magic_read == magic_ || (blocks_allowed && magic_read == block_magic_))
             {
                 break;
             }
@@ -128,182 +393,204 @@ void LogEntry::parse(std::istream* s)
                 glog.is_debug2() && glog << "Discarded bytes: " << discarded << std::endl;
 
                 // rewind to read the next byte
-                s->seekg(s->tellg() - std::streamoff(magic_.size() - 1));
+                in->seekg(in->tellg() - std::streamoff(magic_.size() - 1));
             }
         }
+    }
+    catch (std::ios_base::failure& e)
+    {
+        // blocks are checked before being read, so this should not happen, but the end of a block is not the end of the log
+        if (in == s)
+            throw;
+        discard_block();
+        throw(log::LogException("Failed to find next entry in compressed block"));
+    }
 
-        if (discarded != 0)
-            glog.is(WARN) && glog << "Found next magic word after skipping " << discarded
-                                  << " bytes" << std::endl;
+    if (discarded != 0)
+        glog.is(WARN) && glog << "Found next magic word after skipping " << discarded << " bytes"
+                              << std::endl;
 
-        boost::crc_32_type crc;
-        crc.process_bytes(&magic_read[0], magic_.size());
+    if (magic_read == block_magic_)
+    {
+        read_block(s);
+        return false;
+    }
 
-        auto size(read_one<uint<size_bytes_>::type>(s, &crc));
-        decltype(size) fixed_field_size = scheme_bytes_ + group_bytes_ + type_bytes_ + crc_bytes_;
-        if (version_ >= VERSION_ADD_TIMESTAMP)
-            fixed_field_size += timestamp_bytes_;
+    detail::CRC32 crc;
+    crc.process_bytes(&magic_read[0], magic_.size());
 
-        if (size < fixed_field_size)
-            throw(log::LogException("Invalid size read: " + std::to_string(size) +
-                                    " as message must be at least " +
-                                    std::to_string(fixed_field_size) + " bytes long"));
+    auto size(read_one<uint<size_bytes_>::type>(in, &crc));
+    if (size < fixed_field_size())
+        throw(log::LogException("Invalid size read: " + std::to_string(size) +
+                                " as message must be at least " +
+                                std::to_string(fixed_field_size()) + " bytes long"));
 
-        auto data_size = size - fixed_field_size;
-        glog.is(DEBUG2) && glog << "Reading entry of " << size << " bytes (" << data_size
-                                << " bytes data)" << std::endl;
+    auto data_size = size - fixed_field_size();
+    glog.is(DEBUG2) && glog << "Reading entry of " << size << " bytes (" << data_size
+                            << " bytes data)" << std::endl;
 
-        scheme = read_one<uint<scheme_bytes_>::type>(s, &crc);
-        auto group_index(read_one<uint<group_bytes_>::type>(s, &crc));
-        auto type_index(read_one<uint<type_bytes_>::type>(s, &crc));
-        if (version_ >= VERSION_ADD_TIMESTAMP)
-        {
-            auto timestamp(read_one<uint<timestamp_bytes_>::type>(s, &crc));
-            glog.is(DEBUG2) && glog << "Timestamp: " << timestamp << " microseconds" << std::endl;
-            timestamp_ = goby::time::convert<decltype(timestamp_)>(
-                timestamp * boost::units::si::micro * boost::units::si::seconds);
-        }
+    *scheme = read_one<uint<scheme_bytes_>::type>(in, &crc);
+    *group_index = read_one<uint<group_bytes_>::type>(in, &crc);
+    *type_index = read_one<uint<type_bytes_>::type>(in, &crc);
+    if (version_ >= VERSION_ADD_TIMESTAMP)
+    {
+        auto timestamp(read_one<uint<timestamp_bytes_>::type>(in, &crc));
+        glog.is(DEBUG2) && glog << "Timestamp: " << timestamp << " microseconds" << std::endl;
+        timestamp_ = goby::time::convert<decltype(timestamp_)>(
+            timestamp * boost::units::si::micro * boost::units::si::seconds);
+    }
 
-        auto data_start_pos = s->tellg();
-        try
-        {
-            data_.resize(data_size);
-            s->read(reinterpret_cast<char*>(&data_[0]), data_size);
+    auto data_start_pos = in->tellg();
+    if (in == s)
+        offset_ = std::streamoff(data_start_pos) -
+                  (magic_bytes_ + size_bytes_ + fixed_field_size() - crc_bytes_);
+    else
+        offset_ = std::streamoff(current_block->start);
 
-            crc.process_bytes(&data_[0], data_.size());
+    try
+    {
+        data_.resize(data_size);
+        in->read(reinterpret_cast<char*>(&data_[0]), data_size);
 
-            auto calculated_crc = crc.checksum();
-            auto given_crc(read_one<uint<crc_bytes_>::type>(s));
+        crc.process_bytes(&data_[0], data_.size());
 
-            if (calculated_crc != given_crc)
-            {
-                // return to where we started reading data as the size might have been corrupt
-                s->seekg(data_start_pos);
-                data_.clear();
-                throw(
-                    log::LogException("Invalid CRC on packet: given: " + std::to_string(given_crc) +
-                                      ", calculated: " + std::to_string(calculated_crc)));
-            }
-        }
-        catch (std::ios_base::failure& e)
+        auto calculated_crc = crc.checksum();
+        auto given_crc(read_one<uint<crc_bytes_>::type>(in));
+
+        if (calculated_crc != given_crc)
         {
-            // clear EOF, etc.
-            s->clear();
-            // return to where data reading starting in case size was corrupted
-            s->seekg(data_start_pos);
-            throw(log::LogException("Failed to read " + std::to_string(size) + " bytes of data (" +
-                                    e.what() +
-                                    "); seeking back to start of data read in hopes "
-                                    "of finding valid next message."));
+            // return to where we started reading data as the size might have been corrupt
+            in->seekg(data_start_pos);
+            data_.clear();
+            throw(log::LogException("Invalid CRC on packet: given: " + std::to_string(given_crc) +
+                                    ", calculated: " + std::to_string(calculated_crc)));
         }
+    }
+    catch (std::ios_base::failure& e)
+    {
+        // clear EOF, etc.
+        in->clear();
+        // return to where data reading starting in case size was corrupted
+        in->seekg(data_start_pos);
+        throw(log::LogException("Failed to read " + std::to_string(size) + " bytes of data (" +
+                                e.what() +
+                                "); seeking back to start of data read in hopes "
+                                "of finding valid next message."));
+    }
 
-        if (scheme == scheme_group_index_)
-        {
-            if (version_ < VERSION_ADD_SCHEME_TO_GROUP_TYPE_MAPPING)
-            {
-                std::string group(data_.begin(), data_.end());
+    return true;
+}
 
-                // The first type of .goby files that used a single mapping of type/group
-                // string for all schemes. This worked fine unless the two schemes are in use that had a common type name.
-                glog.is(DEBUG1) && glog << "Mapping group [" << group
-                                        << "] to index: " << group_index << std::endl;
+void LogEntry::read_block(std::istream* s)
+{
+    auto start = s->tellg() - std::streamoff(magic_bytes_);
+    auto after_magic = s->tellg();
 
-                groups_[legacy_scheme].left.insert({group, group_index});
-            }
-            else
-            {
-                std::string group_scheme_str(data_.begin(), data_.begin() + scheme_bytes_);
-                auto group_scheme = string_to_netint<uint<scheme_bytes_>::type>(group_scheme_str);
+    unsigned char header[block_header_bytes_];
+    std::copy(block_magic_.begin(), block_magic_.end(), header);
+    s->read(reinterpret_cast<char*>(header + magic_bytes_), block_header_bytes_ - magic_bytes_);
 
-                std::string group(data_.begin() + scheme_bytes_, data_.end());
-                glog.is(DEBUG1) && glog << "For scheme [" << group_scheme << "], mapping group ["
-                                        << group << "] to index: " << group_index << std::endl;
-                groups_[group_scheme].left.insert({group, group_index});
+    try
+    {
+        auto block_header = parse_block_header(header);
 
-                if (new_group_hook[group_scheme])
-                    new_group_hook[group_scheme](goby::middleware::DynamicGroup(group));
-            }
-            data_.clear();
-        }
-        else if (scheme == scheme_type_index_)
+        auto& compressed = current_block->compressed;
+        compressed.resize(block_header.compressed_size + crc_bytes_);
+        try
         {
-            if (version_ < VERSION_ADD_SCHEME_TO_GROUP_TYPE_MAPPING)
-            {
-                std::string type(data_.begin(), data_.end());
-                glog.is(DEBUG1) && glog << "Mapping type [" << type << "] to index: " << type_index
-                                        << std::endl;
-                types_[legacy_scheme].left.insert({type, type_index});
-            }
-            else
-            {
-                std::string type_scheme_str(data_.begin(), data_.begin() + scheme_bytes_);
-                auto type_scheme = string_to_netint<uint<scheme_bytes_>::type>(type_scheme_str);
-
-                std::string type(data_.begin() + scheme_bytes_, data_.end());
-                glog.is(DEBUG1) && glog << "For scheme [" << type_scheme << "], mapping type ["
-                                        << type << "] to index: " << type_index << std::endl;
-                types_[type_scheme].left.insert({type, type_index});
-
-                if (new_type_hook[type_scheme])
-                    new_type_hook[type_scheme](type);
-            }
-
-            data_.clear();
+            s->read(&compressed[0], compressed.size());
         }
-        else
+        catch (std::ios_base::failure& e)
         {
-            scheme_ = scheme;
-
-            std::string type = "_unknown" + std::to_string(type_index) + "_";
-            auto type_it = types_[scheme].right.find(type_index),
-                 type_end_it = types_[scheme].right.end();
-
-            if (version_ < VERSION_ADD_SCHEME_TO_GROUP_TYPE_MAPPING)
-            {
-                type_it = types_[legacy_scheme].right.find(type_index);
-                type_end_it = types_[legacy_scheme].right.end();
-            }
+            s->clear();
+            throw(log::LogException("Failed to read compressed block of " +
+                                    std::to_string(block_header.compressed_size) + " bytes (" +
+                                    e.what() + ")"));
+        }
 
-            if (type_it != type_end_it)
-                type = type_it->second;
-            else
-                glog.is(WARN) && glog << "No type entry in file for type index: " << type_index
-                                      << std::endl;
+        decompress_block(block_header, reinterpret_cast<const unsigned char*>(compressed.data()),
+                         &current_block->buffer.bytes());
+    }
+    catch (log::LogException& e)
+    {
+        // as for entries, resume after the magic word in case the sizes were corrupt
+        s->seekg(after_magic);
+        throw(log::LogException(std::string(e.what()) +
+                                "; seeking back to start of block in hopes of finding valid next "
+                                "message."));
+    }
 
-            type_ = type;
+    glog.is_debug2() && glog << "Read compressed block of " << current_block->buffer.bytes().size()
+                             << " bytes" << std::endl;
 
-            std::string group = "_unknown" + std::to_string(group_index) + "_";
-            auto group_it = groups_[scheme].right.find(group_index),
-                 group_end_it = groups_[scheme].right.end();
+    current_block->source = s;
+    current_block->start = start;
+    current_block->end = s->tellg();
+    current_block->buffer.rewind();
+    current_block->entries.clear();
+}
 
-            if (version_ < VERSION_ADD_SCHEME_TO_GROUP_TYPE_MAPPING)
-            {
-                group_it = groups_[legacy_scheme].right.find(group_index);
-                group_end_it = groups_[legacy_scheme].right.end();
-            }
+void LogEntry::discard_block()
+{
+    current_block->source = nullptr;
+    current_block->buffer.bytes().clear();
+    current_block->buffer.rewind();
+}
 
-            if (group_it != group_end_it)
-                group = group_it->second;
-            else
-                glog.is(WARN) && glog << "No group entry in file for group index: " << group_index
-                                      << std::endl;
+LogEntry::BlockHeader LogEntry::parse_block_header(const unsigned char* header)
+{
+    const unsigned char* p = header + magic_bytes_;
+    BlockHeader block_header;
+    block_header.compression = static_cast<Compression>(*p);
+    p += block_codec_bytes_;
+    block_header.size = bytes_to_netint<uint<size_bytes_>::type>(p);
+    p += size_bytes_;
+    block_header.compressed_size = bytes_to_netint<uint<size_bytes_>::type>(p);
+    p += size_bytes_;
+
+    auto calculated_crc = detail::crc32(0, header, p - header);
+    auto given_crc = bytes_to_netint<uint<crc_bytes_>::type>(p);
+    if (calculated_crc != given_crc)
+        throw(log::LogException("Invalid CRC on compressed block header: given: " +
+                                std::to_string(given_crc) +
+                                ", calculated: " + std::to_string(calculated_crc)));
+
+    if (block_header.size > max_block_size_ || block_header.compressed_size > max_block_size_)
+        throw(log::LogException("Invalid compressed block size: " +
+                                std::to_string(block_header.size) + " (" +
+                                std::to_string(block_header.compressed_size) + " compressed)"));
+    return block_header;
+}
 
-            group_ = goby::middleware::DynamicGroup(group);
+void LogEntry::decompress_block(const BlockHeader& header, const unsigned char* data,
+                                std::string* out)
+{
+    auto calculated_crc = detail::crc32(0, data, header.compressed_size);
+    auto given_crc = bytes_to_netint<uint<crc_bytes_>::type>(data + header.compressed_size);
+    if (calculated_crc != given_crc)
+        throw(log::LogException("Invalid CRC on compressed block: given: " +
+                                std::to_string(given_crc) +
+                                ", calculated: " + std::to_string(calculated_crc)));
+
+    out->resize(header.size);
+    decompress(header.compression, reinterpret_cast<const char*>(data), header.compressed_size,
+               &(*out)[0], header.size);
+}
 
-            LogFilter filt{scheme_, group, type_};
-            if (filter_hook.count(filt))
-            {
-                filter_matched = true;
-                filter_hook[filt](data_);
-            }
-            else
-            {
-                filter_matched = false;
-            }
-        }
-    } while (scheme == scheme_group_index_ || scheme == scheme_type_index_ || filter_matched);
+std::int64_t LogEntry::tell(std::istream* s)
+{
+    if (current_block->source == s && !current_block->buffer.exhausted() &&
+        s->tellg() == current_block->end)
+        return std::streamoff(current_block->start);
+    return std::streamoff(s->tellg());
+}
 
-    s->exceptions(old_except_mask);
+void LogEntry::seek(std::istream* s, std::uint64_t offset)
+{
+    if (current_block->source == s)
+        discard_block();
+    s->clear();
+    s->seekg(offset);
 }
 
 void LogEntry::serialize(std::ostream* s) const
@@ -314,10 +601,12 @@ void LogEntry::serialize(std::ostream* s) const
     // write version
     if (version_ == invalid_version)
     {
-        version_ = current_version_;
+        version_ = (compressed_blocks_ || current_version_ < uncompressed_version)
+                       ? current_version_
+                       : uncompressed_version;
 
         // version tagging started at version 2
-        if (current_version_ >= VERSION_ADD_VERSION_NUMBER)
+        if (version_ >= VERSION_ADD_VERSION_NUMBER)
         {
             std::string version_str(netint_to_string(version_));
             s->write(version_str.data(), version_str.size());
@@ -364,12 +653,35 @@ void LogEntry::serialize(std::ostream* s) const
     auto type_index = types_[scheme_mapping].left.at(type_);
 
     // insert actual data
-    _serialize(s, scheme_, group_index, type_index, reinterpret_cast<const char*>(&data_[0]),
-               data_.size());
+    auto data = this->data();
+    _serialize(s, scheme_, group_index, type_index, reinterpret_cast<const char*>(data.data()),
+               data.size());
 
     s->exceptions(old_except_mask);
 }
 
+void LogEntry::serialize_block(Compression compression, int level, const char* data,
+                               std::size_t size, std::string* out)
+{
+    std::string compressed;
+    log::compress(compression, level, data, size, &compressed);
+
+    std::string header = block_magic_;
+    header += static_cast<char>(compression);
+    header += netint_to_string(static_cast<uint<size_bytes_>::type>(size));
+    header += netint_to_string(static_cast<uint<size_bytes_>::type>(compressed.size()));
+    header += netint_to_string(detail::crc32(0, header.data(), header.size()));
+
+    out->append(header);
+    out->append(compressed);
+    out->append(netint_to_string(detail::crc32(0, compressed.data(), compressed.size())));
+}
+
+std::size_t LogEntry::serialized_size() const
+{
+    return magic_.size() + size_bytes_ + fixed_field_size() + data().size();
+}
+
 void LogEntry::_serialize(std::ostream* s, uint<scheme_bytes_>::type scheme,
                           uint<group_bytes_>::type group_index, uint<type_bytes_>::type type_index,
                           const char* data, int data_size) const
@@ -397,7 +709,7 @@ void LogEntry::_serialize(std::ostream* s, uint<scheme_bytes_>::type scheme,
     s->write(header.data(), header.size());
     s->write(data, data_size);
 
-    boost::crc_32_type crc;
+    detail::CRC32 crc;
     crc.process_bytes(header.data(), header.size());
     crc.process_bytes(data, data_size);
 
@@ -24,19 +24,23 @@
 #ifndef GOBY_MIDDLEWARE_LOG_LOG_ENTRY_H
 #define GOBY_MIDDLEWARE_LOG_LOG_ENTRY_H
 
+#include <algorithm>       // for equal
 #include <boost/bimap.hpp> // for bimap
-#include <boost/crc.hpp>   // for crc_32_type
+#include <cstddef>         // for size_t
 #include <cstdint>         // for uint16_t, uint32_t, uint64_t, uin...
 #include <functional>      // for function
 #include <istream>         // for ostream, istream, basic_ostream::...
 #include <limits>          // for numeric_limits
 #include <map>             // for map
+#include <memory>          // for unique_ptr
 #include <stdexcept>       // for runtime_error
 #include <string>          // for string, allocator, operator+, ope...
 #include <utility>         // for move
 #include <vector>          // for vector
 
-#include "goby/middleware/group.h" // for Group, DynamicGroup
+#include "goby/middleware/group.h"            // for Group, DynamicGroup
+#include "goby/middleware/log/compression.h"  // for Compression
+#include "goby/middleware/log/detail/crc32.h" // for CRC32
 #include "goby/time/system_clock.h"
 
 namespace goby
@@ -45,6 +49,11 @@ namespace middleware
 {
 namespace log
 {
+namespace detail
+{
+struct ReadBlock;
+} // namespace detail
+
 class LogException : public std::runtime_error
 {
   public:
@@ -71,6 +80,38 @@ template <> struct uint<8>
     using type = std::uint64_t;
 };
 
+/// \brief Non-owning view of a contiguous range of bytes (equivalent to C++20's std::span<const unsigned char>)
+class ByteSpan
+{
+  public:
+    using value_type = unsigned char;
+    using const_iterator = const unsigned char*;
+    using iterator = const_iterator;
+    using size_type = std::size_t;
+
+    ByteSpan() = default;
+    ByteSpan(const unsigned char* data, std::size_t size) : data_(data), size_(size) {}
+    ByteSpan(const std::vector<unsigned char>& v) : data_(v.data()), size_(v.size()) {}
+
+    const unsigned char* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const_iterator begin() const { return data_; }
+    const_iterator end() const { return data_ + size_; }
+    const unsigned char& operator[](std::size_t i) const { return data_[i]; }
+
+  private:
+    const unsigned char* data_{nullptr};
+    std::size_t size_{0};
+};
+
+inline bool operator==(const ByteSpan& a, const ByteSpan& b)
+{
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+inline bool operator!=(const ByteSpan& a, const ByteSpan& b) { return !(a == b); }
+
 struct LogFilter
 {
     int scheme;
@@ -110,8 +151,20 @@ class LogEntry
     static constexpr uint<scheme_bytes_>::type scheme_type_index_{0xFFFE};
 
     static constexpr int version_bytes_{4};
-    static constexpr int compiled_current_version{3};
+    static constexpr int compiled_current_version{4};
+    // first version that may contain compressed blocks
+    static constexpr int compressed_block_version{4};
+    // newest version written to logs without compressed blocks, so that readers older than compressed_block_version can still read them
+    static constexpr int uncompressed_version{3};
+    static constexpr int block_codec_bytes_{1};
+    // [GBYZ][codec: 1][uncompressed size: 4][compressed size: 4][crc32: 4]
+    static constexpr int block_header_bytes_{magic_bytes_ + block_codec_bytes_ + 2 * size_bytes_ +
+                                             crc_bytes_};
+    // limit on both sizes of a compressed block, so that a corrupt header cannot cause a huge allocation
+    static constexpr std::size_t max_block_size_{64 * 1024 * 1024};
     static int current_version_;
+    // false unless set_compressed_blocks(true) was called
+    static bool compressed_blocks_;
     // "invalid_version" until version is read or written
     static uint<version_bytes_>::type version_;
     static constexpr decltype(version_) invalid_version{0};
@@ -123,6 +176,28 @@ class LogEntry
         filter_hook;
 
   public:
+    /// \brief State of parse() that belongs to the log being read: its version, the group and type names of its index entries, and the rest of any compressed block being read. To read several logs in turn (e.g. to merge them by timestamp), keep a ReadState for each and use swap_read_state() to exchange it with the current state before and after reading from that log.
+    class ReadState
+    {
+      public:
+        /// \brief State of a log not yet read
+        ReadState();
+        ~ReadState();
+
+        ReadState(const ReadState&) = delete;
+        ReadState& operator=(const ReadState&) = delete;
+
+      private:
+        friend class LogEntry;
+        std::map<int, boost::bimap<std::string, uint<group_bytes_>::type>> groups_;
+        std::map<int, boost::bimap<std::string, uint<type_bytes_>::type>> types_;
+        uint<version_bytes_>::type version_{invalid_version};
+        std::unique_ptr<detail::ReadBlock> block_;
+    };
+
+    /// \brief Exchange the state of parse() for the log being read with \c state
+    static void swap_read_state(ReadState& state);
+
     LogEntry(std::vector<unsigned char> data, int scheme, std::string type, const Group& group,
              goby::time::SystemClock::time_point timestamp = goby::time::SystemClock::now())
         : data_(std::move(data)),
@@ -134,23 +209,75 @@ class LogEntry
     }
 
     LogEntry() : group_("") {}
+
+    LogEntry(const LogEntry& other) : group_(other.group_) { *this = other; }
+    LogEntry& operator=(const LogEntry& other)
+    {
+        // copies of entries read by LogReader own their data
+        data_.assign(other.data().begin(), other.data().end());
+        mapped_data_ = nullptr;
+        mapped_size_ = 0;
+        scheme_ = other.scheme_;
+        type_ = other.type_;
+        group_ = other.group_;
+        timestamp_ = other.timestamp_;
+        offset_ = other.offset_;
+        return *this;
+    }
+    LogEntry(LogEntry&&) = default;
+    LogEntry& operator=(LogEntry&&) = default;
+
     void parse_version(std::istream* s);
     void parse(std::istream* s);
 
+    /// \brief Position in \c s of the next entry to be read by parse(): the start of the compressed block being read while entries from it remain, otherwise s->tellg()
+    static std::int64_t tell(std::istream* s);
+
+    /// \brief Seek \c s to \c offset, discarding the remainder of any compressed block being read by parse(). Use instead of s->seekg() when reading entries with parse().
+    static void seek(std::istream* s, std::uint64_t offset);
+
+    /// \return Number of metadata entries (group/type index entries and those handled by filter_hook) read by parse() or LogReader so far
+    static std::uint64_t metadata_entries_read() { return metadata_entries_read_; }
+
     // used by the unit tests to override version numbers
     static void set_current_version(decltype(version_) version) { current_version_ = version; }
 
+    /// \brief Set whether the logs written by serialize() may contain compressed blocks. If so, the current version is written, otherwise a version no newer than uncompressed_version, so that the log can be read by Goby releases without compressed block support. Must be set to true before writing the first entry of a log written by a LogWriter with compression enabled (not cleared by reset()).
+    static void set_compressed_blocks(bool compressed_blocks)
+    {
+        compressed_blocks_ = compressed_blocks;
+    }
+
     // [GBY3][size: 4][scheme: 2][group: 2][type: 2][timestamp: 8][data][crc32: 4]
     // if scheme == 0xFFFF what follows is not data, but the string value for the group index
     // if scheme == 0xFFFE what follows is not data, but the string value for the group index
     void serialize(std::ostream* s) const;
 
-    const std::vector<unsigned char>& data() const { return data_; }
+    /// \brief Append a compressed block containing \c size bytes of serialized entries (including any metadata entries) to \c out. Version 4 and newer logs may contain such blocks in place of the entries themselves:
+    ///
+    /// [GBYZ][codec: 1][uncompressed size: 4][compressed size: 4][header crc32: 4][compressed entries][crc32: 4]
+    ///
+    /// \param level Compression level (specific to the algorithm), or -1 for the default
+    /// \throw LogException if \c compression is not available
+    static void serialize_block(Compression compression, int level, const char* data,
+                                std::size_t size, std::string* out);
+
+    /// \brief Number of bytes in the data entry written by serialize(), excluding the version number and any group or type index entries that precede it. Only valid once the file version is known (after the first call to serialize())
+    std::size_t serialized_size() const;
+
+    /// \brief Data of the entry. For entries read by LogReader this refers directly to the mapped log file (or the decompressed block containing the entry), so it is valid only until the next call to LogReader::next() (copy the LogEntry to keep the data beyond that).
+    ByteSpan data() const
+    {
+        return mapped_data_ ? ByteSpan(mapped_data_, mapped_size_) : ByteSpan(data_);
+    }
     int scheme() const { return scheme_; }
     const std::string& type() const { return type_; }
     const Group& group() const { return group_; }
     const goby::time::SystemClock::time_point& timestamp() const { return timestamp_; }
 
+    /// \brief Offset in the log of an entry read by parse() or LogReader: that of its first byte, or of the compressed block containing it
+    std::uint64_t offset() const { return offset_; }
+
     static void reset()
     {
         groups_.clear();
@@ -163,15 +290,59 @@ class LogEntry
         type_index_ = 1;
         version_ = invalid_version;
         current_version_ = compiled_current_version;
+        metadata_entries_read_ = 0;
+        discard_block();
     }
 
   private:
+    friend class LogReader;
+
+    // set version_ from the first version_bytes_ of a file
+    // returns false if these were not a version number but the start of a version 1 file
+    static bool set_version(uint<version_bytes_>::type version);
+
+    // size of the fixed fields of an entry (excluding magic and size) for the current version
+    static std::size_t fixed_field_size();
+
+    // process a group or type index entry (scheme == scheme_group_index_ or scheme_type_index_)
+    static void add_index_entry(uint<scheme_bytes_>::type scheme,
+                                uint<group_bytes_>::type group_index,
+                                uint<type_bytes_>::type type_index, const unsigned char* data,
+                                std::size_t size);
+
+    struct BlockHeader
+    {
+        Compression compression;
+        uint<size_bytes_>::type size;
+        uint<size_bytes_>::type compressed_size;
+    };
+
+    // parse and check the block_header_bytes_ at header
+    static BlockHeader parse_block_header(const unsigned char* header);
+
+    // check and decompress the compressed entries (and the crc that follows them) at data
+    static void decompress_block(const BlockHeader& header, const unsigned char* data,
+                                 std::string* out);
+
+    // read the compressed block whose magic word was just read from s, for parse() to read entries from
+    static void read_block(std::istream* s);
+    static void discard_block();
+
+    // read the next entry (from the compressed block being read, if any) into data_ and timestamp_
+    // returns false if a compressed block was read instead
+    bool read_entry(std::istream* s, uint<scheme_bytes_>::type* scheme,
+                    uint<group_bytes_>::type* group_index, uint<type_bytes_>::type* type_index);
+
+    // group or type name for the given index, or nullptr if none has been read
+    static const std::string* find_group(int scheme, uint<group_bytes_>::type group_index);
+    static const std::string* find_type(int scheme, uint<type_bytes_>::type type_index);
+
     void _serialize(std::ostream* s, uint<scheme_bytes_>::type scheme,
                     uint<group_bytes_>::type group_index, uint<type_bytes_>::type type_index,
                     const char* data, int data_size) const;
 
     template <typename Unsigned>
-    Unsigned read_one(std::istream* s, boost::crc_32_type* crc = nullptr)
+    Unsigned read_one(std::istream* s, detail::CRC32* crc = nullptr)
     {
         auto size = std::numeric_limits<Unsigned>::digits / 8;
         std::string str(size, '\0');
@@ -182,7 +353,7 @@ class LogEntry
         return string_to_netint<Unsigned>(str);
     }
 
-    template <typename Unsigned> std::string netint_to_string(Unsigned u) const
+    template <typename Unsigned> static std::string netint_to_string(Unsigned u)
     {
         auto size = std::numeric_limits<Unsigned>::digits / 8;
         std::string s(size, '\0');
@@ -190,6 +361,14 @@ class LogEntry
         return s;
     }
 
+    template <typename Unsigned> static Unsigned bytes_to_netint(const unsigned char* b)
+    {
+        Unsigned u(0);
+        for (int i = 0, size = std::numeric_limits<Unsigned>::digits / 8; i < size; ++i)
+            u = (u << 8) | b[i];
+        return u;
+    }
+
     template <typename Unsigned> Unsigned string_to_netint(std::string s) const
     {
         Unsigned u(0);
@@ -206,10 +385,14 @@ class LogEntry
 
   private:
     std::vector<unsigned char> data_;
+    // set instead of data_ by LogReader
+    const unsigned char* mapped_data_{nullptr};
+    std::size_t mapped_size_{0};
     uint<scheme_bytes_>::type scheme_;
     std::string type_;
     DynamicGroup group_;
     goby::time::SystemClock::time_point timestamp_;
+    std::uint64_t offset_{0};
 
     // map (scheme -> map (group_name -> group_index)
     static std::map<int, boost::bimap<std::string, uint<group_bytes_>::type>> groups_;
@@ -219,7 +402,10 @@ class LogEntry
     static std::map<int, boost::bimap<std::string, uint<type_bytes_>::type>> types_;
     static uint<type_bytes_>::type type_index_;
 
-    const std::string magic_{"GBY3"};
+    static std::uint64_t metadata_entries_read_;
+
+    static const std::string magic_;
+    static const std::string block_magic_;
 };
 
 } // namespace log
@@ -0,0 +1,495 @@
+// Copyright 2016-2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "log_index.h"
+
+#include <algorithm>  // for upper_bound, max, min
+#include <iterator>   // for istreambuf_iterator
+#include <limits>     // for numeric_limits
+#include <sys/stat.h> // for stat
+
+#include "goby/middleware/log/log_entry.h"       // for LogEntry, LogException
+#include "goby/middleware/log/log_reader.h"      // for LogReader
+#include "goby/time/convert.h"                   // for convert
+#include "goby/util/debug_logger/flex_ostream.h" // for glog
+
+using goby::glog;
+using goby::middleware::log::LogEntry;
+using goby::middleware::log::LogIndex;
+using goby::middleware::log::LogIndexWriter;
+
+// [GBYI][version: 4]([size: 4][LogIndexRecord])*
+namespace
+{
+const std::string index_magic{"GBYI"};
+constexpr std::uint32_t index_version{1};
+constexpr std::uint64_t no_entries_of_interest{std::numeric_limits<std::uint64_t>::max()};
+
+void write_uint32(std::ostream& out, std::uint32_t u)
+{
+    char bytes[4];
+    for (int i = 0; i < 4; ++i) bytes[i] = (u >> (24 - 8 * i)) & 0xFF;
+    out.write(bytes, 4);
+}
+
+std::uint32_t read_uint32(const std::string& s, std::string::size_type pos)
+{
+    std::uint32_t u = 0;
+    for (int i = 0; i < 4; ++i) u = (u << 8) | (static_cast<unsigned char>(s[pos + i]));
+    return u;
+}
+
+// adapters for the two ways of reading a log used by LogIndex::seek_log() and next_log()
+struct StreamLog
+{
+    std::istream& log;
+
+    bool version_known() { return LogEntry::version_ != LogEntry::invalid_version; }
+    void read_version()
+    {
+        log.clear();
+        log.seekg(0);
+        LogEntry entry;
+        entry.parse_version(&log);
+    }
+    std::int64_t tell() { return LogEntry::tell(&log); }
+    void seek(std::uint64_t offset) { LogEntry::seek(&log, offset); }
+    void read_entry()
+    {
+        LogEntry entry;
+        entry.parse(&log);
+    }
+};
+
+struct ReaderLog
+{
+    goby::middleware::log::LogReader& log;
+
+    // LogReader reads the version number when constructed
+    bool version_known() { return true; }
+    void read_version() {}
+    std::int64_t tell() { return log.tell(); }
+    void seek(std::uint64_t offset) { log.seek(offset); }
+    void read_entry()
+    {
+        LogEntry entry;
+        log.next(&entry);
+    }
+};
+
+bool file_size(const std::string& path, std::uint64_t* size)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+    *size = st.st_size;
+    return true;
+}
+} // namespace
+
+LogIndexWriter::LogIndexWriter(std::string path, std::uint64_t block_size)
+    : path_(std::move(path)),
+      block_size_(block_size),
+      out_(path_.c_str(), std::ofstream::binary | std::ofstream::trunc)
+{
+    if (!out_.is_open())
+        throw(LogException("Failed to open log index file: " + path_));
+
+    out_.write(index_magic.data(), index_magic.size());
+    write_uint32(out_, index_version);
+}
+
+LogIndexWriter::~LogIndexWriter()
+{
+    // without a footer, readers know the index may not cover the entire log
+    if (out_.is_open())
+    {
+        if (block_open_)
+            write_block(block_.end_offset());
+        out_.close();
+    }
+}
+
+void LogIndexWriter::add_metadata(std::uint64_t offset)
+{
+    start_block(offset);
+    block_.add_metadata_offset(offset);
+    block_.set_end_offset(offset);
+}
+
+std::uint32_t LogIndexWriter::add_key(const LogEntry& entry)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto key_tuple = std::make_tuple(entry.scheme(), std::string(entry.group()), entry.type());
+    auto it = keys_.find(key_tuple);
+    if (it == keys_.end())
+    {
+        it = keys_.insert(std::make_pair(key_tuple, key_list_.size())).first;
+        key_list_.push_back(&it->first);
+    }
+    return it->second;
+}
+
+void LogIndexWriter::add_entry(std::uint64_t offset, std::uint64_t end_offset, std::uint32_t key,
+                               std::uint64_t time)
+{
+    start_block(offset);
+    write_keys(key);
+
+    if (block_keys_.insert(key).second)
+    {
+        block_.add_key(key);
+        block_.add_key_offset(offset);
+    }
+
+    if (block_.entries() == 0)
+        block_.set_start_time(time);
+    block_.set_end_time(std::max<std::uint64_t>(block_.end_time(), time));
+    block_.set_entries(block_.entries() + 1);
+    block_.set_end_offset(end_offset);
+    last_time_ = block_.end_time();
+}
+
+void LogIndexWriter::add_entry(std::uint64_t offset, const LogEntry& entry)
+{
+    add_entry(offset, offset + entry.serialized_size(), add_key(entry),
+              goby::time::convert<goby::time::MicroTime>(entry.timestamp()).value());
+}
+
+void LogIndexWriter::close(std::uint64_t log_size)
+{
+    if (!out_.is_open())
+        return;
+
+    if (block_open_)
+        write_block(log_size);
+
+    protobuf::LogIndexRecord record;
+    record.mutable_footer()->set_log_size(log_size);
+    write_record(record);
+    out_.close();
+}
+
+void LogIndexWriter::start_block(std::uint64_t offset)
+{
+    // blocks are contiguous, so the next block starts where this one ends
+    if (block_open_ && offset - block_.offset() >= block_size_)
+        write_block(offset);
+
+    if (!block_open_)
+    {
+        block_.Clear();
+        block_keys_.clear();
+        block_.set_offset(offset);
+        block_.set_end_offset(offset);
+        block_.set_start_time(last_time_);
+        block_.set_end_time(last_time_);
+        block_.set_entries(0);
+        block_open_ = true;
+    }
+}
+
+void LogIndexWriter::write_block(std::uint64_t end_offset)
+{
+    block_.set_end_offset(end_offset);
+    protobuf::LogIndexRecord record;
+    *record.mutable_block() = block_;
+    write_record(record);
+    block_open_ = false;
+}
+
+void LogIndexWriter::write_keys(std::uint32_t last_key)
+{
+    if (last_key < keys_written_)
+        return;
+
+    // keys are written in order of id (including any added for entries that were then dropped)
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (; keys_written_ <= last_key && keys_written_ < key_list_.size(); ++keys_written_)
+    {
+        const auto& key_tuple = *key_list_[keys_written_];
+        protobuf::LogIndexRecord record;
+        auto& key = *record.mutable_key();
+        key.set_id(keys_written_);
+        key.set_scheme(std::get<0>(key_tuple));
+        key.set_group(std::get<1>(key_tuple));
+        key.set_type(std::get<2>(key_tuple));
+        write_record(record);
+    }
+}
+
+void LogIndexWriter::write_record(const protobuf::LogIndexRecord& record)
+{
+    std::string bytes;
+    record.SerializeToString(&bytes);
+    write_uint32(out_, bytes.size());
+    out_.write(bytes.data(), bytes.size());
+}
+
+std::unique_ptr<LogIndex> LogIndex::load(const std::string& log_file)
+{
+    std::string index_file = path(log_file);
+    std::uint64_t index_size, log_size;
+    if (!file_size(index_file, &index_size) || !file_size(log_file, &log_size))
+        return nullptr;
+
+    try
+    {
+        std::unique_ptr<LogIndex> index(new LogIndex(index_file, log_size));
+        if ((index->complete_ && index->indexed_end_ != log_size) ||
+            index->indexed_end_ > log_size)
+        {
+            glog.is_warn() && glog << "Ignoring index " << index_file
+                                   << " as it does not match the log (" << index->indexed_end_
+                                   << " bytes indexed, log is " << log_size
+                                   << " bytes). Rebuild it using \"goby log index " << log_file
+                                   << "\"" << std::endl;
+            return nullptr;
+        }
+        if (!index->complete_)
+            glog.is_warn() && glog << "Index " << index_file
+                                   << " is incomplete (was the logger stopped cleanly?): the "
+                                      "remainder of the log will be read in full"
+                                   << std::endl;
+
+        glog.is_verbose() && glog << "Using index " << index_file << " ("
+                                  << index->blocks_.size() << " blocks)" << std::endl;
+        return index;
+    }
+    catch (const LogException& e)
+    {
+        glog.is_warn() && glog << "Ignoring index: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+std::uint64_t LogIndex::build(std::istream& log, const std::string& index_file,
+                              std::uint64_t block_size)
+{
+    LogIndexWriter writer(index_file, block_size);
+
+    LogEntry::seek(&log, 0);
+    std::uint64_t position = 0, entries = 0;
+    for (;;)
+    {
+        LogEntry entry;
+        auto metadata_read = LogEntry::metadata_entries_read();
+        try
+        {
+            entry.parse(&log);
+        }
+        catch (const LogException& e)
+        {
+            glog.is_warn() && glog << "Exception reading log (will attempt to continue): "
+                                   << e.what() << std::endl;
+            log.clear();
+            position = LogEntry::tell(&log);
+            continue;
+        }
+        catch (const std::exception& e)
+        {
+            if (!log.eof())
+                glog.is_warn() && glog << "Error reading log: " << e.what() << std::endl;
+            break;
+        }
+
+        // end of the entry, or of the compressed block containing it
+        std::uint64_t end = log.tellg();
+        if (LogEntry::metadata_entries_read() != metadata_read)
+            writer.add_metadata(position);
+        writer.add_entry(entry.offset(), end, writer.add_key(entry),
+                         goby::time::convert<goby::time::MicroTime>(entry.timestamp()).value());
+        position = LogEntry::tell(&log);
+        ++entries;
+    }
+
+    log.clear();
+    log.seekg(0, std::ios::end);
+    writer.close(log.tellg());
+    return entries;
+}
+
+LogIndex::LogIndex(const std::string& index_file, std::uint64_t log_size) : log_size_(log_size)
+{
+    std::ifstream in(index_file.c_str(), std::ifstream::binary);
+    if (!in.is_open())
+        throw(LogException("Failed to open log index file: " + index_file));
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    const std::string::size_type header_size = index_magic.size() + 4;
+    if (bytes.size() < header_size || bytes.compare(0, index_magic.size(), index_magic) != 0)
+        throw(LogException("Invalid log index file: " + index_file));
+    if (read_uint32(bytes, index_magic.size()) > index_version)
+        throw(LogException("Unsupported log index version in: " + index_file));
+
+    for (std::string::size_type pos = header_size; pos + 4 <= bytes.size();)
+    {
+        std::uint32_t size = read_uint32(bytes, pos);
+        pos += 4;
+        protobuf::LogIndexRecord record;
+        // a partially written record at the end of an incomplete index is ignored
+        if (pos + size > bytes.size() || !record.ParseFromArray(&bytes[pos], size))
+            break;
+        pos += size;
+
+        switch (record.record_case())
+        {
+            case protobuf::LogIndexRecord::kKey:
+                if (record.key().id() != keys_.size())
+                    throw(LogException("Invalid key id in log index file: " + index_file));
+                keys_.push_back({record.key().scheme(), record.key().group(), record.key().type()});
+                break;
+            case protobuf::LogIndexRecord::kBlock:
+                for (auto offset : record.block().metadata_offset()) metadata_.push_back(offset);
+                indexed_end_ = record.block().end_offset();
+                blocks_.push_back(record.block());
+                break;
+            case protobuf::LogIndexRecord::kFooter:
+                complete_ = true;
+                indexed_end_ = record.footer().log_size();
+                break;
+            case protobuf::LogIndexRecord::RECORD_NOT_SET: break;
+        }
+    }
+
+    set_filter(nullptr);
+}
+
+void LogIndex::set_filter(std::function<bool(const Key& key)> filter)
+{
+    std::vector<bool> key_of_interest(keys_.size(), true);
+    if (filter)
+    {
+        for (std::size_t i = 0, n = keys_.size(); i < n; ++i)
+            key_of_interest[i] = filter(keys_[i]);
+    }
+
+    first_of_interest_.assign(blocks_.size(), no_entries_of_interest);
+    for (std::size_t b = 0, n = blocks_.size(); b < n; ++b)
+    {
+        const auto& block = blocks_[b];
+        for (int i = 0, m = block.key_size(); i < m; ++i)
+        {
+            if (block.key(i) < key_of_interest.size() && key_of_interest[block.key(i)])
+                first_of_interest_[b] = std::min(first_of_interest_[b], block.key_offset(i));
+        }
+    }
+}
+
+std::size_t LogIndex::find_block(goby::time::SystemClock::time_point time) const
+{
+    std::uint64_t t = goby::time::convert<goby::time::MicroTime>(time).value();
+    auto it = std::upper_bound(blocks_.begin(), blocks_.end(), t,
+                               [](std::uint64_t t, const Block& b) { return t < b.start_time(); });
+    return it == blocks_.begin() ? 0 : (it - blocks_.begin()) - 1;
+}
+
+void LogIndex::seek(std::istream& log, std::uint64_t offset) { seek_log(StreamLog{log}, offset); }
+
+void LogIndex::seek(LogReader& log, std::uint64_t offset) { seek_log(ReaderLog{log}, offset); }
+
+bool LogIndex::next(std::istream& log) { return next_log(StreamLog{log}); }
+
+bool LogIndex::next(LogReader& log) { return next_log(ReaderLog{log}); }
+
+template <typename Log> void LogIndex::seek_log(Log log, std::uint64_t offset)
+{
+    read_version(log);
+
+    while (next_metadata_ < metadata_.size() && metadata_[next_metadata_] < offset)
+    {
+        // reads the metadata and the data entry that follows it
+        log.seek(std::max(metadata_[next_metadata_], data_start_));
+        try
+        {
+            log.read_entry();
+        }
+        catch (const std::exception& e)
+        {
+            glog.is_debug1() && glog << "Exception reading metadata at offset "
+                                     << metadata_[next_metadata_] << ": " << e.what() << std::endl;
+        }
+        ++next_metadata_;
+    }
+
+    log.seek(std::max(offset, data_start_));
+}
+
+template <typename Log> bool LogIndex::next_log(Log log)
+{
+    read_version(log);
+
+    auto tell = log.tell();
+    // let the caller's parse() handle the error or EOF
+    if (tell < 0 || blocks_.empty())
+        return true;
+
+    std::uint64_t position = tell;
+    // read any part of the log not covered by the index in full
+    if (position >= indexed_end_)
+        return true;
+
+    for (std::size_t b = block_containing(position), n = blocks_.size(); b < n; ++b)
+    {
+        // entries of interest may remain in the current block
+        if (first_of_interest_[b] != no_entries_of_interest && blocks_[b].end_offset() > position)
+        {
+            current_block_ = b;
+            if (first_of_interest_[b] > position)
+                seek_log(log, first_of_interest_[b]);
+            return true;
+        }
+    }
+
+    if (indexed_end_ < log_size_)
+    {
+        seek_log(log, indexed_end_);
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+template <typename Log> void LogIndex::read_version(Log& log)
+{
+    if (!log.version_known())
+        log.read_version();
+
+    // version 1 files have no version number
+    data_start_ = (LogEntry::version_ == 1) ? 0 : LogEntry::version_bytes_;
+}
+
+std::size_t LogIndex::block_containing(std::uint64_t offset)
+{
+    if (current_block_ < blocks_.size() && blocks_[current_block_].offset() <= offset &&
+        offset < blocks_[current_block_].end_offset())
+        return current_block_;
+
+    auto it = std::upper_bound(blocks_.begin(), blocks_.end(), offset,
+                               [](std::uint64_t o, const Block& b) { return o < b.offset(); });
+    current_block_ = it == blocks_.begin() ? 0 : (it - blocks_.begin()) - 1;
+    return current_block_;
+}
@@ -0,0 +1,194 @@
+// Copyright 2016-2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GOBY_MIDDLEWARE_LOG_LOG_INDEX_H
+#define GOBY_MIDDLEWARE_LOG_LOG_INDEX_H
+
+#include <cstddef>    // for size_t
+#include <cstdint>    // for uint64_t, uint32_t
+#include <fstream>    // for ofstream
+#include <functional> // for function
+#include <istream>    // for istream
+#include <map>        // for map
+#include <memory>     // for unique_ptr
+#include <mutex>      // for mutex
+#include <set>        // for set
+#include <string>     // for string
+#include <tuple>      // for tuple
+#include <vector>     // for vector
+
+#include "goby/middleware/protobuf/log_index.pb.h"
+#include "goby/time/system_clock.h"
+
+namespace goby
+{
+namespace middleware
+{
+namespace log
+{
+class LogEntry;
+class LogReader;
+
+/// \brief Writes the index sidecar file (see LogIndex) for a .goby log as the log is written
+class LogIndexWriter
+{
+  public:
+    /// \brief Default size (bytes of the log) of each indexed block
+    static constexpr std::uint64_t default_block_size{256 * 1024};
+
+    /// \throw LogException if the index file cannot be opened
+    LogIndexWriter(std::string path, std::uint64_t block_size = default_block_size);
+    ~LogIndexWriter();
+
+    LogIndexWriter(const LogIndexWriter&) = delete;
+    LogIndexWriter& operator=(const LogIndexWriter&) = delete;
+
+    /// \brief One or more metadata entries (group/type index entries, Protobuf file descriptors) were written to the log at \c offset
+    void add_metadata(std::uint64_t offset);
+
+    /// \brief Key id for the scheme, group and type of \c entry. May be called from a different thread than the other functions (e.g. by the thread that serializes entries while another writes them): new keys are written to the index by add_entry().
+    std::uint32_t add_key(const LogEntry& entry);
+
+    /// \brief A data entry with key id \c key (see add_key()) and timestamp \c time (microseconds since the UNIX epoch) was written to the log at \c offset
+    ///
+    /// \param end_offset Offset of the end of the entry, or of the compressed block containing it (in which case \c offset is that of the block)
+    void add_entry(std::uint64_t offset, std::uint64_t end_offset, std::uint32_t key,
+                   std::uint64_t time);
+
+    /// \brief The data entry \c entry was written (uncompressed) to the log at \c offset
+    void add_entry(std::uint64_t offset, const LogEntry& entry);
+
+    /// \brief Write the last block and a footer recording that the log is complete at \c log_size bytes, and close the index file
+    void close(std::uint64_t log_size);
+
+  private:
+    void start_block(std::uint64_t offset);
+    void write_block(std::uint64_t end_offset);
+    void write_keys(std::uint32_t last_key);
+    void write_record(const protobuf::LogIndexRecord& record);
+
+  private:
+    std::string path_;
+    std::uint64_t block_size_;
+    std::ofstream out_;
+
+    // protects keys_ and key_list_, which add_key() may use from another thread
+    std::mutex mutex_;
+    // (scheme, group, type) -> key id
+    std::map<std::tuple<int, std::string, std::string>, std::uint32_t> keys_;
+    // keys_ in order of id
+    std::vector<const std::tuple<int, std::string, std::string>*> key_list_;
+    std::uint32_t keys_written_{0};
+
+    bool block_open_{false};
+    protobuf::LogIndexRecord::Block block_;
+    std::set<std::uint32_t> block_keys_;
+    std::uint64_t last_time_{0};
+};
+
+/// \brief Reads the index sidecar file of a .goby log (written by goby_logger, or rebuilt from the log using build()), allowing readers to seek by time and to skip regions of the log without entries of interest.
+///
+/// The index divides the log into contiguous blocks, recording for each the offset, time range, the (scheme, group, type) keys of its entries, and the offsets of any metadata entries. As LogEntry::parse() relies on metadata (group/type index entries and Protobuf file descriptors) read previously, seek() reads any skipped metadata before seeking.
+class LogIndex
+{
+  public:
+    struct Key
+    {
+        int scheme;
+        std::string group;
+        std::string type;
+    };
+    using Block = protobuf::LogIndexRecord::Block;
+
+    /// \brief Path of the index file for a given log file
+    static std::string path(const std::string& log_file) { return log_file + ".idx"; }
+
+    /// \brief Load the index for \c log_file, if it exists and is consistent with the log
+    ///
+    /// \return The index, or nullptr if there is no usable index (with a warning if the index exists but cannot be used)
+    static std::unique_ptr<LogIndex> load(const std::string& log_file);
+
+    /// \brief Read the log from the start, writing its index to \c index_file. The read hooks of the log plugins must be registered beforehand so that their metadata entries are recognized.
+    ///
+    /// \return Number of data entries indexed
+    static std::uint64_t build(std::istream& log, const std::string& index_file,
+                               std::uint64_t block_size = LogIndexWriter::default_block_size);
+
+    /// \brief Read the index file \c index_file for a log of \c log_size bytes
+    ///
+    /// \throw LogException if the index file cannot be read
+    LogIndex(const std::string& index_file, std::uint64_t log_size);
+
+    /// \return Keys of the indexed entries (indexed by key id)
+    const std::vector<Key>& keys() const { return keys_; }
+    const std::vector<Block>& blocks() const { return blocks_; }
+
+    /// \return true if the index was closed by the logger (otherwise it covers only part of the log)
+    bool complete() const { return complete_; }
+
+    /// \brief Restrict next() to blocks with entries whose keys pass \c filter (by default all blocks are read)
+    void set_filter(std::function<bool(const Key& key)> filter);
+
+    /// \return Index of the last block starting at or before \c time (or zero if there is none)
+    std::size_t find_block(goby::time::SystemClock::time_point time) const;
+
+    /// \brief Seek \c log to \c offset, first reading any metadata before \c offset that has not yet been read
+    void seek(std::istream& log, std::uint64_t offset);
+    void seek(LogReader& log, std::uint64_t offset);
+
+    /// \brief Call before each LogEntry::parse() when reading sequentially: if no further entries of interest (see set_filter()) remain in the current block, seeks to the first entry of interest in a later block
+    ///
+    /// \return false if there are no further entries of interest in the log
+    bool next(std::istream& log);
+    bool next(LogReader& log);
+
+  private:
+    // Log is one of the adapters for std::istream or LogReader in log_index.cpp
+    template <typename Log> void seek_log(Log log, std::uint64_t offset);
+    template <typename Log> bool next_log(Log log);
+    template <typename Log> void read_version(Log& log);
+    std::size_t block_containing(std::uint64_t offset);
+
+  private:
+    std::vector<Key> keys_;
+    std::vector<Block> blocks_;
+    bool complete_{false};
+    std::uint64_t log_size_{0};
+    std::uint64_t indexed_end_{0};
+
+    // all metadata offsets in order, and the next one to be read by seek()
+    std::vector<std::uint64_t> metadata_;
+    std::size_t next_metadata_{0};
+
+    // offset of the first entry of interest in each block (or the maximum value if none)
+    std::vector<std::uint64_t> first_of_interest_;
+    std::size_t current_block_{0};
+
+    std::uint64_t data_start_{0};
+};
+
+} // namespace log
+} // namespace middleware
+} // namespace goby
+
+#endif
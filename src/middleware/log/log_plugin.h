@@ -24,6 +24,9 @@
 #ifndef GOBY_MIDDLEWARE_LOG_LOG_PLUGIN_H
 #define GOBY_MIDDLEWARE_LOG_LOG_PLUGIN_H
 
+#include <fstream> // for ofstream, ifstream
+#include <ostream> // for ostream
+
 #include "goby/middleware/log/log_entry.h"
 #include "goby/middleware/marshalling/interface.h"
 #include "goby/middleware/marshalling/json.h"
@@ -43,7 +46,35 @@ class LogPlugin
     LogPlugin() {}
     virtual ~LogPlugin() {}
 
-    virtual void register_write_hooks(std::ofstream& out_log_file) = 0;
+    /// \brief Register the hooks that write this scheme's metadata (e.g. type descriptors) to the log
+    ///
+    /// Plugins must override this. The default only exists for plugins written for the previous signature (std::ofstream&): it calls that overload if out_log_file is a std::ofstream, and throws LogException otherwise (goby_logger writes through a std::ostringstream).
+    virtual void register_write_hooks(std::ostream& out_log_file)
+    {
+        auto* file = dynamic_cast<std::ofstream*>(&out_log_file);
+        if (!file || forwarding_)
+            throw(log::LogException(
+                "LogPlugin must override register_write_hooks(std::ostream&)"));
+
+        forwarding_ = true;
+        try
+        {
+            register_write_hooks(*file);
+        }
+        catch (...)
+        {
+            forwarding_ = false;
+            throw;
+        }
+        forwarding_ = false;
+    }
+
+    /// \deprecated Override and call register_write_hooks(std::ostream&) instead. This overload is kept so that existing plugins and callers compile; by default it calls register_write_hooks(std::ostream&).
+    virtual void register_write_hooks(std::ofstream& out_log_file)
+    {
+        register_write_hooks(static_cast<std::ostream&>(out_log_file));
+    }
+
     virtual void register_read_hooks(const std::ifstream& in_log_file) = 0;
 
     virtual std::string debug_text_message(LogEntry& log_entry)
@@ -60,6 +91,10 @@ class LogPlugin
     {
         throw(log::LogException("JSON is not supported by the scheme's plugin"));
     }
+
+  private:
+    // set while the default register_write_hooks(std::ostream&) calls the std::ofstream& overload, so that a plugin overriding neither throws instead of recursing
+    bool forwarding_{false};
 };
 
 } // namespace log
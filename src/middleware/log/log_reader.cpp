@@ -0,0 +1,382 @@
+// Copyright 2016-2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "log_reader.h"
+
+#include <algorithm>  // for search
+#include <cerrno>     // for errno
+#include <cstring>    // for memcmp, strerror
+#include <fcntl.h>    // for open, O_RDONLY
+#include <sys/mman.h> // for mmap, munmap, madvise
+#include <sys/stat.h> // for fstat
+#include <unistd.h>   // for close
+
+#include "goby/time/convert.h"                   // for convert
+#include "goby/util/debug_logger/flex_ostream.h" // for glog
+
+using goby::glog;
+using goby::middleware::log::LogEntry;
+using goby::middleware::log::LogReader;
+
+namespace
+{
+template <int Bytes> using uint_t = typename goby::middleware::log::uint<Bytes>::type;
+} // namespace
+
+LogReader::LogReader(std::string path) : path_(std::move(path))
+{
+    int fd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw(LogException("Failed to open log file: " + path_ + ": " + std::strerror(errno)));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        throw(LogException("Failed to stat log file: " + path_ + ": " + std::strerror(errno)));
+    }
+    size_ = st.st_size;
+
+    if (size_ > 0)
+    {
+        void* map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+        {
+            ::close(fd);
+            throw(LogException("Failed to map log file: " + path_ + ": " + std::strerror(errno)));
+        }
+        data_ = static_cast<const unsigned char*>(map);
+        madvise(map, size_, MADV_SEQUENTIAL);
+    }
+    // the mapping remains valid without the file descriptor
+    ::close(fd);
+
+    if (LogEntry::version_ == LogEntry::invalid_version && size_ >= LogEntry::version_bytes_)
+    {
+        if (LogEntry::set_version(
+                LogEntry::bytes_to_netint<uint_t<LogEntry::version_bytes_>>(data_)))
+            position_ = LogEntry::version_bytes_;
+    }
+    else if (LogEntry::version_ != 1)
+    {
+        // version 1 files have no version number
+        position_ = std::min<std::uint64_t>(LogEntry::version_bytes_, size_);
+    }
+}
+
+LogReader::~LogReader()
+{
+    if (data_)
+        munmap(const_cast<unsigned char*>(data_), size_);
+}
+
+bool LogReader::next(LogEntry* entry)
+{
+    for (;;)
+    {
+        Raw raw;
+        std::uint64_t offset;
+        if (block_position_ < block_.size())
+        {
+            offset = block_start_;
+            auto begin = reinterpret_cast<const unsigned char*>(block_.data());
+            bool complete = false;
+            try
+            {
+                complete = block_.size() - block_position_ >= LogEntry::magic_.size() &&
+                           std::memcmp(begin + block_position_, LogEntry::magic_.data(),
+                                       LogEntry::magic_.size()) == 0 &&
+                           read_raw(begin, block_.size(), block_position_, &raw);
+            }
+            catch (const LogException&)
+            {
+                discard_block();
+                throw;
+            }
+
+            if (!complete)
+            {
+                // blocks are checked before being read, so this should not happen
+                discard_block();
+                throw(LogException("Invalid entry in compressed block"));
+            }
+        }
+        else
+        {
+            discard_block();
+            if (!find_magic())
+                return false;
+
+            if (is_block_magic(position_))
+            {
+                if (!read_block())
+                    return false;
+                continue;
+            }
+
+            offset = position_;
+            if (!read_raw(data_, size_, position_, &raw))
+                return false;
+        }
+
+        if (raw.scheme == LogEntry::scheme_group_index_ ||
+            raw.scheme == LogEntry::scheme_type_index_)
+        {
+            LogEntry::add_index_entry(raw.scheme, raw.group_index, raw.type_index, raw.data,
+                                      raw.data_size);
+            resolved_.clear();
+            continue;
+        }
+
+        const Resolved& resolved = resolve((std::uint64_t(raw.scheme) << 32) |
+                                               (std::uint64_t(raw.group_index) << 16) |
+                                               raw.type_index,
+                                           raw.scheme, raw.group_index, raw.type_index);
+
+        if (resolved.filter_hook)
+        {
+            ++LogEntry::metadata_entries_read_;
+            filter_data_.assign(raw.data, raw.data + raw.data_size);
+            (*resolved.filter_hook)(filter_data_);
+            continue;
+        }
+
+        entry->data_.clear();
+        entry->mapped_data_ = raw.data;
+        entry->mapped_size_ = raw.data_size;
+        entry->scheme_ = raw.scheme;
+        entry->type_ = resolved.type;
+        entry->group_ = resolved.group;
+        entry->offset_ = offset;
+        if (raw.has_timestamp)
+            entry->timestamp_ = goby::time::convert<goby::time::SystemClock::time_point>(
+                raw.timestamp * boost::units::si::micro * boost::units::si::seconds);
+        return true;
+    }
+}
+
+bool LogReader::read_raw(const unsigned char* base, std::uint64_t size, std::uint64_t& position,
+                         Raw* raw)
+{
+    constexpr std::size_t magic_bytes = LogEntry::magic_bytes_;
+    constexpr std::size_t size_bytes = LogEntry::size_bytes_;
+    constexpr std::size_t crc_bytes = LogEntry::crc_bytes_;
+
+    const std::size_t fixed_field_size = LogEntry::fixed_field_size();
+    // timestamps were added in version 3
+    const bool has_timestamp = fixed_field_size > LogEntry::scheme_bytes_ + LogEntry::group_bytes_ +
+                                                      LogEntry::type_bytes_ + crc_bytes;
+
+    const unsigned char* begin = base + position;
+    const std::uint64_t remaining = size - position;
+    if (remaining < magic_bytes + size_bytes + fixed_field_size)
+    {
+        glog.is_verbose() && glog << "Incomplete entry (" << remaining << " bytes) at end of log"
+                                  << std::endl;
+        position = size;
+        return false;
+    }
+
+    const unsigned char* p = begin + magic_bytes;
+    auto entry_size = LogEntry::bytes_to_netint<uint_t<size_bytes>>(p);
+    p += size_bytes;
+    if (entry_size < fixed_field_size)
+    {
+        position = p - base;
+        throw(LogException("Invalid size read: " + std::to_string(entry_size) +
+                           " as message must be at least " + std::to_string(fixed_field_size) +
+                           " bytes long"));
+    }
+
+    raw->scheme = LogEntry::bytes_to_netint<uint_t<LogEntry::scheme_bytes_>>(p);
+    p += LogEntry::scheme_bytes_;
+    raw->group_index = LogEntry::bytes_to_netint<uint_t<LogEntry::group_bytes_>>(p);
+    p += LogEntry::group_bytes_;
+    raw->type_index = LogEntry::bytes_to_netint<uint_t<LogEntry::type_bytes_>>(p);
+    p += LogEntry::type_bytes_;
+    raw->timestamp = 0;
+    raw->has_timestamp = has_timestamp;
+    if (has_timestamp)
+    {
+        raw->timestamp = LogEntry::bytes_to_netint<uint_t<LogEntry::timestamp_bytes_>>(p);
+        p += LogEntry::timestamp_bytes_;
+    }
+
+    raw->data = p;
+    raw->data_size = entry_size - fixed_field_size;
+    if (static_cast<std::uint64_t>(p - begin) + raw->data_size + crc_bytes > remaining)
+    {
+        // as for LogEntry::parse(), resume from the start of the data in case the size was corrupt
+        position = p - base;
+        throw(LogException("Failed to read " + std::to_string(entry_size) +
+                           " bytes of data (end of file); seeking back to start of data read "
+                           "in hopes of finding valid next message."));
+    }
+
+    const unsigned char* end = p + raw->data_size;
+    auto calculated_crc = detail::crc32(0, begin, end - begin);
+    auto given_crc = LogEntry::bytes_to_netint<uint_t<crc_bytes>>(end);
+    if (calculated_crc != given_crc)
+    {
+        position = p - base;
+        throw(LogException("Invalid CRC on packet: given: " + std::to_string(given_crc) +
+                           ", calculated: " + std::to_string(calculated_crc)));
+    }
+    position = (end + crc_bytes) - base;
+    return true;
+}
+
+bool LogReader::is_block_magic(std::uint64_t position) const
+{
+    const auto& magic = LogEntry::block_magic_;
+    return LogEntry::version_ >= LogEntry::compressed_block_version &&
+           size_ - position >= magic.size() &&
+           std::memcmp(data_ + position, magic.data(), magic.size()) == 0;
+}
+
+bool LogReader::read_block()
+{
+    const std::uint64_t remaining = size_ - position_;
+    if (remaining < static_cast<std::uint64_t>(LogEntry::block_header_bytes_))
+    {
+        glog.is_verbose() && glog << "Incomplete compressed block (" << remaining
+                                  << " bytes) at end of log" << std::endl;
+        position_ = size_;
+        return false;
+    }
+
+    try
+    {
+        auto header = LogEntry::parse_block_header(data_ + position_);
+        const std::uint64_t block_size =
+            LogEntry::block_header_bytes_ + header.compressed_size + LogEntry::crc_bytes_;
+        if (block_size > remaining)
+            throw(LogException("Failed to read compressed block of " +
+                               std::to_string(header.compressed_size) + " bytes (end of file)"));
+
+        LogEntry::decompress_block(header, data_ + position_ + LogEntry::block_header_bytes_,
+                                   &block_);
+        block_start_ = position_;
+        block_position_ = 0;
+        position_ += block_size;
+        return true;
+    }
+    catch (const LogException& e)
+    {
+        // as for entries, resume after the magic word in case the sizes were corrupt
+        discard_block();
+        position_ += LogEntry::magic_bytes_;
+        throw(LogException(std::string(e.what()) +
+                           "; seeking back to start of block in hopes of finding valid next "
+                           "message."));
+    }
+}
+
+bool LogReader::find_magic()
+{
+    if (position_ >= size_)
+        return false;
+
+    const auto& magic = LogEntry::magic_;
+    if ((size_ - position_ >= magic.size() &&
+         std::memcmp(data_ + position_, magic.data(), magic.size()) == 0) ||
+        is_block_magic(position_))
+        return true;
+
+    glog.is_warn() && glog << "Next byte [0x" << std::hex
+                           << static_cast<int>(data_[position_]) << std::dec
+                           << "] is not the start of the expected magic word [" << magic
+                           << "]. Seeking until next magic word." << std::endl;
+
+    // entries and compressed blocks have magic words that differ only in the last byte
+    const unsigned char* begin = data_ + position_;
+    const unsigned char* end = data_ + size_;
+    const unsigned char* found = begin;
+    for (;;)
+    {
+        found = std::search(found, end, magic.begin(), magic.end() - 1);
+        if (found == end || (end - found >= static_cast<std::ptrdiff_t>(magic.size()) &&
+                             (found[magic.size() - 1] == magic.back() ||
+                              is_block_magic(found - data_))))
+            break;
+        ++found;
+    }
+    std::uint64_t discarded = found - begin;
+    position_ += discarded;
+
+    if (found == end)
+    {
+        glog.is_warn() && glog << "No further magic word found after skipping " << discarded
+                               << " bytes" << std::endl;
+        return false;
+    }
+
+    glog.is_warn() && glog << "Found next magic word after skipping " << discarded << " bytes"
+                           << std::endl;
+    return true;
+}
+
+const LogReader::Resolved& LogReader::resolve(std::uint64_t key, int scheme,
+                                              std::uint16_t group_index, std::uint16_t type_index)
+{
+    if (filter_hook_count_ != LogEntry::filter_hook.size())
+    {
+        resolved_.clear();
+        filter_hook_count_ = LogEntry::filter_hook.size();
+    }
+
+    auto it = resolved_.find(key);
+    if (it != resolved_.end())
+        return it->second;
+
+    std::string type;
+    if (const auto* t = LogEntry::find_type(scheme, type_index))
+    {
+        type = *t;
+    }
+    else
+    {
+        type = "_unknown" + std::to_string(type_index) + "_";
+        glog.is_warn() && glog << "No type entry in file for type index: " << type_index
+                               << std::endl;
+    }
+
+    std::string group;
+    if (const auto* g = LogEntry::find_group(scheme, group_index))
+    {
+        group = *g;
+    }
+    else
+    {
+        group = "_unknown" + std::to_string(group_index) + "_";
+        glog.is_warn() && glog << "No group entry in file for group index: " << group_index
+                               << std::endl;
+    }
+
+    auto hook_it = LogEntry::filter_hook.find(LogFilter{scheme, group, type});
+    const auto* hook = hook_it != LogEntry::filter_hook.end() ? &hook_it->second : nullptr;
+
+    return resolved_
+        .emplace(key, Resolved{std::move(type), DynamicGroup(group), hook})
+        .first->second;
+}
@@ -0,0 +1,134 @@
+// Copyright 2016-2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GOBY_MIDDLEWARE_LOG_LOG_READER_H
+#define GOBY_MIDDLEWARE_LOG_LOG_READER_H
+
+#include <cstddef>       // for size_t
+#include <cstdint>       // for uint64_t
+#include <string>        // for string
+#include <unordered_map> // for unordered_map
+#include <vector>        // for vector
+
+#include "goby/middleware/log/log_entry.h"
+
+namespace goby
+{
+namespace middleware
+{
+namespace log
+{
+/// \brief Reads a .goby log file through a read-only memory mapping, as a faster alternative to calling LogEntry::parse() on a std::istream.
+///
+/// Entries are read in place: the LogEntry passed to next() refers to its data in the mapped file (or, for compressed blocks, the block decompressed when its first entry is read) rather than copying it (see LogEntry::data()), and the group and type of each entry are resolved from a cache, so reading into the same LogEntry repeatedly does no per-entry heap allocation. Metadata entries (group/type index entries and those handled by LogEntry::filter_hook) are processed as by LogEntry::parse().
+class LogReader
+{
+  public:
+    /// \brief Map the log file at \c path, and read its version number (unless already known, see LogEntry::version_)
+    ///
+    /// \throw LogException if the file cannot be opened or mapped
+    explicit LogReader(std::string path);
+    ~LogReader();
+
+    LogReader(const LogReader&) = delete;
+    LogReader& operator=(const LogReader&) = delete;
+
+    /// \brief Read the next data entry into \c entry, processing any metadata entries before it
+    ///
+    /// \return false at the end of the log (including if the last entry is incomplete)
+    /// \throw LogException if an entry is corrupt. As with LogEntry::parse(), the reader is left at the start of the entry's data, so that calling next() again resynchronizes on the next valid entry.
+    bool next(LogEntry* entry);
+
+    /// \return Offset of the next entry to be read: the start of the compressed block being read while entries from it remain, otherwise the next byte to be read
+    std::uint64_t tell() const
+    {
+        return block_position_ < block_.size() ? block_start_ : position_;
+    }
+    void seek(std::uint64_t offset)
+    {
+        discard_block();
+        position_ = offset < size_ ? offset : size_;
+    }
+
+    std::uint64_t size() const { return size_; }
+    const std::string& path() const { return path_; }
+
+  private:
+    struct Resolved
+    {
+        std::string type;
+        DynamicGroup group;
+        const std::function<void(const std::vector<unsigned char>& data)>* filter_hook;
+    };
+
+    struct Raw
+    {
+        std::uint16_t scheme;
+        std::uint16_t group_index;
+        std::uint16_t type_index;
+        bool has_timestamp;
+        std::uint64_t timestamp;
+        const unsigned char* data;
+        std::uint64_t data_size;
+    };
+
+    const Resolved& resolve(std::uint64_t key, int scheme, std::uint16_t group_index,
+                            std::uint16_t type_index);
+    bool find_magic();
+    bool is_block_magic(std::uint64_t position) const;
+    // returns false if the block is incomplete (at the end of the log)
+    bool read_block();
+    void discard_block()
+    {
+        block_.clear();
+        block_position_ = 0;
+    }
+    // parse the entry at position of the size bytes at begin, advancing position past it
+    // returns false if the entry is incomplete
+    bool read_raw(const unsigned char* begin, std::uint64_t size, std::uint64_t& position,
+                  Raw* raw);
+
+  private:
+    std::string path_;
+    const unsigned char* data_{nullptr};
+    std::uint64_t size_{0};
+    std::uint64_t position_{0};
+
+    // decompressed entries of the compressed block being read
+    std::string block_;
+    std::uint64_t block_position_{0};
+    std::uint64_t block_start_{0};
+
+    // (scheme, group index, type index) -> names and filter hook, reset when the group/type mappings or LogEntry::filter_hook change
+    std::unordered_map<std::uint64_t, Resolved> resolved_;
+    std::size_t filter_hook_count_{0};
+
+    // data passed to LogEntry::filter_hook, which takes a std::vector
+    std::vector<unsigned char> filter_data_;
+};
+
+} // namespace log
+} // namespace middleware
+} // namespace goby
+
+#endif
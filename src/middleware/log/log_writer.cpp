@@ -0,0 +1,403 @@
+// Copyright 2016-2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "log_writer.h"
+
+#include <algorithm> // for min
+#include <cerrno>    // for errno, EINTR
+#include <cstring>   // for memcpy, memmove, strerror
+#include <fcntl.h>   // for open, O_WRONLY, fallocate
+#include <unistd.h>  // for write, close, fdatasync, ftruncate
+
+#include "goby/middleware/log/log_entry.h"       // for LogEntry, LogException
+#include "goby/time/convert.h"                   // for convert
+#include "goby/util/debug_logger/flex_ostream.h" // for glog
+
+using goby::glog;
+
+namespace
+{
+constexpr std::size_t block_alignment{4096};
+// longest the writer thread sleeps without checking for new entries if a wakeup is missed
+constexpr std::chrono::milliseconds max_idle_wait{100};
+} // namespace
+
+goby::middleware::log::LogWriter::LogWriter(std::string path, const Options& options)
+    : path_(std::move(path)), options_(options), queue_(options.queue_size)
+{
+    options_.block_size =
+        std::max<std::size_t>(1, (options_.block_size + block_alignment - 1) / block_alignment) *
+        block_alignment;
+
+    if (options_.compression != Compression::NONE)
+    {
+        if (!compression_available(options_.compression))
+            throw(LogException("Log compression " + compression_name(options_.compression) +
+                               " is not available (was Goby compiled with it enabled?)"));
+        if (LogEntry::current_version_ < LogEntry::compressed_block_version)
+            throw(LogException("Log compression requires log version " +
+                               std::to_string(LogEntry::compressed_block_version) +
+                               " or newer (current version is " +
+                               std::to_string(LogEntry::current_version_) + ")"));
+        if (!LogEntry::compressed_blocks_)
+            throw(LogException("Log compression requires entries to be serialized with "
+                               "LogEntry::set_compressed_blocks(true)"));
+
+        // leave room for compression to expand the data, as readers reject blocks larger than this
+        options_.compression_block_size = std::min<std::size_t>(
+            std::max<std::size_t>(1, options_.compression_block_size),
+            LogEntry::max_block_size_ / 2);
+        block_.reserve(options_.compression_block_size);
+    }
+
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, block_alignment, options_.block_size) != 0)
+        throw(LogException("Failed to allocate log write buffer"));
+    buffer_.reset(static_cast<char*>(buffer));
+
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd_ < 0)
+        throw(LogException("Failed to open log file: " + path_ + ": " + std::strerror(errno)));
+
+#ifdef __linux__
+    if (options_.preallocate > 0)
+    {
+        // not all filesystems support this, and the log is written regardless
+        if (::fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, options_.preallocate) == 0)
+            preallocated_ = true;
+        else
+            glog.is_debug1() && glog << "Could not preallocate " << options_.preallocate
+                                     << " bytes for log file " << path_ << ": "
+                                     << std::strerror(errno) << std::endl;
+    }
+#endif
+
+    if (options_.index_block_size > 0)
+        index_.reset(new LogIndexWriter(LogIndex::path(path_), options_.index_block_size));
+
+    thread_ = std::thread([this]() { run(); });
+}
+
+goby::middleware::log::LogWriter::~LogWriter() { close(); }
+
+bool goby::middleware::log::LogWriter::write(std::string& bytes, const LogEntry& entry)
+{
+    flush_pending();
+
+    Item item;
+    item.metadata_size = bytes.size() - entry.serialized_size();
+    item.entry = true;
+    if (index_)
+    {
+        item.key = index_->add_key(entry);
+        item.time = goby::time::convert<goby::time::MicroTime>(entry.timestamp()).value();
+    }
+    item.bytes = std::move(bytes);
+
+    // metadata must be written before any later entries, so if some is still waiting, so must this
+    if (pending_.empty() && push(item))
+        return true;
+
+    bytes = std::move(item.bytes);
+    if (item.metadata_size > 0)
+    {
+        item.bytes.assign(bytes, 0, std::min(item.metadata_size, bytes.size()));
+        item.entry = false;
+        pending_.push_back(std::move(item));
+    }
+    ++dropped_entries_;
+    return false;
+}
+
+void goby::middleware::log::LogWriter::flush_pending()
+{
+    while (!pending_.empty())
+    {
+        if (!push(pending_.front()))
+            break;
+        pending_.pop_front();
+    }
+}
+
+bool goby::middleware::log::LogWriter::push(Item& item)
+{
+    if (!queue_.try_push(item))
+        return false;
+
+    ++queued_;
+    if (idle_)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cv_.notify_one();
+    }
+    return true;
+}
+
+void goby::middleware::log::LogWriter::close()
+{
+    if (!thread_.joinable())
+        return;
+
+    // the writer thread is draining the queue, so this won't wait long
+    while (!pending_.empty())
+    {
+        flush_pending();
+        if (!pending_.empty())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing_ = true;
+        cv_.notify_one();
+    }
+    thread_.join();
+
+    // release any preallocated space beyond what was written
+    if (preallocated_ && ::ftruncate(fd_, file_offset_) != 0)
+        glog.is_debug1() && glog << "Failed to truncate log file " << path_ << ": "
+                                 << std::strerror(errno) << std::endl;
+
+    ::close(fd_);
+    fd_ = -1;
+
+    if (index_)
+        index_->close(appended_bytes_);
+}
+
+goby::middleware::log::LogWriter::Statistics
+goby::middleware::log::LogWriter::statistics() const
+{
+    Statistics stats;
+    stats.queue_depth = queued_ - dequeued_;
+    stats.queue_capacity = queue_.capacity();
+    stats.entries_written = entries_written_;
+    stats.bytes_written = bytes_written_;
+    stats.dropped_entries = dropped_entries_;
+    stats.write_errors = write_errors_;
+    return stats;
+}
+
+void goby::middleware::log::LogWriter::run()
+{
+    using Clock = std::chrono::steady_clock;
+    auto next_flush = Clock::now() + options_.flush_interval;
+    auto next_sync = Clock::now() + options_.fsync_interval;
+
+    Item item;
+    for (;;)
+    {
+        bool popped = false;
+        while (queue_.try_pop(item))
+        {
+            popped = true;
+            ++dequeued_;
+            handle(item);
+            if (item.entry)
+                ++entries_written_;
+        }
+
+        auto now = Clock::now();
+        if (now >= next_flush)
+        {
+            write_compressed_block();
+            write_buffer(true);
+            next_flush = now + options_.flush_interval;
+        }
+
+        if (options_.fsync_interval.count() > 0 && now >= next_sync)
+        {
+            sync();
+            next_sync = now + options_.fsync_interval;
+        }
+
+        if (!popped)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            // push() checks idle_ after queuing, so either it notifies us or we see the new entry here
+            idle_ = true;
+            if (queued_ == dequeued_)
+            {
+                if (closing_)
+                    break;
+                auto wait = std::min<Clock::duration>(next_flush - now, max_idle_wait);
+                cv_.wait_for(lock, wait);
+            }
+            idle_ = false;
+        }
+    }
+
+    write_compressed_block();
+    write_buffer(true);
+    sync();
+}
+
+void goby::middleware::log::LogWriter::handle(const Item& item)
+{
+    IndexItem index_item{item.metadata_size > 0, item.entry, item.key, item.time};
+    const char* data = item.bytes.data();
+    std::size_t size = item.bytes.size();
+    std::size_t metadata_size = item.metadata_size;
+    const bool compress = options_.compression != Compression::NONE;
+
+    if (compress && appended_bytes_ == 0)
+    {
+        // readers need the version number to know that the log may contain compressed blocks
+        std::size_t n = std::min<std::size_t>(LogEntry::version_bytes_, size);
+        append(data, n);
+        data += n;
+        size -= n;
+        metadata_size -= std::min(n, metadata_size);
+        index_item.metadata = metadata_size > 0;
+    }
+
+    if (!compress || size > options_.compression_block_size)
+    {
+        write_compressed_block();
+        add_to_index(index_item, appended_bytes_, appended_bytes_ + metadata_size,
+                     appended_bytes_ + size);
+        append(data, size);
+        return;
+    }
+
+    // blocks start with any metadata they contain, so that LogIndex can read it by reading the start of the block
+    if (index_item.metadata || block_.size() + size > options_.compression_block_size)
+        write_compressed_block();
+
+    block_.append(data, size);
+    block_items_.push_back(index_item);
+}
+
+void goby::middleware::log::LogWriter::add_to_index(const IndexItem& item, std::uint64_t offset,
+                                                    std::uint64_t entry_offset,
+                                                    std::uint64_t end_offset)
+{
+    if (!index_)
+        return;
+
+    if (item.metadata)
+        index_->add_metadata(offset);
+    if (item.entry)
+        index_->add_entry(entry_offset, end_offset, item.key, item.time);
+}
+
+void goby::middleware::log::LogWriter::write_compressed_block()
+{
+    if (block_.empty())
+        return;
+
+    compressed_block_.clear();
+    try
+    {
+        LogEntry::serialize_block(options_.compression, options_.compression_level, block_.data(),
+                                  block_.size(), &compressed_block_);
+    }
+    catch (const LogException& e)
+    {
+        if (write_errors_++ == 0)
+            glog.is_warn() && glog << "Failed to compress block for log file " << path_ << " ("
+                                   << e.what() << "), writing it uncompressed" << std::endl;
+        compressed_block_.clear();
+        LogEntry::serialize_block(Compression::NONE, 0, block_.data(), block_.size(),
+                                  &compressed_block_);
+    }
+
+    // entries in a compressed block are indexed at the start of the block
+    const std::uint64_t offset = appended_bytes_;
+    for (const auto& item : block_items_)
+        add_to_index(item, offset, offset, offset + compressed_block_.size());
+
+    append(compressed_block_.data(), compressed_block_.size());
+    block_.clear();
+    block_items_.clear();
+}
+
+void goby::middleware::log::LogWriter::append(const char* data, std::size_t size)
+{
+    appended_bytes_ += size;
+    std::size_t remaining = size;
+    while (remaining > 0)
+    {
+        std::size_t n = std::min(remaining, options_.block_size - buffer_used_);
+        std::memcpy(buffer_.get() + buffer_used_, data, n);
+        buffer_used_ += n;
+        data += n;
+        remaining -= n;
+
+        if (buffer_used_ == options_.block_size)
+            write_buffer(false);
+    }
+}
+
+void goby::middleware::log::LogWriter::write_buffer(bool partial_block)
+{
+    std::size_t size = buffer_used_;
+    if (!partial_block)
+    {
+        // write up to the last block boundary of the file, so that a previous flush of a partial block doesn't leave all later writes unaligned
+        std::uint64_t end = (file_offset_ + buffer_used_) / options_.block_size * options_.block_size;
+        size = end > file_offset_ ? end - file_offset_ : 0;
+    }
+
+    if (size == 0)
+        return;
+
+    const char* data = buffer_.get();
+    std::size_t remaining = size;
+    while (remaining > 0)
+    {
+        ssize_t n = ::write(fd_, data, remaining);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            if (write_errors_++ == 0)
+                glog.is_warn() && glog << "Failed to write to log file " << path_ << ": "
+                                       << std::strerror(errno) << std::endl;
+            break;
+        }
+        data += n;
+        remaining -= n;
+        bytes_written_ += n;
+    }
+
+    // on error, the unwritten bytes are discarded and the file offset reflects what was written
+    file_offset_ += size - remaining;
+    std::memmove(buffer_.get(), buffer_.get() + size, buffer_used_ - size);
+    buffer_used_ -= size;
+    unsynced_ = true;
+}
+
+void goby::middleware::log::LogWriter::sync()
+{
+    if (!unsynced_)
+        return;
+
+#ifdef __APPLE__
+    ::fsync(fd_);
+#else
+    ::fdatasync(fd_);
+#endif
+    unsynced_ = false;
+}
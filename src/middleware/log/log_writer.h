@@ -0,0 +1,201 @@
+// Copyright 2016-2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GOBY_MIDDLEWARE_LOG_LOG_WRITER_H
+#define GOBY_MIDDLEWARE_LOG_LOG_WRITER_H
+
+#include <atomic>             // for atomic
+#include <chrono>             // for milliseconds
+#include <condition_variable> // for condition_variable
+#include <cstddef>            // for size_t
+#include <cstdint>            // for uint64_t
+#include <cstdlib>            // for free
+#include <deque>              // for deque
+#include <memory>             // for unique_ptr
+#include <mutex>              // for mutex
+#include <string>             // for string
+#include <thread>             // for thread
+#include <vector>             // for vector
+
+#include "goby/middleware/log/compression.h"
+#include "goby/middleware/log/log_index.h"
+#include "goby/middleware/transport/detail/bounded_queue.h"
+
+namespace goby
+{
+namespace middleware
+{
+namespace log
+{
+class LogEntry;
+
+/// \brief Writes serialized log entries (see LogEntry::serialize) to a file from a dedicated thread, so that a slow or stalled disk does not block the thread that produces the entries (e.g. goby_logger's subscription callbacks).
+///
+/// Entries are passed to the writer thread through a fixed size lock-free queue. The writer thread copies them into a block buffer, writing only whole blocks (aligned to the file offset) except when flushing, and periodically calls fdatasync. If the queue is full, entries are dropped and counted rather than waiting for the disk. Leading metadata (version number, group and type index entries, and Protobuf file descriptors written by the plugin hooks) is never dropped, as later entries cannot be read without it; it is held and queued ahead of any later entries.
+///
+/// Unless disabled, the index sidecar file (see LogIndex) is also written as entries are queued.
+///
+/// write(), flush_pending() and close() must all be called from the same thread, except that close() may be called from another thread once the first no longer uses the writer (e.g. to close a log in the background after switching to a new one).
+class LogWriter
+{
+  public:
+    struct Options
+    {
+        /// \brief Maximum number of entries waiting to be written
+        std::size_t queue_size{4096};
+        /// \brief Size of each write to the file (rounded up to a multiple of 4096 bytes)
+        std::size_t block_size{65536};
+        /// \brief Maximum time that a partial block is held before being written
+        std::chrono::milliseconds flush_interval{std::chrono::seconds(1)};
+        /// \brief Interval between calls to fdatasync (zero disables)
+        std::chrono::milliseconds fsync_interval{std::chrono::seconds(10)};
+        /// \brief Size (bytes of the log) of each block of the index file (zero disables writing the index)
+        std::uint64_t index_block_size{LogIndexWriter::default_block_size};
+        /// \brief Write entries in independently compressed blocks (see LogEntry::serialize_block()), which requires a version 4 or newer log. The first bytes written must then begin with the version number (as written by the first call to LogEntry::serialize() after LogEntry::reset()), which is not compressed.
+        Compression compression{Compression::NONE};
+        /// \brief Compression level (specific to the algorithm), or -1 for the default
+        int compression_level{-1};
+        /// \brief Maximum size (bytes, before compression) of each compressed block. Larger blocks compress better, but more of the log is lost if the logger stops before a block is written (as well as at flush_interval, blocks are ended before entries with metadata, and larger entries are written uncompressed).
+        std::size_t compression_block_size{256 * 1024};
+        /// \brief Space (bytes) to reserve for the file when it is opened (zero disables), so that the filesystem can allocate it up front rather than as it is written. Uses fallocate() without changing the file size (and so only on Linux); any space not written is released by close().
+        std::uint64_t preallocate{0};
+    };
+
+    struct Statistics
+    {
+        std::size_t queue_depth{0};
+        std::size_t queue_capacity{0};
+        std::uint64_t entries_written{0};
+        std::uint64_t bytes_written{0};
+        std::uint64_t dropped_entries{0};
+        std::uint64_t write_errors{0};
+    };
+
+    /// \brief Open (truncating) the file at \c path and start the writer thread
+    ///
+    /// \throw LogException if the file cannot be opened, or the compression is not available
+    LogWriter(std::string path, const Options& options);
+    ~LogWriter();
+
+    LogWriter(const LogWriter&) = delete;
+    LogWriter& operator=(const LogWriter&) = delete;
+
+    /// \brief Queue serialized bytes for writing
+    ///
+    /// \param bytes Result of \c entry.serialize(), moved from if this function returns true. Any bytes before the entry itself (see LogEntry::serialized_size()) are metadata, which is never dropped.
+    /// \param entry The entry serialized into \c bytes
+    /// \return true if all of \c bytes were queued, false if the entry was dropped
+    bool write(std::string& bytes, const LogEntry& entry);
+
+    /// \brief Queue any metadata held back by write() because the queue was full. Called by write(), and should also be called periodically if write() may not be.
+    void flush_pending();
+
+    /// \brief Write all queued entries, fdatasync and close the file, and stop the writer thread. Called by the destructor if not called before.
+    void close();
+
+    /// \return true until close() is called
+    bool is_open() const { return fd_ >= 0; }
+
+    const std::string& path() const { return path_; }
+
+    Statistics statistics() const;
+
+  private:
+    // entry (and/or metadata) to be written by the writer thread
+    struct Item
+    {
+        std::string bytes;
+        // bytes of metadata at the start of bytes
+        std::size_t metadata_size{0};
+        // false for metadata alone (from an entry that was dropped)
+        bool entry{false};
+        // for the index
+        std::uint32_t key{0};
+        std::uint64_t time{0};
+    };
+
+    // what the index needs to know about an item once it is written
+    struct IndexItem
+    {
+        bool metadata;
+        bool entry;
+        std::uint32_t key;
+        std::uint64_t time;
+    };
+
+    bool push(Item& item);
+    void run();
+    void handle(const Item& item);
+    void add_to_index(const IndexItem& item, std::uint64_t offset, std::uint64_t entry_offset,
+                      std::uint64_t end_offset);
+    void write_compressed_block();
+    void append(const char* data, std::size_t size);
+    void write_buffer(bool partial_block);
+    void sync();
+
+  private:
+    std::string path_;
+    Options options_;
+    int fd_{-1};
+    bool preallocated_{false};
+
+    goby::middleware::detail::BoundedQueue<Item> queue_;
+    std::atomic<std::uint64_t> queued_{0};
+    std::atomic<std::uint64_t> dequeued_{0};
+
+    // only used by the producer thread
+    // metadata waiting for room in the queue
+    std::deque<Item> pending_;
+
+    // keys are added by the producer thread, everything else by the writer thread
+    std::unique_ptr<LogIndexWriter> index_;
+
+    // only used by the writer thread
+    std::unique_ptr<char, decltype(&std::free)> buffer_{nullptr, &std::free};
+    std::size_t buffer_used_{0};
+    std::uint64_t file_offset_{0};
+    // total size of all bytes appended to the buffer (i.e. the file offset of the next bytes appended)
+    std::uint64_t appended_bytes_{0};
+    bool unsynced_{false};
+    // entries for the compressed block being filled, and their index entries
+    std::string block_;
+    std::vector<IndexItem> block_items_;
+    std::string compressed_block_;
+
+    std::atomic<std::uint64_t> entries_written_{0};
+    std::atomic<std::uint64_t> bytes_written_{0};
+    std::atomic<std::uint64_t> dropped_entries_{0};
+    std::atomic<std::uint64_t> write_errors_{0};
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::atomic<bool> idle_{false};
+    std::atomic<bool> closing_{false};
+    std::thread thread_;
+};
+
+} // namespace log
+} // namespace middleware
+} // namespace goby
+
+#endif
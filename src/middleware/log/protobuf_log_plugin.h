@@ -124,7 +124,8 @@ template <int scheme> class ProtobufPluginBase : public LogPlugin
         };
     }
 
-    void register_write_hooks(std::ofstream& out_log_file) override
+    using LogPlugin::register_write_hooks;
+    void register_write_hooks(std::ostream& out_log_file) override
     {
         LogEntry::new_type_hook[scheme] = [&](const std::string& type)
         { add_new_protobuf_type(type, out_log_file); };
@@ -160,7 +161,7 @@ template <int scheme> class ProtobufPluginBase : public LogPlugin
 
   private:
     void insert_protobuf_file_desc(const google::protobuf::FileDescriptor* file_desc,
-                                   std::ofstream& out_log_file)
+                                   std::ostream& out_log_file)
     {
         if (written_file_desc_.count(file_desc) == 0)
         {
@@ -190,7 +191,7 @@ template <int scheme> class ProtobufPluginBase : public LogPlugin
         }
     }
 
-    void add_new_protobuf_type(const std::string& protobuf_type, std::ofstream& out_log_file)
+    void add_new_protobuf_type(const std::string& protobuf_type, std::ostream& out_log_file)
     {
         const google::protobuf::Descriptor* desc =
             dccl::DynamicProtobufManager::find_descriptor(protobuf_type);
@@ -206,7 +207,7 @@ template <int scheme> class ProtobufPluginBase : public LogPlugin
     }
 
     void add_new_protobuf_type(const google::protobuf::Descriptor* desc,
-                               std::ofstream& out_log_file)
+                               std::ostream& out_log_file)
     {
         if (written_desc_.count(desc) == 0)
         {
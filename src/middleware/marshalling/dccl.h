@@ -48,7 +48,6 @@ struct SerializerParserHelper<DataType, MarshallingScheme::DCCL>
     /// \brief Serialize message using DCCL encoding
     static std::vector<char> serialize(const DataType& msg)
     {
-        std::lock_guard<std::mutex> lock(dccl_mutex_);
         check_load<DataType>();
         std::vector<char> bytes(codec().size(msg), 0);
         codec().encode(bytes.data(), bytes.size(), msg);
@@ -75,7 +74,6 @@ struct SerializerParserHelper<DataType, MarshallingScheme::DCCL>
                                            CharIterator& actual_end,
                                            const std::string& type = type_name())
     {
-        std::lock_guard<std::mutex> lock(dccl_mutex_);
         check_load<DataType>();
         auto msg = std::make_shared<DataType>();
         actual_end = codec().decode(bytes_begin, bytes_end, msg.get());
@@ -93,7 +91,6 @@ struct SerializerParserHelper<DataType, MarshallingScheme::DCCL>
     /// \endcode
     static unsigned id()
     {
-        std::lock_guard<std::mutex> lock(dccl_mutex_);
         check_load<DataType>();
         return codec().template id<DataType>();
     }
@@ -112,7 +109,6 @@ struct SerializerParserHelper<google::protobuf::Message, MarshallingScheme::DCCL
     /// Serialize DCCL/Protobuf message (using DCCL encoding)
     static std::vector<char> serialize(const google::protobuf::Message& msg)
     {
-        std::lock_guard<std::mutex> lock(dccl_mutex_);
         check_load(msg.GetDescriptor());
         std::vector<char> bytes(codec().size(msg), 0);
         codec().encode(bytes.data(), bytes.size(), msg);
@@ -147,10 +143,8 @@ struct SerializerParserHelper<google::protobuf::Message, MarshallingScheme::DCCL
     parse(CharIterator bytes_begin, CharIterator bytes_end, CharIterator& actual_end,
           const std::string& type, bool user_pool_first = false)
     {
-        std::lock_guard<std::mutex> lock(dccl_mutex_);
-
-        auto msg = dccl::DynamicProtobufManager::new_protobuf_message<
-            std::shared_ptr<google::protobuf::Message>>(type, user_pool_first);
+        std::shared_ptr<google::protobuf::Message> msg(
+            detail::DynamicProtobufPrototypes::prototype(type, user_pool_first).New());
 
         check_load(msg->GetDescriptor());
         actual_end = codec().decode(bytes_begin, bytes_end, msg.get());
@@ -160,7 +154,6 @@ struct SerializerParserHelper<google::protobuf::Message, MarshallingScheme::DCCL
     /// \brief Returns the DCCL ID given a Protobuf Descriptor
     static unsigned id(const google::protobuf::Descriptor* desc)
     {
-        std::lock_guard<std::mutex> lock(dccl_mutex_);
         check_load(desc);
         return codec().id(desc);
     }
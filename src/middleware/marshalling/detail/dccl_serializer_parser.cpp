@@ -47,43 +47,52 @@ class Descriptor;
 } // namespace protobuf
 } // namespace google
 
-std::unique_ptr<dccl::Codec>
-    goby::middleware::detail::DCCLSerializerParserHelperBase::codec_(nullptr);
-std::unordered_map<
-    const google::protobuf::Descriptor*,
-    std::unique_ptr<goby::middleware::detail::DCCLSerializerParserHelperBase::LoaderBase>>
-    goby::middleware::detail::DCCLSerializerParserHelperBase::loader_map_;
+std::vector<const google::protobuf::Descriptor*>
+    goby::middleware::detail::DCCLSerializerParserHelperBase::registry_descriptors_;
+std::vector<std::string> goby::middleware::detail::DCCLSerializerParserHelperBase::registry_libraries_;
+std::atomic<std::uint64_t>
+    goby::middleware::detail::DCCLSerializerParserHelperBase::registry_generation_(0);
 std::mutex goby::middleware::detail::DCCLSerializerParserHelperBase::dccl_mutex_;
 std::set<std::string> goby::middleware::detail::DCCLSerializerParserHelperBase::loaded_proto_files_;
 
+goby::middleware::detail::DCCLSerializerParserHelperBase::ThreadCodec&
+goby::middleware::detail::DCCLSerializerParserHelperBase::thread_codec()
+{
+    thread_local ThreadCodec tc;
+    if (!tc.codec)
+        tc.codec = std::make_unique<dccl::Codec>();
+    return tc;
+}
+
 void goby::middleware::detail::DCCLSerializerParserHelperBase::load_metadata(
     const goby::middleware::protobuf::SerializerProtobufMetadata& meta)
 {
-    std::lock_guard<std::mutex> lock(dccl_mutex_);
-
-    // check that we don't already have this type available
-    if (auto* desc = dccl::DynamicProtobufManager::find_descriptor(meta.protobuf_name()))
-    {
-        check_load(desc);
-    }
-    else
+    const google::protobuf::Descriptor* desc = nullptr;
     {
-        for (const auto& file_desc_proto : meta.file_descriptor())
+        std::lock_guard<std::mutex> lock(DynamicProtobufPrototypes::dynamic_protobuf_manager_mutex());
+
+        // check that we don't already have this type available
+        desc = dccl::DynamicProtobufManager::find_descriptor(meta.protobuf_name());
+        if (!desc)
         {
-            if (!loaded_proto_files_.count(file_desc_proto.name()))
+            for (const auto& file_desc_proto : meta.file_descriptor())
             {
-                dccl::DynamicProtobufManager::add_protobuf_file(file_desc_proto);
-                loaded_proto_files_.insert(file_desc_proto.name());
+                if (!loaded_proto_files_.count(file_desc_proto.name()))
+                {
+                    dccl::DynamicProtobufManager::add_protobuf_file(file_desc_proto);
+                    loaded_proto_files_.insert(file_desc_proto.name());
+                }
             }
+            desc = dccl::DynamicProtobufManager::find_descriptor(meta.protobuf_name());
         }
-
-        if (auto* desc = dccl::DynamicProtobufManager::find_descriptor(meta.protobuf_name()))
-            check_load(desc);
-        else
-            glog.is(goby::util::logger::DEBUG3) &&
-                glog << "Failed to load DCCL message via metadata: " << meta.protobuf_name()
-                     << std::endl;
     }
+
+    if (desc)
+        check_load(desc);
+    else
+        glog.is(goby::util::logger::DEBUG3) &&
+            glog << "Failed to load DCCL message via metadata: " << meta.protobuf_name()
+                 << std::endl;
 }
 
 void check_subscription_version(unsigned dccl_id, const google::protobuf::Message& msg)
@@ -127,8 +136,6 @@ void check_subscription_version(unsigned dccl_id, const google::protobuf::Messag
 goby::middleware::intervehicle::protobuf::DCCLForwardedData
 goby::middleware::detail::DCCLSerializerParserHelperBase::unpack(const std::string& frame)
 {
-    std::lock_guard<std::mutex> lock(dccl_mutex_);
-
     goby::middleware::intervehicle::protobuf::DCCLForwardedData packets;
 
     std::string::const_iterator frame_it = frame.begin(), frame_end = frame.end();
@@ -161,8 +168,8 @@ goby::middleware::detail::DCCLSerializerParserHelperBase::unpack(const std::stri
         }
 
         const auto* desc = codec().loaded().at(dccl_id);
-        auto msg = dccl::DynamicProtobufManager::new_protobuf_message<
-            std::unique_ptr<google::protobuf::Message>>(desc);
+        std::unique_ptr<google::protobuf::Message> msg(
+            DynamicProtobufPrototypes::prototype(desc).New());
 
         try
         {
@@ -24,17 +24,21 @@
 #ifndef GOBY_MIDDLEWARE_MARSHALLING_DETAIL_DCCL_SERIALIZER_PARSER_H
 #define GOBY_MIDDLEWARE_MARSHALLING_DETAIL_DCCL_SERIALIZER_PARSER_H
 
+#include <algorithm>     // for find
+#include <atomic>        // for atomic
+#include <cstdint>       // for uint64_t
 #include <memory>        // for unique_ptr
 #include <mutex>         // for mutex, lock_guard
 #include <ostream>       // for basic_ostream
 #include <set>           // for set
 #include <string>        // for string, operat...
-#include <unordered_map> // for unordered_map
-#include <utility>       // for pair, make_pair
+#include <unordered_set> // for unordered_set
+#include <vector>        // for vector
 
 #include <dccl/codec.h>                    // for Codec
 #include <dccl/dynamic_protobuf_manager.h> // for DynamicProtobu...
 
+#include "goby/middleware/marshalling/detail/dynamic_protobuf_prototypes.h" // for DynamicProto...
 #include "goby/middleware/protobuf/intervehicle.pb.h" // for DCCLForwardedData
 #include "goby/util/debug_logger/flex_ostream.h"      // for operator<<
 
@@ -58,70 +62,96 @@ class SerializerProtobufMetadata;
 namespace detail
 {
 /// \brief Wraps a dccl::Codec in a thread-safe way to make it usable by SerializerParserHelper
+///
+/// Each thread uses its own dccl::Codec so that DCCL encoding and decoding in different threads proceed in parallel. Message types and libraries loaded in any thread are recorded in a shared registry and loaded lazily into the other threads' codecs the next time they are used (so that, for example, a message loaded from metadata in one thread can be decoded by its DCCL ID in another). The codec itself is not shared, so set_codec() only replaces the calling thread's codec.
 struct DCCLSerializerParserHelperBase
 {
   private:
-    static std::unique_ptr<dccl::Codec> codec_;
-
-  protected:
-    static std::mutex dccl_mutex_;
-
-    struct LoaderBase
+    // codec for a single thread and the registry entries loaded into it
+    struct ThreadCodec
     {
-        LoaderBase() = default;
-        virtual ~LoaderBase() = default;
+        std::unique_ptr<dccl::Codec> codec;
+        std::unordered_set<const google::protobuf::Descriptor*> loaded;
+        std::size_t libraries_synced{0};
+        std::size_t descriptors_synced{0};
+        std::uint64_t generation{0};
     };
 
-    template <typename DataType> struct Loader : public LoaderBase
-    {
-        Loader() { codec().load<DataType>(); }
-        ~Loader() override { codec().unload<DataType>(); }
-    };
+    static ThreadCodec& thread_codec();
 
-    struct LoaderDynamic : public LoaderBase
+    // load any libraries or descriptors added to the registry by other threads
+    static void sync(ThreadCodec& tc)
     {
-        LoaderDynamic(const google::protobuf::Descriptor* desc) : desc_(desc)
+        if (tc.generation == registry_generation_.load(std::memory_order_acquire))
+            return;
+
+        std::lock_guard<std::mutex> lock(dccl_mutex_);
+        for (; tc.libraries_synced < registry_libraries_.size(); ++tc.libraries_synced)
+            tc.codec->load_library(registry_libraries_[tc.libraries_synced]);
+        for (; tc.descriptors_synced < registry_descriptors_.size(); ++tc.descriptors_synced)
         {
-            codec().load(desc_);
+            const auto* desc = registry_descriptors_[tc.descriptors_synced];
+            if (!tc.loaded.count(desc))
+            {
+                tc.codec->load(desc);
+                tc.loaded.insert(desc);
+            }
         }
-        ~LoaderDynamic() override { codec().unload(desc_); }
+        tc.generation = registry_generation_.load(std::memory_order_relaxed);
+    }
 
-      private:
-        const google::protobuf::Descriptor* desc_;
-    };
+    // registry of everything loaded by any thread
+    static std::vector<const google::protobuf::Descriptor*> registry_descriptors_;
+    static std::vector<std::string> registry_libraries_;
+    static std::atomic<std::uint64_t> registry_generation_;
 
-    static std::unordered_map<const google::protobuf::Descriptor*, std::unique_ptr<LoaderBase>>
-        loader_map_;
+  protected:
+    /// \brief Protects the shared registry of loaded types and libraries. Not held while encoding or decoding.
+    static std::mutex dccl_mutex_;
 
+    // protected by DynamicProtobufPrototypes::dynamic_protobuf_manager_mutex()
     static std::set<std::string> loaded_proto_files_;
 
-    template <typename DataType> static void check_load()
-    {
-        const auto* desc = DataType::descriptor();
-        if (!loader_map_.count(desc))
-            loader_map_.insert(
-                std::make_pair(desc, std::unique_ptr<LoaderBase>(new Loader<DataType>())));
-    }
+    template <typename DataType> static void check_load() { check_load(DataType::descriptor()); }
 
     static void check_load(const google::protobuf::Descriptor* desc)
     {
-        if (!loader_map_.count(desc))
-            loader_map_.insert(
-                std::make_pair(desc, std::unique_ptr<LoaderBase>(new LoaderDynamic(desc))));
+        auto& tc = thread_codec();
+        sync(tc);
+        if (!tc.loaded.count(desc))
+        {
+            tc.codec->load(desc);
+            tc.loaded.insert(desc);
+
+            std::lock_guard<std::mutex> lock(dccl_mutex_);
+            if (std::find(registry_descriptors_.begin(), registry_descriptors_.end(), desc) ==
+                registry_descriptors_.end())
+            {
+                registry_descriptors_.push_back(desc);
+                registry_generation_.fetch_add(1, std::memory_order_release);
+            }
+        }
     }
 
-
+    /// \brief The calling thread's codec, with all types and libraries loaded by other threads
     static dccl::Codec& codec()
     {
-        if (!codec_)
-            codec_ = std::make_unique<dccl::Codec>();
-        return *codec_;
+        auto& tc = thread_codec();
+        sync(tc);
+        return *tc.codec;
     }
 
+    /// \brief Replace the calling thread's codec (takes ownership). Types and libraries in the shared registry are reloaded into it as needed.
+    ///
+    /// \warning This only affects the calling thread: every other thread keeps using its own codec (previously, a single codec was shared by all threads). To use a customized codec everywhere, call this from each thread that encodes or decodes DCCL, before it first does so.
     static dccl::Codec& set_codec(dccl::Codec* new_codec)
     {
-        codec_.reset(new_codec);
-        loader_map_.clear();
+        auto& tc = thread_codec();
+        tc.codec.reset(new_codec);
+        tc.loaded.clear();
+        tc.libraries_synced = 0;
+        tc.descriptors_synced = 0;
+        tc.generation = 0;
         return *new_codec;
     }
 
@@ -133,14 +163,17 @@ struct DCCLSerializerParserHelperBase
 
     template <typename CharIterator> static unsigned id(CharIterator begin, CharIterator end)
     {
-        std::lock_guard<std::mutex> lock(dccl_mutex_);
         return codec().id(begin, end);
     }
 
     static unsigned id(const std::string& full_name)
     {
-        std::lock_guard<std::mutex> lock(dccl_mutex_);
-        auto* desc = dccl::DynamicProtobufManager::find_descriptor(full_name);
+        const google::protobuf::Descriptor* desc;
+        {
+            std::lock_guard<std::mutex> lock(
+                DynamicProtobufPrototypes::dynamic_protobuf_manager_mutex());
+            desc = dccl::DynamicProtobufManager::find_descriptor(full_name);
+        }
         if (desc)
         {
             return codec().id(desc);
@@ -157,10 +190,15 @@ struct DCCLSerializerParserHelperBase
     static goby::middleware::intervehicle::protobuf::DCCLForwardedData
     unpack(const std::string& bytes);
 
+    /// \brief Load a library of DCCL codecs (and/or messages) into the codecs of all threads
     static void load_library(const std::string& library)
     {
-        std::lock_guard<std::mutex> lock(dccl_mutex_);
-        codec().load_library(library);
+        {
+            std::lock_guard<std::mutex> lock(dccl_mutex_);
+            registry_libraries_.push_back(library);
+            registry_generation_.fetch_add(1, std::memory_order_release);
+        }
+        codec();
     }
 
     /// \brief Enable dlog output to glog using same verbosity settings as glog.
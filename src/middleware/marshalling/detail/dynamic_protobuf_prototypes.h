@@ -0,0 +1,183 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GOBY_MIDDLEWARE_MARSHALLING_DETAIL_DYNAMIC_PROTOBUF_PROTOTYPES_H
+#define GOBY_MIDDLEWARE_MARSHALLING_DETAIL_DYNAMIC_PROTOBUF_PROTOTYPES_H
+
+#include <atomic>        // for atomic
+#include <cstdint>       // for uint64_t
+#include <memory>        // for unique_ptr
+#include <mutex>         // for mutex, lock_guard
+#include <string>        // for string
+#include <unordered_map> // for unordered_map
+#include <utility>       // for move
+
+#include <dccl/dynamic_protobuf_manager.h>
+#include <google/protobuf/message.h>
+
+namespace goby
+{
+namespace middleware
+{
+namespace detail
+{
+/// \brief Cache of prototype messages used to create Protobuf messages from a type name (or descriptor) at runtime, for example when parsing via SerializerParserHelper<google::protobuf::Message, ...>.
+///
+/// Each thread looks up prototypes in its own cache without locking, falling back to a shared cache (and then dccl::DynamicProtobufManager) under dynamic_protobuf_manager_mutex() the first time it needs a given type. New messages are then created using prototype->New().
+class DynamicProtobufPrototypes
+{
+  public:
+    /// \brief Mutex to hold for any other use of dccl::DynamicProtobufManager (which is not thread-safe) from the marshalling code
+    static std::mutex& dynamic_protobuf_manager_mutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    /// \brief Prototype for the given type name, loading it if necessary. Throws (as dccl::DynamicProtobufManager::new_protobuf_message) if the type is unknown.
+    ///
+    /// \param type Full Protobuf type name (e.g. "goby.middleware.protobuf.NavigationReport")
+    /// \param user_pool_first Search the user descriptor pool before the generated pool
+    static const google::protobuf::Message& prototype(const std::string& type,
+                                                      bool user_pool_first = false)
+    {
+        auto& local = local_cache().by_name[user_pool_first ? 1 : 0];
+        auto it = local.find(type);
+        if (it != local.end())
+            return *it->second;
+
+        const google::protobuf::Message* proto;
+        {
+            std::lock_guard<std::mutex> lock(dynamic_protobuf_manager_mutex());
+            auto& shared = registry().by_name[user_pool_first ? 1 : 0];
+            auto shared_it = shared.find(type);
+            if (shared_it == shared.end())
+            {
+                auto msg = dccl::DynamicProtobufManager::new_protobuf_message<
+                    std::unique_ptr<google::protobuf::Message>>(type, user_pool_first);
+                shared_it = shared.insert(std::make_pair(type, std::move(msg))).first;
+            }
+            proto = shared_it->second.get();
+        }
+        local.insert(std::make_pair(type, proto));
+        return *proto;
+    }
+
+    /// \brief Prototype for the given descriptor
+    static const google::protobuf::Message& prototype(const google::protobuf::Descriptor* desc)
+    {
+        auto& local = local_cache().by_descriptor;
+        auto it = local.find(desc);
+        if (it != local.end())
+            return *it->second;
+
+        const google::protobuf::Message* proto;
+        {
+            std::lock_guard<std::mutex> lock(dynamic_protobuf_manager_mutex());
+            auto& shared = registry().by_descriptor;
+            auto shared_it = shared.find(desc);
+            if (shared_it == shared.end())
+            {
+                auto msg = dccl::DynamicProtobufManager::new_protobuf_message<
+                    std::unique_ptr<google::protobuf::Message>>(desc);
+                shared_it = shared.insert(std::make_pair(desc, std::move(msg))).first;
+            }
+            proto = shared_it->second.get();
+        }
+        local.insert(std::make_pair(desc, proto));
+        return *proto;
+    }
+
+    /// \brief Discard all cached prototypes. Must be called after dccl::DynamicProtobufManager::reset(), as the cached prototypes may refer to descriptors it has destroyed (prefer reset_dynamic_protobuf_manager(), which does both).
+    static void reset()
+    {
+        std::lock_guard<std::mutex> lock(dynamic_protobuf_manager_mutex());
+        clear_registry();
+    }
+
+    /// \brief Reset dccl::DynamicProtobufManager (discarding all dynamically loaded types) and the cached prototypes together. Use this instead of calling dccl::DynamicProtobufManager::reset() directly.
+    static void reset_dynamic_protobuf_manager()
+    {
+        std::lock_guard<std::mutex> lock(dynamic_protobuf_manager_mutex());
+        dccl::DynamicProtobufManager::reset();
+        clear_registry();
+    }
+
+  private:
+    template <typename Pointer> struct Maps
+    {
+        std::unordered_map<std::string, Pointer> by_name[2];
+        std::unordered_map<const google::protobuf::Descriptor*, Pointer> by_descriptor;
+    };
+
+    struct Registry : Maps<std::unique_ptr<google::protobuf::Message>>
+    {
+        std::atomic<std::uint64_t> generation{0};
+    };
+
+    struct LocalCache : Maps<const google::protobuf::Message*>
+    {
+        std::uint64_t generation{0};
+    };
+
+    // requires dynamic_protobuf_manager_mutex()
+    static void clear_registry()
+    {
+        auto& reg = registry();
+        // the old prototypes may no longer be safely destroyed, so they are leaked
+        for (auto& by_name : reg.by_name)
+            for (auto& p : by_name) p.second.release();
+        for (auto& p : reg.by_descriptor) p.second.release();
+        reg.by_name[0].clear();
+        reg.by_name[1].clear();
+        reg.by_descriptor.clear();
+        reg.generation.fetch_add(1, std::memory_order_release);
+    }
+
+    static Registry& registry()
+    {
+        // never destroyed, as dynamic prototypes depend on dccl::DynamicProtobufManager's message factory, which may be destroyed first at exit
+        static Registry* registry = new Registry;
+        return *registry;
+    }
+
+    static LocalCache& local_cache()
+    {
+        thread_local LocalCache local;
+        auto generation = registry().generation.load(std::memory_order_acquire);
+        if (local.generation != generation)
+        {
+            local.by_name[0].clear();
+            local.by_name[1].clear();
+            local.by_descriptor.clear();
+            local.generation = generation;
+        }
+        return local;
+    }
+};
+
+} // namespace detail
+} // namespace middleware
+} // namespace goby
+
+#endif
@@ -0,0 +1,160 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GOBY_MIDDLEWARE_MARSHALLING_DETAIL_PROTOBUF_ARENA_H
+#define GOBY_MIDDLEWARE_MARSHALLING_DETAIL_PROTOBUF_ARENA_H
+
+#include <cstddef> // for size_t
+#include <cstdint> // for uint64_t
+#include <memory>  // for shared_ptr, unique_ptr
+#include <mutex>   // for mutex, lock_guard
+#include <vector>  // for vector
+
+#include <google/protobuf/arena.h>
+
+namespace goby
+{
+namespace middleware
+{
+namespace detail
+{
+/// \brief Provides the google::protobuf::Arena that SerializerParserHelper<DataType, MarshallingScheme::PROTOBUF>::parse() allocates from while a ProtobufArenaScope is active on the calling thread.
+///
+/// Parsed messages are returned as aliasing std::shared_ptr that share ownership of the arena, so a message kept by a subscriber beyond its callback remains valid. At the end of each scope the pool releases its reference to the arena; once the last message is also released (typically immediately) the arena is reset and kept for reuse by a later scope. Each scope uses a new std::shared_ptr control block, so weak references to messages from a previous scope expire as usual.
+class ProtobufArenaPool
+{
+  public:
+    /// \brief Maximum number of reset arenas kept for reuse
+    static constexpr std::size_t max_spare_arenas{2};
+
+    /// \param start_block_size Size of the first block allocated by each arena
+    /// \param max_block_size Maximum size of subsequent blocks allocated by each arena
+    ProtobufArenaPool(std::size_t start_block_size = 4096, std::size_t max_block_size = 65536)
+        : spare_(std::make_shared<Spare>())
+    {
+        options_.start_block_size = start_block_size;
+        options_.max_block_size = max_block_size;
+    }
+
+    ProtobufArenaPool(const ProtobufArenaPool&) = delete;
+    ProtobufArenaPool& operator=(const ProtobufArenaPool&) = delete;
+
+    /// \return The pool active on this thread (set by ProtobufArenaScope), or nullptr if parsing should use the heap
+    static ProtobufArenaPool*& active()
+    {
+        static thread_local ProtobufArenaPool* active = nullptr;
+        return active;
+    }
+
+    /// \return The arena for the current scope (created or taken from the spares if necessary)
+    const std::shared_ptr<google::protobuf::Arena>& arena()
+    {
+        if (!arena_)
+        {
+            google::protobuf::Arena* arena = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(spare_->mutex);
+                if (!spare_->arenas.empty())
+                {
+                    arena = spare_->arenas.back().release();
+                    spare_->arenas.pop_back();
+                    ++reuses_;
+                }
+            }
+            if (!arena)
+                arena = new google::protobuf::Arena(options_);
+
+            // the last message released (possibly on another thread) resets the arena and returns it to the spares
+            std::shared_ptr<Spare> spare(spare_);
+            arena_ = std::shared_ptr<google::protobuf::Arena>(
+                arena, [spare](google::protobuf::Arena* a) {
+                    std::unique_ptr<google::protobuf::Arena> released(a);
+                    released->Reset();
+                    std::lock_guard<std::mutex> lock(spare->mutex);
+                    if (spare->arenas.size() < max_spare_arenas)
+                        spare->arenas.push_back(std::move(released));
+                });
+        }
+        return arena_;
+    }
+
+    /// \brief Release this pool's reference to the current arena (called at the end of each ProtobufArenaScope)
+    void recycle()
+    {
+        if (!arena_)
+            return;
+
+        if (arena_.use_count() > 1)
+            ++handoffs_;
+        arena_.reset();
+    }
+
+    /// \return number of times a previously used arena was reused
+    std::uint64_t reuses() const { return reuses_; }
+    /// \return number of times messages parsed into the arena were still in use at the end of a scope
+    std::uint64_t handoffs() const { return handoffs_; }
+
+  private:
+    struct Spare
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<google::protobuf::Arena>> arenas;
+    };
+
+    google::protobuf::ArenaOptions options_;
+    std::shared_ptr<Spare> spare_;
+    std::shared_ptr<google::protobuf::Arena> arena_;
+    std::uint64_t reuses_{0};
+    std::uint64_t handoffs_{0};
+};
+
+/// \brief Activates a ProtobufArenaPool on this thread for the lifetime of this object (e.g. a single poll of a transporter), recycling its arena on destruction. Scopes may be nested; a nullptr pool disables arena parsing within the scope.
+class ProtobufArenaScope
+{
+  public:
+    explicit ProtobufArenaScope(ProtobufArenaPool* pool)
+        : pool_(pool), previous_(ProtobufArenaPool::active())
+    {
+        ProtobufArenaPool::active() = pool_;
+    }
+
+    ~ProtobufArenaScope()
+    {
+        ProtobufArenaPool::active() = previous_;
+        if (pool_ && pool_ != previous_)
+            pool_->recycle();
+    }
+
+    ProtobufArenaScope(const ProtobufArenaScope&) = delete;
+    ProtobufArenaScope& operator=(const ProtobufArenaScope&) = delete;
+
+  private:
+    ProtobufArenaPool* pool_;
+    ProtobufArenaPool* previous_;
+};
+
+} // namespace detail
+} // namespace middleware
+} // namespace goby
+
+#endif
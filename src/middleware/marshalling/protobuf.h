@@ -29,6 +29,8 @@
 #include <dccl/dynamic_protobuf_manager.h>
 #include <google/protobuf/message.h>
 
+#include "goby/middleware/marshalling/detail/dynamic_protobuf_prototypes.h"
+#include "goby/middleware/marshalling/detail/protobuf_arena.h"
 #include "goby/middleware/protobuf/intervehicle.pb.h"
 
 #include "interface.h"
@@ -68,14 +70,28 @@ struct SerializerParserHelper<
     }
 
     /// \brief Parse Protobuf message (using standard Protobuf decoding)
+    ///
+    /// If a detail::ProtobufArenaScope is active on this thread, the message is allocated on its arena and the returned pointer shares ownership of that arena.
     template <typename CharIterator>
     static std::shared_ptr<DataType> parse(CharIterator bytes_begin, CharIterator bytes_end,
                                            CharIterator& actual_end,
                                            const std::string& type = type_name())
     {
-        auto msg = std::make_shared<DataType>();
+        std::shared_ptr<DataType> msg;
+        if (auto* pool = detail::ProtobufArenaPool::active())
+        {
+            const auto& arena = pool->arena();
+            msg = std::shared_ptr<DataType>(
+                arena, google::protobuf::Arena::Create<DataType>(arena.get()));
+        }
+        else
+        {
+            msg = std::make_shared<DataType>();
+        }
+
         msg->ParseFromArray(&*bytes_begin, bytes_end - bytes_begin);
-        actual_end = bytes_begin + msg->ByteSizeLong();
+        // the Protobuf encoding is not self-delimiting so the parser always consumes all the bytes it is given
+        actual_end = bytes_end;
         return msg;
     }
 };
@@ -107,7 +123,9 @@ template <> struct SerializerParserHelper<google::protobuf::Message, Marshalling
         return desc->full_name();
     }
 
-    /// \brief Parse Protobuf message (using standard Protobuf decoding) given the Protobuf type name and assuming the message descriptor is loaded into dccl::DynamicProtobufManage
+    /// \brief Parse Protobuf message (using standard Protobuf decoding) given the Protobuf type name and assuming the message descriptor is loaded into dccl::DynamicProtobufManager
+    ///
+    /// The message is created from a cached prototype (see detail::DynamicProtobufPrototypes), and allocated on the arena of the active detail::ProtobufArenaScope, if any.
     ///
     /// \tparam CharIterator an iterator to a container of bytes (char), e.g. std::vector<char>::iterator, or std::string::iterator
     /// \param bytes_begin Iterator to the beginning of a container of bytes
@@ -119,17 +137,23 @@ template <> struct SerializerParserHelper<google::protobuf::Message, Marshalling
     parse(CharIterator bytes_begin, CharIterator bytes_end, CharIterator& actual_end,
           const std::string& type, bool user_pool_first = false)
     {
-        std::shared_ptr<google::protobuf::Message> msg;
+        const auto& prototype =
+            detail::DynamicProtobufPrototypes::prototype(type, user_pool_first);
 
+        std::shared_ptr<google::protobuf::Message> msg;
+        if (auto* pool = detail::ProtobufArenaPool::active())
+        {
+            const auto& arena = pool->arena();
+            msg = std::shared_ptr<google::protobuf::Message>(arena, prototype.New(arena.get()));
+        }
+        else
         {
-            static std::mutex dynamic_protobuf_manager_mutex;
-            std::lock_guard<std::mutex> lock(dynamic_protobuf_manager_mutex);
-            msg = dccl::DynamicProtobufManager::new_protobuf_message<
-                std::shared_ptr<google::protobuf::Message>>(type, user_pool_first);
+            msg.reset(prototype.New());
         }
 
         msg->ParseFromArray(&*bytes_begin, bytes_end - bytes_begin);
-        actual_end = bytes_begin + msg->ByteSizeLong();
+        // the Protobuf encoding is not self-delimiting so the parser always consumes all the bytes it is given
+        actual_end = bytes_end;
         return msg;
     }
 };
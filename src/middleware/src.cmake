@@ -23,6 +23,7 @@ protobuf_generate_cpp(MIDDLEWARE_PROTO_SRCS MIDDLEWARE_PROTO_HDRS
   middleware/protobuf/pty_config.proto
   middleware/protobuf/navigation.proto
   middleware/protobuf/logger.proto
+  middleware/protobuf/log_index.proto
   )
 
 set(MIDDLEWARE_SRC
@@ -33,6 +34,12 @@ set(MIDDLEWARE_SRC
   middleware/application/configuration_reader.cpp
   middleware/application/tool.cpp
   middleware/log/log_entry.cpp
+  middleware/log/log_writer.cpp
+  middleware/log/log_index.cpp
+  middleware/log/log_reader.cpp
+  middleware/log/detail/crc32.cpp
+  middleware/log/compression.cpp
+  middleware/log/arrow/arrow.cpp
   middleware/frontseat/interface.cpp
   middleware/coroner/health_monitor_thread.cpp
   ${MIDDLEWARE_PROTO_SRCS} ${MIDDLEWARE_PROTO_HDRS} 
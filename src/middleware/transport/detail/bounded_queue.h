@@ -0,0 +1,149 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GOBY_MIDDLEWARE_TRANSPORT_DETAIL_BOUNDED_QUEUE_H
+#define GOBY_MIDDLEWARE_TRANSPORT_DETAIL_BOUNDED_QUEUE_H
+
+#include <algorithm> // for max
+#include <atomic>    // for atomic
+#include <cstddef>   // for size_t
+#include <cstdint>   // for intptr_t
+#include <memory>    // for unique_ptr
+
+namespace goby
+{
+namespace middleware
+{
+namespace detail
+{
+/// \brief Fixed capacity lock-free ring buffer (D. Vyukov's bounded MPMC array queue).
+///
+/// Any number of threads may call try_push() and try_pop() concurrently. Multiple consumers are supported so that producers may discard the oldest element (try_pop()) to make room when the queue is full.
+///
+/// \tparam T Element type (must be default constructible and move assignable)
+template <typename T> class BoundedQueue
+{
+  public:
+    /// \param capacity Maximum number of elements held (values less than 2 are treated as 2)
+    explicit BoundedQueue(std::size_t capacity)
+        : capacity_(std::max<std::size_t>(capacity, 2)), cells_(new Cell[capacity_])
+    {
+        for (std::size_t i = 0; i < capacity_; ++i)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /// \brief Push a value if there is room
+    ///
+    /// \param value Value to push. Moved from only if this function returns true.
+    /// \return true if the value was pushed, false if the queue was full
+    bool try_push(T& value)
+    {
+        Cell* cell;
+        std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cells_[pos % capacity_];
+            std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            std::intptr_t diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// \brief Pop the oldest value, if any
+    ///
+    /// \param value Set to the popped value if this function returns true
+    /// \return true if a value was popped, false if the queue was empty
+    bool try_pop(T& value)
+    {
+        Cell* cell;
+        std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cells_[pos % capacity_];
+            std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            std::intptr_t diff =
+                static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        value = std::move(cell->value);
+        // release anything (e.g. shared_ptr) still held by the moved-from cell
+        cell->value = T();
+        cell->sequence.store(pos + capacity_, std::memory_order_release);
+        return true;
+    }
+
+    /// \return Maximum number of elements that can be held
+    std::size_t capacity() const { return capacity_; }
+
+  private:
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence{0};
+        T value;
+    };
+
+    const std::size_t capacity_;
+    std::unique_ptr<Cell[]> cells_;
+
+    // keep producer and consumer positions on separate cache lines
+    alignas(64) std::atomic<std::size_t> enqueue_pos_{0};
+    alignas(64) std::atomic<std::size_t> dequeue_pos_{0};
+};
+
+} // namespace detail
+} // namespace middleware
+} // namespace goby
+
+#endif
@@ -0,0 +1,179 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GOBY_MIDDLEWARE_TRANSPORT_DETAIL_REGEX_MATCHER_H
+#define GOBY_MIDDLEWARE_TRANSPORT_DETAIL_REGEX_MATCHER_H
+
+#include <cctype>        // for isalnum
+#include <cstddef>       // for size_t
+#include <cstdint>       // for uint64_t
+#include <regex>         // for regex, regex_match
+#include <string>        // for string
+#include <unordered_map> // for unordered_map
+
+namespace goby
+{
+namespace middleware
+{
+namespace detail
+{
+/// \brief Full match (as std::regex_match) of strings against a regular expression, with fast paths for the common patterns ".*", literals, and literal prefixes followed by ".*", and memoization of the std::regex result for all other patterns.
+///
+/// As "." does not match line terminators (ECMAScript), the ".*" fast paths are not used for strings containing them.
+///
+/// Not thread-safe.
+class RegexMatcher
+{
+  public:
+    /// \brief Maximum number of memoized results before the cache is cleared (bounds memory if the matched strings are unbounded)
+    static constexpr std::size_t max_cache_size{10000};
+
+    explicit RegexMatcher(const std::string& pattern) { assign(pattern); }
+
+    /// \brief Change the pattern, invalidating all memoized results
+    void assign(const std::string& pattern)
+    {
+        cache_.clear();
+        regex_ = std::regex();
+        literal_.clear();
+
+        std::string body = pattern;
+        // ^ and $ are redundant for a full match
+        if (!body.empty() && body.front() == '^')
+            body.erase(0, 1);
+        if (!body.empty() && body.back() == '$' &&
+            (body.size() < 2 || body[body.size() - 2] != '\\'))
+            body.pop_back();
+
+        const std::string any(".*");
+        if (body == any)
+        {
+            kind_ = Kind::ANY;
+            regex_.assign(pattern);
+        }
+        else if (unescape_literal(body, &literal_))
+        {
+            kind_ = Kind::LITERAL;
+        }
+        else if (body.size() > any.size() &&
+                 body.compare(body.size() - any.size(), any.size(), any) == 0 &&
+                 unescape_literal(body.substr(0, body.size() - any.size()), &literal_))
+        {
+            kind_ = Kind::PREFIX;
+            regex_.assign(pattern);
+        }
+        else
+        {
+            kind_ = Kind::REGEX;
+            regex_.assign(pattern);
+        }
+    }
+
+    /// \return true if \c s fully matches the pattern
+    bool match(const std::string& s)
+    {
+        const bool has_line_terminator = s.find_first_of("\n\r") != std::string::npos;
+        switch (kind_)
+        {
+            case Kind::ANY:
+                if (has_line_terminator)
+                    break;
+                ++hits_;
+                return true;
+            case Kind::LITERAL: ++hits_; return s == literal_;
+            case Kind::PREFIX:
+                if (has_line_terminator && s.compare(0, literal_.size(), literal_) == 0)
+                    break;
+                ++hits_;
+                return s.compare(0, literal_.size(), literal_) == 0;
+            case Kind::REGEX: break;
+        }
+
+        auto it = cache_.find(s);
+        if (it != cache_.end())
+        {
+            ++hits_;
+            return it->second;
+        }
+
+        ++misses_;
+        if (cache_.size() >= max_cache_size)
+            cache_.clear();
+        bool result = std::regex_match(s, regex_);
+        cache_.insert(std::make_pair(s, result));
+        return result;
+    }
+
+    /// \return number of calls to match() answered without running std::regex_match
+    std::uint64_t hits() const { return hits_; }
+    /// \return number of calls to match() that ran std::regex_match
+    std::uint64_t misses() const { return misses_; }
+
+  private:
+    // if s only matches a single literal string, return true and set *literal to that string (e.g. "goby\.Foo" is the literal "goby.Foo", as produced by InterProcessTransporterBase::subscribe_type_regex)
+    static bool unescape_literal(const std::string& s, std::string* literal)
+    {
+        literal->clear();
+        for (std::string::size_type i = 0, n = s.size(); i < n; ++i)
+        {
+            char c = s[i];
+            if (c == '\\')
+            {
+                // escaped punctuation is literal, but escapes such as \d or \w are character classes
+                if (i + 1 == n || std::isalnum(static_cast<unsigned char>(s[i + 1])))
+                    return false;
+                literal->push_back(s[++i]);
+            }
+            else if (std::string("^$.|?*+()[]{}").find(c) != std::string::npos)
+            {
+                return false;
+            }
+            else
+            {
+                literal->push_back(c);
+            }
+        }
+        return true;
+    }
+
+  private:
+    enum class Kind
+    {
+        ANY,
+        LITERAL,
+        PREFIX,
+        REGEX
+    };
+    Kind kind_{Kind::REGEX};
+    std::string literal_;
+    std::regex regex_;
+    std::unordered_map<std::string, bool> cache_;
+    std::uint64_t hits_{0};
+    std::uint64_t misses_{0};
+};
+
+} // namespace detail
+} // namespace middleware
+} // namespace goby
+
+#endif
@@ -0,0 +1,194 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GOBY_MIDDLEWARE_TRANSPORT_DETAIL_SERIALIZATION_CACHE_H
+#define GOBY_MIDDLEWARE_TRANSPORT_DETAIL_SERIALIZATION_CACHE_H
+
+#include <array>         // for array
+#include <atomic>        // for atomic
+#include <cstddef>       // for size_t
+#include <cstdint>       // for uint64_t, uintptr_t
+#include <functional>    // for hash
+#include <memory>        // for shared_ptr, weak_ptr
+#include <mutex>         // for mutex, lock_guard
+#include <unordered_map> // for unordered_map
+#include <utility>       // for pair
+#include <vector>        // for vector
+
+#include "goby/middleware/marshalling/interface.h"
+
+namespace goby
+{
+namespace middleware
+{
+namespace detail
+{
+/// \brief Process-wide cache of the serialized bytes of published messages, keyed by the address of the (shared, const) message and the marshalling scheme, so that a message published several times (e.g. on multiple groups, or republished from another thread) is only serialized once per scheme.
+///
+/// Each entry holds a weak reference to the message, so entries never extend the life of a message and are discarded once it is destroyed (this also detects a new message allocated at the address of an old one). A message modified after it was cached (e.g. through a mutable alias) is not detected, so the cache is only used by transporters that opt in (InterProcessTransporterBase::set_serialization_cache()), and then only for messages published via std::shared_ptr<const Data>.
+class SerializationCache
+{
+  public:
+    using Bytes = std::vector<char>;
+
+    /// \brief Sweep a shard for expired entries after this many insertions
+    static constexpr std::size_t sweep_interval{64};
+    /// \brief Maximum number of entries in a shard (after sweeping) before it is cleared
+    static constexpr std::size_t max_shard_size{1024};
+
+    static SerializationCache& instance()
+    {
+        static SerializationCache cache;
+        return cache;
+    }
+
+    /// \brief Return the serialized bytes of \c data for the given scheme, serializing it only if it has not been serialized previously
+    template <typename Data, int scheme>
+    std::shared_ptr<const Bytes> serialize(const std::shared_ptr<const Data>& data)
+    {
+        const Key key(static_cast<const void*>(data.get()), scheme);
+        Shard& shard = shard_for(key);
+
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.entries.find(key);
+            if (it != shard.entries.end() && same_owner(it->second.owner, data))
+            {
+                ++hits_;
+                return it->second.bytes;
+            }
+        }
+
+        // serialize outside the lock: other threads serializing this same message concurrently is harmless
+        ++misses_;
+        auto bytes =
+            std::make_shared<const Bytes>(SerializerParserHelper<Data, scheme>::serialize(*data));
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (++shard.insertions % sweep_interval == 0)
+            sweep(shard);
+
+        Entry& entry = shard.entries[key];
+        entry.owner = data;
+        entry.bytes = bytes;
+        return bytes;
+    }
+
+    /// \return number of calls to serialize() that returned previously serialized bytes
+    std::uint64_t hits() const { return hits_; }
+    /// \return number of calls to serialize() that serialized the message
+    std::uint64_t misses() const { return misses_; }
+
+    /// \return number of entries currently held (including those for expired messages not yet swept)
+    std::size_t size()
+    {
+        std::size_t n = 0;
+        for (auto& shard : shards_)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            n += shard.entries.size();
+        }
+        return n;
+    }
+
+    /// \brief Remove all entries
+    void clear()
+    {
+        for (auto& shard : shards_)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.entries.clear();
+        }
+    }
+
+  private:
+    SerializationCache() = default;
+    SerializationCache(const SerializationCache&) = delete;
+    SerializationCache& operator=(const SerializationCache&) = delete;
+
+    using Key = std::pair<const void*, int>;
+
+    struct KeyHash
+    {
+        std::size_t operator()(const Key& key) const
+        {
+            return std::hash<const void*>()(key.first) ^
+                   (std::hash<int>()(key.second) * 0x9e3779b97f4a7c15ull);
+        }
+    };
+
+    struct Entry
+    {
+        std::weak_ptr<const void> owner;
+        std::shared_ptr<const Bytes> bytes;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<Key, Entry, KeyHash> entries;
+        std::size_t insertions{0};
+    };
+
+    // true if the (live) message referred to by owner shares its control block with data, i.e. it is the same message, not a new one at the same address
+    template <typename Data>
+    static bool same_owner(const std::weak_ptr<const void>& owner,
+                           const std::shared_ptr<const Data>& data)
+    {
+        return !owner.expired() && !owner.owner_before(data) && !data.owner_before(owner);
+    }
+
+    static void sweep(Shard& shard)
+    {
+        for (auto it = shard.entries.begin(); it != shard.entries.end();)
+        {
+            if (it->second.owner.expired())
+                it = shard.entries.erase(it);
+            else
+                ++it;
+        }
+
+        // bound memory if many long-lived messages are published
+        if (shard.entries.size() > max_shard_size)
+            shard.entries.clear();
+    }
+
+    Shard& shard_for(const Key& key)
+    {
+        // low bits of the address are zero due to alignment
+        auto address = reinterpret_cast<std::uintptr_t>(key.first);
+        return shards_[(address >> 4) % number_of_shards];
+    }
+
+  private:
+    static constexpr std::size_t number_of_shards{16};
+    std::array<Shard, number_of_shards> shards_;
+    std::atomic<std::uint64_t> hits_{0};
+    std::atomic<std::uint64_t> misses_{0};
+};
+
+} // namespace detail
+} // namespace middleware
+} // namespace goby
+
+#endif
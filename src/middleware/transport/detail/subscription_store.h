@@ -24,7 +24,9 @@
 #ifndef GOBY_MIDDLEWARE_TRANSPORT_DETAIL_SUBSCRIPTION_STORE_H
 #define GOBY_MIDDLEWARE_TRANSPORT_DETAIL_SUBSCRIPTION_STORE_H
 
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -35,6 +37,8 @@
 #include <unordered_map>
 #include <vector>
 
+#include "goby/middleware/protobuf/transporter_config.pb.h"
+#include "goby/middleware/transport/detail/bounded_queue.h"
 #include "goby/middleware/transport/publisher.h"
 
 namespace goby
@@ -130,7 +134,9 @@ template <typename Data> class SubscriptionStore : public SubscriptionStoreBase
     static void subscribe(std::function<void(std::shared_ptr<const Data>)> func, const Group& group,
                           std::thread::id thread_id, std::shared_ptr<std::mutex> data_mutex,
                           std::shared_ptr<std::condition_variable_any> cv,
-                          std::shared_ptr<std::timed_mutex> poller_mutex)
+                          std::shared_ptr<std::timed_mutex> poller_mutex,
+                          const protobuf::InterThreadTransporterConfig& cfg =
+                              protobuf::InterThreadTransporterConfig())
     {
         {
             std::lock_guard<std::shared_timed_mutex> lock(subscription_mutex_);
@@ -148,7 +154,7 @@ template <typename Data> class SubscriptionStore : public SubscriptionStoreBase
                 auto bool_it_pair = data_.insert(std::make_pair(thread_id, DataQueue()));
                 queue_it = bool_it_pair.first;
             }
-            queue_it->second.create(group);
+            queue_it->second.create(group, cfg);
 
             // if we don't have a condition variable already for this thread, store it
             if (!data_protection_.count(thread_id))
@@ -182,9 +188,10 @@ template <typename Data> class SubscriptionStore : public SubscriptionStoreBase
                 }
             }
 
-            // remove the dataqueue for this group
+            // remove the dataqueue for this group (if this thread ever subscribed)
             auto queue_it = data_.find(thread_id);
-            queue_it->second.remove(group);
+            if (queue_it != data_.end())
+                queue_it->second.remove(group);
         }
     }
 
@@ -194,6 +201,9 @@ template <typename Data> class SubscriptionStore : public SubscriptionStoreBase
         // push new data
         // build up local vector of relevant condition variables while locked
         std::vector<detail::DataProtection> cv_to_notify;
+        // bounded queues are lock-free, so they are written after releasing subscription_mutex_ (required for OverflowPolicy::BLOCK)
+        std::vector<std::pair<std::shared_ptr<GroupQueue>, detail::DataProtection>>
+            bounded_to_push;
         {
             std::shared_lock<std::shared_timed_mutex> lock(subscription_mutex_);
 
@@ -205,30 +215,49 @@ template <typename Data> class SubscriptionStore : public SubscriptionStoreBase
                 // don't store a copy if publisher == subscriber, and echo is false
                 if (thread_id != std::this_thread::get_id() || publisher.cfg().echo())
                 {
-                    // protect the DataQueue we are writing to
-                    std::unique_lock<std::mutex> lock(*(data_protection_.at(thread_id).data_mutex));
                     auto queue_it = data_.find(thread_id);
-                    queue_it->second.insert(group, data);
-                    cv_to_notify.push_back(data_protection_.at(thread_id));
+                    const auto& group_queue = queue_it->second.at(group);
+                    if (group_queue->is_bounded())
+                    {
+                        bounded_to_push.push_back(
+                            std::make_pair(group_queue, data_protection_.at(thread_id)));
+                    }
+                    else
+                    {
+                        // protect the DataQueue we are writing to
+                        std::unique_lock<std::mutex> lock(
+                            *(data_protection_.at(thread_id).data_mutex));
+                        group_queue->insert(data);
+                        cv_to_notify.push_back(data_protection_.at(thread_id));
+                    }
                 }
             }
         }
 
+        for (const auto& queue_protection_pair : bounded_to_push)
+        {
+            queue_protection_pair.first->insert_bounded(
+                data, [&]() { notify(queue_protection_pair.second); });
+            cv_to_notify.push_back(queue_protection_pair.second);
+        }
+
         // unlock and notify condition variables from local vector
-        for (const auto& data_protection : cv_to_notify)
+        for (const auto& data_protection : cv_to_notify) notify(data_protection);
+    }
+
+  private:
+    static void notify(const detail::DataProtection& data_protection)
+    {
         {
-            {
-                // lock to ensure the other thread isn't in the limbo region
-                // between _poll_all() and wait(), where the condition variable
-                // signal would be lost
+            // lock to ensure the other thread isn't in the limbo region
+            // between _poll_all() and wait(), where the condition variable
+            // signal would be lost
 
-                std::lock_guard<std::timed_mutex>(*data_protection.poller_mutex);
-            }
-            data_protection.poller_cv->notify_all();
+            std::lock_guard<std::timed_mutex>(*data_protection.poller_mutex);
         }
+        data_protection.poller_cv->notify_all();
     }
 
-  private:
     int poll(std::thread::id thread_id,
              std::unique_ptr<std::unique_lock<std::timed_mutex>>& lock) override
     {
@@ -248,10 +277,11 @@ template <typename Data> class SubscriptionStore : public SubscriptionStoreBase
                 *(data_protection_.find(thread_id)->second.data_mutex));
 
             // loop over all Groups stored in this DataQueue
-            for (auto data_it = queue_it->second.cbegin(), end = queue_it->second.cend();
+            for (auto data_it = queue_it->second.begin(), end = queue_it->second.end();
                  data_it != end; ++data_it)
             {
                 const Group& group = data_it->first;
+                const auto& queued = data_it->second->drain();
                 auto group_range = subscription_groups_.equal_range(group);
                 // For a given Group, loop over all subscriptions to this Group
                 for (auto group_it = group_range.first; group_it != group_range.second; ++group_it)
@@ -260,7 +290,7 @@ template <typename Data> class SubscriptionStore : public SubscriptionStoreBase
                         continue;
 
                     // store the callback function and datum for all the elements queued
-                    for (auto& datum : data_it->second)
+                    for (auto& datum : queued)
                     {
                         ++poll_items_count;
                         // we have data, no need to keep this lock any longer
@@ -270,7 +300,7 @@ template <typename Data> class SubscriptionStore : public SubscriptionStoreBase
                             std::make_pair(group_it->second->second.callback, datum));
                     }
                 }
-                queue_it->second.clear(group);
+                data_it->second->clear();
             }
         }
 
@@ -301,6 +331,9 @@ template <typename Data> class SubscriptionStore : public SubscriptionStoreBase
                 }
             }
 
+            auto queue_it = data_.find(thread_id);
+            if (queue_it != data_.end())
+                queue_it->second.remove_all();
             data_.erase(thread_id);
             data_protection_.erase(thread_id);
         }
@@ -318,28 +351,147 @@ template <typename Data> class SubscriptionStore : public SubscriptionStoreBase
         std::shared_ptr<CallbackType> callback;
     };
 
+    // data queued for a given thread and group
+    class GroupQueue
+    {
+      public:
+        GroupQueue(const protobuf::InterThreadTransporterConfig& cfg)
+            : policy_(cfg.overflow_policy())
+        {
+            if (cfg.max_queue() > 0)
+                bounded_.reset(new BoundedQueue<std::shared_ptr<const Data>>(cfg.max_queue()));
+        }
+
+        bool is_bounded() const { return bool(bounded_); }
+
+        // requires data_mutex
+        void insert(std::shared_ptr<const Data> datum) { data_.push_back(std::move(datum)); }
+
+        // lock-free unless blocked: applies the overflow policy if the queue is full, calling wake_func (to wake the subscriber) before blocking
+        template <typename WakeFunc>
+        void insert_bounded(std::shared_ptr<const Data> datum, WakeFunc wake_func)
+        {
+            while (true)
+            {
+                // read before trying so that a drain() between the failed push and the wait isn't missed
+                std::uint64_t drains = 0;
+                if (policy_ == protobuf::InterThreadTransporterConfig::BLOCK)
+                {
+                    std::lock_guard<std::mutex> lock(space_mutex_);
+                    drains = drains_;
+                }
+
+                if (bounded_->try_push(datum))
+                    return;
+
+                switch (policy_)
+                {
+                    case protobuf::InterThreadTransporterConfig::DROP_OLDEST:
+                    {
+                        std::shared_ptr<const Data> oldest;
+                        bounded_->try_pop(oldest);
+                        break;
+                    }
+                    case protobuf::InterThreadTransporterConfig::DROP_NEWEST: return;
+                    case protobuf::InterThreadTransporterConfig::BLOCK:
+                    {
+                        wake_func();
+                        std::unique_lock<std::mutex> lock(space_mutex_);
+                        // subscriber has gone away, so no one will make room
+                        space_cv_.wait(lock, [&]() { return closed_ || drains_ != drains; });
+                        if (closed_)
+                            return;
+                        break;
+                    }
+                }
+            }
+        }
+
+        // requires data_mutex: moves any data in the bounded queue into the vector and returns it
+        const std::vector<std::shared_ptr<const Data>>& drain()
+        {
+            if (bounded_)
+            {
+                std::shared_ptr<const Data> datum;
+                bool popped = false;
+                while (bounded_->try_pop(datum))
+                {
+                    data_.push_back(std::move(datum));
+                    popped = true;
+                }
+
+                // release publishers blocked on a full queue
+                if (popped && policy_ == protobuf::InterThreadTransporterConfig::BLOCK)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(space_mutex_);
+                        ++drains_;
+                    }
+                    space_cv_.notify_all();
+                }
+            }
+            return data_;
+        }
+
+        // requires data_mutex
+        void clear() { data_.clear(); }
+
+        // called on unsubscribe to release any publishers blocked on this queue
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(space_mutex_);
+                closed_ = true;
+            }
+            space_cv_.notify_all();
+        }
+
+      private:
+        std::vector<std::shared_ptr<const Data>> data_;
+        std::unique_ptr<BoundedQueue<std::shared_ptr<const Data>>> bounded_;
+        protobuf::InterThreadTransporterConfig::OverflowPolicy policy_;
+        std::atomic<bool> closed_{false};
+
+        // BLOCK policy: signaled by drain() and close()
+        std::mutex space_mutex_;
+        std::condition_variable space_cv_;
+        // number of drain() calls that made room
+        std::uint64_t drains_{0};
+    };
+
     class DataQueue
     {
       private:
-        std::unordered_map<Group, std::vector<std::shared_ptr<const Data>>> data_;
+        // shared_ptr so that bounded queues can be written by publishers outside the subscription_mutex_ lock
+        std::unordered_map<Group, std::shared_ptr<GroupQueue>> data_;
 
       public:
-        void create(const Group& g)
+        // the first subscription to a given group on a thread determines the queue configuration
+        void create(const Group& g, const protobuf::InterThreadTransporterConfig& cfg)
         {
             auto it = data_.find(g);
             if (it == data_.end())
-                data_.insert(std::make_pair(g, std::vector<std::shared_ptr<const Data>>()));
+                data_.insert(std::make_pair(g, std::make_shared<GroupQueue>(cfg)));
         }
-        void remove(const Group& g) { data_.erase(g); }
-
-        void insert(const Group& g, std::shared_ptr<const Data> datum)
+        void remove(const Group& g)
+        {
+            auto it = data_.find(g);
+            if (it != data_.end())
+            {
+                it->second->close();
+                data_.erase(it);
+            }
+        }
+        void remove_all()
         {
-            data_.find(g)->second.push_back(datum);
+            for (auto& group_queue_pair : data_) group_queue_pair.second->close();
+            data_.clear();
         }
-        void clear(const Group& g) { data_.find(g)->second.clear(); }
+
+        const std::shared_ptr<GroupQueue>& at(const Group& g) { return data_.find(g)->second; }
         bool empty() { return data_.empty(); }
-        typename decltype(data_)::const_iterator cbegin() { return data_.begin(); }
-        typename decltype(data_)::const_iterator cend() { return data_.end(); }
+        typename decltype(data_)::iterator begin() { return data_.begin(); }
+        typename decltype(data_)::iterator end() { return data_.end(); }
     };
 
     // subscriptions for a given thread
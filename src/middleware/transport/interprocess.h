@@ -31,10 +31,13 @@
 #include <thread>
 #include <tuple>
 #include <unistd.h>
+#include <utility>
 
 #include "goby/middleware/group.h"
 
 #include "goby/middleware/marshalling/interface.h"
+#include "goby/middleware/protobuf/serializer_transporter.pb.h"
+#include "goby/middleware/transport/detail/serialization_cache.h"
 #include "goby/middleware/transport/null.h"
 #include "goby/middleware/transport/poller.h"
 #include "goby/middleware/transport/serialization_handlers.h"
@@ -43,6 +46,35 @@ namespace goby
 {
 namespace middleware
 {
+namespace detail
+{
+/// \brief Publication forwarded from an InterProcessForwarder to the InterProcessPortal. The serialized bytes are shared (e.g. with the SerializationCache) rather than copied into a protobuf::SerializerTransporterMessage.
+struct SerializedPublication
+{
+    protobuf::SerializerTransporterKey key;
+    std::shared_ptr<const std::vector<char>> bytes;
+};
+
+inline SerializedPublication
+make_serialized_publication(const protobuf::SerializerTransporterMessage& msg)
+{
+    SerializedPublication publication;
+    publication.key = msg.key();
+    publication.bytes = std::make_shared<const std::vector<char>>(msg.data().begin(),
+                                                                  msg.data().end());
+    return publication;
+}
+
+inline protobuf::SerializerTransporterMessage
+make_serializer_transporter_message(const SerializedPublication& publication)
+{
+    protobuf::SerializerTransporterMessage msg;
+    *msg.mutable_key() = publication.key;
+    msg.set_data(std::string(publication.bytes->begin(), publication.bytes->end()));
+    return msg;
+}
+} // namespace detail
+
 /// \brief Base class for implementing transporters (both portal and forwarder) for the interprocess layer
 ///
 /// \tparam Derived derived class (curiously recurring template pattern)
@@ -99,6 +131,7 @@ class InterProcessTransporterBase
 
     /// \brief Publish a message using a run-time defined DynamicGroup (shared pointer to const data variant). Where possible, prefer the static variant in StaticTransporterInterface::publish()
     ///
+    /// If enabled with set_serialization_cache(), the serialized message is cached for as long as \c data exists, so publishing the same message again (on any group) does not serialize it again.
     /// \tparam Data data type to publish. Can usually be inferred from the \c data parameter.
     /// \tparam scheme Marshalling scheme id (typically MarshallingScheme::MarshallingSchemeEnum). Can usually be inferred from the Data type.
     /// \param data Message to publish
@@ -111,7 +144,7 @@ class InterProcessTransporterBase
         if (data)
         {
             check_validity_runtime(group);
-            static_cast<Derived*>(this)->template _publish<Data, scheme>(*data, group, publisher);
+            _publish_shared<Data, scheme>(data, group, publisher, 0);
             this->inner().template publish_dynamic<Data, scheme>(data, group, publisher);
         }
     }
@@ -127,7 +160,14 @@ class InterProcessTransporterBase
     void publish_dynamic(std::shared_ptr<Data> data, const Group& group,
                          const Publisher<Data>& publisher = Publisher<Data>())
     {
-        publish_dynamic<Data, scheme>(std::shared_ptr<const Data>(data), group, publisher);
+        // mutable data may be modified and republished, so bypass the serialization cache
+        if (data)
+        {
+            check_validity_runtime(group);
+            static_cast<Derived*>(this)->template _publish<Data, scheme>(*data, group, publisher);
+            this->inner().template publish_dynamic<Data, scheme>(
+                std::shared_ptr<const Data>(data), group, publisher);
+        }
     }
 
     /// \brief Publish a message that has already been serialized for the given scheme
@@ -266,17 +306,51 @@ class InterProcessTransporterBase
             throw(goby::Exception("Group must have a non-empty string for use on InterProcess"));
     }
 
+    /// \brief Enable (or disable) the detail::SerializationCache for publications of std::shared_ptr<const Data> from this transporter (disabled by default)
+    ///
+    /// Only enable this if messages are never modified (through any alias) after they are published, as the cached bytes are found using the address of the message. The bytes are kept until the message is destroyed.
+    void set_serialization_cache(bool enable) { use_serialization_cache_ = enable; }
+    bool serialization_cache() const { return use_serialization_cache_; }
+
   protected:
     static constexpr Group to_portal_group_{"goby::middleware::interprocess::to_portal"};
     static constexpr Group regex_group_{"goby::middleware::interprocess::regex"};
     static constexpr Group from_portal_group_{"goby::middleware::interprocess::from_portal"};
 
+  private:
+    // used if Derived implements _publish_encoded (publication of bytes that may be shared)
+    template <typename Data, int scheme, typename D = Derived>
+    auto _publish_shared(const std::shared_ptr<const Data>& data, const Group& group,
+                         const Publisher<Data>& publisher, int)
+        -> decltype(std::declval<D&>().template _publish_encoded<Data, scheme>(
+                        *data, std::shared_ptr<const std::vector<char>>(), group, publisher),
+                    void())
+    {
+        auto bytes =
+            use_serialization_cache_
+                ? detail::SerializationCache::instance().template serialize<Data, scheme>(data)
+                : std::make_shared<const std::vector<char>>(
+                      SerializerParserHelper<Data, scheme>::serialize(*data));
+        static_cast<D*>(this)->template _publish_encoded<Data, scheme>(*data, bytes, group,
+                                                                       publisher);
+    }
+
+    // otherwise (e.g. InterModuleForwarder)
+    template <typename Data, int scheme>
+    void _publish_shared(const std::shared_ptr<const Data>& data, const Group& group,
+                         const Publisher<Data>& publisher, long)
+    {
+        static_cast<Derived*>(this)->template _publish<Data, scheme>(*data, group, publisher);
+    }
+
   private:
     friend PollerType;
     int _poll(std::unique_ptr<std::unique_lock<std::timed_mutex>>& lock)
     {
         return static_cast<Derived*>(this)->_poll(lock);
     }
+
+    bool use_serialization_cache_{false};
 };
 
 template <typename Derived, typename InnerTransporter>
@@ -327,34 +401,44 @@ class InterProcessForwarder
     template <typename Data, int scheme>
     void _publish(const Data& d, const Group& group, const Publisher<Data>& publisher)
     {
-        // create and forward publication to edge
-        std::vector<char> bytes(SerializerParserHelper<Data, scheme>::serialize(d));
-        std::string* sbytes = new std::string(bytes.begin(), bytes.end());
-        auto msg = std::make_shared<goby::middleware::protobuf::SerializerTransporterMessage>();
-        auto* key = msg->mutable_key();
+        _publish_encoded<Data, scheme>(
+            d,
+            std::make_shared<const std::vector<char>>(
+                SerializerParserHelper<Data, scheme>::serialize(d)),
+            group, publisher);
+    }
+
+    template <typename Data, int scheme>
+    void _publish_encoded(const Data& d, std::shared_ptr<const std::vector<char>> bytes,
+                          const Group& group, const Publisher<Data>& publisher)
+    {
+        // forward publication to edge, sharing (not copying) the serialized bytes
+        auto msg = std::make_shared<detail::SerializedPublication>();
+        auto* key = &msg->key;
 
         key->set_marshalling_scheme(scheme);
         key->set_type(SerializerParserHelper<Data, scheme>::type_name(d));
         key->set_group(std::string(group));
-        msg->set_allocated_data(sbytes);
-
         *key->mutable_cfg() = publisher.cfg();
+        msg->bytes = std::move(bytes);
 
-        this->inner().template publish<Base::to_portal_group_>(msg);
+        this->inner().template publish<Base::to_portal_group_>(
+            std::shared_ptr<const detail::SerializedPublication>(msg));
     }
 
     void _publish_serialized(std::string type_name, int scheme, const std::vector<char>& bytes,
                              const goby::middleware::Group& group)
     {
-        auto msg = std::make_shared<goby::middleware::protobuf::SerializerTransporterMessage>();
-        auto* key = msg->mutable_key();
+        auto msg = std::make_shared<detail::SerializedPublication>();
+        auto* key = &msg->key;
 
         key->set_marshalling_scheme(scheme);
         key->set_type(type_name);
         key->set_group(std::string(group));
-        msg->set_data(std::string(bytes.begin(), bytes.end()));
+        msg->bytes = std::make_shared<const std::vector<char>>(bytes);
 
-        this->inner().template publish<Base::to_portal_group_>(msg);
+        this->inner().template publish<Base::to_portal_group_>(
+            std::shared_ptr<const detail::SerializedPublication>(msg));
     }
 
     template <typename Data, int scheme>
@@ -457,12 +541,19 @@ class InterProcessPortalBase : public InterProcessTransporterBase<Derived, Inner
   private:
     void _init()
     {
-        using goby::middleware::protobuf::SerializerTransporterMessage;
-        this->inner().template subscribe<Base::to_portal_group_, SerializerTransporterMessage>(
-            [this](std::shared_ptr<const SerializerTransporterMessage> d) {
-                static_cast<Derived*>(this)->_receive_publication_forwarded(*d);
+        this->inner().template subscribe<Base::to_portal_group_, detail::SerializedPublication>(
+            [this](std::shared_ptr<const detail::SerializedPublication> d) {
+                _dispatch_publication_forwarded(static_cast<Derived*>(this), *d, 0);
             });
 
+        // publications forwarded as protobuf::SerializerTransporterMessage (the previous message type on this group)
+        this->inner()
+            .template subscribe<Base::to_portal_group_,
+                                goby::middleware::protobuf::SerializerTransporterMessage>(
+                [this](
+                    std::shared_ptr<const goby::middleware::protobuf::SerializerTransporterMessage>
+                        d) { _dispatch_publication_forwarded(static_cast<Derived*>(this), *d, 0); });
+
         this->inner().template subscribe<Base::to_portal_group_, SerializationHandlerBase<>>(
             [this](std::shared_ptr<const middleware::SerializationHandlerBase<>> s) {
                 static_cast<Derived*>(this)->_receive_subscription_forwarded(s);
@@ -478,6 +569,28 @@ class InterProcessPortalBase : public InterProcessTransporterBase<Derived, Inner
                 static_cast<Derived*>(this)->_unsubscribe_all(s->subscriber_id());
             });
     }
+
+    // Derived::_receive_publication_forwarded() takes either message type: portals written before detail::SerializedPublication only implement the protobuf::SerializerTransporterMessage overload, so convert if needed
+    template <typename Portal, typename Publication>
+    static auto _dispatch_publication_forwarded(Portal* portal, const Publication& publication, int)
+        -> decltype(portal->_receive_publication_forwarded(publication), void())
+    {
+        portal->_receive_publication_forwarded(publication);
+    }
+    template <typename Portal>
+    static void _dispatch_publication_forwarded(Portal* portal,
+                                               const detail::SerializedPublication& publication,
+                                               long)
+    {
+        portal->_receive_publication_forwarded(
+            detail::make_serializer_transporter_message(publication));
+    }
+    template <typename Portal>
+    static void _dispatch_publication_forwarded(
+        Portal* portal, const goby::middleware::protobuf::SerializerTransporterMessage& msg, long)
+    {
+        portal->_receive_publication_forwarded(detail::make_serialized_publication(msg));
+    }
 };
 
 } // namespace middleware
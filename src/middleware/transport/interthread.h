@@ -147,15 +147,16 @@ class InterThreadTransporter
     /// \tparam scheme Marshalling scheme id (typically MarshallingScheme::MarshallingSchemeEnum). Can usually be inferred from the Data type.
     /// \param f Callback function or lambda that is called upon receipt of the subscribed data
     /// \param group group to subscribe to (typically a DynamicGroup)
+    /// \param subscriber Optional metadata: Subscriber::cfg().interthread() can bound the queue of undelivered messages for this thread (unbounded by default)
     template <typename Data, int scheme = scheme<Data>()>
     void subscribe_dynamic(std::function<void(const Data&)> f, const Group& group,
-                           const Subscriber<Data>& /*subscriber*/ = Subscriber<Data>())
+                           const Subscriber<Data>& subscriber = Subscriber<Data>())
     {
         check_validity_runtime(group);
-        detail::SubscriptionStore<Data>::subscribe([=](std::shared_ptr<const Data> pd) { f(*pd); },
-                                                   group, std::this_thread::get_id(), data_mutex_,
-                                                   Poller<InterThreadTransporter>::cv(),
-                                                   Poller<InterThreadTransporter>::poll_mutex());
+        detail::SubscriptionStore<Data>::subscribe(
+            [=](std::shared_ptr<const Data> pd) { f(*pd); }, group, std::this_thread::get_id(),
+            data_mutex_, Poller<InterThreadTransporter>::cv(),
+            Poller<InterThreadTransporter>::poll_mutex(), subscriber.cfg().interthread());
     }
 
     /// \brief Subscribe to a specific run-time defined group and data type (shared pointer variant). Where possible, prefer the static variant in StaticTransporterInterface::subscribe()
@@ -164,14 +165,15 @@ class InterThreadTransporter
     /// \tparam scheme Marshalling scheme id (typically MarshallingScheme::MarshallingSchemeEnum). Can usually be inferred from the Data type.
     /// \param f Callback function or lambda that is called upon receipt of the subscribed data
     /// \param group group to subscribe to (typically a DynamicGroup)
+    /// \param subscriber Optional metadata: Subscriber::cfg().interthread() can bound the queue of undelivered messages for this thread (unbounded by default)
     template <typename Data, int scheme = scheme<Data>()>
     void subscribe_dynamic(std::function<void(std::shared_ptr<const Data>)> f, const Group& group,
-                           const Subscriber<Data>& /*subscriber*/ = Subscriber<Data>())
+                           const Subscriber<Data>& subscriber = Subscriber<Data>())
     {
         check_validity_runtime(group);
         detail::SubscriptionStore<Data>::subscribe(
             f, group, std::this_thread::get_id(), data_mutex_, Poller<InterThreadTransporter>::cv(),
-            Poller<InterThreadTransporter>::poll_mutex());
+            Poller<InterThreadTransporter>::poll_mutex(), subscriber.cfg().interthread());
     }
 
     /// \brief Subscribe with no data (used to receive a signal from another thread)
@@ -134,6 +134,18 @@ goby::middleware::intervehicle::ModemDriverThread::ModemDriverThread(
           cfg().modem_report_interval_with_units()))
 {
     goby::glog.add_group(glog_group_, util::Colors::blue);
+    frame_packing_report_.set_link_modem_id(cfg().modem_id());
+    frame_packing_report_.set_strategy(cfg().frame_packing().strategy());
+
+    if (cfg().has_spill())
+    {
+        goby::acomms::DynamicBuffer<buffer_data_type>::SpillConfig spill_cfg;
+        spill_cfg.directory = cfg().spill().directory();
+        spill_cfg.memory_budget = cfg().spill().memory_budget();
+        spill_cfg.segment_bytes = cfg().spill().segment_size();
+        buffer_.enable_spill(spill_cfg);
+    }
+
     interthread_ = std::make_unique<InterThreadTransporter>();
     interprocess_ = std::make_unique<InterProcessForwarder<InterThreadTransporter>>(*interthread_);
     this->set_transporter(interprocess_.get());
@@ -326,6 +338,13 @@ void goby::middleware::intervehicle::ModemDriverThread::loop()
         report_with_id.set_link_modem_id(cfg().modem_id());
         driver_->report(report_with_id.mutable_data());
         interprocess_->publish<groups::modem_report>(report_with_id);
+
+        if (frame_packing_report_.bytes_available() > 0)
+            frame_packing_report_.set_efficiency(
+                static_cast<double>(frame_packing_report_.bytes_used()) /
+                frame_packing_report_.bytes_available());
+        interprocess_->publish<groups::frame_packing_report>(frame_packing_report_);
+
         next_modem_report_time_ += modem_report_interval_;
     }
 }
@@ -414,43 +433,69 @@ void goby::middleware::intervehicle::ModemDriverThread::_data_request(
     }
 
     int dest = msg->dest();
+    auto ack_timeout =
+        goby::time::convert_duration<std::chrono::microseconds>(cfg().ack_timeout_with_units());
+
+    const auto& packing_cfg = cfg().frame_packing();
+    bool knapsack = packing_cfg.strategy() ==
+                    intervehicle::protobuf::PortalConfig::LinkConfig::FramePacking::KNAPSACK;
+    goby::acomms::DynamicBuffer<buffer_data_type>::Packing packing;
+    if (knapsack)
+    {
+        goby::acomms::DynamicBuffer<buffer_data_type>::PackingBudget budget;
+        budget.max_candidates = packing_cfg.max_candidates();
+        budget.max_cells = packing_cfg.max_cells();
+        packing = buffer_.pack(dest, msg->max_frame_bytes(), msg->max_num_frames(), ack_timeout,
+                               budget);
+        frame_packing_report_.set_greedy_frames(frame_packing_report_.greedy_frames() +
+                                                packing.greedy_frames);
+    }
+    frame_packing_report_.set_transmissions(frame_packing_report_.transmissions() + 1);
+
     for (auto frame_number = msg->frame_start(),
               total_frames = msg->max_num_frames() + msg->frame_start();
          frame_number < total_frames; ++frame_number)
     {
         std::string* frame = msg->add_frame();
 
-        while (frame->size() < msg->max_frame_bytes())
+        auto buffer_values =
+            knapsack ? std::move(packing.frames.at(frame_number - msg->frame_start()))
+                     : buffer_.fill(dest, msg->max_frame_bytes(), ack_timeout);
+
+        if (buffer_values.empty())
+        {
+            glog.is_debug1() && glog << group(glog_group_) << "No data for frame " << frame_number
+                                     << std::endl;
+            continue;
+        }
+
+        for (const auto& buffer_value : buffer_values)
         {
-            try
+            dest = buffer_value.modem_id;
+            *frame += buffer_value.data.data();
+
+            bool ack_required = buffer_.sub(buffer_value.modem_id, buffer_value.subbuffer_id)
+                                    .cfg()
+                                    .ack_required();
+
+            if (!ack_required)
             {
-                auto buffer_value =
-                    buffer_.top(dest, msg->max_frame_bytes() - frame->size(),
-                                goby::time::convert_duration<std::chrono::microseconds>(
-                                    cfg().ack_timeout_with_units()));
-                dest = buffer_value.modem_id;
-                *frame += buffer_value.data.data();
-
-                bool ack_required = buffer_.sub(buffer_value.modem_id, buffer_value.subbuffer_id)
-                                        .cfg()
-                                        .ack_required();
-
-                if (!ack_required)
-                {
-                    buffer_.erase(buffer_value);
-                }
-                else
-                {
-                    msg->set_ack_requested(true);
-                    pending_ack_[frame_number].push_back(buffer_value);
-                }
+                buffer_.erase(buffer_value);
             }
-            catch (goby::acomms::DynamicBufferNoDataException& e)
+            else
             {
-                glog.is_debug1() && glog << group(glog_group_) << e.what() << std::endl;
-                break;
+                msg->set_ack_requested(true);
+                pending_ack_[frame_number].push_back(buffer_value);
             }
         }
+
+        frame_packing_report_.set_frames(frame_packing_report_.frames() + 1);
+        frame_packing_report_.set_bytes_used(frame_packing_report_.bytes_used() + frame->size());
+        frame_packing_report_.set_bytes_available(frame_packing_report_.bytes_available() +
+                                                  msg->max_frame_bytes());
+        glog.is_debug1() && glog << group(glog_group_) << "Frame " << frame_number << ": "
+                                 << frame->size() << "/" << msg->max_frame_bytes() << " bytes"
+                                 << std::endl;
     }
 
     if (!msg->has_ack_requested())
@@ -72,6 +72,16 @@ namespace protobuf
 {
 inline size_t data_size(const SerializerTransporterMessage& msg) { return msg.data().size(); }
 
+inline std::string spill_serialize(const SerializerTransporterMessage& msg)
+{
+    return msg.SerializeAsString();
+}
+
+inline void spill_parse(const std::string& bytes, SerializerTransporterMessage* msg)
+{
+    msg->ParseFromString(bytes);
+}
+
 inline bool operator==(const SerializerTransporterMessage& a, const SerializerTransporterMessage& b)
 {
     return (a.key().serialize_time() == b.key().serialize_time() &&
@@ -220,6 +230,8 @@ class ModemDriverThread
 
     goby::time::SteadyClock::time_point next_modem_report_time_;
     const goby::time::SteadyClock::duration modem_report_interval_;
+
+    intervehicle::protobuf::FramePackingReport frame_packing_report_;
 };
 
 } // namespace intervehicle
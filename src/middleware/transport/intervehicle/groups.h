@@ -63,6 +63,7 @@ constexpr Group modem_raw_outgoing{"goby::middleware::intervehicle::modem_raw_ou
 
 // from calling ModemDriverBase::report()
 constexpr Group modem_report{"goby::middleware::intervehicle::modem_report"};
+constexpr Group frame_packing_report{"goby::middleware::intervehicle::frame_packing_report"};
 
 // direct connection to MACManager signals
 constexpr Group mac_initiate_transmission{
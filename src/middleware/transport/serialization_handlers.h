@@ -27,7 +27,7 @@
 
 #include <chrono>
 #include <memory>
-#include <regex>
+#include <mutex>
 #include <thread>
 #include <unordered_map>
 
@@ -39,6 +39,7 @@
 #include "goby/middleware/protobuf/intervehicle.pb.h"
 #include "goby/middleware/protobuf/serializer_transporter.pb.h"
 
+#include "detail/regex_matcher.h"
 #include "interface.h"
 #include "null.h"
 
@@ -404,8 +405,16 @@ class SerializationSubscriptionRegex
     {
     }
 
-    void update_type_regex(const std::string& type_regex) { type_regex_.assign(type_regex); }
-    void update_group_regex(const std::string& group_regex) { group_regex_.assign(group_regex); }
+    void update_type_regex(const std::string& type_regex)
+    {
+        std::lock_guard<std::mutex> lock(regex_mutex_);
+        type_regex_.assign(type_regex);
+    }
+    void update_group_regex(const std::string& group_regex)
+    {
+        std::lock_guard<std::mutex> lock(regex_mutex_);
+        group_regex_.assign(group_regex);
+    }
 
     // handle an incoming message
     // return true if posted
@@ -415,7 +424,7 @@ class SerializationSubscriptionRegex
     {
         if ((schemes_.count(goby::middleware::MarshallingScheme::ALL_SCHEMES) ||
              schemes_.count(scheme)) &&
-            std::regex_match(type, type_regex_) && std::regex_match(group, group_regex_))
+            matches(type, group))
         {
             std::vector<unsigned char> data(bytes_begin, bytes_end);
             handler_(data, scheme, type, goby::middleware::DynamicGroup(group));
@@ -430,11 +439,42 @@ class SerializationSubscriptionRegex
     std::thread::id thread_id() const { return thread_id_; }
     std::string subscriber_id() const { return subscriber_id_; }
 
+    /// \return Number of type and group matches answered without evaluating a std::regex (fast path or memoized result)
+    std::uint64_t match_cache_hits() const
+    {
+        std::lock_guard<std::mutex> lock(regex_mutex_);
+        return type_regex_.hits() + group_regex_.hits();
+    }
+    /// \return Number of type and group matches that required evaluating a std::regex
+    std::uint64_t match_cache_misses() const
+    {
+        std::lock_guard<std::mutex> lock(regex_mutex_);
+        return type_regex_.misses() + group_regex_.misses();
+    }
+    /// \return Fraction of type and group matches answered without evaluating a std::regex
+    double match_cache_hit_rate() const
+    {
+        std::lock_guard<std::mutex> lock(regex_mutex_);
+        auto hits = type_regex_.hits() + group_regex_.hits();
+        auto total = hits + type_regex_.misses() + group_regex_.misses();
+        return total ? static_cast<double>(hits) / total : 0;
+    }
+
+  private:
+    // the result only depends on type and group (not scheme), so these are memoized independently
+    bool matches(const std::string& type, const std::string& group) const
+    {
+        std::lock_guard<std::mutex> lock(regex_mutex_);
+        return type_regex_.match(type) && group_regex_.match(group);
+    }
+
   private:
     HandlerType handler_;
     const std::set<int> schemes_;
-    std::regex type_regex_;
-    std::regex group_regex_;
+    // guards the matchers, as the regex may be updated by the subscribing thread while another thread posts
+    mutable std::mutex regex_mutex_;
+    mutable detail::RegexMatcher type_regex_;
+    mutable detail::RegexMatcher group_regex_;
     const std::thread::id thread_id_{std::this_thread::get_id()};
     const std::string subscriber_id_{goby::middleware::thread_id(thread_id_)};
 };
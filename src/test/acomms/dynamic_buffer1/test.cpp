@@ -710,3 +710,477 @@ BOOST_FIXTURE_TEST_CASE(check_multiframe_size, DynamicBufferFixture)
     BOOST_CHECK_EQUAL(msg.frame(0).size(), 29 + 138);
     BOOST_CHECK_EQUAL(msg.frame(0), std::string(29, 'C') + std::string(138, 'B'));
 }
+
+BOOST_FIXTURE_TEST_CASE(check_try_top, DynamicBufferFixture)
+{
+    BOOST_CHECK(!buffer.try_top());
+    BOOST_CHECK(!buffer.try_top(3));
+    BOOST_CHECK(!buffer.sub(goby::acomms::BROADCAST_ID, "A").try_top());
+
+    buffer.push({goby::acomms::BROADCAST_ID, "A", TestClock::now(), "1234567890"});
+
+    TestClock::increment(std::chrono::milliseconds(1));
+    BOOST_CHECK(!buffer.try_top(goby::acomms::BROADCAST_ID, 3));
+    auto vp = buffer.try_top(goby::acomms::BROADCAST_ID, 15, std::chrono::milliseconds(10));
+    BOOST_REQUIRE(vp);
+    BOOST_CHECK_EQUAL(vp->subbuffer_id, "A");
+    BOOST_CHECK_EQUAL(vp->data, "1234567890");
+
+    // waiting for ack
+    TestClock::increment(std::chrono::milliseconds(1));
+    BOOST_CHECK(!buffer.try_top(goby::acomms::BROADCAST_ID, 15, std::chrono::milliseconds(10)));
+    BOOST_CHECK(!buffer.sub(goby::acomms::BROADCAST_ID, "A")
+                     .try_top(TestClock::now(), std::chrono::milliseconds(10)));
+}
+
+BOOST_FIXTURE_TEST_CASE(check_fill, DynamicBufferFixture)
+{
+    auto now = TestClock::now();
+
+    goby::acomms::protobuf::DynamicBufferConfig cfg =
+        buffer.sub(goby::acomms::BROADCAST_ID, "A").cfg();
+    cfg.set_max_queue(3);
+    buffer.replace(goby::acomms::BROADCAST_ID, "A", cfg);
+
+    buffer.push({goby::acomms::BROADCAST_ID, "A", now, std::string(133, 'A')});
+    buffer.push({goby::acomms::BROADCAST_ID, "A", now, std::string(138, 'B')});
+    buffer.push({goby::acomms::BROADCAST_ID, "A", now, std::string(29, 'C')});
+    buffer.push({goby::acomms::BROADCAST_ID, "B", now, std::string(50, 'D')});
+    buffer.push({goby::acomms::BROADCAST_ID, "B", now, std::string(90, 'E')});
+
+    TestClock::increment(std::chrono::milliseconds(1));
+
+    // A and B tie (A was recreated when B was created), then both tie at zero so A wins again
+    auto values =
+        buffer.fill(goby::acomms::BROADCAST_ID, 250, std::chrono::milliseconds(1000));
+    std::string frame;
+    for (const auto& v : values) frame += v.data;
+    BOOST_CHECK_EQUAL(frame, std::string(29, 'C') + std::string(50, 'D') + std::string(138, 'B'));
+
+    // the next fill gets the values that did not fit
+    values = buffer.fill(goby::acomms::BROADCAST_ID, 250, std::chrono::milliseconds(1000));
+    BOOST_REQUIRE_EQUAL(values.size(), 2);
+    BOOST_CHECK_EQUAL(values[0].data, std::string(133, 'A'));
+    BOOST_CHECK_EQUAL(values[1].data, std::string(90, 'E'));
+
+    // everything is waiting for ack
+    BOOST_CHECK(buffer.fill(goby::acomms::BROADCAST_ID, 250, std::chrono::milliseconds(1000))
+                    .empty());
+
+    // without ack timeout, remaining values are still only returned once each in the same frame
+    TestClock::increment(std::chrono::milliseconds(1));
+    values = buffer.fill(goby::acomms::QUERY_DESTINATION_ID, 1000);
+    BOOST_CHECK_EQUAL(values.size(), 5);
+}
+
+// a subbuffer is in blackout at the time of its last access, even with a blackout_time of zero, but fill() can take several values from it
+BOOST_FIXTURE_TEST_CASE(check_zero_blackout, DynamicBufferFixture)
+{
+    auto& sub_a = buffer.sub(goby::acomms::BROADCAST_ID, "A");
+    BOOST_REQUIRE_EQUAL(sub_a.cfg().blackout_time(), 0);
+
+    auto now = TestClock::now();
+    buffer.push({goby::acomms::BROADCAST_ID, "A", now, "1"});
+    buffer.push({goby::acomms::BROADCAST_ID, "A", now, "2"});
+    buffer.push({goby::acomms::BROADCAST_ID, "B", now, "3"});
+
+    TestClock::increment(std::chrono::milliseconds(1));
+    now = TestClock::now();
+    auto first = buffer.top();
+    const auto& first_sub = buffer.sub(goby::acomms::BROADCAST_ID, first.subbuffer_id);
+    BOOST_CHECK(first_sub.in_blackout(now));
+    using ValueResult = goby::acomms::DynamicSubBuffer<std::string, TestClock>::ValueResult;
+    BOOST_CHECK(first_sub.top_value(now).second == ValueResult::IN_BLACKOUT);
+    BOOST_CHECK(!first_sub.in_blackout(now + std::chrono::microseconds(1)));
+
+    // so another top() at the same time goes to the other subbuffer
+    auto second = buffer.top();
+    BOOST_CHECK_NE(first.subbuffer_id, second.subbuffer_id);
+
+    // a later fill() takes all three values, two of them from A
+    TestClock::increment(std::chrono::milliseconds(1));
+    auto values = buffer.fill(goby::acomms::BROADCAST_ID, 100);
+    BOOST_REQUIRE_EQUAL(values.size(), 3);
+    BOOST_CHECK_EQUAL(std::count_if(values.begin(), values.end(),
+                                    [](const decltype(first)& v) { return v.subbuffer_id == "A"; }),
+                      2);
+
+    // and the same values are not returned again at that time
+    BOOST_CHECK(buffer.fill(goby::acomms::BROADCAST_ID, 100).empty());
+}
+
+// subbuffers in blackout or waiting for ack are left out of the priority contest until they can send again
+BOOST_AUTO_TEST_CASE(check_parked_subbuffers)
+{
+    using Buffer = goby::acomms::DynamicBuffer<std::string, TestClock>;
+    using boost::units::si::milli;
+    using boost::units::si::seconds;
+
+    Buffer buffer;
+    const int num_sub = 50;
+    for (int i = 0; i < num_sub; ++i)
+    {
+        goby::acomms::protobuf::DynamicBufferConfig cfg;
+        cfg.set_ttl_with_units(10.0 * milli * seconds);
+        cfg.set_value_base(1 + i);
+        cfg.set_blackout_time_with_units((i % 2 == 0 ? 5.0 : 0.0) * milli * seconds);
+        cfg.set_max_queue(2);
+        buffer.create(goby::acomms::BROADCAST_ID, "sub" + std::to_string(i), cfg);
+        buffer.push({goby::acomms::BROADCAST_ID, "sub" + std::to_string(i), TestClock::now(),
+                     std::to_string(i)});
+    }
+
+    const auto ack_timeout = std::chrono::milliseconds(20);
+    TestClock::increment(std::chrono::milliseconds(1));
+    std::set<std::string> sent;
+    while (auto vp = buffer.try_top(goby::acomms::BROADCAST_ID, 100, ack_timeout))
+        BOOST_CHECK(sent.insert(vp->subbuffer_id).second);
+    BOOST_CHECK_EQUAL(sent.size(), num_sub);
+
+    // all parked: in blackout (even) or waiting for ack (odd)
+    TestClock::increment(std::chrono::milliseconds(1));
+    BOOST_CHECK(!buffer.try_top(goby::acomms::BROADCAST_ID, 100, ack_timeout));
+
+    // a push makes a subbuffer eligible again, as long as it is not in blackout
+    buffer.push({goby::acomms::BROADCAST_ID, "sub1", TestClock::now(), "new"});
+    buffer.push({goby::acomms::BROADCAST_ID, "sub2", TestClock::now(), "new"});
+    {
+        auto vp = buffer.try_top(goby::acomms::BROADCAST_ID, 100, ack_timeout);
+        BOOST_REQUIRE(vp);
+        BOOST_CHECK_EQUAL(vp->subbuffer_id, "sub1");
+        BOOST_CHECK_EQUAL(vp->data, "new");
+    }
+    BOOST_CHECK(!buffer.try_top(goby::acomms::BROADCAST_ID, 100, ack_timeout));
+
+    // at the end of the blackout, sub2 has a value that was never sent
+    TestClock::increment(std::chrono::milliseconds(5));
+    {
+        auto vp = buffer.try_top(goby::acomms::BROADCAST_ID, 100, ack_timeout);
+        BOOST_REQUIRE(vp);
+        BOOST_CHECK_EQUAL(vp->subbuffer_id, "sub2");
+        BOOST_CHECK_EQUAL(vp->data, "new");
+    }
+    BOOST_CHECK(!buffer.try_top(goby::acomms::BROADCAST_ID, 100, ack_timeout));
+
+    // a shorter ack timeout applies to the parked subbuffers straight away
+    sent.clear();
+    while (auto vp =
+               buffer.try_top(goby::acomms::BROADCAST_ID, 100, std::chrono::milliseconds(2)))
+        sent.insert(vp->subbuffer_id);
+    BOOST_CHECK_EQUAL(sent.size(), num_sub - 1);
+    BOOST_CHECK(!sent.count("sub2"));
+
+    // and the original ack timeout ends for all
+    TestClock::increment(ack_timeout + std::chrono::milliseconds(1));
+    sent.clear();
+    while (auto vp = buffer.try_top(goby::acomms::BROADCAST_ID, 100, ack_timeout))
+        sent.insert(vp->subbuffer_id);
+    BOOST_CHECK_EQUAL(sent.size(), num_sub);
+}
+
+BOOST_AUTO_TEST_CASE(check_pack)
+{
+    using Buffer = goby::acomms::DynamicBuffer<std::string, TestClock>;
+    Buffer buffer;
+
+    goby::acomms::protobuf::DynamicBufferConfig cfg;
+    cfg.set_ttl(10);
+    cfg.set_value_base(10);
+    for (std::string id : {"A", "B", "C"})
+    {
+        buffer.create(goby::acomms::BROADCAST_ID, id, cfg);
+        TestClock::increment(std::chrono::microseconds(1));
+    }
+
+    auto now = TestClock::now();
+    buffer.push({goby::acomms::BROADCAST_ID, "A", now, std::string(20, 'A')});
+    buffer.push({goby::acomms::BROADCAST_ID, "B", now, std::string(16, 'B')});
+    buffer.push({goby::acomms::BROADCAST_ID, "C", now, std::string(16, 'C')});
+    TestClock::increment(std::chrono::seconds(1));
+
+    // fill() would send A alone (20 of 32 bytes); packing sends B and C first
+    auto packing =
+        buffer.pack(goby::acomms::QUERY_DESTINATION_ID, 32, 2, std::chrono::seconds(10));
+    BOOST_CHECK_EQUAL(packing.greedy_frames, 0);
+    BOOST_REQUIRE_EQUAL(packing.frames.size(), 2);
+    BOOST_REQUIRE_EQUAL(packing.frames[0].size(), 2);
+    BOOST_CHECK_EQUAL(packing.frames[0][0].subbuffer_id, "B");
+    BOOST_CHECK_EQUAL(packing.frames[0][1].subbuffer_id, "C");
+    BOOST_REQUIRE_EQUAL(packing.frames[1].size(), 1);
+    BOOST_CHECK_EQUAL(packing.frames[1][0].subbuffer_id, "A");
+
+    // all sent, waiting for ack
+    BOOST_CHECK(!buffer.try_top(goby::acomms::QUERY_DESTINATION_ID, 32, std::chrono::seconds(10)));
+
+    // with a budget too small for an exact solution, values are taken in priority order
+    TestClock::increment(std::chrono::seconds(11));
+    Buffer::PackingBudget budget;
+    budget.max_cells = 32;
+    packing = buffer.pack(goby::acomms::BROADCAST_ID, 32, 1, std::chrono::seconds(10), budget);
+    BOOST_CHECK_EQUAL(packing.greedy_frames, 1);
+    BOOST_REQUIRE_EQUAL(packing.frames.size(), 1);
+    BOOST_REQUIRE_EQUAL(packing.frames[0].size(), 1);
+
+    // a subbuffer with a blackout_time gives at most one value per pack(), like fill()
+    cfg.set_blackout_time(1);
+    cfg.set_max_queue(10);
+    buffer.create(goby::acomms::BROADCAST_ID, "D", cfg);
+    TestClock::increment(std::chrono::seconds(2));
+    now = TestClock::now();
+    for (int i = 0; i < 4; ++i)
+        buffer.push({goby::acomms::BROADCAST_ID, "D", now, std::string(4, '0' + i)});
+    TestClock::increment(std::chrono::milliseconds(1));
+    packing = buffer.pack(goby::acomms::BROADCAST_ID, 32, 2, std::chrono::seconds(10));
+    int num_d = 0;
+    for (const auto& frame : packing.frames)
+        num_d += std::count_if(frame.begin(), frame.end(),
+                               [](const Buffer::Value& v) { return v.subbuffer_id == "D"; });
+    BOOST_CHECK_EQUAL(num_d, 1);
+    BOOST_CHECK_EQUAL(
+        buffer.fill(goby::acomms::BROADCAST_ID, 32, std::chrono::seconds(10)).size(), 0);
+
+    // after the blackout, the next value
+    TestClock::increment(std::chrono::seconds(2));
+    packing = buffer.pack(goby::acomms::BROADCAST_ID, 32, 2, std::chrono::seconds(10));
+    num_d = 0;
+    for (const auto& frame : packing.frames)
+        num_d += std::count_if(frame.begin(), frame.end(),
+                               [](const Buffer::Value& v) { return v.subbuffer_id == "D"; });
+    BOOST_CHECK_EQUAL(num_d, 1);
+}
+
+BOOST_AUTO_TEST_CASE(check_knapsack)
+{
+    // capacity 10: {6, 5, 5} with weights {7, 5, 5} -> 5 + 5
+    auto chosen = goby::acomms::detail::knapsack({6, 5, 5}, {7, 5, 5}, 10);
+    BOOST_REQUIRE_EQUAL(chosen.size(), 2);
+    BOOST_CHECK_EQUAL(chosen[0], 1);
+    BOOST_CHECK_EQUAL(chosen[1], 2);
+
+    // too large and zero weight items are never chosen
+    chosen = goby::acomms::detail::knapsack({11, 3, 4}, {100, 0, 1}, 10);
+    BOOST_REQUIRE_EQUAL(chosen.size(), 1);
+    BOOST_CHECK_EQUAL(chosen[0], 2);
+}
+
+BOOST_AUTO_TEST_CASE(check_spill)
+{
+    using Buffer = goby::acomms::DynamicBuffer<std::string, TestClock>;
+
+    // same operations on a buffer that spills and one that doesn't must give the same results
+    Buffer plain, spilled;
+    for (Buffer* buffer : {&plain, &spilled})
+    {
+        goby::acomms::protobuf::DynamicBufferConfig cfg;
+        cfg.set_ttl(10);
+        cfg.set_newest_first(false);
+        cfg.set_value_base(10);
+        buffer->create(goby::acomms::BROADCAST_ID, "A", cfg);
+        cfg.set_value_base(1);
+        buffer->create(goby::acomms::BROADCAST_ID, "B", cfg);
+    }
+
+    Buffer::SpillConfig spill_cfg;
+    spill_cfg.directory = ".";
+    spill_cfg.memory_budget = 100;
+    // several values per segment, so that segments are shared and rotated
+    spill_cfg.segment_bytes = 64;
+    spilled.enable_spill(spill_cfg);
+
+    auto check_same = [](const Buffer::Value& a, const Buffer::Value& b) {
+        BOOST_CHECK_EQUAL(a.modem_id, b.modem_id);
+        BOOST_CHECK_EQUAL(a.subbuffer_id, b.subbuffer_id);
+        BOOST_CHECK(a.push_time == b.push_time);
+        BOOST_CHECK_EQUAL(a.data, b.data);
+    };
+
+    std::vector<Buffer::Value> pushed;
+    for (int i = 0; i < 10; ++i)
+    {
+        for (std::string id : {"A", "B"})
+        {
+            Buffer::Value value{goby::acomms::BROADCAST_ID, id, TestClock::now(),
+                                id + std::string(9, '0' + i)};
+            plain.push(value);
+            spilled.push(value);
+            pushed.push_back(value);
+            BOOST_CHECK_LE(spilled.resident_bytes(), spill_cfg.memory_budget);
+        }
+        TestClock::increment(std::chrono::seconds(1));
+    }
+
+    BOOST_CHECK_EQUAL(spilled.size(), 20);
+    BOOST_CHECK_GT(spilled.spilled_bytes(), 0);
+    BOOST_CHECK_EQUAL(spilled.resident_bytes() + spilled.spilled_bytes(), 200);
+    // the lower priority subbuffer is spilled first
+    BOOST_CHECK_LT(spilled.sub(goby::acomms::BROADCAST_ID, "B").resident_bytes(),
+                   spilled.sub(goby::acomms::BROADCAST_ID, "A").resident_bytes());
+
+    // the first values pushed expire
+    TestClock::increment(std::chrono::milliseconds(1));
+    auto plain_expired = plain.expire();
+    auto spilled_expired = spilled.expire();
+    BOOST_REQUIRE_EQUAL(spilled_expired.size(), 2);
+    BOOST_REQUIRE_EQUAL(plain_expired.size(), spilled_expired.size());
+    for (int i = 0, n = plain_expired.size(); i < n; ++i)
+        check_same(plain_expired[i], spilled_expired[i]);
+
+    // erase works on spilled values
+    BOOST_CHECK(plain.erase(pushed[11]));
+    BOOST_CHECK(spilled.erase(pushed[11]));
+    BOOST_CHECK(!spilled.erase(pushed[11]));
+    BOOST_CHECK_EQUAL(spilled.resident_bytes() + spilled.spilled_bytes(), 170);
+
+    // spilled values are paged back in as they reach the top
+    while (auto plain_value = plain.try_top())
+    {
+        auto spilled_value = spilled.try_top();
+        BOOST_REQUIRE(spilled_value);
+        check_same(*plain_value, *spilled_value);
+        plain.erase(*plain_value);
+        BOOST_CHECK(spilled.erase(*spilled_value));
+        TestClock::increment(std::chrono::microseconds(1));
+    }
+    BOOST_CHECK(!spilled.try_top());
+    BOOST_CHECK(spilled.empty());
+    BOOST_CHECK_EQUAL(spilled.spilled_bytes(), 0);
+    BOOST_CHECK_EQUAL(spilled.resident_bytes(), 0);
+
+    // changes made through sub() and remove() are accounted for
+    spilled.sub(goby::acomms::BROADCAST_ID, "A").push("A123");
+    BOOST_CHECK_EQUAL(spilled.resident_bytes(), 4);
+    spilled.push({goby::acomms::BROADCAST_ID, "B", TestClock::now(), "B12"});
+    BOOST_CHECK_EQUAL(spilled.resident_bytes(), 7);
+    spilled.remove(goby::acomms::BROADCAST_ID, "A");
+    BOOST_CHECK_EQUAL(spilled.resident_bytes(), 3);
+}
+
+// a spill store that cannot be written disables spilling, keeping the values in memory
+BOOST_AUTO_TEST_CASE(check_spill_failure)
+{
+    using Buffer = goby::acomms::DynamicBuffer<std::string, TestClock>;
+    Buffer buffer;
+    goby::acomms::protobuf::DynamicBufferConfig cfg;
+    cfg.set_ttl(10);
+    cfg.set_max_queue(100);
+    cfg.set_newest_first(false);
+    buffer.create(goby::acomms::BROADCAST_ID, "A", cfg);
+
+    Buffer::SpillConfig spill_cfg;
+    // segment files can't be created here
+    spill_cfg.directory = "/nonexistent/goby_test_dynamic_buffer";
+    spill_cfg.memory_budget = 10;
+    buffer.enable_spill(spill_cfg);
+    BOOST_CHECK(buffer.spilling());
+
+    std::vector<std::string> pushed;
+    for (int i = 0; i < 10; ++i)
+    {
+        pushed.push_back(std::string(5, '0' + i));
+        BOOST_CHECK_NO_THROW(
+            buffer.push({goby::acomms::BROADCAST_ID, "A", TestClock::now(), pushed.back()}));
+    }
+    BOOST_CHECK(!buffer.spilling());
+    BOOST_CHECK_EQUAL(buffer.spilled_bytes(), 0);
+    BOOST_CHECK_EQUAL(buffer.resident_bytes(), 50);
+
+    // nothing was lost
+    TestClock::increment(std::chrono::milliseconds(1));
+    auto values = buffer.fill(goby::acomms::BROADCAST_ID, 1000);
+    BOOST_REQUIRE_EQUAL(values.size(), pushed.size());
+    for (int i = 0, n = values.size(); i < n; ++i) BOOST_CHECK_EQUAL(values[i].data, pushed[i]);
+}
+
+// priority contest over many subbuffers: checks top() against an exhaustive search, and reports the time per top() as the number of subbuffers grows
+BOOST_AUTO_TEST_CASE(check_priority_index_scaling)
+{
+    using Buffer = goby::acomms::DynamicBuffer<std::string, TestClock>;
+    const int num_dest = 20;
+
+    for (int num_sub : {20, 200, 2000, 6000})
+    {
+        Buffer buffer;
+        for (int i = 0; i < num_sub; ++i)
+        {
+            goby::acomms::protobuf::DynamicBufferConfig cfg;
+            cfg.set_ttl(1 + i % 7);
+            cfg.set_value_base(1 + i % 97);
+            cfg.set_blackout_time(i % 5 == 0 ? 0.01 : 0);
+            cfg.set_max_queue(4);
+            buffer.create(i % num_dest, "sub" + std::to_string(i), cfg);
+            TestClock::increment(std::chrono::microseconds(3));
+        }
+
+        auto fill = [&](int i) {
+            buffer.push({i % num_dest, "sub" + std::to_string(i), TestClock::now(),
+                         std::string(1 + (i * 13) % 40, 'x')});
+        };
+        for (int i = 0; i < num_sub; ++i)
+            for (int j = 0; j < 3; ++j) fill(i);
+
+        const int num_top = 500;
+        // values that are not erased wait for ack, so subbuffers are left out of the contest for blackout and ack waits
+        const auto ack_timeout = std::chrono::milliseconds(5);
+        for (int n = 0; n < num_top; ++n)
+        {
+            TestClock::increment(std::chrono::milliseconds(1));
+            auto now = TestClock::now();
+            Buffer::size_type max_bytes = 1 + (n * 7) % 48;
+
+            // exhaustive search, as DynamicBuffer::top() did before it had a priority index
+            // (read only, so the subbuffers left out of the contest while in blackout stay out)
+            const Buffer& reference = buffer;
+            double best = -std::numeric_limits<double>::infinity();
+            std::map<std::pair<int, std::string>, double> values;
+            for (int i = 0; i < num_sub; ++i)
+            {
+                auto id = "sub" + std::to_string(i);
+                double v =
+                    reference.sub(i % num_dest, id).top_value(now, max_bytes, ack_timeout).first;
+                values[std::make_pair(i % num_dest, id)] = v;
+                best = std::max(best, v);
+            }
+
+            if (best == -std::numeric_limits<double>::infinity())
+            {
+                BOOST_CHECK_THROW(
+                    buffer.top(goby::acomms::QUERY_DESTINATION_ID, max_bytes, ack_timeout),
+                    goby::acomms::DynamicBufferNoDataException);
+                continue;
+            }
+
+            auto vp = buffer.top(goby::acomms::QUERY_DESTINATION_ID, max_bytes, ack_timeout);
+            BOOST_CHECK_EQUAL(values.at(std::make_pair(vp.modem_id, vp.subbuffer_id)), best);
+            BOOST_CHECK_LE(vp.data.size(), max_bytes);
+            if (n % 2 == 0)
+            {
+                BOOST_CHECK(buffer.erase(vp));
+                fill(n % num_sub);
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        int num_found = 0;
+        for (int n = 0; n < num_top; ++n)
+        {
+            TestClock::increment(std::chrono::milliseconds(1));
+            try
+            {
+                auto vp = buffer.top(goby::acomms::QUERY_DESTINATION_ID, 1 + (n * 7) % 48);
+                buffer.erase(vp);
+                fill(n % num_sub);
+                ++num_found;
+            }
+            catch (goby::acomms::DynamicBufferNoDataException&)
+            {
+            }
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+
+        std::cout << num_sub << " subbuffers: " << static_cast<double>(elapsed) / num_top
+                  << " us per top() (" << num_found << "/" << num_top << " found a value)"
+                  << std::endl;
+    }
+}
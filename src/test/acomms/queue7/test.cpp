@@ -0,0 +1,161 @@
+// Copyright 2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <dccl/dynamic_protobuf_manager.h>
+#include <dccl/option_extensions.pb.h>
+#include <google/protobuf/descriptor.pb.h>
+
+#include "goby/acomms/connect.h"
+#include "goby/acomms/protobuf/modem_message.pb.h"
+#include "goby/acomms/queue.h"
+#include "goby/util/debug_logger.h"
+
+// tests that the priority contest stays correct (and cheap) with many queues
+
+const int MY_MODEM_ID = 1;
+const int FIRST_DCCL_ID = 20000;
+
+std::vector<std::string> received;
+
+void handle_receive(const google::protobuf::Message& msg)
+{
+    received.push_back(msg.GetDescriptor()->full_name());
+}
+
+// one message type per queue, built at runtime: ScaleMsg<dccl_id> { required int32 telegram }
+const google::protobuf::Descriptor* make_message_type(int dccl_id)
+{
+    std::string name = "ScaleMsg" + std::to_string(dccl_id);
+
+    google::protobuf::FileDescriptorProto file;
+    file.set_name("goby/test/acomms/queue7/" + name + ".proto");
+    file.set_package("goby.test.acomms.protobuf");
+    file.set_syntax("proto2");
+    file.add_dependency("dccl/option_extensions.proto");
+
+    google::protobuf::DescriptorProto* msg = file.add_message_type();
+    msg->set_name(name);
+    dccl::DCCLMessageOptions* msg_options = msg->mutable_options()->MutableExtension(dccl::msg);
+    msg_options->set_id(dccl_id);
+    msg_options->set_max_bytes(32);
+    msg_options->set_codec_version(3);
+
+    google::protobuf::FieldDescriptorProto* field = msg->add_field();
+    field->set_name("telegram");
+    field->set_number(1);
+    field->set_label(google::protobuf::FieldDescriptorProto::LABEL_REQUIRED);
+    field->set_type(google::protobuf::FieldDescriptorProto::TYPE_INT32);
+    dccl::DCCLFieldOptions* field_options = field->mutable_options()->MutableExtension(dccl::field);
+    field_options->set_min(0);
+    field_options->set_max(255);
+
+    dccl::DynamicProtobufManager::add_protobuf_file(file);
+    return dccl::DynamicProtobufManager::find_descriptor("goby.test.acomms.protobuf." + name);
+}
+
+void push(goby::acomms::QueueManager& q_manager, const google::protobuf::Descriptor* desc)
+{
+    auto msg = dccl::DynamicProtobufManager::new_protobuf_message<
+        std::shared_ptr<google::protobuf::Message> >(desc);
+    msg->GetReflection()->SetInt32(msg.get(), desc->FindFieldByName("telegram"), 1);
+    q_manager.push_message(*msg);
+}
+
+// queues every type, gives one of them by far the highest priority and checks that it is sent
+// first, then that every other queue's message is sent exactly once
+void check_scaling(const std::vector<const google::protobuf::Descriptor*>& types)
+{
+    const int num_queues = types.size();
+    const int favorite = num_queues / 2;
+
+    goby::acomms::QueueManager q_manager;
+    goby::acomms::protobuf::QueueManagerConfig cfg;
+    cfg.set_modem_id(MY_MODEM_ID);
+    for (int i = 0; i < num_queues; ++i)
+    {
+        goby::acomms::protobuf::QueuedMessageEntry* q_entry = cfg.add_message_entry();
+        q_entry->set_protobuf_name(types[i]->full_name());
+        q_entry->set_ack(false);
+        q_entry->set_value_base(i == favorite ? 1e6 : 1);
+    }
+    q_manager.set_cfg(cfg);
+    goby::acomms::connect(&q_manager.signal_receive, &handle_receive);
+
+    for (const auto* desc : types) push(q_manager, desc);
+
+    received.clear();
+    int requests = 0;
+    std::chrono::duration<double, std::micro> elapsed(0);
+    while (true)
+    {
+        goby::acomms::protobuf::ModemTransmission msg;
+        msg.set_max_frame_bytes(32);
+
+        auto start = std::chrono::steady_clock::now();
+        q_manager.handle_modem_data_request(&msg);
+        elapsed += std::chrono::steady_clock::now() - start;
+        ++requests;
+
+        if (msg.frame(0).empty())
+            break;
+
+        q_manager.handle_modem_receive(msg);
+        assert(requests <= num_queues);
+    }
+
+    std::cout << num_queues << " queues: " << elapsed.count() / requests << " us per data request"
+              << std::endl;
+
+    assert(static_cast<int>(received.size()) == num_queues);
+    assert(received.front() == types[favorite]->full_name());
+    assert(static_cast<int>(std::set<std::string>(received.begin(), received.end()).size()) ==
+           num_queues);
+}
+
+int main(int /*argc*/, char* argv[])
+{
+    goby::glog.add_stream(goby::util::logger::WARN, &std::cerr);
+    goby::glog.set_name(argv[0]);
+
+    std::vector<const google::protobuf::Descriptor*> types;
+    for (int num_queues : {16, 256, 2048})
+    {
+        while (static_cast<int>(types.size()) < num_queues)
+        {
+            types.push_back(make_message_type(FIRST_DCCL_ID + types.size()));
+            assert(types.back());
+        }
+        check_scaling(types);
+    }
+
+    std::cout << "all tests passed" << std::endl;
+    dccl::DynamicProtobufManager::protobuf_shutdown();
+}
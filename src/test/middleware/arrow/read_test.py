@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+# Copyright 2024:
+#   GobySoft, LLC (2013-)
+#   Community contributors (see AUTHORS file)
+# File authors:
+#   Toby Schneider <toby@gobysoft.org>
+#
+#
+# This file is part of the Goby Underwater Autonomy Project Binaries
+# ("The Goby Binaries").
+#
+# The Goby Binaries are free software: you can redistribute them and/or modify
+# them under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+#
+# The Goby Binaries are distributed in the hope that they will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+# Reads the Arrow files written by goby_test_middleware_arrow with pyarrow, checking that they are
+# valid and hold the values written (keep in step with test.cpp).
+
+import datetime
+import os
+import sys
+import urllib.parse
+
+import pyarrow
+import pyarrow.ipc
+
+output_dir = sys.argv[1] if len(sys.argv) > 1 else "/tmp/goby3_test_arrow"
+n = 1000
+n_proto3 = 10
+PROTOBUF = 1
+epoch = datetime.datetime(1970, 1, 1, tzinfo=datetime.timezone.utc)
+
+
+def read(group, type_name):
+    path = os.path.join(output_dir, group, type_name + ".arrow")
+    table = pyarrow.ipc.open_file(path).read_all()
+    table.validate(full=True)
+    # the directory name is the percent-encoded group
+    assert table.schema.metadata[b"goby.group"].decode() == urllib.parse.unquote(group)
+    assert table.schema.metadata[b"goby.type"].decode() == type_name
+    return table.to_pylist()
+
+
+def sample(i):
+    return {
+        "_utime_": i * 1000000,
+        "_scheme_": PROTOBUF,
+        "x": i / 10.0,
+        "n": -i if i % 2 else None,
+        "u": None,
+        "flag": i % 3 == 0,
+        "raw": None,
+        "mode": "MODE_A" if i % 2 else "MODE_B",
+        "sub": {"a": i, "s": []} if i % 5 == 0 else None,
+        "subs": [{"a": None, "s": [str(j)]} for j in range(i % 4)],
+        "f": [float(i)],
+        # recursive messages are written as text
+        "tree": {"value": None, "child": "value: %d" % i},
+    }
+
+
+def check(rows, expected):
+    assert len(rows) == len(expected), (len(rows), len(expected))
+    for row, expected_row in zip(rows, expected):
+        row["_utime_"] = (row["_utime_"] - epoch) // datetime.timedelta(microseconds=1)
+        assert row == expected_row, (row, expected_row)
+
+
+sample_type = "goby.test.middleware.protobuf.ArrowSample"
+check(read("test%2Fgroup", sample_type), [sample(i) for i in range(n)])
+check(read("test_group", sample_type), [sample(0)])
+check(read("test%252Fgroup", sample_type), [sample(1)])
+
+proto3_type = "goby.test.middleware.protobuf.ArrowProto3Sample"
+if os.path.exists(os.path.join(output_dir, "proto3", proto3_type + ".arrow")):
+    check(read("proto3", proto3_type),
+          [{"_utime_": i * 1000000, "_scheme_": PROTOBUF,
+            # proto3 fields without presence are never null, proto3 optional fields are if unset
+            "plain": i if i % 3 else 0,
+            "maybe": (i if i % 4 else 0) if i % 2 == 0 else None} for i in range(n_proto3)])
+
+print("pyarrow %s read all files" % pyarrow.__version__)
+print("all tests passed")
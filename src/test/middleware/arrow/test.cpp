@@ -0,0 +1,288 @@
+// Copyright 2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm> // for min
+#include <cassert>   // for assert
+#include <cstdint>   // for uint32_t, int64_t
+#include <cstring>   // for memcpy
+#include <fstream>   // for ifstream
+#include <iostream>  // for cout
+#include <iterator>  // for istreambuf_iterator
+#include <memory>    // for make_shared
+#include <string>    // for string
+
+#include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/dynamic_message.h>
+
+#include "goby/middleware/log/arrow/arrow.h"
+#include "goby/middleware/marshalling/interface.h"
+#include "goby/test/middleware/arrow/test.pb.h"
+#include "goby/util/debug_logger.h"
+
+// tests writing Arrow IPC files, checking their structure by reading back the metadata (read_test.py
+// reads the files written here with pyarrow, if available)
+
+using goby::test::middleware::protobuf::ArrowSample;
+
+const std::string output_dir("/tmp/goby3_test_arrow");
+const int n = 1000;
+const int batch_rows = 300;
+const int n_proto3 = 10;
+#if GOOGLE_PROTOBUF_VERSION >= 3015000
+const int proto3_files = 1;
+#else
+const int proto3_files = 0;
+#endif
+
+std::string read_file(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    assert(in.is_open());
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// minimal FlatBuffers reader
+struct FlatBuffer
+{
+    explicit FlatBuffer(std::string b) : buf(std::move(b)) {}
+
+    template <typename T> T read(std::size_t pos) const
+    {
+        assert(pos + sizeof(T) <= buf.size());
+        T value;
+        std::memcpy(&value, &buf[pos], sizeof(value));
+        return value;
+    }
+
+    // object referred to by the offset at pos
+    std::size_t deref(std::size_t pos) const { return pos + read<std::uint32_t>(pos); }
+
+    // position of field id of the table at pos, or 0 if it is not present
+    std::size_t field(std::size_t table, int id) const
+    {
+        std::size_t vtable = table - read<std::int32_t>(table);
+        if (4 + 2 * id >= read<std::uint16_t>(vtable))
+            return 0;
+        auto offset = read<std::uint16_t>(vtable + 4 + 2 * id);
+        return offset ? table + offset : 0;
+    }
+
+    std::string buf;
+};
+
+struct ArrowFile
+{
+    explicit ArrowFile(const std::string& path) : file(read_file(path)), footer(read_footer(file))
+    {
+        assert(file.substr(0, 6) == "ARROW1");
+        assert(file.substr(file.size() - 6) == "ARROW1");
+        footer_table = footer.deref(0);
+    }
+
+    static FlatBuffer read_footer(const std::string& file)
+    {
+        auto footer_size = FlatBuffer(file).read<std::int32_t>(file.size() - 10);
+        return FlatBuffer(file.substr(file.size() - 10 - footer_size, footer_size));
+    }
+
+    std::uint32_t field_count() const
+    {
+        auto schema = footer.deref(footer.field(footer_table, 1));
+        return footer.read<std::uint32_t>(footer.deref(footer.field(schema, 1)));
+    }
+
+    std::size_t record_batches() const { return footer.deref(footer.field(footer_table, 3)); }
+    std::uint32_t record_batch_count() const { return footer.read<std::uint32_t>(record_batches()); }
+
+    // RecordBatch message i, checking the framing given by the footer
+    FlatBuffer record_batch(std::uint32_t i, std::size_t* record_batch_table) const
+    {
+        // Block { offset, metaDataLength, bodyLength }
+        std::size_t block = record_batches() + 4 + 24 * i;
+        auto offset = footer.read<std::int64_t>(block);
+        auto metadata_length = footer.read<std::int32_t>(block + 8);
+        auto body_length = footer.read<std::int64_t>(block + 16);
+        assert(offset % 8 == 0 && metadata_length % 8 == 0 && body_length % 8 == 0);
+
+        FlatBuffer prefix(file.substr(offset, 8));
+        assert(prefix.read<std::uint32_t>(0) == 0xFFFFFFFF);
+        assert(prefix.read<std::int32_t>(4) == metadata_length - 8);
+
+        FlatBuffer message(file.substr(offset + 8, metadata_length - 8));
+        auto message_table = message.deref(0);
+        // RecordBatch
+        assert(message.read<std::uint8_t>(message.field(message_table, 1)) == 3);
+        assert(message.read<std::int64_t>(message.field(message_table, 3)) == body_length);
+        *record_batch_table = message.deref(message.field(message_table, 2));
+        return message;
+    }
+
+    std::string file;
+    FlatBuffer footer;
+    std::size_t footer_table;
+};
+
+// writes messages of a proto3 file (built at runtime, as proto3 optional needs a newer protoc than Goby otherwise requires)
+void write_proto3(goby::middleware::arrow::Writer& writer, const std::string& group, int count)
+{
+#if GOOGLE_PROTOBUF_VERSION >= 3015000
+    using google::protobuf::FieldDescriptorProto;
+
+    google::protobuf::FileDescriptorProto file_proto;
+    file_proto.set_name("goby/test/middleware/arrow/test_proto3.proto");
+    file_proto.set_package("goby.test.middleware.protobuf");
+    file_proto.set_syntax("proto3");
+    auto* msg_proto = file_proto.add_message_type();
+    msg_proto->set_name("ArrowProto3Sample");
+    msg_proto->add_oneof_decl()->set_name("_maybe");
+
+    auto* plain = msg_proto->add_field();
+    plain->set_name("plain");
+    plain->set_number(1);
+    plain->set_label(FieldDescriptorProto::LABEL_OPTIONAL);
+    plain->set_type(FieldDescriptorProto::TYPE_INT32);
+
+    auto* maybe = msg_proto->add_field();
+    maybe->set_name("maybe");
+    maybe->set_number(2);
+    maybe->set_label(FieldDescriptorProto::LABEL_OPTIONAL);
+    maybe->set_type(FieldDescriptorProto::TYPE_INT32);
+    maybe->set_proto3_optional(true);
+    maybe->set_oneof_index(0);
+
+    static google::protobuf::DescriptorPool pool;
+    static google::protobuf::DynamicMessageFactory factory(&pool);
+    const auto* file_desc = pool.BuildFile(file_proto);
+    assert(file_desc);
+    const auto* desc = file_desc->message_type(0);
+
+    for (int i = 0; i < count; ++i)
+    {
+        std::shared_ptr<google::protobuf::Message> msg(factory.GetPrototype(desc)->New());
+        const auto* refl = msg->GetReflection();
+        // proto3 fields without presence are never null, even if zero
+        if (i % 3)
+            refl->SetInt32(msg.get(), desc->field(0), i);
+        // even rows have "maybe" set (some to zero), odd rows are null
+        if (i % 2 == 0)
+            refl->SetInt32(msg.get(), desc->field(1), i % 4 ? i : 0);
+
+        goby::middleware::HDF5ProtobufEntry entry;
+        entry.channel = group;
+        entry.time = goby::time::MicroTime::from_value(1000000 * i);
+        entry.msg = msg;
+        entry.scheme = goby::middleware::MarshallingScheme::PROTOBUF;
+        writer.add_entry(entry);
+    }
+#endif
+}
+
+int main(int /*argc*/, char* argv[])
+{
+    goby::glog.add_stream(goby::util::logger::DEBUG3, &std::cerr);
+    goby::glog.set_name(argv[0]);
+
+    {
+        goby::middleware::arrow::Writer writer(output_dir, batch_rows);
+        for (int i = 0; i < n; ++i)
+        {
+            auto msg = std::make_shared<ArrowSample>();
+            msg->set_x(i / 10.0);
+            if (i % 2)
+                msg->set_n(-i);
+            msg->set_flag(i % 3 == 0);
+            msg->set_mode(i % 2 ? ArrowSample::MODE_A : ArrowSample::MODE_B);
+            if (i % 5 == 0)
+                msg->mutable_sub()->set_a(i);
+            for (int j = 0; j < i % 4; ++j) msg->add_subs()->add_s(std::to_string(j));
+            msg->add_f(i);
+            msg->mutable_tree()->mutable_child()->set_value(i);
+
+            goby::middleware::HDF5ProtobufEntry entry;
+            entry.channel = "test/group";
+            entry.time = goby::time::MicroTime::from_value(1000000 * i);
+            entry.msg = msg;
+            entry.scheme = goby::middleware::MarshallingScheme::PROTOBUF;
+            writer.add_entry(entry);
+
+            // groups that would have been written to the same directory if '/' were replaced
+            if (i < 2)
+            {
+                entry.channel = i == 0 ? "test_group" : "test%2Fgroup";
+                writer.add_entry(entry);
+            }
+        }
+        write_proto3(writer, "proto3", n_proto3);
+        writer.close();
+
+        auto stats = writer.statistics();
+        std::cout << stats << std::endl;
+        assert(stats.files == 3 + proto3_files);
+        assert(stats.record_batches == (n + batch_rows - 1) / batch_rows + 2 + proto3_files);
+        assert(stats.rows == n + 2 + proto3_files * n_proto3);
+    }
+
+    // '/' and '%' in the group are percent-encoded
+    const std::string file_name("/goby.test.middleware.protobuf.ArrowSample.arrow");
+    ArrowFile file(output_dir + "/test%2Fgroup" + file_name);
+    for (const auto& other : {"/test_group", "/test%252Fgroup"})
+    {
+        ArrowFile other_file(output_dir + other + file_name);
+        assert(other_file.record_batch_count() == 1);
+    }
+
+    // _utime_, _scheme_ and the fields
+    assert(file.field_count() == 2 + ArrowSample::descriptor()->field_count());
+    assert(file.record_batch_count() == (n + batch_rows - 1) / batch_rows);
+
+    std::int64_t rows = 0;
+    for (std::uint32_t i = 0; i < file.record_batch_count(); ++i)
+    {
+        std::size_t record_batch;
+        auto message = file.record_batch(i, &record_batch);
+        auto length = message.read<std::int64_t>(message.field(record_batch, 0));
+        assert(length == std::min<std::int64_t>(batch_rows, n - rows));
+        rows += length;
+    }
+    assert(rows == n);
+
+    if (proto3_files)
+    {
+        ArrowFile proto3_file(output_dir +
+                              "/proto3/goby.test.middleware.protobuf.ArrowProto3Sample.arrow");
+        assert(proto3_file.field_count() == 4);
+        std::size_t record_batch;
+        auto message = proto3_file.record_batch(0, &record_batch);
+
+        // FieldNode { length, null_count } of _utime_, _scheme_, plain, maybe
+        auto nodes = message.deref(message.field(record_batch, 1));
+        assert(message.read<std::uint32_t>(nodes) == 4);
+        auto null_count = [&](int column)
+        { return message.read<std::int64_t>(nodes + 4 + 16 * column + 8); };
+        assert(null_count(2) == 0);
+        assert(null_count(3) == n_proto3 / 2);
+    }
+
+    std::cout << "all tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,141 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "goby/middleware/marshalling/dccl.h"
+
+#include "goby/test/middleware/dccl_threads/test.pb.h"
+
+// tests DCCL encoding and decoding from many threads at once (each using its own dccl::Codec), and reports the throughput as a benchmark
+
+using goby::middleware::MarshallingScheme;
+using goby::test::middleware::protobuf::NavSample;
+using goby::test::middleware::protobuf::StatusSample;
+
+using NavHelper = goby::middleware::SerializerParserHelper<NavSample, MarshallingScheme::DCCL>;
+using StatusHelper =
+    goby::middleware::SerializerParserHelper<StatusSample, MarshallingScheme::DCCL>;
+using DynamicHelper =
+    goby::middleware::SerializerParserHelper<google::protobuf::Message, MarshallingScheme::DCCL>;
+
+// access the protected members for testing
+struct TestHelper : public goby::middleware::detail::DCCLSerializerParserHelperBase
+{
+    static dccl::Codec& this_thread_codec() { return codec(); }
+};
+
+NavSample make_nav(int i)
+{
+    NavSample nav;
+    nav.set_time(1700000000 + i);
+    nav.set_x(i % 10000);
+    nav.set_y(-(i % 5000));
+    nav.set_z(i % 6000);
+    nav.set_heading(i % 360);
+    nav.set_speed((i % 1000) / 100.0);
+    return nav;
+}
+
+// encode and decode "count" messages, checking the round trip
+void encode_decode(int thread, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        NavSample nav = make_nav(thread * count + i);
+        auto bytes = NavHelper::serialize(nav);
+
+        auto actual_end = bytes.cbegin();
+        auto decoded = NavHelper::parse(bytes.cbegin(), bytes.cend(), actual_end);
+        assert(actual_end == bytes.cend());
+        assert(decoded->SerializeAsString() == nav.SerializeAsString());
+
+        // dynamic (google::protobuf::Message) variant
+        if (i % 10 == 0)
+        {
+            auto dyn_bytes = DynamicHelper::serialize(nav);
+            assert(dyn_bytes == bytes);
+            auto dyn_end = dyn_bytes.cbegin();
+            auto dyn_decoded = DynamicHelper::parse(dyn_bytes.cbegin(), dyn_bytes.cend(), dyn_end,
+                                                    NavHelper::type_name());
+            assert(dyn_decoded->SerializeAsString() == nav.SerializeAsString());
+        }
+    }
+}
+
+// returns messages per second (encode + decode)
+double benchmark(int nthreads, int count)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; ++t) threads.emplace_back(encode_decode, t, count);
+    for (auto& th : threads) th.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return nthreads * count / elapsed.count();
+}
+
+int main(int argc, char* argv[])
+{
+    int count = argc > 1 ? std::atoi(argv[1]) : 20000;
+
+    // a type loaded in one thread can be decoded by DCCL ID in another thread that has never used it
+    StatusSample status;
+    status.set_status(42);
+    auto status_bytes = StatusHelper::serialize(status);
+    assert(StatusHelper::id() == 125);
+
+    std::thread other([&]() {
+        assert(TestHelper::this_thread_codec().loaded().count(125) == 1);
+        auto packets = goby::middleware::detail::DCCLSerializerParserHelperBase::unpack(
+            std::string(status_bytes.begin(), status_bytes.end()));
+        assert(packets.frame_size() == 1);
+        assert(packets.frame(0).dccl_id() == 125);
+    });
+    other.join();
+
+    // each thread has its own codec
+    dccl::Codec* main_codec = &TestHelper::this_thread_codec();
+    dccl::Codec* other_codec = nullptr;
+    std::thread([&]() { other_codec = &TestHelper::this_thread_codec(); }).join();
+    assert(main_codec != other_codec);
+
+    unsigned hw = std::max(2u, std::thread::hardware_concurrency());
+    double single = benchmark(1, count);
+    std::cout << "1 thread: " << single << " msg/s" << std::endl;
+    for (unsigned nthreads = 2; nthreads <= hw; nthreads *= 2)
+    {
+        double multi = benchmark(nthreads, count);
+        std::cout << nthreads << " threads: " << multi << " msg/s (" << multi / single
+                  << "x single thread)" << std::endl;
+    }
+
+    std::cout << "all tests passed" << std::endl;
+    return 0;
+}
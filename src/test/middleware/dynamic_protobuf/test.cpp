@@ -0,0 +1,171 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <google/protobuf/descriptor.pb.h>
+
+#include "goby/middleware/marshalling/protobuf.h"
+#include "goby/middleware/protobuf/serializer_transporter.pb.h"
+
+// tests creating and parsing Protobuf messages by type name from many threads using the cached prototypes
+
+using goby::middleware::MarshallingScheme;
+using goby::middleware::detail::DynamicProtobufPrototypes;
+using goby::middleware::protobuf::SerializerTransporterMessage;
+using DynamicHelper =
+    goby::middleware::SerializerParserHelper<google::protobuf::Message, MarshallingScheme::PROTOBUF>;
+
+const std::string dynamic_type = "goby.test.dynamic.Sample";
+
+// add a type to the user pool that is not compiled into this binary
+void load_dynamic_type()
+{
+    google::protobuf::FileDescriptorProto file;
+    file.set_name("goby/test/dynamic/sample.proto");
+    file.set_package("goby.test.dynamic");
+    auto* msg = file.add_message_type();
+    msg->set_name("Sample");
+    auto* field = msg->add_field();
+    field->set_name("value");
+    field->set_number(1);
+    field->set_label(google::protobuf::FieldDescriptorProto::LABEL_OPTIONAL);
+    field->set_type(google::protobuf::FieldDescriptorProto::TYPE_INT32);
+
+    std::lock_guard<std::mutex> lock(DynamicProtobufPrototypes::dynamic_protobuf_manager_mutex());
+    dccl::DynamicProtobufManager::add_protobuf_file(file);
+}
+
+void parse_by_name(int thread, int count)
+{
+    SerializerTransporterMessage generated;
+    generated.mutable_key()->set_marshalling_scheme(MarshallingScheme::PROTOBUF);
+    generated.mutable_key()->set_type("thread" + std::to_string(thread));
+    generated.mutable_key()->set_group("group");
+    generated.set_data("data");
+    auto generated_bytes = DynamicHelper::serialize(generated);
+
+    std::shared_ptr<google::protobuf::Message> dynamic(
+        DynamicProtobufPrototypes::prototype(dynamic_type).New());
+    dynamic->GetReflection()->SetInt32(dynamic.get(), dynamic->GetDescriptor()->field(0), thread);
+    auto dynamic_bytes = DynamicHelper::serialize(*dynamic);
+
+    for (int i = 0; i < count; ++i)
+    {
+        auto actual_end = generated_bytes.cbegin();
+        auto msg = DynamicHelper::parse(generated_bytes.cbegin(), generated_bytes.cend(),
+                                        actual_end,
+                                        SerializerTransporterMessage::descriptor()->full_name());
+        // generated types are created as the generated class
+        auto* typed = dynamic_cast<SerializerTransporterMessage*>(msg.get());
+        assert(typed);
+        assert(typed->key().type() == "thread" + std::to_string(thread));
+
+        auto dyn_end = dynamic_bytes.cbegin();
+        auto dyn_msg = DynamicHelper::parse(dynamic_bytes.cbegin(), dynamic_bytes.cend(), dyn_end,
+                                            dynamic_type);
+        assert(dyn_msg->GetDescriptor()->full_name() == dynamic_type);
+        assert(dyn_msg->GetReflection()->GetInt32(*dyn_msg, dyn_msg->GetDescriptor()->field(0)) ==
+               thread);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    load_dynamic_type();
+
+    // same prototype is returned for each lookup, in any thread
+    const auto* proto = &DynamicProtobufPrototypes::prototype(dynamic_type);
+    assert(proto == &DynamicProtobufPrototypes::prototype(dynamic_type));
+    const google::protobuf::Message* other_proto = nullptr;
+    std::thread([&]() { other_proto = &DynamicProtobufPrototypes::prototype(dynamic_type); }).join();
+    assert(proto == other_proto);
+    assert(DynamicProtobufPrototypes::prototype(proto->GetDescriptor()).GetDescriptor() ==
+           proto->GetDescriptor());
+
+    // unknown types throw
+    bool threw = false;
+    try
+    {
+        DynamicProtobufPrototypes::prototype("goby.test.dynamic.DoesNotExist");
+    }
+    catch (const std::exception& e)
+    {
+        threw = true;
+    }
+    assert(threw);
+
+    const int nthreads = 8;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; ++t) threads.emplace_back(parse_by_name, t, 10000);
+    for (auto& th : threads) th.join();
+
+    // parsing by name within an arena scope allocates on the arena
+    {
+        goby::middleware::detail::ProtobufArenaPool pool;
+        goby::middleware::detail::ProtobufArenaScope scope(&pool);
+        SerializerTransporterMessage generated;
+        generated.mutable_key()->set_marshalling_scheme(MarshallingScheme::PROTOBUF);
+        generated.mutable_key()->set_type("type");
+        generated.mutable_key()->set_group("group");
+        generated.set_data("arena");
+        auto bytes = DynamicHelper::serialize(generated);
+        auto actual_end = bytes.cbegin();
+        auto msg = DynamicHelper::parse(bytes.cbegin(), bytes.cend(), actual_end,
+                                        SerializerTransporterMessage::descriptor()->full_name());
+        assert(msg->GetArena() == pool.arena().get());
+        assert(dynamic_cast<SerializerTransporterMessage&>(*msg).data() == "arena");
+    }
+
+    // after a reset, prototypes are looked up again
+    DynamicProtobufPrototypes::reset();
+    assert(DynamicProtobufPrototypes::prototype(dynamic_type).GetDescriptor()->full_name() ==
+           dynamic_type);
+
+    // resetting the manager along with the prototypes discards the dynamic type, but not the generated ones
+    DynamicProtobufPrototypes::reset_dynamic_protobuf_manager();
+    bool dynamic_type_found = true;
+    try
+    {
+        DynamicProtobufPrototypes::prototype(dynamic_type);
+    }
+    catch (std::exception&)
+    {
+        dynamic_type_found = false;
+    }
+    assert(!dynamic_type_found);
+    assert(DynamicProtobufPrototypes::prototype(
+               SerializerTransporterMessage::descriptor()->full_name())
+               .GetDescriptor() == SerializerTransporterMessage::descriptor());
+    load_dynamic_type();
+    assert(DynamicProtobufPrototypes::prototype(dynamic_type).GetDescriptor()->full_name() ==
+           dynamic_type);
+
+    std::cout << "all tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,178 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "goby/middleware/group.h"
+#include "goby/middleware/transport/interthread.h"
+#include "goby/util/debug_logger.h"
+
+// benchmarks the Group lookups on the interthread publish path, comparing a hash computed from the group string on every lookup (the previous implementation) against the precomputed Group::hash()
+// not run by ctest: the timings depend on the machine, so nothing is asserted about them
+
+using goby::middleware::DynamicGroup;
+using goby::middleware::Group;
+
+constexpr Group nav{"navigation"};
+
+// previous implementation, which allocated a std::string per call
+struct StringGroupHash
+{
+    size_t operator()(const Group& group) const noexcept
+    {
+        return std::hash<std::string>{}(std::string(group));
+    }
+};
+
+struct StringGroupEqual
+{
+    bool operator()(const Group& a, const Group& b) const
+    {
+        if (a.c_str() != nullptr && b.c_str() != nullptr)
+            return (std::string(a.c_str()) == std::string(b.c_str())) &&
+                   (a.numeric() == b.numeric());
+        else
+            return a.numeric() == b.numeric();
+    }
+};
+
+// the lookups done by detail::SubscriptionStore::publish(): subscription_groups_.equal_range() followed by DataQueue::find() per subscriber
+template <typename Hash, typename Equal> class PublishLookups
+{
+  public:
+    PublishLookups(const Group& group)
+    {
+        const int num_groups = 50;
+        for (int i = 0; i < num_groups; ++i)
+        {
+            groups_.emplace_back(new DynamicGroup("group_" + std::to_string(i)));
+            subscriptions_.insert(std::make_pair(*groups_.back(), i));
+            queue_.insert(std::make_pair(*groups_.back(), i));
+        }
+        subscriptions_.insert(std::make_pair(group, -1));
+        queue_.insert(std::make_pair(group, -1));
+    }
+
+    int lookup(const Group& group) const
+    {
+        int found = 0;
+        auto range = subscriptions_.equal_range(group);
+        for (auto it = range.first; it != range.second; ++it) found += queue_.find(group)->second;
+        return found;
+    }
+
+  private:
+    std::vector<std::unique_ptr<DynamicGroup>> groups_;
+    std::unordered_multimap<Group, int, Hash, Equal> subscriptions_;
+    std::unordered_map<Group, int, Hash, Equal> queue_;
+};
+
+// the lookups alone
+template <typename Hash, typename Equal> double time_lookups(const Group& group, int iterations)
+{
+    PublishLookups<Hash, Equal> lookups(group);
+
+    long found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) found += lookups.lookup(group);
+    auto end = std::chrono::steady_clock::now();
+    assert(found == -iterations);
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+// publish on group through an InterThreadTransporter until a subscriber thread has polled every publication; the publish path lookups are done again with Hash and Equal for each publication, so the difference between two runs is the cost of the hash on a real publish / poll loop
+template <typename Hash, typename Equal>
+double time_interthread(const Group& group, int iterations)
+{
+    PublishLookups<Hash, Equal> lookups(group);
+    goby::middleware::InterThreadTransporter publisher;
+    std::atomic<int> received(0);
+    std::atomic<bool> subscribed(false);
+
+    std::thread subscriber_thread([&]() {
+        goby::middleware::InterThreadTransporter subscriber;
+        subscriber.subscribe_dynamic<int>([&](std::shared_ptr<const int>) { ++received; },
+                                          group);
+        subscribed = true;
+        while (received < iterations) subscriber.poll(std::chrono::milliseconds(10));
+    });
+
+    while (!subscribed) std::this_thread::yield();
+
+    auto data = std::make_shared<const int>(1);
+    long found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        found += lookups.lookup(group);
+        publisher.publish_dynamic<int>(data, group);
+    }
+    subscriber_thread.join();
+    auto end = std::chrono::steady_clock::now();
+    assert(found == -iterations);
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+int main(int argc, char* argv[])
+{
+    goby::glog.add_stream(goby::util::logger::WARN, &std::cerr);
+    goby::glog.set_name(argv[0]);
+
+    const int iterations = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    DynamicGroup dyn_nav("navigation");
+
+    std::cout << "publish path group lookups (ns/publish):" << std::endl;
+    std::cout << "\tGroup: string hash: "
+              << time_lookups<StringGroupHash, StringGroupEqual>(nav, iterations)
+              << ", precomputed hash: "
+              << time_lookups<std::hash<Group>, std::equal_to<Group>>(nav, iterations)
+              << std::endl;
+    std::cout << "\tDynamicGroup: string hash: "
+              << time_lookups<StringGroupHash, StringGroupEqual>(dyn_nav, iterations)
+              << ", precomputed hash: "
+              << time_lookups<std::hash<Group>, std::equal_to<Group>>(dyn_nav, iterations)
+              << std::endl;
+
+    std::cout << "interthread publish and poll (ns/publish):" << std::endl;
+    std::cout << "\tGroup: string hash: "
+              << time_interthread<StringGroupHash, StringGroupEqual>(nav, iterations / 10)
+              << ", precomputed hash: "
+              << time_interthread<std::hash<Group>, std::equal_to<Group>>(nav, iterations / 10)
+              << std::endl;
+    std::cout << "\tDynamicGroup: string hash: "
+              << time_interthread<StringGroupHash, StringGroupEqual>(dyn_nav, iterations / 10)
+              << ", precomputed hash: "
+              << time_interthread<std::hash<Group>, std::equal_to<Group>>(dyn_nav,
+                                                                          iterations / 10)
+              << std::endl;
+}
@@ -0,0 +1,139 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "goby/middleware/group.h"
+#include "goby/util/debug_logger.h"
+
+// tests Group hashing and equality, including the c_str() identity of DynamicGroup copies
+
+using goby::middleware::DynamicGroup;
+using goby::middleware::Group;
+
+constexpr Group nav{"navigation"};
+constexpr Group status{"status", 2};
+constexpr Group numeric_only{3};
+
+// compile-time hash
+static_assert(nav.hash() != Group("navigation", 1).hash(), "numeric value must affect hash");
+static_assert(nav.hash() == Group("navigation").hash(), "hash must only depend on the values");
+
+void test_equality()
+{
+    DynamicGroup dyn_nav("navigation");
+    assert(dyn_nav == nav);
+    assert(nav == dyn_nav);
+    assert(dyn_nav.hash() == nav.hash());
+    assert(std::hash<Group>{}(dyn_nav) == std::hash<Group>{}(nav));
+
+    DynamicGroup dyn_status("status", 2);
+    assert(dyn_status == status);
+    assert(dyn_status.hash() == status.hash());
+    assert(DynamicGroup("status", 3) != status);
+    assert(DynamicGroup("status") != status);
+    assert(DynamicGroup(3) == numeric_only);
+    assert(DynamicGroup(3).hash() == numeric_only.hash());
+    assert(DynamicGroup(3).c_str() == nullptr);
+    assert(nav != status);
+
+    // same hash input, different strings
+    assert(DynamicGroup("ab") != DynamicGroup("ba"));
+    assert(DynamicGroup("navigation") != DynamicGroup("navigation_"));
+}
+
+void test_identity()
+{
+    // independently constructed groups compare equal but do not share storage
+    DynamicGroup a("identity_group");
+    DynamicGroup b(std::string("identity_") + "group");
+    assert(a == b);
+    assert(a.hash() == b.hash());
+    assert(a.c_str() != b.c_str());
+
+    // copies share storage, so they hit the pointer comparison in operator==
+    DynamicGroup c(a);
+    assert(c.c_str() == a.c_str());
+    assert(c == a);
+    b = a;
+    assert(b.c_str() == a.c_str());
+    assert(b.hash() == a.hash());
+
+    // the storage outlives the original as long as a copy exists
+    const char* storage = a.c_str();
+    {
+        DynamicGroup original("scoped_group", 4);
+        c = original;
+        storage = original.c_str();
+    }
+    assert(c.c_str() == storage);
+    assert(std::strcmp(c.c_str(), "scoped_group") == 0);
+    assert(c.numeric() == 4);
+    assert(c == Group("scoped_group", 4));
+
+    // a moved "from" group is copied, so it stays valid
+    DynamicGroup d(std::move(c));
+    assert(c.c_str() == d.c_str());
+    assert(c == d);
+
+    // sliced copies refer to the same storage
+    Group sliced = d;
+    assert(sliced.c_str() == d.c_str());
+    assert(sliced.hash() == d.hash());
+}
+
+void test_containers()
+{
+    std::unordered_multimap<Group, int> map;
+    map.insert(std::make_pair(nav, 1));
+    map.insert(std::make_pair(status, 2));
+    map.insert(std::make_pair(numeric_only, 3));
+    assert(map.count(DynamicGroup("navigation")) == 1);
+    assert(map.count(DynamicGroup("status", 2)) == 1);
+    assert(map.count(DynamicGroup("status", 1)) == 0);
+    assert(map.count(DynamicGroup(3)) == 1);
+
+    std::unordered_set<Group> set;
+    std::vector<DynamicGroup> groups;
+    for (int i = 0; i < 100; ++i) groups.emplace_back("group_" + std::to_string(i));
+    for (const auto& g : groups) set.insert(g);
+    for (const auto& g : groups) set.insert(g);
+    assert(set.size() == groups.size());
+    for (int i = 0; i < 100; ++i) assert(set.count(DynamicGroup("group_" + std::to_string(i))));
+}
+
+int main(int /*argc*/, char* argv[])
+{
+    goby::glog.add_stream(goby::util::logger::DEBUG3, &std::cerr);
+    goby::glog.set_name(argv[0]);
+
+    test_equality();
+    test_identity();
+    test_containers();
+
+    std::cout << "all tests passed" << std::endl;
+}
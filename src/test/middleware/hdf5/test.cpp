@@ -40,6 +40,14 @@ int main(int /*argc*/, char* argv[])
     std::cout << "Running: [" << sys_cmd << "]" << std::endl;
     int rc = system(sys_cmd.c_str());
 
+    // again, streaming the entries to the file (see goby_test_hdf5_writer for the background writes)
+    if (rc == 0)
+    {
+        std::string streaming_cmd = sys_cmd + " --memory_budget_mb 1";
+        std::cout << "Running: [" << streaming_cmd << "]" << std::endl;
+        rc = system(streaming_cmd.c_str());
+    }
+
     if (rc == 0)
     {
         std::cout << "All tests passed." << std::endl;
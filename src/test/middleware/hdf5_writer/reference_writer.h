@@ -0,0 +1,545 @@
+// Copyright 2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GOBY_TEST_MIDDLEWARE_HDF5_WRITER_REFERENCE_WRITER_H
+#define GOBY_TEST_MIDDLEWARE_HDF5_WRITER_REFERENCE_WRITER_H
+
+#include <algorithm>  // for max
+#include <cstdint>    // for uint64_t
+#include <functional> // for function
+#include <map>        // for map
+#include <memory>     // for unique_ptr
+#include <string>     // for string
+#include <vector>     // for vector
+
+#include <boost/algorithm/string/classification.hpp> // for is_any_of
+#include <boost/algorithm/string/trim.hpp>           // for trim_if
+
+#include <dccl/dynamic_protobuf_manager.h>
+
+#include "goby/exception.h"
+#include "goby/middleware/log/hdf5/hdf5.h"
+#include "goby/middleware/log/hdf5/hdf5_plugin.h"
+#include "goby/util/dccl_compat.h"
+#include "goby/util/debug_logger.h"
+
+namespace goby
+{
+namespace test
+{
+namespace middleware
+{
+namespace reference
+{
+using goby::middleware::HDF5ProtobufEntry;
+using goby::middleware::hdf5::predicate;
+using goby::middleware::hdf5::PBMeta;
+using goby::middleware::hdf5::retrieve_default_value;
+using goby::middleware::hdf5::retrieve_empty_value;
+using goby::middleware::hdf5::retrieve_repeated_value;
+using goby::middleware::hdf5::retrieve_single_value;
+
+/// \brief The hdf5::Writer as it was before it compiled column plans, which walks every field of every message with reflection and looks up each group and dataset in the file on every write. Kept so that the output of hdf5::Writer can be compared against it.
+class Writer
+{
+  public:
+    Writer(const std::string& output_file, bool write_zero_length_dim = true,
+           bool use_chunks = false, hsize_t chunk_length = 0, bool use_compression = false,
+           int compression_level = 0)
+        : h5file_(output_file, H5F_ACC_TRUNC),
+          group_factory_(h5file_),
+          write_zero_length_dim_(write_zero_length_dim),
+          use_chunks_(use_chunks),
+          chunk_length_(chunk_length),
+          use_compression_(use_compression),
+          compression_level_(compression_level),
+          final_write_(false)
+    {
+    }
+
+    void add_entry(HDF5ProtobufEntry entry)
+    {
+        if (final_write_)
+            throw(goby::Exception("add_entry() called after final_write = true"));
+
+        boost::trim_if(entry.channel,
+                       boost::algorithm::is_space() || boost::algorithm::is_any_of("/"));
+
+        auto it = channels_.find(entry.channel);
+        if (it == channels_.end())
+            it = channels_
+                     .insert(std::make_pair(entry.channel,
+                                            goby::middleware::hdf5::Channel(entry.channel)))
+                     .first;
+
+        auto channel_size = it->second.add_message(entry);
+
+        if (use_chunks_ && channel_size >= chunk_length_)
+            write_channel_chunk_and_clear(it->second);
+    }
+
+    void write(bool final_write = true)
+    {
+        if (final_write_)
+            throw(goby::Exception("write() called after final_write = true"));
+
+        final_write_ = final_write;
+        for (const auto& channel : channels_)
+        {
+            for (const auto& entry : channel.second.entries) write_message_collection(entry.second);
+        }
+    }
+
+  private:
+    void write_channel_chunk_and_clear(goby::middleware::hdf5::Channel& channel)
+    {
+        for (auto& entry : channel.entries)
+        {
+            if (entry.second.entries.size() >= chunk_length_)
+            {
+                write_message_collection(entry.second);
+                entry.second.entries.clear();
+            }
+        }
+    }
+
+    static std::vector<const google::protobuf::FieldDescriptor*>
+    extensions(const google::protobuf::Descriptor* desc)
+    {
+        std::vector<const google::protobuf::FieldDescriptor*> extensions;
+        google::protobuf::DescriptorPool::generated_pool()->FindAllExtensions(desc, &extensions);
+#ifdef DCCL_VERSION_4_1_OR_NEWER
+        dccl::DynamicProtobufManager::user_descriptor_pool_call(
+            &google::protobuf::DescriptorPool::FindAllExtensions, desc, &extensions);
+#else
+        dccl::DynamicProtobufManager::user_descriptor_pool().FindAllExtensions(desc, &extensions);
+#endif
+        return extensions;
+    }
+
+    void write_message_collection(
+        const goby::middleware::hdf5::MessageCollection& message_collection)
+    {
+        // (the original dereferenced begin() here even if a previous chunk emptied the collection)
+        if (message_collection.entries.empty())
+            return;
+
+        const auto& group = message_collection.group;
+        write_time(group, message_collection);
+        write_scheme(group, message_collection);
+
+        auto write_field = [&](const google::protobuf::FieldDescriptor* field_desc)
+        {
+            std::vector<const google::protobuf::Message*> messages;
+            for (const auto& entry : message_collection.entries)
+                messages.push_back(entry.second.msg.get());
+            std::vector<hsize_t> hs;
+            hs.push_back(messages.size());
+            write_field_selector(group, field_desc, messages, hs);
+        };
+
+        const google::protobuf::Descriptor* desc =
+            message_collection.entries.begin()->second.msg->GetDescriptor();
+        for (int i = 0, n = desc->field_count(); i < n; ++i) write_field(desc->field(i));
+        for (auto field_desc : extensions(desc)) write_field(field_desc);
+    }
+
+    void write_embedded_message(const std::string& group,
+                                const google::protobuf::FieldDescriptor* field_desc,
+                                const std::vector<const google::protobuf::Message*> messages,
+                                std::vector<hsize_t>& hs)
+    {
+        const google::protobuf::Descriptor* sub_desc = field_desc->message_type();
+        const std::string sub_group =
+            group + "/" + (field_desc->is_extension() ? field_desc->full_name() : field_desc->name());
+
+        std::function<void(const google::protobuf::FieldDescriptor*)> write_field;
+        int max_field_size = 0;
+        if (field_desc->is_repeated())
+        {
+            for (auto message : messages)
+            {
+                if (message)
+                    max_field_size = std::max(
+                        max_field_size, message->GetReflection()->FieldSize(*message, field_desc));
+            }
+
+            hs.push_back(max_field_size);
+
+            write_field = [&](const google::protobuf::FieldDescriptor* sub_field_desc)
+            {
+                std::vector<const google::protobuf::Message*> sub_messages(
+                    messages.size() * max_field_size, (const google::protobuf::Message*)nullptr);
+
+                bool has_submessages = false;
+                for (unsigned i = 0, n = messages.size(); i < n; ++i)
+                {
+                    if (messages[i])
+                    {
+                        const google::protobuf::Reflection* refl = messages[i]->GetReflection();
+                        int field_size = refl->FieldSize(*messages[i], field_desc);
+                        for (int j = 0; j < field_size; ++j)
+                            sub_messages[i * max_field_size + j] =
+                                &refl->GetRepeatedMessage(*messages[i], field_desc, j);
+                        has_submessages = true;
+                    }
+                }
+
+                // don't recurse unless one or more message requires it
+                if (has_submessages)
+                    write_field_selector(sub_group, sub_field_desc, sub_messages, hs);
+            };
+        }
+        else
+        {
+            write_field = [&](const google::protobuf::FieldDescriptor* sub_field_desc)
+            {
+                std::vector<const google::protobuf::Message*> sub_messages;
+                bool has_submessages = false;
+                for (auto message : messages)
+                {
+                    if (message)
+                    {
+                        sub_messages.push_back(
+                            &message->GetReflection()->GetMessage(*message, field_desc));
+                        has_submessages = true;
+                    }
+                    else
+                    {
+                        sub_messages.push_back(nullptr);
+                    }
+                }
+
+                if (has_submessages)
+                    write_field_selector(sub_group, sub_field_desc, sub_messages, hs);
+            };
+        }
+
+        for (int i = 0, n = sub_desc->field_count(); i < n; ++i) write_field(sub_desc->field(i));
+        for (auto sub_field_desc : extensions(sub_desc)) write_field(sub_field_desc);
+
+        if (field_desc->is_repeated())
+            hs.pop_back();
+    }
+
+    void write_field_selector(const std::string& group,
+                              const google::protobuf::FieldDescriptor* field_desc,
+                              const std::vector<const google::protobuf::Message*>& messages,
+                              std::vector<hsize_t>& hs)
+    {
+        switch (field_desc->cpp_type())
+        {
+            case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
+                if (field_desc->message_type()->full_name() !=
+                    "google.protobuf.FileDescriptorProto")
+                    write_embedded_message(group, field_desc, messages, hs);
+                break;
+
+            case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+                write_field<std::int32_t>(group, field_desc, messages, hs);
+                write_enum_attributes(group, field_desc);
+                break;
+
+            case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
+                write_field<std::int32_t>(group, field_desc, messages, hs);
+                break;
+
+            case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
+                write_field<std::int64_t>(group, field_desc, messages, hs);
+                break;
+
+            case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
+                write_field<std::uint32_t>(group, field_desc, messages, hs);
+                break;
+
+            case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
+                write_field<std::uint64_t>(group, field_desc, messages, hs);
+                break;
+
+            case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+                write_field<unsigned char>(group, field_desc, messages, hs);
+                break;
+
+            case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+                write_field<std::string>(group, field_desc, messages, hs);
+                break;
+
+            case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+                write_field<float>(group, field_desc, messages, hs);
+                break;
+
+            case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
+                write_field<double>(group, field_desc, messages, hs);
+                break;
+        }
+    }
+
+    void write_enum_attributes(const std::string& group,
+                               const google::protobuf::FieldDescriptor* field_desc)
+    {
+        H5::DataSet ds = group_factory_.fetch_group(group).openDataSet(field_desc->name());
+        if (ds.attrExists("enum_names") && ds.attrExists("enum_values"))
+            return;
+
+        const google::protobuf::EnumDescriptor* enum_desc = field_desc->enum_type();
+        std::vector<const char*> names(enum_desc->value_count(), (const char*)nullptr);
+        std::vector<std::int32_t> values(enum_desc->value_count(), 0);
+        for (int i = 0, n = enum_desc->value_count(); i < n; ++i)
+        {
+            names[i] = enum_desc->value(i)->name().c_str();
+            values[i] = enum_desc->value(i)->number();
+        }
+
+        hsize_t hs[] = {names.size()};
+        H5::DataSpace att_space(1, hs, hs);
+        if (!ds.attrExists("enum_names"))
+        {
+            H5::StrType att_type(H5::PredType::C_S1, H5T_VARIABLE);
+            ds.createAttribute("enum_names", att_type, att_space).write(att_type, &names[0]);
+        }
+        if (!ds.attrExists("enum_values"))
+        {
+            H5::IntType att_type(predicate<std::int32_t>());
+            ds.createAttribute("enum_values", att_type, att_space).write(att_type, &values[0]);
+        }
+    }
+
+    void write_time(const std::string& group,
+                    const goby::middleware::hdf5::MessageCollection& message_collection)
+    {
+        std::vector<std::uint64_t> utime;
+        std::vector<double> datenum;
+        for (const auto& entry : message_collection.entries)
+        {
+            // datenum(1970, 1, 1, 0, 0, 0)
+            const double datenum_unix_epoch = 719529;
+            const double seconds_in_day = 86400;
+            std::uint64_t utime_sec = entry.first / 1000000;
+            std::uint64_t utime_frac = entry.first - utime_sec * 1000000;
+            utime.push_back(entry.first);
+            datenum.push_back(datenum_unix_epoch +
+                              static_cast<double>(utime_sec) / seconds_in_day +
+                              static_cast<double>(utime_frac) / 1000000 / seconds_in_day);
+        }
+
+        std::vector<hsize_t> hs{message_collection.entries.size()};
+        write_vector(group, "_utime_", utime, hs, (std::uint64_t)0);
+        write_vector(group, "_datenum_", datenum, hs, (double)0);
+    }
+
+    void write_scheme(const std::string& group,
+                      const goby::middleware::hdf5::MessageCollection& message_collection)
+    {
+        std::vector<int> scheme;
+        for (const auto& entry : message_collection.entries) scheme.push_back(entry.second.scheme);
+
+        std::vector<hsize_t> hs{message_collection.entries.size()};
+        write_vector(group, "_scheme_", scheme, hs, (int)0);
+    }
+
+    template <typename T>
+    void write_field(const std::string& group, const google::protobuf::FieldDescriptor* field_desc,
+                     const std::vector<const google::protobuf::Message*>& messages,
+                     std::vector<hsize_t>& hs)
+    {
+        T default_value;
+        retrieve_default_value(&default_value, field_desc);
+
+        if (field_desc->is_repeated())
+        {
+            int max_field_size = 0;
+            for (auto message : messages)
+            {
+                if (message)
+                    max_field_size = std::max(
+                        max_field_size, message->GetReflection()->FieldSize(*message, field_desc));
+            }
+
+            hs.push_back(max_field_size);
+            std::vector<T> values(messages.size() * max_field_size, retrieve_empty_value<T>());
+            for (unsigned i = 0, n = messages.size(); i < n; ++i)
+            {
+                if (messages[i])
+                {
+                    const google::protobuf::Reflection* refl = messages[i]->GetReflection();
+                    int field_size = refl->FieldSize(*messages[i], field_desc);
+                    for (int j = 0; j < field_size; ++j)
+                        retrieve_repeated_value<T>(&values[i * max_field_size + j], j,
+                                                   PBMeta(refl, field_desc, (*messages[i])));
+                }
+            }
+            write_vector(group, field_desc->name(), values, hs, default_value);
+            hs.pop_back();
+        }
+        else
+        {
+            std::vector<T> values(messages.size(), retrieve_empty_value<T>());
+            for (unsigned i = 0, n = messages.size(); i < n; ++i)
+            {
+                if (messages[i])
+                    retrieve_single_value<T>(
+                        &values[i],
+                        PBMeta(messages[i]->GetReflection(), field_desc, (*messages[i])));
+            }
+            write_vector(group, field_desc->name(), values, hs, default_value);
+        }
+    }
+
+    // creates the dataset (chunked if needed), or extends it if it already exists
+    H5::DataSet create_or_extend(H5::Group& grp, const std::string& dataset_name,
+                                 const H5::DataType& type, const std::vector<hsize_t>& hs,
+                                 bool has_data, hsize_t last_chunk_dim, const void* fill_value,
+                                 const void* data)
+    {
+        if (grp.exists(dataset_name))
+        {
+            H5::DataSet dataset = grp.openDataSet(dataset_name);
+            H5::DataSpace existing_space(dataset.getSpace());
+            std::vector<hsize_t> existing_hs(existing_space.getSimpleExtentNdims());
+            existing_space.getSimpleExtentDims(&existing_hs[0]);
+
+            // new size is larger of the existing or new vectors, except for the first dimension which is the sum
+            std::vector<hsize_t> new_size(hs.size(), 0);
+            for (int i = 0, n = new_size.size(); i < n; ++i)
+                new_size[i] = std::max(hs[i], existing_hs[i]);
+            new_size.front() = existing_hs.front() + hs.front();
+            dataset.extend(new_size.data());
+
+            H5::DataSpace memspace(hs.size(), hs.data());
+            H5::DataSpace filespace(dataset.getSpace());
+            std::vector<hsize_t> offset(hs.size(), 0);
+            offset.front() = existing_hs.front();
+            filespace.selectHyperslab(H5S_SELECT_SET, hs.data(), offset.data());
+            if (has_data)
+                dataset.write(data, type, memspace, filespace);
+            return dataset;
+        }
+
+        auto maxhs = hs;
+        H5::DSetCreatPropList prop;
+        if (use_chunks_ && !final_write_)
+        {
+            for (auto& m : maxhs) m = H5S_UNLIMITED;
+            auto chunkhs = hs;
+            chunkhs.front() = chunk_length_;
+            if (last_chunk_dim)
+                chunkhs.back() = last_chunk_dim;
+            for (auto& s : chunkhs)
+            {
+                if (s == 0)
+                    s = 1;
+            }
+            prop.setChunk(chunkhs.size(), chunkhs.data());
+            prop.setFillValue(type, fill_value);
+            if (use_compression_)
+                prop.setDeflate(compression_level_);
+        }
+
+        std::unique_ptr<H5::DataSpace> dataspace;
+        if (has_data || write_zero_length_dim_)
+            dataspace = std::make_unique<H5::DataSpace>(hs.size(), hs.data(), maxhs.data());
+        else
+            dataspace = std::make_unique<H5::DataSpace>(H5S_NULL);
+
+        H5::DataSet dataset = grp.createDataSet(dataset_name, type, *dataspace, prop);
+        if (has_data)
+            dataset.write(data, type);
+        return dataset;
+    }
+
+    template <typename T>
+    void write_vector(const std::string& group, const std::string dataset_name,
+                      const std::vector<T>& data, const std::vector<hsize_t>& hs,
+                      const T& default_value, T empty_value = retrieve_empty_value<T>())
+    {
+        H5::DataSet dataset =
+            create_or_extend(group_factory_.fetch_group(group), dataset_name, predicate<T>(), hs,
+                             !data.empty(), 0, &empty_value, data.data());
+
+        if (!dataset.attrExists("default_value"))
+        {
+            hsize_t att_hs[] = {1};
+            H5::DataSpace att_space(1, att_hs, att_hs);
+            dataset.createAttribute("default_value", predicate<T>(), att_space)
+                .write(predicate<T>(), &default_value);
+        }
+    }
+
+    void write_vector(const std::string& group, const std::string& dataset_name,
+                      const std::vector<std::string>& data, const std::vector<hsize_t>& hs_outer,
+                      const std::string& default_value)
+    {
+        std::vector<std::uint32_t> sizes;
+        std::size_t max_size = 0;
+        for (const auto& d : data)
+        {
+            sizes.push_back(d.size());
+            max_size = std::max(max_size, d.size());
+        }
+
+        char fill_value = '\0';
+        std::vector<char> data_char;
+        for (auto d : data)
+        {
+            d.resize(max_size, fill_value);
+            data_char.insert(data_char.end(), d.begin(), d.end());
+        }
+        std::vector<hsize_t> hs = hs_outer;
+        hs.push_back(max_size);
+
+        // string width dimension is chunked by 256
+        H5::DataSet dataset = create_or_extend(group_factory_.fetch_group(group), dataset_name,
+                                               H5::PredType::NATIVE_CHAR, hs, !data_char.empty(),
+                                               256, &fill_value, data_char.data());
+
+        write_vector(group, dataset_name + "_size", sizes, hs_outer, std::uint32_t(0),
+                     static_cast<std::uint32_t>(0) /* use empty value of 0 not uint32 max */);
+
+        if (!dataset.attrExists("default_value"))
+        {
+            hsize_t att_hs[] = {1};
+            H5::DataSpace att_space(1, att_hs, att_hs);
+            H5::StrType att_datatype(H5::PredType::C_S1, default_value.size() + 1);
+            dataset.createAttribute("default_value", att_datatype, att_space)
+                .write(att_datatype, H5std_string(default_value));
+        }
+    }
+
+  private:
+    std::map<std::string, goby::middleware::hdf5::Channel> channels_;
+    H5::H5File h5file_;
+    goby::middleware::hdf5::GroupFactory group_factory_;
+    bool write_zero_length_dim_;
+    bool use_chunks_;
+    hsize_t chunk_length_;
+    bool use_compression_;
+    int compression_level_;
+    bool final_write_;
+};
+
+} // namespace reference
+} // namespace middleware
+} // namespace test
+} // namespace goby
+
+#endif
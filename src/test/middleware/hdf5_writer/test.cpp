@@ -0,0 +1,383 @@
+// Copyright 2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <H5Cpp.h>
+
+// before hdf5.h, which uses glog
+#include "goby/util/debug_logger.h"
+
+#include "goby/middleware/log/hdf5/hdf5.h"
+#include "goby/middleware/log/hdf5/hdf5_plugin.h"
+#include "goby/util/binary.h"
+
+#include "goby/test/middleware/hdf5_writer/test.pb.h"
+#include "reference_writer.h"
+
+// tests that hdf5::Writer writes the same datasets as the writer it replaced (reference::Writer)
+
+using goby::middleware::HDF5ProtobufEntry;
+using goby::test::middleware::protobuf::WriterTestInner;
+using goby::test::middleware::protobuf::WriterTestMessage;
+using goby::test::middleware::protobuf::WriterTestOther;
+
+const std::string reference_file("/tmp/goby3_test_hdf5_writer_reference.h5");
+const std::string output_file("/tmp/goby3_test_hdf5_writer.h5");
+const std::uint64_t start_utime = 1700000000000000;
+
+void fill_inner(WriterTestInner* inner, int i, int depth)
+{
+    inner->set_x(i * 0.5);
+    for (int j = 0; j < i % 4; ++j) inner->add_y(i * 10 + j);
+    if (i % 3)
+        inner->set_label(std::string(i % 7, 'a' + i % 26));
+    if (i % 2)
+        inner->set_color(goby::test::middleware::protobuf::BLUE);
+    // the depth of recursion varies between messages (and so between chunks)
+    for (int j = 0; j < depth; ++j) fill_inner(inner->add_child(), i + j, depth - 1 - j);
+}
+
+HDF5ProtobufEntry make_entry(int i)
+{
+    HDF5ProtobufEntry entry;
+    entry.time = goby::time::MicroTime::from_value(start_utime + i * 1000);
+    entry.scheme = i % 3 ? 1 : 2;
+
+    if (i % 5 == 4)
+    {
+        auto msg = std::make_shared<WriterTestOther>();
+        msg->set_n(i);
+        for (int j = 0; j < i % 3; ++j) msg->add_names("name" + std::to_string(i * j));
+        entry.msg = msg;
+        entry.channel = "/other/";
+        return entry;
+    }
+
+    auto msg = std::make_shared<WriterTestMessage>();
+    // leave some fields unset, so that empty and default values are written
+    if (i % 2)
+    {
+        msg->set_d(i + 0.25);
+        msg->set_f(i + 0.5f);
+        msg->set_i64(-i * 1000000000LL);
+        msg->set_u64(i * 3000000000ULL);
+        msg->set_b(i % 4 == 1);
+    }
+    if (i % 3)
+    {
+        msg->set_i32(-i);
+        msg->set_u32(i);
+        msg->set_color(goby::test::middleware::protobuf::RED);
+    }
+    // strings both shorter and longer than a string chunk (256)
+    if (i % 4)
+        msg->set_s(std::string((i * 37) % 300, 'A' + i % 26));
+    msg->set_raw(std::string("\0\x01\xff", 3) + std::to_string(i));
+
+    for (int j = 0; j < i % 5; ++j) msg->add_rd(i + j * 0.1);
+    for (int j = 0; j < i % 3; ++j) msg->add_rs(std::string(j + i % 11, 'x'));
+    for (int j = 0; j < (i + 1) % 4; ++j) msg->add_rb(j % 2);
+    for (int j = 0; j < i % 2; ++j) msg->add_rcolor(goby::test::middleware::protobuf::GREEN);
+
+    if (i % 6)
+        fill_inner(msg->mutable_inner(), i, i % 3);
+    for (int j = 0; j < i % 4; ++j) fill_inner(msg->add_rinner(), i + j, (i + j) % 3);
+
+    if (i % 7 == 0)
+        msg->SetExtension(goby::test::middleware::protobuf::ext_int, i);
+    for (int j = 0; j < i % 2; ++j)
+        fill_inner(msg->AddExtension(goby::test::middleware::protobuf::ext_inner), i, 1);
+
+    entry.msg = msg;
+    // leading and trailing whitespace and "/" are trimmed
+    entry.channel = i % 2 ? " nav/fast" : "\tnav/slow/";
+    return entry;
+}
+
+// everything about a dataset or group that should be the same for both writers, by path
+std::map<std::string, std::string> dump(const std::string& file_name)
+{
+    std::map<std::string, std::string> objects;
+    H5::H5File file(file_name, H5F_ACC_RDONLY);
+
+    auto type_str = [](const H5::DataType& type)
+    {
+        std::stringstream ss;
+        ss << "class " << type.getClass() << " size " << type.getSize();
+        if (type.getClass() == H5T_INTEGER)
+            ss << " sign " << H5::IntType(type.getId()).getSign();
+        return ss.str();
+    };
+
+    auto dims_str = [](const std::vector<hsize_t>& dims)
+    {
+        std::stringstream ss;
+        for (auto d : dims) ss << (d == H5S_UNLIMITED ? std::string("U") : std::to_string(d)) << ",";
+        return ss.str();
+    };
+
+    auto attributes_str = [&](const H5::DataSet& ds)
+    {
+        std::map<std::string, std::string> attributes;
+        for (int i = 0, n = ds.getNumAttrs(); i < n; ++i)
+        {
+            H5::Attribute att = ds.openAttribute(static_cast<unsigned>(i));
+            H5::DataType type = att.getDataType();
+            hssize_t points = att.getSpace().getSimpleExtentNpoints();
+            std::string value = type_str(type) + ": ";
+            if (type.isVariableStr())
+            {
+                std::vector<char*> strs(points);
+                att.read(type, strs.data());
+                for (auto s : strs) value += std::string(s) + ";";
+                H5::DataSet::vlenReclaim(strs.data(), type, att.getSpace());
+            }
+            else
+            {
+                std::vector<char> bytes(points * type.getSize());
+                att.read(type, bytes.data());
+                value += goby::util::hex_encode(std::string(bytes.begin(), bytes.end()));
+            }
+            attributes[att.getName()] = value;
+        }
+        std::string s;
+        for (const auto& a : attributes) s += " [" + a.first + " = " + a.second + "]";
+        return s;
+    };
+
+    std::function<void(H5::Group&, const std::string&)> dump_group =
+        [&](H5::Group& group, const std::string& path)
+    {
+        for (hsize_t i = 0, n = group.getNumObjs(); i < n; ++i)
+        {
+            std::string name = group.getObjnameByIdx(i);
+            std::string child_path = path + "/" + name;
+            if (group.childObjType(name) == H5O_TYPE_GROUP)
+            {
+                objects[child_path] = "group";
+                H5::Group child = group.openGroup(name);
+                dump_group(child, child_path);
+                continue;
+            }
+
+            H5::DataSet ds = group.openDataSet(name);
+            H5::DataType type = ds.getDataType();
+            H5::DataSpace space = ds.getSpace();
+            std::stringstream ss;
+            ss << type_str(type);
+
+            if (space.getSimpleExtentType() == H5S_NULL)
+            {
+                ss << " null";
+            }
+            else
+            {
+                int rank = space.getSimpleExtentNdims();
+                std::vector<hsize_t> dims(rank), maxdims(rank);
+                space.getSimpleExtentDims(dims.data(), maxdims.data());
+                ss << " dims " << dims_str(dims) << " maxdims " << dims_str(maxdims);
+
+                H5::DSetCreatPropList prop = ds.getCreatePlist();
+                if (prop.getLayout() == H5D_CHUNKED)
+                {
+                    std::vector<hsize_t> chunk(rank);
+                    prop.getChunk(rank, chunk.data());
+                    ss << " chunk " << dims_str(chunk) << " filters " << prop.getNfilters();
+                }
+
+                std::vector<char> bytes(space.getSimpleExtentNpoints() * type.getSize());
+                if (!bytes.empty())
+                    ds.read(bytes.data(), type);
+                ss << " data " << std::hash<std::string>()(std::string(bytes.begin(), bytes.end()))
+                   << " (" << bytes.size() << " bytes)";
+            }
+
+            ss << attributes_str(ds);
+            objects[child_path] = ss.str();
+        }
+    };
+
+    H5::Group root = file.openGroup("/");
+    dump_group(root, "");
+    return objects;
+}
+
+void check_same(const std::map<std::string, std::string>& expected,
+                const std::map<std::string, std::string>& actual)
+{
+    bool same = true;
+    for (const auto& object : expected)
+    {
+        auto it = actual.find(object.first);
+        if (it == actual.end())
+        {
+            std::cout << "Missing: " << object.first << std::endl;
+            same = false;
+        }
+        else if (it->second != object.second)
+        {
+            std::cout << "Differs: " << object.first << "\n\texpected: " << object.second
+                      << "\n\tactual:   " << it->second << std::endl;
+            same = false;
+        }
+    }
+    for (const auto& object : actual)
+    {
+        if (!expected.count(object.first))
+        {
+            std::cout << "Unexpected: " << object.first << std::endl;
+            same = false;
+        }
+    }
+    assert(same);
+}
+
+struct Options
+{
+    std::string name;
+    bool write_zero_length_dim{true};
+    bool use_chunks{false};
+    hsize_t chunk_length{0};
+    bool use_compression{false};
+    int compression_level{0};
+};
+
+void test_same_as_reference(const Options& options, int n)
+{
+    {
+        goby::test::middleware::reference::Writer reference(
+            reference_file, options.write_zero_length_dim, options.use_chunks,
+            options.chunk_length, options.use_compression, options.compression_level);
+        for (int i = 0; i < n; ++i) reference.add_entry(make_entry(i));
+        reference.write();
+    }
+
+    {
+        goby::middleware::hdf5::Writer writer(output_file, options.write_zero_length_dim,
+                                              options.use_chunks, options.chunk_length,
+                                              options.use_compression, options.compression_level);
+        for (int i = 0; i < n; ++i) writer.add_entry(make_entry(i));
+        writer.write();
+    }
+
+    auto expected = dump(reference_file);
+    check_same(expected, dump(output_file));
+    std::cout << options.name << ": " << expected.size() << " groups and datasets match"
+              << std::endl;
+}
+
+// with a memory budget, entries are written by the background thread as they are added: the datasets are chunked and extended, but hold the same data as those written all at once
+void test_streaming(int n, std::size_t memory_budget)
+{
+    {
+        goby::test::middleware::reference::Writer reference(reference_file);
+        for (int i = 0; i < n; ++i) reference.add_entry(make_entry(i));
+        reference.write();
+    }
+
+    goby::middleware::hdf5::Writer::Statistics stats;
+    {
+        goby::middleware::hdf5::Writer writer(output_file, true, false, 0, false, 0,
+                                              memory_budget);
+        for (int i = 0; i < n; ++i) writer.add_entry(make_entry(i));
+        writer.write();
+        stats = writer.statistics();
+    }
+    std::cout << "Streaming (budget " << memory_budget / 1024 << " KiB): " << stats << std::endl;
+
+    // the budget forced several background writes, which wrote most of the entries
+    assert(stats.flushes > 1);
+    assert(stats.entries_flushed > static_cast<std::uint64_t>(n / 2));
+    assert(stats.entries_flushed <= static_cast<std::uint64_t>(n));
+    // entries are only added beyond the budget while the largest ones are handed off
+    assert(stats.peak_memory > 0 && stats.peak_memory <= memory_budget + memory_budget / 4);
+
+    // compare the data, not the layout
+    auto data_only = [](std::map<std::string, std::string> objects)
+    {
+        for (auto& object : objects)
+        {
+            auto& s = object.second;
+            for (const std::string& key : {std::string(" maxdims "), std::string(" chunk ")})
+            {
+                auto pos = s.find(key);
+                if (pos != std::string::npos)
+                    s.erase(pos, s.find(" data ") - pos);
+            }
+        }
+        return objects;
+    };
+
+    auto expected = data_only(dump(reference_file));
+    check_same(expected, data_only(dump(output_file)));
+    std::cout << "Streaming: " << expected.size() << " groups and datasets match" << std::endl;
+}
+
+int main(int /*argc*/, char* argv[])
+{
+    goby::glog.add_stream(goby::util::logger::WARN, &std::cerr);
+    goby::glog.set_name(argv[0]);
+
+    const int n = 500;
+
+    Options contiguous;
+    contiguous.name = "Contiguous";
+    test_same_as_reference(contiguous, n);
+
+    Options no_zero_length_dim = contiguous;
+    no_zero_length_dim.name = "Contiguous, no zero length dimensions";
+    no_zero_length_dim.write_zero_length_dim = false;
+    test_same_as_reference(no_zero_length_dim, n);
+
+    Options chunks;
+    chunks.name = "Chunks";
+    chunks.use_chunks = true;
+    chunks.chunk_length = 32;
+    test_same_as_reference(chunks, n);
+
+    // a chunk boundary falls exactly at the end of the entries
+    Options exact_chunks = chunks;
+    exact_chunks.name = "Chunks, ending on a chunk boundary";
+    exact_chunks.chunk_length = 25;
+    test_same_as_reference(exact_chunks, n);
+
+    Options compressed = chunks;
+    compressed.name = "Compressed chunks";
+    compressed.use_compression = true;
+    compressed.compression_level = 4;
+    test_same_as_reference(compressed, n);
+
+    test_streaming(4000, 64 * 1024);
+
+    std::cout << "all tests passed" << std::endl;
+    return 0;
+}
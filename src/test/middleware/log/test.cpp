@@ -24,6 +24,7 @@
 #include "goby/middleware/log.h"
 #include "goby/middleware/log/dccl_log_plugin.h"
 #include "goby/middleware/log/protobuf_log_plugin.h"
+#include "goby/middleware/marshalling/detail/dynamic_protobuf_prototypes.h"
 #include "goby/middleware/marshalling/interface.h"
 #include "goby/util/debug_logger.h"
 
@@ -50,7 +51,7 @@ void read_log(int test, int version)
     goby::middleware::log::ProtobufPlugin pb_plugin;
     goby::middleware::log::DCCLPlugin dccl_plugin;
     LogEntry::reset();
-    dccl::DynamicProtobufManager::reset();
+    goby::middleware::detail::DynamicProtobufPrototypes::reset_dynamic_protobuf_manager();
 
     // can't read version since we corrupted it
     if (test == 1 && version < LogEntry::compiled_current_version)
@@ -145,6 +146,7 @@ void write_log(int test, int version)
     goby::middleware::log::DCCLPlugin dccl_plugin;
     LogEntry::reset();
     LogEntry::set_current_version(version);
+    LogEntry::set_compressed_blocks(version >= LogEntry::compressed_block_version);
     std::ofstream out_log_file("/tmp/goby3_test_log.goby");
     pb_plugin.register_write_hooks(out_log_file);
     dccl_plugin.register_write_hooks(out_log_file);
@@ -250,6 +252,25 @@ void write_log(int test, int version)
     }
 }
 
+// logs are only tagged with the version that added compressed blocks if they may contain them
+void test_written_version()
+{
+    for (bool compressed_blocks : {false, true})
+    {
+        LogEntry::reset();
+        LogEntry::set_compressed_blocks(compressed_blocks);
+        std::ostringstream out;
+        LogEntry entry({1, 2, 3}, goby::middleware::MarshallingScheme::PROTOBUF, "Foo",
+                       tempgroup);
+        entry.serialize(&out);
+        std::cout << "Compressed blocks: " << std::boolalpha << compressed_blocks
+                  << ", written version: " << LogEntry::version_ << std::endl;
+        assert(LogEntry::version_ == (compressed_blocks ? LogEntry::compiled_current_version
+                                                        : LogEntry::uncompressed_version));
+    }
+    LogEntry::set_compressed_blocks(false);
+}
+
 int main(int /*argc*/, char* argv[])
 {
     goby::glog.add_stream(goby::util::logger::DEBUG3, &std::cerr);
@@ -258,7 +279,7 @@ int main(int /*argc*/, char* argv[])
     codec.load<CTDSample>();
 
     int ntests = 7;
-    int nversions = 3;
+    int nversions = 4;
 
     for (int version = 1; version <= nversions; ++version)
     {
@@ -270,5 +291,7 @@ int main(int /*argc*/, char* argv[])
         }
     }
 
+    test_written_version();
+
     std::cout << "all tests passed" << std::endl;
 }
@@ -0,0 +1,415 @@
+// Copyright 2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "goby/middleware/log/compression.h"
+#include "goby/middleware/log/log_entry.h"
+#include "goby/middleware/log/log_index.h"
+#include "goby/middleware/log/log_reader.h"
+#include "goby/middleware/log/log_writer.h"
+#include "goby/middleware/marshalling/interface.h"
+
+// tests writing and reading logs with compressed blocks (version 4)
+
+using goby::middleware::MarshallingScheme;
+using goby::middleware::log::Compression;
+using goby::middleware::log::LogEntry;
+using goby::middleware::log::LogException;
+using goby::middleware::log::LogIndex;
+using goby::middleware::log::LogReader;
+
+const std::string log_file("/tmp/goby3_test_log_compression.goby");
+const std::string rebuilt_index_file("/tmp/goby3_test_log_compression_rebuilt.goby.idx");
+const std::string other_log_file("/tmp/goby3_test_log_compression_other.goby");
+const int n = 2000;
+const goby::time::SystemClock::time_point start_time{
+    std::chrono::time_point_cast<std::chrono::microseconds>(goby::time::SystemClock::now())};
+
+const std::string hook_type("HookType");
+int hook_calls = 0;
+
+std::vector<unsigned char> entry_data(int i)
+{
+    // a few entries are larger than a compressed block, so are written uncompressed
+    std::vector<unsigned char> data(i % 500 == 250 ? 6000 : i % 200);
+    for (std::size_t j = 0; j < data.size(); ++j) data[j] = (j / 16 + i) & 0xFF;
+    return data;
+}
+
+std::string entry_group(int i) { return "group" + std::to_string(i % 5); }
+std::string entry_type(int i)
+{
+    // new types (and so metadata) appear throughout the log
+    return i % 50 == 1 ? hook_type : "Type" + std::to_string(i % (3 + i / 500));
+}
+int entry_scheme(int i) { return i % 2 ? MarshallingScheme::PROTOBUF : MarshallingScheme::JSON; }
+goby::time::SystemClock::time_point entry_time(int i)
+{
+    return start_time + std::chrono::milliseconds(i);
+}
+
+bool hooked(int i)
+{
+    return entry_type(i) == hook_type && entry_scheme(i) == MarshallingScheme::PROTOBUF;
+}
+const int n_hooked = n / 50;
+
+void reset_read()
+{
+    LogEntry::reset();
+    hook_calls = 0;
+    // entries of hook_type and scheme PROTOBUF are consumed by the hook, as Protobuf file descriptors are
+    for (int g = 0; g < 5; ++g)
+        LogEntry::filter_hook[{MarshallingScheme::PROTOBUF, entry_group(g), hook_type}] =
+            [](const std::vector<unsigned char>& data) { ++hook_calls; };
+}
+
+bool matches(const LogEntry& entry, int i)
+{
+    return entry.data() == entry_data(i) && entry.scheme() == entry_scheme(i) &&
+           entry.type() == entry_type(i) && std::string(entry.group()) == entry_group(i) &&
+           entry.timestamp() == entry_time(i);
+}
+
+// entry must be a later entry than the last one read (i - 1), skipping any lost to corruption
+void check_entry(const LogEntry& entry, int* i)
+{
+    // if the metadata for a type was lost to corruption, the entry can't be identified
+    if (entry.type().compare(0, 8, "_unknown") == 0)
+        return;
+
+    while (*i < n && (hooked(*i) || !matches(entry, *i))) ++*i;
+    assert(*i < n);
+    ++*i;
+}
+
+// writes entries shift, shift + 1, ... (modulo n)
+std::uint64_t write_log(Compression compression, const std::string& path = log_file,
+                        int shift = 0)
+{
+    LogEntry::reset();
+    LogEntry::set_compressed_blocks(compression != Compression::NONE);
+    goby::middleware::log::LogWriter::Options options;
+    options.compression = compression;
+    options.compression_block_size = 4096;
+    options.index_block_size = 16384;
+    std::uint64_t uncompressed_size = 0;
+    {
+        goby::middleware::log::LogWriter writer(path, options);
+        for (int k = 0; k < n; ++k)
+        {
+            int i = (k + shift) % n;
+            while (writer.statistics().queue_depth >= options.queue_size / 2)
+                std::this_thread::yield();
+
+            std::ostringstream staging;
+            LogEntry entry(entry_data(i), entry_scheme(i), entry_type(i),
+                           goby::middleware::DynamicGroup(entry_group(i)), entry_time(i));
+            entry.serialize(&staging);
+            std::string bytes = staging.str();
+            uncompressed_size += bytes.size();
+            bool queued = writer.write(bytes, entry);
+            assert(queued);
+        }
+    }
+    return uncompressed_size;
+}
+
+std::string read_file()
+{
+    std::ifstream in(log_file.c_str());
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// returns entries read, and counts exceptions in errors
+int read_parse(int* errors)
+{
+    reset_read();
+    std::ifstream in(log_file.c_str());
+    int read = 0, i = 0;
+    for (;;)
+    {
+        LogEntry entry;
+        try
+        {
+            entry.parse(&in);
+        }
+        catch (LogException& e)
+        {
+            ++*errors;
+            continue;
+        }
+        catch (std::ifstream::failure& e)
+        {
+            break;
+        }
+
+        check_entry(entry, &i);
+        ++read;
+    }
+    return read;
+}
+
+int read_reader(int* errors)
+{
+    reset_read();
+    LogReader reader(log_file);
+    LogEntry entry;
+    int read = 0, i = 0;
+    for (;;)
+    {
+        try
+        {
+            if (!reader.next(&entry))
+                break;
+        }
+        catch (LogException& e)
+        {
+            ++*errors;
+            continue;
+        }
+
+        check_entry(entry, &i);
+        ++read;
+    }
+    assert(reader.tell() == reader.size());
+    return read;
+}
+
+void test_read(Compression compression)
+{
+    auto uncompressed_size = write_log(compression);
+    auto compressed_size = read_file().size();
+    std::cout << goby::middleware::log::compression_name(compression) << ": " << uncompressed_size
+              << " bytes compressed to " << compressed_size << std::endl;
+    assert(compressed_size < uncompressed_size / 2);
+
+    int errors = 0;
+    assert(read_parse(&errors) == n - n_hooked);
+    assert(errors == 0);
+    assert(hook_calls == n_hooked);
+
+    assert(read_reader(&errors) == n - n_hooked);
+    assert(errors == 0);
+    assert(hook_calls == n_hooked);
+}
+
+// each read uses a new LogIndex, as it tracks the metadata read from the log
+int read_indexed(const std::string& index_file, bool use_reader)
+{
+    reset_read();
+    LogIndex index(index_file, read_file().size());
+    assert(index.complete());
+    index.set_filter([](const LogIndex::Key& key) { return key.type == "Type2"; });
+
+    std::ifstream in(log_file.c_str());
+    LogReader reader(log_file);
+    auto seek_to = index.blocks()[index.find_block(entry_time(n / 2))].offset();
+    use_reader ? index.seek(reader, seek_to) : index.seek(in, seek_to);
+
+    int matched = 0;
+    LogEntry entry;
+    for (;;)
+    {
+        try
+        {
+            if (use_reader)
+            {
+                if (!index.next(reader) || !reader.next(&entry))
+                    break;
+            }
+            else
+            {
+                if (!index.next(in))
+                    break;
+                entry.parse(&in);
+            }
+        }
+        catch (std::ifstream::failure& e)
+        {
+            break;
+        }
+
+        // group and type names are known despite seeking past their metadata
+        assert(entry.type().compare(0, 4, "Type") == 0);
+        if (entry.type() == "Type2")
+        {
+            assert(entry.timestamp() >= entry_time(n / 2) - std::chrono::seconds(1));
+            ++matched;
+        }
+    }
+    return matched;
+}
+
+void test_index(Compression compression)
+{
+    write_log(compression);
+
+    int expected = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        if (entry_type(i) == "Type2" && entry_time(i) >= entry_time(n / 2))
+            ++expected;
+    }
+
+    assert(LogIndex::load(log_file));
+    int matched = read_indexed(LogIndex::path(log_file), false);
+    std::cout << "Index: " << matched << " entries (" << expected << " after seek time)"
+              << std::endl;
+    assert(matched >= expected);
+    assert(read_indexed(LogIndex::path(log_file), true) == matched);
+
+    // the index rebuilt from the log works the same way
+    reset_read();
+    {
+        std::ifstream in(log_file.c_str());
+        auto entries = LogIndex::build(in, rebuilt_index_file, 16384);
+        assert(entries == static_cast<std::uint64_t>(n - n_hooked));
+    }
+    assert(read_indexed(rebuilt_index_file, false) >= expected);
+    assert(read_indexed(rebuilt_index_file, true) >= expected);
+}
+
+// reads two logs in turn, each with its own LogEntry::ReadState
+void test_interleaved(Compression compression)
+{
+    // the other log starts part way through the entries, so its group and type indices differ
+    const int shift[2] = {0, n / 3};
+    write_log(Compression::NONE, other_log_file, shift[1]);
+    write_log(compression);
+
+    reset_read();
+    LogEntry::ReadState states[2];
+    std::ifstream in[2];
+    in[0].open(log_file.c_str());
+    in[1].open(other_log_file.c_str());
+    int next[2] = {0, 0}, read[2] = {0, 0};
+    bool done[2] = {false, false};
+    while (!done[0] || !done[1])
+    {
+        for (int f = 0; f < 2; ++f)
+        {
+            LogEntry::swap_read_state(states[f]);
+            // read a different number of entries from each log so that compressed blocks are left part read
+            for (int k = 0; k < 3 + 4 * f && !done[f]; ++k)
+            {
+                LogEntry entry;
+                try
+                {
+                    entry.parse(&in[f]);
+                }
+                catch (std::ifstream::failure& e)
+                {
+                    done[f] = true;
+                    break;
+                }
+
+                while (hooked((next[f] + shift[f]) % n)) ++next[f];
+                assert(matches(entry, (next[f] + shift[f]) % n));
+                ++next[f];
+                ++read[f];
+            }
+            LogEntry::swap_read_state(states[f]);
+        }
+    }
+
+    std::cout << "Interleaved: read " << read[0] << " and " << read[1] << " entries" << std::endl;
+    assert(read[0] == n - n_hooked && read[1] == n - n_hooked);
+    assert(hook_calls == 2 * n_hooked);
+}
+
+void test_corrupt(Compression compression)
+{
+    write_log(compression);
+
+    // corrupt the data of a compressed block in the middle
+    std::string bytes = read_file();
+    auto block = bytes.find("GBYZ", bytes.size() / 2);
+    assert(block != std::string::npos);
+    bytes[block + LogEntry::block_header_bytes_ + 10] ^= 0x55;
+    {
+        std::ofstream out(log_file.c_str());
+        out << bytes;
+    }
+
+    int errors = 0;
+    int read = read_parse(&errors);
+    std::cout << "Corrupt log (parse): read " << read << " entries, " << errors << " errors"
+              << std::endl;
+    // lose the entries of the corrupt block (at most 4096 bytes of entries, each 4096 / 50 bytes or more on average)
+    assert(errors >= 1);
+    assert(read < n - n_hooked && read > n - n_hooked - 100);
+
+    errors = 0;
+    int reader_read = read_reader(&errors);
+    std::cout << "Corrupt log (LogReader): read " << reader_read << " entries, " << errors
+              << " errors" << std::endl;
+    assert(errors >= 1);
+    assert(reader_read == read);
+}
+
+int main(int argc, char* argv[])
+{
+    bool tested = false;
+    for (auto compression : {Compression::ZLIB, Compression::ZSTD})
+    {
+        if (!goby::middleware::log::compression_available(compression))
+        {
+            std::cout << "Skipping " << goby::middleware::log::compression_name(compression)
+                      << " (not available)" << std::endl;
+            continue;
+        }
+
+        test_read(compression);
+        test_index(compression);
+        test_interleaved(compression);
+        test_corrupt(compression);
+        tested = true;
+    }
+
+    // blocks must be rejected if the compression isn't available
+    if (!tested)
+    {
+        bool threw = false;
+        try
+        {
+            goby::middleware::log::LogWriter::Options options;
+            options.compression = Compression::ZLIB;
+            goby::middleware::log::LogWriter writer(log_file, options);
+        }
+        catch (LogException& e)
+        {
+            threw = true;
+        }
+        assert(threw);
+    }
+
+    std::cout << "all tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,201 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "goby/middleware/log/log_entry.h"
+#include "goby/middleware/log/log_index.h"
+#include "goby/middleware/log/log_writer.h"
+#include "goby/middleware/marshalling/interface.h"
+
+// tests the index written alongside logs by goby::middleware::log::LogWriter, and seeking and filtering using goby::middleware::log::LogIndex
+
+using goby::middleware::MarshallingScheme;
+using goby::middleware::log::LogEntry;
+using goby::middleware::log::LogIndex;
+using goby::middleware::log::LogWriter;
+
+const std::string log_file("/tmp/goby3_test_log_index.goby");
+const std::string rebuilt_index_file("/tmp/goby3_test_log_index_rebuilt.goby.idx");
+const int n = 3000;
+const goby::time::SystemClock::time_point start_time{goby::time::SystemClock::now()};
+
+std::vector<unsigned char> entry_data(int i)
+{
+    std::vector<unsigned char> data(50 + i % 100);
+    for (std::size_t j = 0; j < data.size(); ++j) data[j] = (i + j) & 0xFF;
+    return data;
+}
+
+// groupC only appears in the middle of the log, after all the types have been indexed
+std::string entry_group(int i)
+{
+    if (i >= 1200 && i < 1300)
+        return "groupC";
+    else
+        return i % 2 ? "groupA" : "groupB";
+}
+
+std::string entry_type(int i) { return "Type" + std::to_string(i % 3); }
+
+goby::time::SystemClock::time_point entry_time(int i) { return start_time + std::chrono::seconds(i); }
+
+void write_log()
+{
+    LogEntry::reset();
+    LogWriter::Options options;
+    options.index_block_size = 4096;
+    LogWriter writer(log_file, options);
+    for (int i = 0; i < n; ++i)
+    {
+        while (writer.statistics().queue_depth >= options.queue_size / 2)
+            std::this_thread::yield();
+
+        std::ostringstream staging;
+        LogEntry entry(entry_data(i), MarshallingScheme::PROTOBUF, entry_type(i),
+                       goby::middleware::DynamicGroup(entry_group(i)), entry_time(i));
+        entry.serialize(&staging);
+        std::string bytes = staging.str();
+        bool queued = writer.write(bytes, entry);
+        assert(queued);
+    }
+    writer.close();
+}
+
+int entry_number(const LogEntry& entry)
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(entry.timestamp() - start_time).count();
+}
+
+void check_entry(const LogEntry& entry)
+{
+    int i = entry_number(entry);
+    assert(entry.data() == entry_data(i));
+    assert(entry.type() == entry_type(i));
+    assert(std::string(entry.group()) == entry_group(i));
+}
+
+void test_filter()
+{
+    LogEntry::reset();
+    std::ifstream in(log_file.c_str());
+    auto index = LogIndex::load(log_file);
+    assert(index);
+    assert(index->complete());
+    assert(index->keys().size() == 9);
+    assert(index->blocks().size() > 10);
+
+    index->set_filter([](const LogIndex::Key& key) { return key.group == "groupC"; });
+
+    int read = 0;
+    std::vector<int> matched;
+    while (index->next(in))
+    {
+        LogEntry entry;
+        try
+        {
+            entry.parse(&in);
+        }
+        catch (std::ifstream::failure& e)
+        {
+            break;
+        }
+        ++read;
+        check_entry(entry);
+        if (std::string(entry.group()) == "groupC")
+            matched.push_back(entry_number(entry));
+    }
+
+    std::cout << "Read " << read << " entries to find " << matched.size() << " in groupC"
+              << std::endl;
+    assert(matched.size() == 100);
+    for (int j = 0; j < 100; ++j) assert(matched[j] == 1200 + j);
+    // only the blocks containing groupC were read
+    assert(read < 300);
+}
+
+void test_seek(int target)
+{
+    LogEntry::reset();
+    std::ifstream in(log_file.c_str());
+    auto index = LogIndex::load(log_file);
+    assert(index);
+
+    const auto& block = index->blocks()[index->find_block(entry_time(target))];
+    index->seek(in, block.offset());
+
+    int read = 0;
+    LogEntry entry;
+    do {
+        entry.parse(&in);
+        check_entry(entry);
+        ++read;
+    } while (entry.timestamp() < entry_time(target));
+
+    std::cout << "Seek to entry " << target << " read " << read << " entries" << std::endl;
+    assert(entry_number(entry) == target);
+    assert(read < 100);
+}
+
+std::string file_contents(const std::string& file)
+{
+    std::ifstream in(file.c_str());
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+int main(int argc, char* argv[])
+{
+    write_log();
+
+    test_filter();
+    test_seek(0);
+    test_seek(1);
+    test_seek(1234);
+    test_seek(n - 1);
+
+    {
+        LogEntry::reset();
+        std::ifstream in(log_file.c_str());
+        auto entries = LogIndex::build(in, rebuilt_index_file, 4096);
+        assert(entries == n);
+        // rebuilding produces the same index as written by the logger
+        assert(file_contents(rebuilt_index_file) == file_contents(LogIndex::path(log_file)));
+    }
+
+    {
+        // an index that does not match the log is not used
+        std::ofstream out(log_file.c_str(), std::ofstream::app);
+        out << "more data";
+        out.close();
+        assert(!LogIndex::load(log_file));
+    }
+
+    std::cout << "all tests passed" << std::endl;
+    return 0;
+}
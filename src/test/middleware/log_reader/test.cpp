@@ -0,0 +1,277 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <boost/crc.hpp>
+
+#include "goby/middleware/log/detail/crc32.h"
+#include "goby/middleware/log/log_entry.h"
+#include "goby/middleware/log/log_index.h"
+#include "goby/middleware/log/log_reader.h"
+#include "goby/middleware/log/log_writer.h"
+#include "goby/middleware/marshalling/interface.h"
+
+// tests reading logs using goby::middleware::log::LogReader, compared to LogEntry::parse()
+
+using goby::middleware::MarshallingScheme;
+using goby::middleware::log::LogEntry;
+using goby::middleware::log::LogException;
+using goby::middleware::log::LogIndex;
+using goby::middleware::log::LogReader;
+
+const std::string log_file("/tmp/goby3_test_log_reader.goby");
+const int n = 1000;
+const goby::time::SystemClock::time_point start_time{
+    std::chrono::time_point_cast<std::chrono::microseconds>(goby::time::SystemClock::now())};
+
+const std::string hook_type("HookType");
+int hook_calls = 0;
+
+std::vector<unsigned char> entry_data(int i)
+{
+    std::vector<unsigned char> data(i % 200);
+    for (std::size_t j = 0; j < data.size(); ++j) data[j] = (i * 7 + j) & 0xFF;
+    return data;
+}
+
+std::string entry_group(int i) { return "group" + std::to_string(i % 5); }
+std::string entry_type(int i) { return i % 50 == 1 ? hook_type : "Type" + std::to_string(i % 3); }
+int entry_scheme(int i) { return i % 2 ? MarshallingScheme::PROTOBUF : MarshallingScheme::JSON; }
+goby::time::SystemClock::time_point entry_time(int i)
+{
+    return start_time + std::chrono::milliseconds(i);
+}
+
+void test_crc32()
+{
+    std::vector<unsigned char> bytes(1000);
+    for (std::size_t i = 0; i < bytes.size(); ++i) bytes[i] = (i * 31 + 7) & 0xFF;
+
+    for (std::size_t size = 0; size < 300; ++size)
+    {
+        for (std::size_t offset = 0; offset < 4; ++offset)
+        {
+            boost::crc_32_type expected;
+            expected.process_bytes(&bytes[offset], size);
+
+            goby::middleware::log::detail::CRC32 crc;
+            crc.process_bytes(&bytes[offset], size / 2);
+            crc.process_bytes(&bytes[offset + size / 2], size - size / 2);
+            assert(crc.checksum() == expected.checksum());
+        }
+    }
+}
+
+void write_log(int version)
+{
+    LogEntry::reset();
+    LogEntry::set_current_version(version);
+    std::ofstream out(log_file.c_str());
+    for (int i = 0; i < n; ++i)
+    {
+        LogEntry entry(entry_data(i), entry_scheme(i), entry_type(i),
+                       goby::middleware::DynamicGroup(entry_group(i)), entry_time(i));
+        entry.serialize(&out);
+    }
+}
+
+void reset_read()
+{
+    LogEntry::reset();
+    hook_calls = 0;
+    // entries of hook_type and scheme PROTOBUF are consumed by the hook, as Protobuf file descriptors are
+    for (int g = 0; g < 5; ++g)
+        LogEntry::filter_hook[{MarshallingScheme::PROTOBUF, entry_group(g), hook_type}] =
+            [](const std::vector<unsigned char>& data) { ++hook_calls; };
+}
+
+bool hooked(int i) { return entry_type(i) == hook_type && entry_scheme(i) == MarshallingScheme::PROTOBUF; }
+
+void check_entry(const LogEntry& entry, int i, int version)
+{
+    assert(entry.data() == entry_data(i));
+    assert(entry.scheme() == entry_scheme(i));
+    assert(entry.type() == entry_type(i));
+    assert(std::string(entry.group()) == entry_group(i));
+    if (version >= 3)
+        assert(entry.timestamp() == entry_time(i));
+}
+
+void test_read(int version)
+{
+    write_log(version);
+
+    std::vector<LogEntry> parsed;
+    {
+        reset_read();
+        std::ifstream in(log_file.c_str());
+        for (;;)
+        {
+            LogEntry entry;
+            try
+            {
+                entry.parse(&in);
+            }
+            catch (std::ifstream::failure& e)
+            {
+                break;
+            }
+            parsed.push_back(entry);
+        }
+        assert(hook_calls == 20);
+    }
+
+    reset_read();
+    LogReader reader(log_file);
+    assert(LogEntry::version_ == version);
+    LogEntry entry;
+    int i = 0, read = 0;
+    while (reader.next(&entry))
+    {
+        while (hooked(i)) ++i;
+        check_entry(entry, i, version);
+        // same as read by LogEntry::parse
+        assert(entry.data() == parsed[read].data());
+        assert(entry.type() == parsed[read].type());
+        assert(entry.group() == parsed[read].group());
+        ++i;
+        ++read;
+    }
+    assert(read == static_cast<int>(parsed.size()));
+    assert(hook_calls == 20);
+    assert(reader.tell() == reader.size());
+
+    // copies own their data
+    LogEntry copy;
+    {
+        LogReader reader2(log_file);
+        reader2.next(&copy);
+        reader2.next(&copy);
+        copy = LogEntry(copy);
+    }
+    check_entry(copy, 2, version);
+
+    std::cout << "Version " << version << ": read " << read << " entries" << std::endl;
+}
+
+void test_corrupt()
+{
+    write_log(LogEntry::compiled_current_version);
+
+    std::string bytes;
+    {
+        std::ifstream in(log_file.c_str());
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    // corrupt the data of an entry in the middle, and truncate the last entry
+    bytes[bytes.size() / 2] ^= 0x55;
+    bytes.resize(bytes.size() - 10);
+    {
+        std::ofstream out(log_file.c_str());
+        out << bytes;
+    }
+
+    reset_read();
+    LogReader reader(log_file);
+    LogEntry entry;
+    int read = 0, errors = 0;
+    for (;;)
+    {
+        try
+        {
+            if (!reader.next(&entry))
+                break;
+            ++read;
+        }
+        catch (LogException& e)
+        {
+            ++errors;
+        }
+    }
+    std::cout << "Corrupt log: read " << read << " entries, " << errors << " errors" << std::endl;
+    // lose the corrupted entry (and possibly its neighbor, depending on where it was corrupted) and the truncated one
+    assert(read >= n - 20 - 3 && read <= n - 20 - 2);
+    assert(errors >= 1);
+}
+
+void test_index()
+{
+    LogEntry::reset();
+    goby::middleware::log::LogWriter::Options options;
+    options.index_block_size = 4096;
+    {
+        goby::middleware::log::LogWriter writer(log_file, options);
+        for (int i = 0; i < n; ++i)
+        {
+            while (writer.statistics().queue_depth >= options.queue_size / 2)
+                std::this_thread::yield();
+
+            std::ostringstream staging;
+            LogEntry entry(entry_data(i), entry_scheme(i), entry_type(i),
+                           goby::middleware::DynamicGroup(entry_group(i)), entry_time(i));
+            entry.serialize(&staging);
+            std::string bytes = staging.str();
+            bool queued = writer.write(bytes, entry);
+            assert(queued);
+        }
+    }
+
+    LogEntry::reset();
+    LogReader reader(log_file);
+    auto index = LogIndex::load(log_file);
+    assert(index);
+    index->set_filter([](const LogIndex::Key& key) { return key.type == "Type2"; });
+
+    // seek into the middle, then read only blocks with entries of interest
+    index->seek(reader, index->blocks()[index->find_block(entry_time(n / 2))].offset());
+    int matched = 0;
+    LogEntry entry;
+    while (index->next(reader) && reader.next(&entry))
+    {
+        if (entry.type() == "Type2")
+        {
+            assert(entry.timestamp() >= entry_time(n / 2) - std::chrono::seconds(1));
+            ++matched;
+        }
+    }
+    std::cout << "Index: " << matched << " entries" << std::endl;
+    assert(matched > 0);
+}
+
+int main(int argc, char* argv[])
+{
+    test_crc32();
+    test_read(2);
+    test_read(3);
+    test_corrupt();
+    test_index();
+
+    std::cout << "all tests passed" << std::endl;
+    return 0;
+}
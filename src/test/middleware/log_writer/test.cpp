@@ -0,0 +1,219 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+
+#include "goby/middleware/log/log_entry.h"
+#include "goby/middleware/log/log_writer.h"
+#include "goby/middleware/marshalling/interface.h"
+
+// tests writing log entries through goby::middleware::log::LogWriter and reading them back
+
+using goby::middleware::MarshallingScheme;
+using goby::middleware::log::LogEntry;
+using goby::middleware::log::LogWriter;
+
+const std::string log_file("/tmp/goby3_test_log_writer.goby");
+
+std::vector<unsigned char> entry_data(int i)
+{
+    // variety of sizes, some larger than the block size
+    std::vector<unsigned char> data(i % 7 == 0 ? 5000 + i : i % 300);
+    for (std::size_t j = 0; j < data.size(); ++j) data[j] = (i + j) & 0xFF;
+    return data;
+}
+
+std::string entry_group(int i) { return "group" + std::to_string(i / 100); }
+
+// serialize as goby_logger does, returning false if the entry was dropped
+bool write_entry(LogWriter& writer, int i)
+{
+    std::ostringstream staging;
+    LogEntry entry(entry_data(i), MarshallingScheme::PROTOBUF, "Type" + std::to_string(i % 3),
+                   goby::middleware::DynamicGroup(entry_group(i)));
+    entry.serialize(&staging);
+    std::string bytes = staging.str();
+    return writer.write(bytes, entry);
+}
+
+// read back all the entries, returning the number read
+int read_log(bool expect_all)
+{
+    LogEntry::reset();
+    std::ifstream in(log_file.c_str());
+    int i = 0, read = 0;
+    for (;;)
+    {
+        LogEntry entry;
+        try
+        {
+            entry.parse(&in);
+        }
+        catch (std::ifstream::failure& e)
+        {
+            assert(in.eof());
+            break;
+        }
+
+        assert(entry.scheme() == MarshallingScheme::PROTOBUF);
+        // metadata is never dropped, so the group and type are always known
+        assert(entry.type().find("_unknown") == std::string::npos);
+        assert(std::string(entry.group()).find("_unknown") == std::string::npos);
+
+        // find the matching entry (skipping any that were dropped)
+        while (entry.data() != entry_data(i)) ++i;
+        assert(entry.type() == "Type" + std::to_string(i % 3));
+        assert(std::string(entry.group()) == entry_group(i));
+        if (expect_all)
+            assert(i == read);
+        ++i;
+        ++read;
+    }
+    return read;
+}
+
+off_t file_size()
+{
+    struct stat st;
+    stat(log_file.c_str(), &st);
+    return st.st_size;
+}
+
+// space allocated to the file
+off_t file_allocated()
+{
+    struct stat st;
+    stat(log_file.c_str(), &st);
+    return st.st_blocks * 512;
+}
+
+int main(int argc, char* argv[])
+{
+    const int n = 2000;
+
+    {
+        std::cout << "Writing all entries" << std::endl;
+        LogEntry::reset();
+        LogWriter::Options options;
+        options.block_size = 4096;
+        options.queue_size = 16;
+        LogWriter writer(log_file, options);
+        for (int i = 0; i < n; ++i)
+        {
+            // don't allow any to be dropped
+            while (writer.statistics().queue_depth >= options.queue_size / 2)
+                std::this_thread::yield();
+            bool queued = write_entry(writer, i);
+            assert(queued);
+        }
+        writer.close();
+        assert(!writer.is_open());
+
+        auto stats = writer.statistics();
+        std::cout << "Wrote " << stats.entries_written << " entries, " << stats.bytes_written
+                  << " bytes" << std::endl;
+        assert(stats.entries_written == n);
+        assert(stats.dropped_entries == 0);
+        assert(stats.queue_depth == 0);
+        assert(stats.write_errors == 0);
+        assert(static_cast<off_t>(stats.bytes_written) == file_size());
+        assert(read_log(true) == n);
+    }
+
+    {
+        std::cout << "Flushing partial blocks" << std::endl;
+        LogEntry::reset();
+        LogWriter::Options options;
+        options.flush_interval = std::chrono::milliseconds(10);
+        LogWriter writer(log_file, options);
+        assert(write_entry(writer, 1));
+        for (int tries = 0; writer.statistics().bytes_written == 0 && tries < 1000; ++tries)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        assert(writer.statistics().bytes_written > 0);
+        assert(static_cast<off_t>(writer.statistics().bytes_written) == file_size());
+    }
+
+    {
+        std::cout << "Overflowing the queue" << std::endl;
+        LogEntry::reset();
+        LogWriter::Options options;
+        options.queue_size = 2;
+        LogWriter writer(log_file, options);
+        int queued = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            if (write_entry(writer, i))
+                ++queued;
+        }
+        writer.close();
+
+        auto stats = writer.statistics();
+        std::cout << "Queued " << queued << ", dropped " << stats.dropped_entries << std::endl;
+        assert(queued + stats.dropped_entries == n);
+        assert(read_log(false) == queued);
+
+        // the index accounts for the dropped entries
+        auto index = goby::middleware::log::LogIndex::load(log_file);
+        assert(index && index->complete());
+        int indexed = 0;
+        for (const auto& block : index->blocks()) indexed += block.entries();
+        assert(indexed == queued);
+    }
+
+    {
+        std::cout << "Preallocating" << std::endl;
+        LogEntry::reset();
+        LogWriter::Options options;
+        options.preallocate = 16 * 1024 * 1024;
+        LogWriter writer(log_file, options);
+        // the file size is unchanged by preallocation, which not all filesystems support
+        assert(file_size() == 0);
+        bool preallocated = file_allocated() >= static_cast<off_t>(options.preallocate);
+        std::cout << (preallocated ? "Preallocated " : "Could not preallocate ")
+                  << options.preallocate << " bytes" << std::endl;
+
+        for (int i = 0; i < 100; ++i)
+        {
+            while (writer.statistics().queue_depth >= options.queue_size / 2)
+                std::this_thread::yield();
+            assert(write_entry(writer, i));
+        }
+        writer.close();
+
+        assert(static_cast<off_t>(writer.statistics().bytes_written) == file_size());
+        assert(read_log(true) == 100);
+        // the space not written is released
+        if (preallocated)
+            assert(file_allocated() < static_cast<off_t>(options.preallocate));
+    }
+
+    std::cout << "all tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,122 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <atomic>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+#include "goby/middleware/transport/interthread.h"
+#include "goby/util/debug_logger.h"
+
+// tests InterThreadTransporter with bounded subscription queues
+
+using goby::middleware::protobuf::InterThreadTransporterConfig;
+
+extern constexpr goby::middleware::Group bounded{"Bounded"};
+
+struct Counter
+{
+    int value;
+};
+
+goby::middleware::InterThreadTransporter publisher_transporter;
+
+const int max_queue = 5;
+const int max_publish = 100;
+
+std::atomic<bool> subscribed(false);
+std::atomic<bool> published(false);
+
+std::vector<int> run_subscriber(InterThreadTransporterConfig::OverflowPolicy policy)
+{
+    goby::middleware::InterThreadTransporter transporter;
+    std::vector<int> received;
+
+    goby::middleware::protobuf::TransporterConfig cfg;
+    cfg.mutable_interthread()->set_max_queue(max_queue);
+    cfg.mutable_interthread()->set_overflow_policy(policy);
+
+    transporter.subscribe<bounded, Counter>(
+        [&](std::shared_ptr<const Counter> c) { received.push_back(c->value); },
+        goby::middleware::Subscriber<Counter>(cfg));
+    subscribed = true;
+
+    if (policy == InterThreadTransporterConfig::BLOCK)
+    {
+        // drain concurrently, otherwise the publisher would never return
+        while (received.size() < max_publish) transporter.poll(std::chrono::milliseconds(10));
+    }
+    else
+    {
+        while (!published) std::this_thread::yield();
+        transporter.poll(std::chrono::seconds(0));
+    }
+
+    return received;
+}
+
+std::vector<int> run_test(InterThreadTransporterConfig::OverflowPolicy policy)
+{
+    subscribed = false;
+    published = false;
+    std::vector<int> received;
+    std::thread subscriber([&]() { received = run_subscriber(policy); });
+
+    while (!subscribed) std::this_thread::yield();
+
+    for (int i = 0; i < max_publish; ++i)
+        publisher_transporter.publish<bounded>(std::make_shared<Counter>(Counter{i}));
+    published = true;
+
+    subscriber.join();
+    return received;
+}
+
+int main(int /*argc*/, char* argv[])
+{
+    goby::glog.add_stream(goby::util::logger::DEBUG3, &std::cerr);
+    goby::glog.set_name(argv[0]);
+    goby::glog.set_lock_action(goby::util::logger_lock::lock);
+
+    {
+        auto received = run_test(InterThreadTransporterConfig::DROP_OLDEST);
+        assert(received.size() == max_queue);
+        for (int i = 0; i < max_queue; ++i)
+            assert(received[i] == max_publish - max_queue + i);
+    }
+
+    {
+        auto received = run_test(InterThreadTransporterConfig::DROP_NEWEST);
+        assert(received.size() == max_queue);
+        for (int i = 0; i < max_queue; ++i) assert(received[i] == i);
+    }
+
+    {
+        auto received = run_test(InterThreadTransporterConfig::BLOCK);
+        assert(received.size() == max_publish);
+        for (int i = 0; i < max_publish; ++i) assert(received[i] == i);
+    }
+
+    std::cout << "all tests passed" << std::endl;
+}
@@ -0,0 +1,195 @@
+// Copyright 2024:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "goby/middleware/log/detail/ordered_pipeline.h"
+
+// tests that OrderedPipeline consumes results in push order when the workers finish them out of order
+
+using goby::middleware::log::detail::OrderedPipeline;
+
+const int workers = 4;
+const std::size_t max_in_flight = 8;
+
+// every fourth item takes much longer, so later items finish before it
+void slow_process(int& in, std::string& out)
+{
+    if (in % 4 == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    out = std::to_string(in);
+}
+
+void check_in_order(const std::vector<std::string>& consumed, int n)
+{
+    assert(static_cast<int>(consumed.size()) == n);
+    for (int i = 0; i < n; ++i) assert(consumed[i] == std::to_string(i));
+}
+
+void test_order()
+{
+    const int n = 200;
+
+    std::mutex completed_mutex;
+    std::vector<int> completed;
+    std::vector<std::string> consumed;
+    std::atomic<int> pushed{0};
+    std::atomic<int> max_outstanding{0};
+
+    OrderedPipeline<int, std::string> pipeline(
+        workers, max_in_flight,
+        [&](int& in, std::string& out)
+        {
+            slow_process(in, out);
+            std::lock_guard<std::mutex> lock(completed_mutex);
+            completed.push_back(in);
+        },
+        [&](std::string& out)
+        {
+            // an item isn't consumed until pushed, and no more than max_in_flight are outstanding
+            int outstanding = pushed - static_cast<int>(consumed.size());
+            assert(outstanding > 0);
+            if (outstanding > max_outstanding)
+                max_outstanding = outstanding;
+            consumed.push_back(out);
+        });
+
+    for (int i = 0; i < n; ++i)
+    {
+        pipeline.push(i);
+        ++pushed;
+    }
+    pipeline.finish();
+
+    check_in_order(consumed, n);
+    assert(max_outstanding <= static_cast<int>(max_in_flight));
+
+    // the workers did complete items out of order
+    assert(static_cast<int>(completed.size()) == n);
+    bool out_of_order = false;
+    for (int i = 1; i < n; ++i)
+        if (completed[i] < completed[i - 1])
+            out_of_order = true;
+    assert(out_of_order);
+
+    std::cout << "Order: consumed " << consumed.size() << " items in order (at most "
+              << max_outstanding << " outstanding)" << std::endl;
+}
+
+void test_drain()
+{
+    std::atomic<int> consumed_count{0};
+    std::vector<std::string> consumed;
+    OrderedPipeline<int, std::string> pipeline(workers, max_in_flight, slow_process,
+                                               [&](std::string& out)
+                                               {
+                                                   consumed.push_back(out);
+                                                   ++consumed_count;
+                                               });
+
+    // drain with nothing pushed returns immediately
+    pipeline.drain();
+    assert(consumed_count == 0);
+
+    int n = 0;
+    for (int batch : {3, 1, 20, 8})
+    {
+        for (int i = 0; i < batch; ++i) pipeline.push(n++);
+        pipeline.drain();
+        // everything pushed so far has been consumed, and nothing is consumed twice
+        assert(consumed_count == n);
+        check_in_order(consumed, n);
+    }
+
+    pipeline.finish();
+    assert(consumed_count == n);
+    std::cout << "Drain: consumed " << n << " items" << std::endl;
+}
+
+void test_finish()
+{
+    const int n = 50;
+
+    // finish() consumes everything pushed before it stops the threads, and the destructor does nothing more
+    {
+        std::vector<std::string> consumed;
+        OrderedPipeline<int, std::string> pipeline(
+            workers, max_in_flight, slow_process,
+            [&](std::string& out) { consumed.push_back(out); });
+        for (int i = 0; i < n; ++i) pipeline.push(i);
+        pipeline.finish();
+        check_in_order(consumed, n);
+        pipeline.finish();
+        check_in_order(consumed, n);
+    }
+
+    // the destructor finishes if finish() wasn't called
+    {
+        std::vector<std::string> consumed;
+        {
+            OrderedPipeline<int, std::string> pipeline(
+                workers, max_in_flight, slow_process,
+                [&](std::string& out) { consumed.push_back(out); });
+            for (int i = 0; i < n; ++i) pipeline.push(i);
+        }
+        check_in_order(consumed, n);
+    }
+
+    // a pipeline that was never pushed to finishes right away
+    {
+        bool called = false;
+        OrderedPipeline<int, std::string> pipeline(
+            workers, max_in_flight, slow_process, [&](std::string&) { called = true; });
+        pipeline.finish();
+        assert(!called);
+    }
+
+    // a single worker and a single slot still work (each item processed and consumed in turn)
+    {
+        std::vector<std::string> consumed;
+        OrderedPipeline<int, std::string> pipeline(
+            0, 0, slow_process, [&](std::string& out) { consumed.push_back(out); });
+        for (int i = 0; i < n; ++i) pipeline.push(i);
+        pipeline.finish();
+        check_in_order(consumed, n);
+    }
+
+    std::cout << "Finish: ok" << std::endl;
+}
+
+int main()
+{
+    test_order();
+    test_drain();
+    test_finish();
+
+    std::cout << "all tests passed" << std::endl;
+    return 0;
+}
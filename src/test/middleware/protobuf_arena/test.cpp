@@ -0,0 +1,130 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+#include "goby/middleware/marshalling/protobuf.h"
+#include "goby/middleware/protobuf/serializer_transporter.pb.h"
+
+using goby::middleware::MarshallingScheme;
+using goby::middleware::detail::ProtobufArenaPool;
+using goby::middleware::detail::ProtobufArenaScope;
+using goby::middleware::protobuf::SerializerTransporterMessage;
+using Helper = goby::middleware::SerializerParserHelper<SerializerTransporterMessage,
+                                                        MarshallingScheme::PROTOBUF>;
+
+std::vector<char> make_bytes(int i)
+{
+    SerializerTransporterMessage msg;
+    msg.mutable_key()->set_marshalling_scheme(MarshallingScheme::PROTOBUF);
+    msg.mutable_key()->set_type("goby.test.Type" + std::to_string(i));
+    msg.mutable_key()->set_group("group" + std::to_string(i));
+    msg.set_data(std::string(100 + i, 'x'));
+    return Helper::serialize(msg);
+}
+
+std::shared_ptr<SerializerTransporterMessage> parse(const std::vector<char>& bytes)
+{
+    auto actual_end = bytes.begin();
+    auto msg = Helper::parse(bytes.begin(), bytes.end(), actual_end);
+    assert(actual_end == bytes.end());
+    return msg;
+}
+
+void check(const SerializerTransporterMessage& msg, int i)
+{
+    assert(msg.key().type() == "goby.test.Type" + std::to_string(i));
+    assert(msg.key().group() == "group" + std::to_string(i));
+    assert(msg.data().size() == 100 + i);
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::vector<char>> encoded;
+    for (int i = 0; i < 10; ++i) encoded.push_back(make_bytes(i));
+
+    // without a scope: heap allocated
+    {
+        auto msg = parse(encoded[0]);
+        assert(msg->GetArena() == nullptr);
+        check(*msg, 0);
+    }
+
+    ProtobufArenaPool pool;
+    std::shared_ptr<SerializerTransporterMessage> kept;
+    for (int poll = 0; poll < 5; ++poll)
+    {
+        ProtobufArenaScope scope(&pool);
+        for (int i = 0; i < 10; ++i)
+        {
+            auto msg = parse(encoded[i]);
+            // all messages in a scope share the arena
+            assert(msg.get() != nullptr);
+            assert(pool.arena().use_count() > 1);
+            check(*msg, i);
+
+            // keep one message from the second poll beyond its scope
+            if (poll == 1 && i == 3)
+                kept = msg;
+        }
+
+        // nested scope with nullptr disables arena parsing
+        {
+            ProtobufArenaScope no_arena(nullptr);
+            assert(ProtobufArenaPool::active() == nullptr);
+            auto msg = parse(encoded[1]);
+            assert(msg->GetArena() == nullptr);
+        }
+        assert(ProtobufArenaPool::active() == &pool);
+    }
+    assert(ProtobufArenaPool::active() == nullptr);
+
+    // the kept message is still valid after its arena was released by the pool
+    check(*kept, 3);
+    assert(pool.handoffs() == 1);
+    // every poll except the first and the one following the handoff reused a reset arena
+    std::cout << "reuses: " << pool.reuses() << ", handoffs: " << pool.handoffs() << std::endl;
+    assert(pool.reuses() == 3);
+
+    // releasing the last message returns its arena for reuse
+    std::weak_ptr<SerializerTransporterMessage> weak_kept(kept);
+    kept.reset();
+    assert(weak_kept.expired());
+
+    // messages kept past the lifetime of the pool remain valid
+    {
+        std::shared_ptr<SerializerTransporterMessage> outlives;
+        {
+            ProtobufArenaPool short_pool;
+            ProtobufArenaScope scope(&short_pool);
+            outlives = parse(encoded[7]);
+        }
+        check(*outlives, 7);
+    }
+
+    std::cout << "all tests passed" << std::endl;
+    return 0;
+}
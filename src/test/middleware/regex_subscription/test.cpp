@@ -0,0 +1,132 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cassert>
+#include <iostream>
+#include <regex>
+#include <vector>
+
+#include "goby/middleware/marshalling/interface.h"
+#include "goby/middleware/transport/serialization_handlers.h"
+
+using goby::middleware::MarshallingScheme;
+using goby::middleware::SerializationSubscriptionRegex;
+using goby::middleware::detail::RegexMatcher;
+
+// tests that the fast paths and memoization of RegexMatcher agree with std::regex_match
+void check_matcher()
+{
+    std::vector<std::string> patterns{".*",
+                                      "^.*$",
+                                      "goby.middleware.protobuf.NavigationReport",
+                                      "goby\\.middleware\\.protobuf\\.NavigationReport",
+                                      "^goby::middleware::frontseat::.*",
+                                      "goby::.*",
+                                      "goby::.*::raw",
+                                      "(foo|bar).*",
+                                      "\\w+",
+                                      ""};
+
+    std::vector<std::string> strings{"",
+                                     "goby.middleware.protobuf.NavigationReport",
+                                     "gobyXmiddleware.protobuf.NavigationReport",
+                                     "goby::middleware::frontseat::node_status",
+                                     "goby::middleware::frontseat",
+                                     "goby::foo::raw",
+                                     "foobar",
+                                     "bar",
+                                     "baz",
+                                     // "." does not match line terminators
+                                     "goby::line\nbreak",
+                                     "goby::carriage\rreturn",
+                                     "\n"};
+
+    for (const auto& pattern : patterns)
+    {
+        RegexMatcher matcher(pattern);
+        std::regex regex(pattern);
+        // twice to check memoized results
+        for (int i = 0; i < 2; ++i)
+        {
+            for (const auto& s : strings)
+            {
+                if (matcher.match(s) != std::regex_match(s, regex))
+                {
+                    std::cerr << "Mismatch for pattern: \"" << pattern << "\", string: \"" << s
+                              << "\"" << std::endl;
+                    assert(false);
+                }
+            }
+        }
+        std::cout << "Pattern \"" << pattern << "\": hits: " << matcher.hits()
+                  << ", misses: " << matcher.misses() << std::endl;
+        // at most one std::regex evaluation per distinct string
+        assert(matcher.misses() <= strings.size());
+    }
+}
+
+void check_subscription()
+{
+    int posted = 0;
+    SerializationSubscriptionRegex sub(
+        [&](const std::vector<unsigned char>&, int, const std::string&,
+            const goby::middleware::Group&) { ++posted; },
+        {MarshallingScheme::PROTOBUF}, "goby::(foo|bar)", "Sample[0-9]");
+
+    std::vector<char> bytes{'a', 'b'};
+    const int n = 100;
+    for (int i = 0; i < n; ++i)
+    {
+        assert(sub.post(bytes.begin(), bytes.end(), MarshallingScheme::PROTOBUF, "goby::foo",
+                        "Sample1"));
+        assert(!sub.post(bytes.begin(), bytes.end(), MarshallingScheme::PROTOBUF, "goby::baz",
+                         "Sample1"));
+        // wrong scheme: regex not evaluated
+        assert(!sub.post(bytes.begin(), bytes.end(), MarshallingScheme::DCCL, "goby::foo",
+                         "Sample1"));
+    }
+    assert(posted == n);
+    // goby::foo, goby::baz, and Sample1 evaluated once each
+    assert(sub.match_cache_misses() == 3);
+    std::cout << "Subscription hit rate: " << sub.match_cache_hit_rate() << std::endl;
+    assert(sub.match_cache_hit_rate() > 0.9);
+
+    // updating invalidates the cache
+    sub.update_type_regex("goby::baz");
+    assert(sub.post(bytes.begin(), bytes.end(), MarshallingScheme::PROTOBUF, "goby::baz",
+                    "Sample1"));
+    assert(!sub.post(bytes.begin(), bytes.end(), MarshallingScheme::PROTOBUF, "goby::foo",
+                     "Sample1"));
+    sub.update_group_regex("Sample[2-9]");
+    assert(!sub.post(bytes.begin(), bytes.end(), MarshallingScheme::PROTOBUF, "goby::baz",
+                     "Sample1"));
+    assert(posted == n + 1);
+}
+
+int main()
+{
+    check_matcher();
+    check_subscription();
+    std::cout << "all tests passed" << std::endl;
+}
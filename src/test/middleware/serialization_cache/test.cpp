@@ -0,0 +1,306 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "goby/middleware/marshalling/interface.h"
+
+// test type with two (made up) marshalling schemes that counts the number of times it is serialized
+struct Counted
+{
+    int value{0};
+};
+
+constexpr int SCHEME_A{900};
+constexpr int SCHEME_B{901};
+
+std::atomic<int> serialize_count{0};
+
+namespace goby
+{
+namespace middleware
+{
+template <int scheme>
+struct SerializerParserHelper<Counted, scheme,
+                              typename std::enable_if<scheme == SCHEME_A || scheme == SCHEME_B>::type>
+{
+    static std::vector<char> serialize(const Counted& msg)
+    {
+        ++serialize_count;
+        return std::vector<char>{static_cast<char>(scheme - SCHEME_A), static_cast<char>(msg.value)};
+    }
+
+    static std::string type_name(const Counted& d = Counted()) { return "Counted"; }
+};
+
+template <typename T, typename std::enable_if<std::is_same<T, Counted>::value>::type* = nullptr>
+constexpr int scheme()
+{
+    return SCHEME_A;
+}
+} // namespace middleware
+} // namespace goby
+
+// include after the scheme() overload for Counted is declared
+#include "goby/middleware/transport/intermodule.h"
+#include "goby/middleware/transport/interprocess.h"
+#include "goby/middleware/transport/interthread.h"
+
+using goby::middleware::detail::SerializationCache;
+
+void check_cache()
+{
+    auto& cache = SerializationCache::instance();
+    cache.clear();
+    serialize_count = 0;
+
+    // allocated separately from the control block so that the address may be reused once it is destroyed
+    std::shared_ptr<Counted> a(new Counted);
+    a->value = 1;
+    std::shared_ptr<const Counted> ca(a);
+
+    // same message and scheme: serialized once
+    auto bytes1 = cache.serialize<Counted, SCHEME_A>(ca);
+    auto bytes2 = cache.serialize<Counted, SCHEME_A>(ca);
+    assert(serialize_count == 1);
+    assert(bytes1 == bytes2);
+    assert((*bytes1 == std::vector<char>{0, 1}));
+
+    // another scheme: serialized separately
+    auto bytes3 = cache.serialize<Counted, SCHEME_B>(ca);
+    assert(serialize_count == 2);
+    assert((*bytes3 == std::vector<char>{1, 1}));
+
+    // copies of the shared_ptr (and aliases to the same object) refer to the same message
+    std::shared_ptr<const Counted> ca_copy(ca);
+    cache.serialize<Counted, SCHEME_A>(ca_copy);
+    assert(serialize_count == 2);
+
+    // a different message: serialized
+    auto b = std::make_shared<const Counted>();
+    cache.serialize<Counted, SCHEME_A>(b);
+    assert(serialize_count == 3);
+
+    // a new message at the same address as an expired one must not reuse the old bytes
+    const void* old_address = ca.get();
+    a.reset();
+    ca.reset();
+    ca_copy.reset();
+    std::shared_ptr<Counted> reused;
+    std::vector<std::shared_ptr<Counted>> keep;
+    for (int i = 0; i < 1000 && !reused; ++i)
+    {
+        std::shared_ptr<Counted> c(new Counted);
+        c->value = 2;
+        if (c.get() == old_address)
+            reused = c;
+        else
+            keep.push_back(c);
+    }
+    if (reused)
+    {
+        int before = serialize_count;
+        auto bytes = cache.serialize<Counted, SCHEME_A>(std::shared_ptr<const Counted>(reused));
+        assert(serialize_count == before + 1);
+        assert((*bytes == std::vector<char>{0, 2}));
+    }
+    else
+    {
+        std::cout << "Allocator did not reuse address; skipping address reuse check" << std::endl;
+    }
+    keep.clear();
+    reused.reset();
+    b.reset();
+
+    // expired entries are eventually swept
+    for (int i = 0; i < 10000; ++i)
+        cache.serialize<Counted, SCHEME_A>(std::make_shared<const Counted>());
+    assert(cache.size() < 10000);
+
+    std::cout << "Cache hits: " << cache.hits() << ", misses: " << cache.misses() << std::endl;
+}
+
+void check_threads()
+{
+    auto& cache = SerializationCache::instance();
+    cache.clear();
+    serialize_count = 0;
+
+    auto msg = std::make_shared<const Counted>();
+    const int nthreads = 8;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; ++t)
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 1000; ++i)
+            {
+                auto bytes = cache.serialize<Counted, SCHEME_A>(msg);
+                assert(bytes->size() == 2);
+                // interleave with short-lived messages
+                cache.serialize<Counted, SCHEME_B>(std::make_shared<const Counted>());
+            }
+        });
+    for (auto& th : threads) th.join();
+
+    // concurrent misses may serialize the same message more than once, but never more than once per thread
+    int shared_count = serialize_count - nthreads * 1000;
+    assert(shared_count >= 1 && shared_count <= nthreads);
+}
+
+// collects the publications forwarded to the portal (in another thread, as interthread publications are not echoed to the publishing thread)
+template <typename Forwarded> class PortalThread
+{
+  public:
+    PortalThread(std::size_t expected)
+        : thread_([this, expected]() {
+              goby::middleware::InterThreadTransporter interthread;
+              goby::middleware::DynamicGroup to_portal("goby::middleware::interprocess::to_portal");
+              interthread.subscribe_dynamic<Forwarded>(
+                  [&](std::shared_ptr<const Forwarded> p) { forwarded.push_back(p); }, to_portal);
+              subscribed = true;
+              while (forwarded.size() < expected) interthread.poll(std::chrono::seconds(1));
+          })
+    {
+        while (!subscribed) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    void join() { thread_.join(); }
+
+    std::vector<std::shared_ptr<const Forwarded>> forwarded;
+
+  private:
+    std::atomic<bool> subscribed{false};
+    std::thread thread_;
+};
+
+// with the cache enabled, the forwarder should forward the (cached) bytes of a shared_ptr publication to the portal without serializing it again
+void check_forwarder()
+{
+    SerializationCache::instance().clear();
+    serialize_count = 0;
+
+    PortalThread<goby::middleware::detail::SerializedPublication> portal(3);
+
+    goby::middleware::InterThreadTransporter interthread;
+    goby::middleware::InterProcessForwarder<goby::middleware::InterThreadTransporter> interprocess(
+        interthread);
+    assert(!interprocess.serialization_cache());
+    interprocess.set_serialization_cache(true);
+
+    auto msg = std::make_shared<Counted>();
+    msg->value = 5;
+    std::shared_ptr<const Counted> cmsg(msg);
+    goby::middleware::DynamicGroup group1("group1"), group2("group2");
+    interprocess.publish_dynamic<Counted>(cmsg, group1);
+    interprocess.publish_dynamic<Counted>(cmsg, group2);
+    // mutable pointer: not cached
+    interprocess.publish_dynamic<Counted>(msg, group1);
+
+    portal.join();
+    const auto& forwarded = portal.forwarded;
+
+    assert(serialize_count == 2);
+    assert(forwarded[0]->key.group() == "group1");
+    assert(forwarded[1]->key.group() == "group2");
+    assert(forwarded[0]->key.type() == "Counted");
+    assert(forwarded[0]->key.marshalling_scheme() == SCHEME_A);
+    // the same bytes are shared by both forwarded publications
+    assert(forwarded[0]->bytes == forwarded[1]->bytes);
+    assert(forwarded[2]->bytes != forwarded[0]->bytes);
+    assert(*forwarded[2]->bytes == *forwarded[0]->bytes);
+}
+
+// by default, every publication is serialized, so modifications through another alias are published
+void check_forwarder_without_cache()
+{
+    SerializationCache::instance().clear();
+    serialize_count = 0;
+
+    PortalThread<goby::middleware::detail::SerializedPublication> portal(2);
+
+    goby::middleware::InterThreadTransporter interthread;
+    goby::middleware::InterProcessForwarder<goby::middleware::InterThreadTransporter> interprocess(
+        interthread);
+
+    auto msg = std::make_shared<Counted>();
+    msg->value = 5;
+    std::shared_ptr<const Counted> cmsg(msg);
+    goby::middleware::DynamicGroup group("group1");
+    interprocess.publish_dynamic<Counted>(cmsg, group);
+    msg->value = 6;
+    interprocess.publish_dynamic<Counted>(cmsg, group);
+
+    portal.join();
+    const auto& forwarded = portal.forwarded;
+
+    assert(serialize_count == 2);
+    assert(SerializationCache::instance().size() == 0);
+    assert((*forwarded[0]->bytes == std::vector<char>{0, 5}));
+    assert((*forwarded[1]->bytes == std::vector<char>{0, 6}));
+}
+
+// InterModuleForwarder only implements _publish, so shared_ptr publications must use it
+void check_intermodule_forwarder()
+{
+    serialize_count = 0;
+
+    PortalThread<goby::middleware::protobuf::SerializerTransporterMessage> portal(2);
+
+    goby::middleware::InterThreadTransporter interthread;
+    goby::middleware::InterModuleForwarder<goby::middleware::InterThreadTransporter> intermodule(
+        interthread);
+
+    auto msg = std::make_shared<Counted>();
+    msg->value = 7;
+    goby::middleware::DynamicGroup group("group1");
+    intermodule.publish_dynamic<Counted>(std::shared_ptr<const Counted>(msg), group);
+    intermodule.publish_dynamic<Counted>(msg, group);
+
+    portal.join();
+    const auto& forwarded = portal.forwarded;
+
+    assert(serialize_count == 2);
+    for (const auto& f : forwarded)
+    {
+        assert(f->key().group() == "group1");
+        assert(f->key().type() == "Counted");
+        assert(f->key().marshalling_scheme() == SCHEME_A);
+        assert(f->data() == std::string({0, 7}));
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    check_cache();
+    check_threads();
+    check_forwarder();
+    check_forwarder_without_cache();
+    check_intermodule_forwarder();
+
+    std::cout << "all tests passed" << std::endl;
+    return 0;
+}
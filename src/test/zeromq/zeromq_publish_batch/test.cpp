@@ -0,0 +1,189 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+
+#include "goby/middleware/marshalling/protobuf.h"
+#include "goby/zeromq/transport/interprocess.h"
+
+#include "goby/test/zeromq/zeromq_publish_batch/test.pb.h"
+#include "goby/util/debug_logger.h"
+
+#include <zmq.hpp>
+
+using namespace goby::test::zeromq::protobuf;
+
+// tests InterProcessPortal with publication batching enabled
+
+const int max_publish = 1000;
+const int max_batch_messages = 50;
+// every widget_period samples, publish a Widget (which flushes the pending batch of Samples)
+const int widget_period = 200;
+
+int sample_receive_count = 0;
+int widget_receive_count = 0;
+
+std::atomic<bool> forward(true);
+
+using goby::glog;
+using namespace goby::util::logger;
+
+extern constexpr goby::middleware::Group sample{"Sample"};
+extern constexpr goby::middleware::Group widget{"Widget"};
+
+// parent process
+void publisher(const goby::zeromq::protobuf::InterProcessPortalConfig& cfg)
+{
+    goby::zeromq::InterProcessPortal<> zmq(cfg);
+    zmq.ready();
+
+    while (zmq.hold_state()) zmq.poll(std::chrono::milliseconds(10));
+
+    for (int i = 0; i < max_publish; ++i)
+    {
+        Sample s;
+        s.set_a(i);
+        zmq.publish<sample>(s);
+
+        if (i % widget_period == widget_period - 1)
+        {
+            Widget w;
+            w.set_b(i);
+            zmq.publish<widget>(w);
+        }
+    }
+
+    // the last (partial) batch is sent after max_latency_us
+    while (forward) { zmq.poll(std::chrono::milliseconds(10)); }
+
+    const auto& stats = zmq.publish_batch_statistics();
+    glog.is(VERBOSE) && glog << "Batches: " << stats.batches << ", messages: " << stats.messages
+                             << ", mean: " << stats.mean_messages()
+                             << ", max: " << stats.max_messages << std::endl;
+
+    // ManagerRequests are never batched
+    assert(stats.messages == max_publish + max_publish / widget_period);
+    assert(stats.max_messages == max_batch_messages);
+    assert(stats.batches < stats.messages);
+    assert(stats.flushed_on_max_messages > 0);
+    assert(stats.flushed_on_identifier_change > 0);
+}
+
+// child process
+void handle_sample(const Sample& s)
+{
+    glog.is(DEBUG1) && glog << "Received sample: " << s.ShortDebugString() << std::endl;
+    assert(s.a() == sample_receive_count);
+    ++sample_receive_count;
+}
+
+void handle_widget(const Widget& w)
+{
+    glog.is(DEBUG1) && glog << "Received widget: " << w.ShortDebugString() << std::endl;
+    // batches are never reordered
+    assert(w.b() == sample_receive_count - 1);
+    ++widget_receive_count;
+}
+
+void subscriber(const goby::zeromq::protobuf::InterProcessPortalConfig& cfg)
+{
+    goby::zeromq::InterProcessPortal<> zmq(cfg);
+    zmq.subscribe<sample, Sample>(&handle_sample);
+    zmq.subscribe<widget, Widget>(&handle_widget);
+    zmq.ready();
+    while (sample_receive_count < max_publish || widget_receive_count < max_publish / widget_period)
+        zmq.poll();
+    glog.is(DEBUG1) && glog << "Subscriber complete." << std::endl;
+}
+
+int main(int /*argc*/, char* argv[])
+{
+    goby::zeromq::protobuf::InterProcessPortalConfig cfg;
+    cfg.set_platform("test_publish_batch");
+    cfg.set_transport(goby::zeromq::protobuf::InterProcessPortalConfig::IPC);
+    cfg.set_send_queue_size(max_publish);
+    cfg.set_receive_queue_size(max_publish);
+
+    pid_t child_pid = fork();
+
+    bool is_child = (child_pid == 0);
+
+    std::string os_name =
+        std::string("/tmp/goby_test_zeromq_publish_batch_") + (is_child ? "subscriber" : "publisher");
+    std::ofstream os(os_name.c_str());
+    goby::glog.add_stream(goby::util::logger::DEBUG3, &os);
+    goby::glog.set_name(std::string(argv[0]) + (is_child ? "_subscriber" : "_publisher"));
+    goby::glog.set_lock_action(goby::util::logger_lock::lock);
+
+    std::unique_ptr<std::thread> t2, t3;
+    std::unique_ptr<zmq::context_t> manager_context;
+    std::unique_ptr<zmq::context_t> router_context;
+    if (!is_child)
+    {
+        manager_context = std::make_unique<zmq::context_t>(1);
+        router_context = std::make_unique<zmq::context_t>(10);
+
+        goby::zeromq::protobuf::InterProcessManagerHold hold;
+        hold.add_required_client("subscriber");
+        hold.add_required_client("publisher");
+
+        goby::zeromq::Router router(*router_context, cfg);
+        t2 = std::make_unique<std::thread>([&] { router.run(); });
+        goby::zeromq::Manager manager(*manager_context, cfg, router, hold);
+        t3 = std::make_unique<std::thread>([&] { manager.run(); });
+
+        auto pub_cfg = cfg;
+        pub_cfg.set_client_name("publisher");
+        pub_cfg.mutable_publish_batch()->set_enable(true);
+        pub_cfg.mutable_publish_batch()->set_max_messages(max_batch_messages);
+        pub_cfg.mutable_publish_batch()->set_max_latency_us(5000);
+        std::thread t1([&] { publisher(pub_cfg); });
+        int wstatus;
+        wait(&wstatus);
+        forward = false;
+        t1.join();
+        router_context.reset();
+        manager_context.reset();
+        t2->join();
+        t3->join();
+        if (wstatus != 0)
+            exit(EXIT_FAILURE);
+    }
+    else
+    {
+        auto sub_cfg = cfg;
+        sub_cfg.set_client_name("subscriber");
+        std::thread t1([&] { subscriber(sub_cfg); });
+        t1.join();
+    }
+
+    glog.is(VERBOSE) && glog << (is_child ? "subscriber" : "publisher") << ": all tests passed"
+                             << std::endl;
+    std::cout << (is_child ? "subscriber" : "publisher") << ": all tests passed" << std::endl;
+}
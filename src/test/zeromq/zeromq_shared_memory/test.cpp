@@ -0,0 +1,258 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Binaries
+// ("The Goby Binaries").
+//
+// The Goby Binaries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// The Goby Binaries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <vector>
+
+#include "goby/middleware/marshalling/protobuf.h"
+#include "goby/zeromq/transport/interprocess.h"
+#include "goby/zeromq/transport/shared_memory.h"
+
+#include "goby/test/zeromq/zeromq_shared_memory/test.pb.h"
+#include "goby/util/debug_logger.h"
+
+#include <zmq.hpp>
+
+using namespace goby::test::zeromq::protobuf;
+
+// tests InterProcessPortal using the gobyd shared memory segment, including publications too large for a slot (which are written to their own shared memory object)
+
+const int max_publish = 100;
+// fits in a slot
+const int small_scan_bytes = 1000;
+// exceeds slot_bytes
+const int large_scan_bytes = 300000;
+const int slot_bytes = 4096;
+
+int sample_receive_count = 0;
+int scan_receive_count = 0;
+
+std::atomic<bool> forward(true);
+
+using goby::glog;
+using namespace goby::util::logger;
+
+extern constexpr goby::middleware::Group sample{"Sample"};
+extern constexpr goby::middleware::Group scan{"Scan"};
+
+// parent process
+void publisher(const goby::zeromq::protobuf::InterProcessPortalConfig& cfg)
+{
+    goby::zeromq::InterProcessPortal<> zmq(cfg);
+    zmq.ready();
+
+    while (zmq.hold_state()) zmq.poll(std::chrono::milliseconds(10));
+
+    for (int i = 0; i < max_publish; ++i)
+    {
+        Sample s;
+        s.set_a(i);
+        zmq.publish<sample>(s);
+
+        Scan sc;
+        sc.set_index(i);
+        sc.set_data(std::string(i % 2 ? large_scan_bytes : small_scan_bytes, 'A' + i % 26));
+        zmq.publish<scan>(sc);
+
+        glog.is(DEBUG1) && glog << "Published: " << i << std::endl;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    while (forward) { zmq.poll(std::chrono::milliseconds(10)); }
+}
+
+// child process
+void handle_sample(const Sample& s)
+{
+    glog.is(DEBUG1) && glog << "Received sample: " << s.ShortDebugString() << std::endl;
+    assert(s.a() == sample_receive_count);
+    ++sample_receive_count;
+}
+
+void handle_scan(const Scan& sc)
+{
+    glog.is(DEBUG1) && glog << "Received scan: " << sc.index() << std::endl;
+    int i = sc.index();
+    // large and small publications are received in order
+    assert(i == scan_receive_count);
+    assert(sc.data() == std::string(i % 2 ? large_scan_bytes : small_scan_bytes, 'A' + i % 26));
+    ++scan_receive_count;
+}
+
+// tests SharedMemorySegment directly: per-subscriber doorbells, publications larger than a slot, and skipping slots that are still being read
+void test_segment()
+{
+    goby::zeromq::protobuf::SharedMemoryConfig shm_cfg;
+    shm_cfg.set_segment_name("/goby_test_zeromq_shared_memory_segment.shm");
+    shm_cfg.set_max_channels(4);
+    shm_cfg.set_slots_per_channel(4);
+    shm_cfg.set_slot_bytes(256);
+
+    auto owner = goby::zeromq::SharedMemorySegment::create(shm_cfg);
+    auto client = goby::zeromq::SharedMemorySegment::open(owner->cfg());
+    assert(client->cfg().slot_bytes() == 256);
+
+    goby::zeromq::SharedMemorySubscriber sub_a(*client), sub_b(*client);
+    sub_a.subscribe("/a/1/A/");
+    sub_b.subscribe("/b/1/B/");
+    int channel_a = owner->channel("/a/1/A/");
+    int channel_b = owner->channel("/b/1/B/");
+    assert(channel_a >= 0 && channel_b >= 0 && channel_a != channel_b);
+
+    std::vector<std::string> received;
+    auto collect = [&](const char* begin, const char* end) { received.emplace_back(begin, end); };
+
+    // only the subscribers to the channel are rung
+    std::uint32_t doorbell_a = sub_a.doorbell(), doorbell_b = sub_b.doorbell();
+    const std::string identifier_a("/a/1/A/1/1");
+    const std::string small(100, 's'), large(10000, 'l');
+    assert(owner->publish(channel_a, identifier_a, small.data(), small.size()));
+    assert(owner->publish(channel_a, identifier_a, large.data(), large.size()));
+    assert(owner->publish(channel_a, identifier_a, small.data(), small.size()));
+    assert(sub_a.doorbell() == doorbell_a + 3);
+    assert(sub_b.doorbell() == doorbell_b);
+    assert(sub_a.wait(doorbell_a, std::chrono::milliseconds(0)) == doorbell_a + 3);
+
+    // large publications keep their order in the ring
+    assert(sub_a.receive(collect) == 3);
+    assert(sub_b.receive(collect) == 0);
+    assert(received.size() == 3);
+    assert(received[0] == identifier_a + small);
+    assert(received[1] == identifier_a + large);
+    assert(received[2] == identifier_a + small);
+    received.clear();
+
+    // a slot pinned by a (slow) subscriber is skipped rather than overwritten
+    const std::uint64_t pinned_seq = owner->head(channel_a) - 1;
+    bool first_read = true;
+    auto result = client->read(channel_a, pinned_seq, [&](const char* begin, const char* end) {
+        std::string before(begin, end);
+        // publish a full lap of the ring while this slot is pinned
+        for (int i = 0; i < 4; ++i)
+            assert(owner->publish(channel_a, identifier_a, large.data(), large.size()));
+        assert(std::string(begin, end) == before);
+        first_read = false;
+    });
+    assert(result == goby::zeromq::SharedMemorySegment::ReadResult::READ && !first_read);
+
+    // the fourth publication skipped the pinned slot, and so overwrote the first
+    assert(owner->head(channel_a) == pinned_seq + 1 + 5);
+    assert(sub_a.receive(collect) == 3);
+    assert(received.size() == 3);
+    for (const auto& r : received) assert(r == identifier_a + large);
+    assert(sub_a.dropped() == 1);
+
+    // subscribers to all channels are rung for any channel
+    sub_b.subscribe_all();
+    doorbell_b = sub_b.doorbell();
+    assert(owner->publish(channel_a, identifier_a, small.data(), small.size()));
+    assert(sub_b.doorbell() == doorbell_b + 1);
+}
+
+void subscriber(const goby::zeromq::protobuf::InterProcessPortalConfig& cfg)
+{
+    goby::zeromq::InterProcessPortal<> zmq(cfg);
+    zmq.subscribe<sample, Sample>(&handle_sample);
+    zmq.subscribe<scan, Scan>(&handle_scan);
+    zmq.ready();
+    while (sample_receive_count < max_publish || scan_receive_count < max_publish)
+        zmq.poll();
+    glog.is(DEBUG1) && glog << "Subscriber complete." << std::endl;
+}
+
+int main(int /*argc*/, char* argv[])
+{
+    goby::zeromq::protobuf::InterProcessPortalConfig cfg;
+    cfg.set_platform("test_shared_memory");
+    cfg.set_transport(goby::zeromq::protobuf::InterProcessPortalConfig::IPC);
+
+    // only used by the Manager, which passes it on to the clients
+    cfg.mutable_shared_memory()->set_enable(true);
+    cfg.mutable_shared_memory()->set_max_channels(8);
+    cfg.mutable_shared_memory()->set_slots_per_channel(2 * max_publish);
+    cfg.mutable_shared_memory()->set_slot_bytes(slot_bytes);
+
+    test_segment();
+
+    pid_t child_pid = fork();
+
+    bool is_child = (child_pid == 0);
+
+    std::string os_name =
+        std::string("/tmp/goby_test_zeromq_shared_memory_") + (is_child ? "subscriber" : "publisher");
+    std::ofstream os(os_name.c_str());
+    goby::glog.add_stream(goby::util::logger::DEBUG3, &os);
+    goby::glog.set_name(std::string(argv[0]) + (is_child ? "_subscriber" : "_publisher"));
+    goby::glog.set_lock_action(goby::util::logger_lock::lock);
+
+    std::unique_ptr<std::thread> t2, t3;
+    std::unique_ptr<zmq::context_t> manager_context;
+    std::unique_ptr<zmq::context_t> router_context;
+    if (!is_child)
+    {
+        manager_context = std::make_unique<zmq::context_t>(1);
+        router_context = std::make_unique<zmq::context_t>(10);
+
+        goby::zeromq::protobuf::InterProcessManagerHold hold;
+        hold.add_required_client("subscriber");
+        hold.add_required_client("publisher");
+
+        goby::zeromq::Router router(*router_context, cfg);
+        t2 = std::make_unique<std::thread>([&] { router.run(); });
+        goby::zeromq::Manager manager(*manager_context, cfg, router, hold);
+        t3 = std::make_unique<std::thread>([&] { manager.run(); });
+
+        auto pub_cfg = cfg;
+        pub_cfg.clear_shared_memory();
+        pub_cfg.set_client_name("publisher");
+        std::thread t1([&] { publisher(pub_cfg); });
+        int wstatus;
+        wait(&wstatus);
+        forward = false;
+        t1.join();
+        router_context.reset();
+        manager_context.reset();
+        t2->join();
+        t3->join();
+        if (wstatus != 0)
+            exit(EXIT_FAILURE);
+    }
+    else
+    {
+        auto sub_cfg = cfg;
+        sub_cfg.clear_shared_memory();
+        sub_cfg.set_client_name("subscriber");
+        std::thread t1([&] { subscriber(sub_cfg); });
+        t1.join();
+    }
+
+    glog.is(VERBOSE) && glog << (is_child ? "subscriber" : "publisher") << ": all tests passed"
+                             << std::endl;
+    std::cout << (is_child ? "subscriber" : "publisher") << ": all tests passed" << std::endl;
+}
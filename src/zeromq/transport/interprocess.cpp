@@ -40,9 +40,11 @@ using namespace goby::util::logger;
 // support moving to new API in ZeroMQ 4.3.1
 #ifdef USE_OLD_ZMQ_CPP_API
 int zmq_send_flags_none{0};
+int zmq_send_flags_sndmore{ZMQ_SNDMORE};
 int zmq_recv_flags_none{0};
 #else
 auto zmq_send_flags_none{zmq::send_flags::none};
+auto zmq_send_flags_sndmore{zmq::send_flags::sndmore};
 auto zmq_recv_flags_none{zmq::recv_flags::none};
 #endif
 
@@ -116,7 +118,8 @@ goby::zeromq::InterProcessPortalMainThread::InterProcessPortalMainThread(zmq::co
 }
 
 bool goby::zeromq::InterProcessPortalMainThread::recv(protobuf::InprocControl* control_msg,
-                                                      zmq_recv_flags_type flags)
+                                                      zmq_recv_flags_type flags,
+                                                      zmq::message_t* received_data)
 {
     zmq::message_t zmq_msg;
     bool message_received = false;
@@ -126,6 +129,17 @@ bool goby::zeromq::InterProcessPortalMainThread::recv(protobuf::InprocControl* c
         glog.is(DEBUG3) && glog << "Main thread received control msg: "
                                 << control_msg->ShortDebugString() << std::endl;
         message_received = true;
+
+        // multipart messages are delivered atomically, so the data part is already available
+        if (zmq_msg.more())
+        {
+            zmq::message_t discard;
+            zmq_socket_recv(control_socket_, received_data ? *received_data : discard);
+        }
+        else if (received_data)
+        {
+            received_data->rebuild();
+        }
     }
 
     return message_received;
@@ -175,14 +189,16 @@ void goby::zeromq::InterProcessPortalMainThread::publish(const std::string& iden
 {
     if (publish_ready() || ignore_buffer)
     {
-        zmq::message_t msg(identifier.size() + size);
-        memcpy(msg.data(), identifier.data(), identifier.size());
-        memcpy(static_cast<char*>(msg.data()) + identifier.size(), bytes, size);
-
-        publish_socket_.send(msg, zmq_send_flags_none);
-
-        glog.is(DEBUG3) && glog << "Published " << size << " bytes to ["
-                                << identifier.substr(0, identifier.size() - 1) << "]" << std::endl;
+        if (batch_cfg_.enable() && !ignore_buffer)
+        {
+            batch_publication(identifier, bytes, size);
+        }
+        else
+        {
+            // preserve ordering with any pending batch
+            flush_batch();
+            send_publication(identifier, bytes, size);
+        }
     }
     else
     {
@@ -193,6 +209,134 @@ void goby::zeromq::InterProcessPortalMainThread::publish(const std::string& iden
     }
 }
 
+void goby::zeromq::InterProcessPortalMainThread::send_publication(const std::string& identifier,
+                                                                  const char* bytes, int size)
+{
+    zmq::message_t msg(identifier.size() + size);
+    memcpy(msg.data(), identifier.data(), identifier.size());
+    memcpy(static_cast<char*>(msg.data()) + identifier.size(), bytes, size);
+
+    publish_socket_.send(msg, zmq_send_flags_none);
+
+    glog.is(DEBUG3) && glog << "Published " << size << " bytes to ["
+                            << identifier.substr(0, identifier.size() - 1) << "]" << std::endl;
+}
+
+void goby::zeromq::InterProcessPortalMainThread::set_batch_cfg(
+    const protobuf::PublishBatchConfig& cfg, std::shared_ptr<std::timed_mutex> poll_mutex,
+    std::shared_ptr<std::condition_variable_any> poller_cv)
+{
+    batch_cfg_ = cfg;
+    if (!batch_cfg_.enable() || batch_timer_thread_)
+        return;
+
+    batch_data_.reserve(batch_cfg_.max_bytes());
+    batch_timer_thread_ = std::make_unique<std::thread>([this, poll_mutex, poller_cv]() {
+        std::unique_lock<std::mutex> lock(batch_timer_mutex_);
+        while (batch_timer_alive_)
+        {
+            if (batch_timer_deadline_ == std::chrono::steady_clock::time_point::max())
+            {
+                batch_timer_cv_.wait(lock);
+            }
+            else if (batch_timer_cv_.wait_until(lock, batch_timer_deadline_) ==
+                     std::cv_status::timeout)
+            {
+                batch_timer_deadline_ = std::chrono::steady_clock::time_point::max();
+                lock.unlock();
+                {
+                    // avoid a lost wakeup between _poll() and the wait on poller_cv
+                    std::lock_guard<std::timed_mutex> l(*poll_mutex);
+                }
+                poller_cv->notify_all();
+                lock.lock();
+            }
+        }
+    });
+}
+
+void goby::zeromq::InterProcessPortalMainThread::batch_publication(const std::string& identifier,
+                                                                   const char* bytes, int size)
+{
+    // batches only contain publications with the same identifier so that ZeroMQ subscription filtering still applies and ordering is preserved
+    if (batch_messages_ > 0 && batch_identifier_ != identifier)
+        flush_batch(&PublishBatchStatistics::flushed_on_identifier_change);
+
+    if (batch_messages_ > 0 &&
+        batch_data_.size() + batch_frame_header_size + size > batch_cfg_.max_bytes())
+        flush_batch(&PublishBatchStatistics::flushed_on_max_bytes);
+
+    if (batch_messages_ == 0)
+    {
+        batch_identifier_ = identifier;
+        batch_deadline_ =
+            std::chrono::steady_clock::now() + std::chrono::microseconds(batch_cfg_.max_latency_us());
+        {
+            std::lock_guard<std::mutex> l(batch_timer_mutex_);
+            batch_timer_deadline_ = batch_deadline_;
+        }
+        batch_timer_cv_.notify_one();
+    }
+
+    auto frame_begin = batch_data_.size();
+    batch_data_.resize(frame_begin + batch_frame_header_size + size);
+    encode_batch_frame_size(size, &batch_data_[frame_begin]);
+    memcpy(&batch_data_[frame_begin + batch_frame_header_size], bytes, size);
+    ++batch_messages_;
+
+    if (batch_messages_ >= batch_cfg_.max_messages())
+        flush_batch(&PublishBatchStatistics::flushed_on_max_messages);
+    else if (batch_data_.size() >= batch_cfg_.max_bytes())
+        flush_batch(&PublishBatchStatistics::flushed_on_max_bytes);
+}
+
+void goby::zeromq::InterProcessPortalMainThread::flush_expired_batch()
+{
+    if (batch_messages_ > 0 && std::chrono::steady_clock::now() >= batch_deadline_)
+        flush_batch(&PublishBatchStatistics::flushed_on_max_latency);
+}
+
+void goby::zeromq::InterProcessPortalMainThread::flush_batch(
+    std::uint64_t PublishBatchStatistics::*reason)
+{
+    if (batch_messages_ == 0)
+        return;
+
+    if (batch_messages_ == 1)
+    {
+        // no need for the batch framing
+        send_publication(batch_identifier_, &batch_data_[batch_frame_header_size],
+                         batch_data_.size() - batch_frame_header_size);
+    }
+    else
+    {
+        // identifier (without null), suffix, null, frames
+        auto id_size = batch_identifier_.size() - 1;
+        zmq::message_t msg(id_size + 2 + batch_data_.size());
+        char* dest = static_cast<char*>(msg.data());
+        memcpy(dest, batch_identifier_.data(), id_size);
+        dest[id_size] = batch_identifier_suffix;
+        dest[id_size + 1] = '\0';
+        memcpy(dest + id_size + 2, batch_data_.data(), batch_data_.size());
+
+        publish_socket_.send(msg, zmq_send_flags_none);
+
+        glog.is(DEBUG3) && glog << "Published batch of " << batch_messages_ << " messages ("
+                                << batch_data_.size() << " bytes) to ["
+                                << batch_identifier_.substr(0, id_size) << "]" << std::endl;
+    }
+
+    ++batch_statistics_.batches;
+    batch_statistics_.messages += batch_messages_;
+    batch_statistics_.bytes += batch_data_.size() - batch_messages_ * batch_frame_header_size;
+    batch_statistics_.max_messages =
+        std::max<std::uint64_t>(batch_statistics_.max_messages, batch_messages_);
+    ++(batch_statistics_.*reason);
+
+    batch_data_.clear();
+    batch_messages_ = 0;
+}
+
 void goby::zeromq::InterProcessPortalMainThread::subscribe(const std::string& identifier)
 {
     protobuf::InprocControl control;
@@ -204,11 +348,12 @@ void goby::zeromq::InterProcessPortalMainThread::subscribe(const std::string& id
 
     // wait for ack
     protobuf::InprocControl control_msg;
-    recv(&control_msg);
+    zmq::message_t received_data;
+    recv(&control_msg, zmq_recv_flags_none, &received_data);
     while (control_msg.type() != protobuf::InprocControl::SUBSCRIBE_ACK)
     {
-        control_buffer_.push_back(control_msg);
-        recv(&control_msg);
+        control_buffer_.emplace_back(control_msg, std::move(received_data));
+        recv(&control_msg, zmq_recv_flags_none, &received_data);
     }
 }
 
@@ -221,11 +366,12 @@ void goby::zeromq::InterProcessPortalMainThread::unsubscribe(const std::string&
 
     // wait for ack
     protobuf::InprocControl control_msg;
-    recv(&control_msg);
+    zmq::message_t received_data;
+    recv(&control_msg, zmq_recv_flags_none, &received_data);
     while (control_msg.type() != protobuf::InprocControl::UNSUBSCRIBE_ACK)
     {
-        control_buffer_.push_back(control_msg);
-        recv(&control_msg);
+        control_buffer_.emplace_back(control_msg, std::move(received_data));
+        recv(&control_msg, zmq_recv_flags_none, &received_data);
     }
 }
 void goby::zeromq::InterProcessPortalMainThread::reader_shutdown()
@@ -437,13 +583,12 @@ void goby::zeromq::InterProcessPortalReadThread::control_data(const zmq::message
         default: break;
     }
 }
-void goby::zeromq::InterProcessPortalReadThread::subscribe_data(const zmq::message_t& zmq_msg)
+void goby::zeromq::InterProcessPortalReadThread::subscribe_data(zmq::message_t& zmq_msg)
 {
-    // data from goby - forward to the main thread
+    // data from goby - hand off the message to the main thread without copying
     protobuf::InprocControl control;
     control.set_type(protobuf::InprocControl::RECEIVE);
-    control.set_received_data(std::string((char*)zmq_msg.data(), zmq_msg.size()));
-    send_control_msg(control);
+    send_control_msg(control, &zmq_msg);
 }
 void goby::zeromq::InterProcessPortalReadThread::manager_data(const zmq::message_t& zmq_msg)
 {
@@ -468,6 +613,8 @@ void goby::zeromq::InterProcessPortalReadThread::manager_data(const zmq::message
         control.set_type(protobuf::InprocControl::PUB_CONFIGURATION);
         control.set_hold(response.hold());
         *control.mutable_publish_socket() = response.publish_socket();
+        if (response.has_shared_memory())
+            *control.mutable_shared_memory() = response.shared_memory();
         send_control_msg(control);
 
         have_pubsub_sockets_ = true;
@@ -477,11 +624,20 @@ void goby::zeromq::InterProcessPortalReadThread::manager_data(const zmq::message
 }
 
 void goby::zeromq::InterProcessPortalReadThread::send_control_msg(
-    const protobuf::InprocControl& control)
+    const protobuf::InprocControl& control, zmq::message_t* data)
 {
     zmq::message_t zmq_control_msg(control.ByteSizeLong());
     control.SerializeToArray((char*)zmq_control_msg.data(), zmq_control_msg.size());
-    control_socket_.send(zmq_control_msg, zmq_send_flags_none);
+    if (data)
+    {
+        control_socket_.send(zmq_control_msg, zmq_send_flags_sndmore);
+        // ownership of the message buffer passes to the main thread (no copy for inproc)
+        control_socket_.send(*data, zmq_send_flags_none);
+    }
+    else
+    {
+        control_socket_.send(zmq_control_msg, zmq_send_flags_none);
+    }
     poller_cv_->notify_all();
 }
 
@@ -615,6 +771,23 @@ goby::zeromq::Manager::Manager(zmq::context_t& context,
             break;
         }
     }
+
+    if (cfg_.shared_memory().enable())
+    {
+        if (cfg_.transport() == protobuf::InterProcessPortalConfig::IPC)
+        {
+            protobuf::SharedMemoryConfig shm_cfg = cfg_.shared_memory();
+            if (!shm_cfg.has_segment_name())
+                shm_cfg.set_segment_name(SharedMemorySegment::default_name(cfg_.platform()));
+            shared_memory_ = SharedMemorySegment::create(shm_cfg);
+        }
+        else
+        {
+            glog.is(WARN) && glog << "Shared memory is only supported for transport == IPC, "
+                                     "disabling"
+                                  << std::endl;
+        }
+    }
 }
 
 void goby::zeromq::Manager::run()
@@ -711,6 +884,8 @@ goby::zeromq::Manager::handle_request(const protobuf::ManagerRequest& pb_request
     {
         *pb_response.mutable_subscribe_socket() = subscribe_socket_cfg();
         *pb_response.mutable_publish_socket() = publish_socket_cfg();
+        if (shared_memory_)
+            *pb_response.mutable_shared_memory() = shared_memory_->cfg();
     }
     else if (pb_request.request() == protobuf::PROVIDE_HOLD_STATE)
     {
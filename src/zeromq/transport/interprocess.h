@@ -48,6 +48,7 @@
 
 #include "goby/middleware/common.h"                             // for thre...
 #include "goby/middleware/group.h"                              // for Group
+#include "goby/middleware/marshalling/detail/protobuf_arena.h"  // for Prot...
 #include "goby/middleware/marshalling/interface.h"              // for Seri...
 #include "goby/middleware/protobuf/serializer_transporter.pb.h" // for Seri...
 #include "goby/middleware/protobuf/transporter_config.pb.h"     // for Tran...
@@ -61,6 +62,7 @@
 #include "goby/util/debug_logger/flex_ostreambuf.h"             // for lock
 #include "goby/zeromq/protobuf/interprocess_config.pb.h"        // for Inte...
 #include "goby/zeromq/protobuf/interprocess_zeromq.pb.h"        // for Inpr...
+#include "goby/zeromq/transport/shared_memory.h"                // for Shar...
 
 #if ZMQ_VERSION <= ZMQ_MAKE_VERSION(4, 3, 1)
 #define USE_OLD_ZMQ_CPP_API
@@ -157,6 +159,49 @@ make_identifier(const std::string& type_name, int scheme, const std::string& gro
     }
 }
 
+/// Appended to the identifier (after the thread) of a publication containing several serialized messages, each preceded by its size (batch_frame_header_size bytes, little-endian)
+constexpr char batch_identifier_suffix{'#'};
+constexpr int batch_frame_header_size{4};
+
+inline void encode_batch_frame_size(std::uint32_t size, char* dest)
+{
+    for (int i = 0; i < batch_frame_header_size; ++i) dest[i] = (size >> (8 * i)) & 0xFF;
+}
+
+inline std::uint32_t decode_batch_frame_size(const char* src)
+{
+    std::uint32_t size = 0;
+    for (int i = 0; i < batch_frame_header_size; ++i)
+        size |= static_cast<std::uint32_t>(static_cast<unsigned char>(src[i])) << (8 * i);
+    return size;
+}
+
+/// \brief Counters describing the publication batches sent by InterProcessPortal (when InterProcessPortalConfig::publish_batch is enabled)
+struct PublishBatchStatistics
+{
+    /// number of ZeroMQ messages sent containing batched publications (including "batches" of one)
+    std::uint64_t batches{0};
+    /// number of publications sent in these batches
+    std::uint64_t messages{0};
+    /// total bytes of serialized data in these batches
+    std::uint64_t bytes{0};
+    /// largest number of publications in a single batch
+    std::uint64_t max_messages{0};
+
+    /// number of batches sent because the next publication would exceed max_bytes
+    std::uint64_t flushed_on_max_bytes{0};
+    /// number of batches sent because max_messages was reached
+    std::uint64_t flushed_on_max_messages{0};
+    /// number of batches sent because max_latency_us elapsed
+    std::uint64_t flushed_on_max_latency{0};
+    /// number of batches sent because the next publication had a different identifier (group, type, or thread)
+    std::uint64_t flushed_on_identifier_change{0};
+    /// number of batches sent for any other reason (e.g. shutdown)
+    std::uint64_t flushed_other{0};
+
+    double mean_messages() const { return batches ? static_cast<double>(messages) / batches : 0; }
+};
+
 #ifdef USE_OLD_ZMQ_CPP_API
 using zmq_recv_flags_type = int;
 using zmq_send_flags_type = int;
@@ -172,6 +217,16 @@ class InterProcessPortalMainThread
     InterProcessPortalMainThread(zmq::context_t& context);
     ~InterProcessPortalMainThread()
     {
+        if (batch_timer_thread_)
+        {
+            {
+                std::lock_guard<std::mutex> l(batch_timer_mutex_);
+                batch_timer_alive_ = false;
+            }
+            batch_timer_cv_.notify_one();
+            batch_timer_thread_->join();
+        }
+
 #ifdef USE_OLD_CPPZMQ_SETSOCKOPT
         control_socket_.setsockopt(ZMQ_LINGER, 0);
         publish_socket_.setsockopt(ZMQ_LINGER, 0);
@@ -184,8 +239,14 @@ class InterProcessPortalMainThread
     bool publish_ready() { return !hold_; }
     bool subscribe_ready() { return have_pubsub_sockets_; }
 
+    /// \brief Receive a control message from the read thread
+    ///
+    /// \param control_msg Set to the received control message
+    /// \param flags ZeroMQ receive flags
+    /// \param received_data If non-null, set to the received publication (identifier + data) for InprocControl::RECEIVE, which is handed off from the read thread in a second message part without copying
     bool recv(protobuf::InprocControl* control_msg,
-              zmq_recv_flags_type flags = zmq_recv_flags_type());
+              zmq_recv_flags_type flags = zmq_recv_flags_type(),
+              zmq::message_t* received_data = nullptr);
     void set_publish_cfg(const protobuf::Socket& cfg);
 
     void set_hold_state(bool hold);
@@ -193,25 +254,64 @@ class InterProcessPortalMainThread
 
     void publish(const std::string& identifier, const char* bytes, int size,
                  bool ignore_buffer = false);
+
+    /// \brief Enable batching of publications
+    ///
+    /// \param cfg Batch configuration
+    /// \param poll_mutex Poller mutex of the owning InterProcessPortal
+    /// \param poller_cv Poller condition variable of the owning InterProcessPortal, notified when the batch latency expires so that flush_expired_batch() is called
+    void set_batch_cfg(const protobuf::PublishBatchConfig& cfg,
+                       std::shared_ptr<std::timed_mutex> poll_mutex,
+                       std::shared_ptr<std::condition_variable_any> poller_cv);
+    /// \brief Send the pending batch if max_latency_us has elapsed since its first publication
+    void flush_expired_batch();
+    /// \brief Send the pending batch, if any
+    void flush_batch() { flush_batch(&PublishBatchStatistics::flushed_other); }
+    const PublishBatchStatistics& batch_statistics() const { return batch_statistics_; }
+
     void subscribe(const std::string& identifier);
     void unsubscribe(const std::string& identifier);
     void reader_shutdown();
 
-    std::deque<protobuf::InprocControl>& control_buffer() { return control_buffer_; }
+    std::deque<std::pair<protobuf::InprocControl, zmq::message_t>>& control_buffer()
+    {
+        return control_buffer_;
+    }
     void send_control_msg(const protobuf::InprocControl& control);
 
   private:
+    void send_publication(const std::string& identifier, const char* bytes, int size);
+    void batch_publication(const std::string& identifier, const char* bytes, int size);
+    void flush_batch(std::uint64_t PublishBatchStatistics::*reason);
+
   private:
     zmq::socket_t control_socket_;
     zmq::socket_t publish_socket_;
     bool hold_{true};
     bool have_pubsub_sockets_{false};
 
+    protobuf::PublishBatchConfig batch_cfg_;
+    // identifier (including null terminator) of the pending batch
+    std::string batch_identifier_;
+    // size-prefixed serialized publications
+    std::vector<char> batch_data_;
+    std::uint32_t batch_messages_{0};
+    std::chrono::steady_clock::time_point batch_deadline_;
+    PublishBatchStatistics batch_statistics_;
+
+    // wakes the poller when the pending batch's max_latency_us expires
+    std::unique_ptr<std::thread> batch_timer_thread_;
+    std::mutex batch_timer_mutex_;
+    std::condition_variable batch_timer_cv_;
+    std::chrono::steady_clock::time_point batch_timer_deadline_{
+        std::chrono::steady_clock::time_point::max()};
+    bool batch_timer_alive_{true};
+
     std::deque<std::pair<std::string, std::vector<char>>>
         publish_queue_; //used before hold == false
 
-    // buffer messages while waiting for (un)subscribe ack
-    std::deque<protobuf::InprocControl> control_buffer_;
+    // buffer messages (and received data, if any) while waiting for (un)subscribe ack
+    std::deque<std::pair<protobuf::InprocControl, zmq::message_t>> control_buffer_;
 };
 
 // run in a separate thread to allow zmq_.poll() to block without interrupting the main thread
@@ -238,9 +338,10 @@ class InterProcessPortalReadThread
   private:
     void poll(long timeout_ms = -1);
     void control_data(const zmq::message_t& zmq_msg);
-    void subscribe_data(const zmq::message_t& zmq_msg);
+    void subscribe_data(zmq::message_t& zmq_msg);
     void manager_data(const zmq::message_t& zmq_msg);
-    void send_control_msg(const protobuf::InprocControl& control);
+    void send_control_msg(const protobuf::InprocControl& control,
+                          zmq::message_t* data = nullptr);
     void send_manager_request(const protobuf::ManagerRequest& req);
 
   private:
@@ -303,8 +404,15 @@ class InterProcessPortalImplementation
 
     ~InterProcessPortalImplementation()
     {
+        if (shm_thread_)
+        {
+            shm_alive_ = false;
+            shm_thread_->join();
+        }
+
         if (zmq_thread_)
         {
+            zmq_main_.flush_batch();
             zmq_main_.reader_shutdown();
             zmq_thread_->join();
         }
@@ -316,6 +424,12 @@ class InterProcessPortalImplementation
     /// \brief When using hold functionality, returns whether the system is holding (true) and thus waiting for all processes to connect and be ready, or running (false).
     bool hold_state() { return zmq_main_.hold_state(); }
 
+    /// \brief Statistics on the batches of publications sent (if cfg.publish_batch().enable() is true)
+    const PublishBatchStatistics& publish_batch_statistics() const
+    {
+        return zmq_main_.batch_statistics();
+    }
+
     friend Base;
     friend typename Base::Base;
 
@@ -336,12 +450,22 @@ class InterProcessPortalImplementation
                 {
                     case protobuf::InprocControl::PUB_CONFIGURATION:
                         zmq_main_.set_publish_cfg(control_msg.publish_socket());
+                        if (control_msg.has_shared_memory())
+                            _init_shared_memory(control_msg.shared_memory());
                         break;
                     default: break;
                 }
             }
         }
 
+        if (cfg_.arena_parse().enable())
+            arena_pool_ = std::make_unique<middleware::detail::ProtobufArenaPool>(
+                cfg_.arena_parse().start_block_bytes(), cfg_.arena_parse().max_block_bytes());
+
+        if (cfg_.publish_batch().enable())
+            zmq_main_.set_batch_cfg(cfg_.publish_batch(), middleware::PollerInterface::poll_mutex(),
+                                    middleware::PollerInterface::cv());
+
         //
         // Handle hold state request/response using pub sub so that we ensure
         // publishing and subscribe is completely functional before releasing the hold
@@ -369,6 +493,37 @@ class InterProcessPortalImplementation
             groups::manager_response, middleware::Subscriber<protobuf::ManagerResponse>());
     }
 
+    void _init_shared_memory(const protobuf::SharedMemoryConfig& shm_cfg)
+    {
+        shm_segment_ = SharedMemorySegment::open(shm_cfg);
+        shm_subscriber_ = std::make_unique<SharedMemorySubscriber>(*shm_segment_);
+
+        // wake up the poller when another client publishes to a channel we subscribe to
+        shm_thread_ = std::make_unique<std::thread>(
+            [this, poll_mutex = middleware::PollerInterface::poll_mutex(),
+             cv = middleware::PollerInterface::cv()]() {
+                std::uint32_t doorbell = shm_subscriber_->doorbell();
+                while (shm_alive_)
+                {
+                    std::uint32_t new_doorbell =
+                        shm_subscriber_->wait(doorbell, std::chrono::milliseconds(100));
+                    if (new_doorbell != doorbell)
+                    {
+                        doorbell = new_doorbell;
+                        {
+                            // avoid a lost wakeup between _poll() and the wait on cv
+                            std::lock_guard<std::timed_mutex> l(*poll_mutex);
+                        }
+                        cv->notify_all();
+                    }
+                }
+            });
+
+        goby::glog.is_debug1() && goby::glog << "Using shared memory segment "
+                                             << shm_cfg.segment_name() << " for publications"
+                                             << std::endl;
+    }
+
     template <typename Data, int scheme>
     void _publish(const Data& d, const goby::middleware::Group& group,
                   const middleware::Publisher<Data>& /*publisher*/, bool ignore_buffer = false)
@@ -378,11 +533,69 @@ class InterProcessPortalImplementation
         _publish_serialized(type_name, scheme, bytes, group, ignore_buffer);
     }
 
+    template <typename Data, int scheme>
+    void _publish_encoded(const Data& d, std::shared_ptr<const std::vector<char>> bytes,
+                          const goby::middleware::Group& group,
+                          const middleware::Publisher<Data>& /*publisher*/)
+    {
+        std::string type_name = middleware::SerializerParserHelper<Data, scheme>::type_name(d);
+        _publish_serialized(type_name, scheme, *bytes, group);
+    }
+
     void _publish_serialized(std::string type_name, int scheme, const std::vector<char>& bytes,
                              const goby::middleware::Group& group, bool ignore_buffer = false)
     {
         std::string identifier = _make_fully_qualified_identifier(type_name, scheme, group) + '\0';
-        zmq_main_.publish(identifier, &bytes[0], bytes.size(), ignore_buffer);
+        _transport_publish(identifier, &bytes[0], bytes.size(), ignore_buffer);
+    }
+
+    void _transport_publish(const std::string& identifier, const char* bytes, int size,
+                            bool ignore_buffer = false)
+    {
+        // publications buffered during hold and those to the Manager (gobyd) always use ZeroMQ
+        if (shm_segment_ && !ignore_buffer && zmq_main_.publish_ready())
+        {
+            auto it = shm_publish_channels_.find(identifier);
+            if (it == shm_publish_channels_.end())
+            {
+                // channel key is /group/scheme/type/ (i.e. PROCESS_THREAD_WILDCARD)
+                std::string::size_type key_end = 0;
+                for (int i = 0; i < 4 && key_end != std::string::npos; ++i)
+                    key_end = identifier.find('/', i == 0 ? 0 : key_end + 1);
+                int channel = (key_end == std::string::npos)
+                                  ? -1
+                                  : shm_segment_->channel(identifier.substr(0, key_end + 1));
+                it = shm_publish_channels_.insert(std::make_pair(identifier, channel)).first;
+            }
+
+            if (it->second >= 0 && shm_segment_->publish(it->second, identifier, bytes, size))
+                return;
+        }
+        zmq_main_.publish(identifier, bytes, size, ignore_buffer);
+    }
+
+    void _transport_subscribe(const std::string& identifier)
+    {
+        zmq_main_.subscribe(identifier);
+        if (shm_subscriber_)
+        {
+            if (identifier == "/")
+                shm_subscriber_->subscribe_all();
+            else
+                shm_subscriber_->subscribe(identifier);
+        }
+    }
+
+    void _transport_unsubscribe(const std::string& identifier)
+    {
+        zmq_main_.unsubscribe(identifier);
+        if (shm_subscriber_)
+        {
+            if (identifier == "/")
+                shm_subscriber_->unsubscribe_all();
+            else
+                shm_subscriber_->unsubscribe(identifier);
+        }
     }
 
     template <typename Data, int scheme>
@@ -400,7 +613,7 @@ class InterProcessPortalImplementation
 
         if (forwarder_subscriptions_.count(identifier) == 0 &&
             portal_subscriptions_.count(identifier) == 0)
-            zmq_main_.subscribe(identifier);
+            _transport_subscribe(identifier);
         portal_subscriptions_.insert(std::make_pair(identifier, subscription));
     }
 
@@ -428,7 +641,7 @@ class InterProcessPortalImplementation
 
         // If no forwarded subscriptions, do the actual unsubscribe
         if (forwarder_subscriptions_.count(identifier) == 0)
-            zmq_main_.unsubscribe(identifier);
+            _transport_unsubscribe(identifier);
     }
 
     void _unsubscribe_all(
@@ -441,7 +654,7 @@ class InterProcessPortalImplementation
             {
                 const auto& identifier = p.first;
                 if (forwarder_subscriptions_.count(identifier) == 0)
-                    zmq_main_.unsubscribe(identifier);
+                    _transport_unsubscribe(identifier);
             }
             portal_subscriptions_.clear();
         }
@@ -458,14 +671,18 @@ class InterProcessPortalImplementation
         {
             regex_subscriptions_.erase(subscriber_id);
             if (regex_subscriptions_.empty())
-                zmq_main_.unsubscribe("/");
+                _transport_unsubscribe("/");
         }
     }
 
     int _poll(std::unique_ptr<std::unique_lock<std::timed_mutex>>& lock)
     {
+        // Protobuf messages received during this poll are allocated on a shared arena (if enabled)
+        middleware::detail::ProtobufArenaScope arena_scope(arena_pool_.get());
+
         int items = 0;
         protobuf::InprocControl new_control_msg;
+        zmq::message_t new_data;
 
 #ifdef USE_OLD_ZMQ_CPP_API
         int flags = ZMQ_NOBLOCK;
@@ -473,12 +690,12 @@ class InterProcessPortalImplementation
         auto flags = zmq::recv_flags::dontwait;
 #endif
 
-        while (zmq_main_.recv(&new_control_msg, flags))
-            zmq_main_.control_buffer().push_back(new_control_msg);
+        while (zmq_main_.recv(&new_control_msg, flags, &new_data))
+            zmq_main_.control_buffer().emplace_back(new_control_msg, std::move(new_data));
 
         while (!zmq_main_.control_buffer().empty())
         {
-            const auto& control_msg = zmq_main_.control_buffer().front();
+            const auto& control_msg = zmq_main_.control_buffer().front().first;
             switch (control_msg.type())
             {
                 case protobuf::InprocControl::RECEIVE:
@@ -487,54 +704,10 @@ class InterProcessPortalImplementation
                     if (lock)
                         lock.reset();
 
-                    const auto& data = control_msg.received_data();
-
-                    std::string group, type, thread;
-                    int scheme, process;
-                    std::tie(group, scheme, type, process, thread) = parse_identifier(data);
-                    std::string identifier = _make_identifier(
-                        type, scheme, group, IdentifierWildcard::PROCESS_THREAD_WILDCARD);
-
-                    // build a set so if any of the handlers unsubscribes, we still have a pointer to the middleware::SerializationHandlerBase<>
-                    std::vector<std::weak_ptr<const middleware::SerializationHandlerBase<>>>
-                        subs_to_post;
-                    auto portal_range = portal_subscriptions_.equal_range(identifier);
-                    for (auto it = portal_range.first; it != portal_range.second; ++it)
-                        subs_to_post.push_back(it->second);
-                    auto forwarder_it = forwarder_subscriptions_.find(identifier);
-                    if (forwarder_it != forwarder_subscriptions_.end())
-                        subs_to_post.push_back(forwarder_it->second);
-
-                    // actually post the data
-                    {
-                        const auto& data = control_msg.received_data();
-                        auto null_delim_it = std::find(std::begin(data), std::end(data), '\0');
-                        for (auto& sub : subs_to_post)
-                        {
-                            if (auto sub_sp = sub.lock())
-                                sub_sp->post(null_delim_it + 1, data.end());
-                        }
-                    }
-
-                    if (!regex_subscriptions_.empty())
-                    {
-                        auto null_delim_it = std::find(std::begin(data), std::end(data), '\0');
-
-                        bool forwarder_subscription_posted = false;
-                        for (auto& sub : regex_subscriptions_)
-                        {
-                            // only post at most once for forwarders as the threads will filter
-                            bool is_forwarded_sub =
-                                sub.first != identifier_part_to_string(std::this_thread::get_id());
-                            if (is_forwarded_sub && forwarder_subscription_posted)
-                                continue;
-
-                            if (sub.second->post(null_delim_it + 1, data.end(), scheme, type,
-                                                 group) &&
-                                is_forwarded_sub)
-                                forwarder_subscription_posted = true;
-                        }
-                    }
+                    // parse directly from the buffer owned by the zmq::message_t received by the read thread
+                    const auto& zmq_data = zmq_main_.control_buffer().front().second;
+                    const char* data_begin = static_cast<const char*>(zmq_data.data());
+                    _post_received(data_begin, data_begin + zmq_data.size());
                 }
                 break;
 
@@ -560,18 +733,112 @@ class InterProcessPortalImplementation
             }
             zmq_main_.control_buffer().pop_front();
         }
+
+        zmq_main_.flush_expired_batch();
+
+        if (shm_subscriber_)
+        {
+            // parse directly from the shared memory segment
+            items += shm_subscriber_->receive([&](const char* data_begin, const char* data_end) {
+                if (lock)
+                    lock.reset();
+                _post_received(data_begin, data_end);
+            });
+        }
+
         return items;
     }
 
-    void _receive_publication_forwarded(
-        const goby::middleware::protobuf::SerializerTransporterMessage& msg)
+    // post received data (null terminated identifier followed by the serialized data, or by several size-prefixed serialized messages if the identifier ends in batch_identifier_suffix)
+    void _post_received(const char* data_begin, const char* data_end)
     {
+        const char* null_delim_it = std::find(data_begin, data_end, '\0');
+        bool is_batch = null_delim_it != data_begin && null_delim_it != data_end &&
+                        *(null_delim_it - 1) == batch_identifier_suffix;
+
+        std::string group, type, thread;
+        int scheme, process;
+        std::tie(group, scheme, type, process, thread) =
+            parse_identifier(std::string(data_begin, is_batch ? null_delim_it - 1 : null_delim_it));
         std::string identifier =
-            _make_identifier(msg.key().type(), msg.key().marshalling_scheme(), msg.key().group(),
+            _make_identifier(type, scheme, group, IdentifierWildcard::PROCESS_THREAD_WILDCARD);
+
+        // build a set so if any of the handlers unsubscribes, we still have a pointer to the middleware::SerializationHandlerBase<>
+        std::vector<std::weak_ptr<const middleware::SerializationHandlerBase<>>> subs_to_post;
+        auto portal_range = portal_subscriptions_.equal_range(identifier);
+        for (auto it = portal_range.first; it != portal_range.second; ++it)
+            subs_to_post.push_back(it->second);
+        auto forwarder_it = forwarder_subscriptions_.find(identifier);
+        if (forwarder_it != forwarder_subscriptions_.end())
+            subs_to_post.push_back(forwarder_it->second);
+
+        auto post = [&](const char* bytes_begin, const char* bytes_end) {
+            // actually post the data
+            for (auto& sub : subs_to_post)
+            {
+                if (auto sub_sp = sub.lock())
+                    sub_sp->post(bytes_begin, bytes_end);
+            }
+
+            if (!regex_subscriptions_.empty())
+            {
+                bool forwarder_subscription_posted = false;
+                for (auto& sub : regex_subscriptions_)
+                {
+                    // only post at most once for forwarders as the threads will filter
+                    bool is_forwarded_sub =
+                        sub.first != identifier_part_to_string(std::this_thread::get_id());
+                    if (is_forwarded_sub && forwarder_subscription_posted)
+                        continue;
+
+                    if (sub.second->post(bytes_begin, bytes_end, scheme, type, group) &&
+                        is_forwarded_sub)
+                        forwarder_subscription_posted = true;
+                }
+            }
+        };
+
+        if (!is_batch)
+        {
+            post(null_delim_it + 1, data_end);
+        }
+        else
+        {
+            const char* frame_it = null_delim_it + 1;
+            while (frame_it + batch_frame_header_size <= data_end)
+            {
+                std::uint32_t size = decode_batch_frame_size(frame_it);
+                frame_it += batch_frame_header_size;
+                if (size > static_cast<std::uint32_t>(data_end - frame_it))
+                {
+                    goby::glog.is_warn() && goby::glog << "Truncated batched publication for ["
+                                                       << identifier << "]" << std::endl;
+                    break;
+                }
+                post(frame_it, frame_it + size);
+                frame_it += size;
+            }
+        }
+    }
+
+    void _receive_publication_forwarded(const middleware::detail::SerializedPublication& msg)
+    {
+        std::string identifier =
+            _make_identifier(msg.key.type(), msg.key.marshalling_scheme(), msg.key.group(),
                              IdentifierWildcard::NO_WILDCARDS) +
             '\0';
-        auto& bytes = msg.data();
-        zmq_main_.publish(identifier, &bytes[0], bytes.size());
+        const auto& bytes = *msg.bytes;
+        _transport_publish(identifier, bytes.data(), bytes.size());
+    }
+
+    void _receive_publication_forwarded(
+        const goby::middleware::protobuf::SerializerTransporterMessage& msg)
+    {
+        const auto& bytes = msg.data();
+        _transport_publish(_make_identifier(msg.key().type(), msg.key().marshalling_scheme(),
+                                            msg.key().group(), IdentifierWildcard::NO_WILDCARDS) +
+                               '\0',
+                           bytes.data(), bytes.size());
     }
 
     void _receive_subscription_forwarded(
@@ -598,7 +865,7 @@ class InterProcessPortalImplementation
                     {
                         // first to subscribe (locally or forwarded)
                         if (portal_subscriptions_.count(identifier) == 0)
-                            zmq_main_.subscribe(identifier);
+                            _transport_subscribe(identifier);
 
                         // create Forwarder subscription
                         forwarder_subscriptions_.insert(std::make_pair(identifier, subscription));
@@ -642,7 +909,7 @@ class InterProcessPortalImplementation
 
                 // do the actual unsubscribe if we aren't subscribe locally as well
                 if (portal_subscriptions_.count(identifier) == 0)
-                    zmq_main_.unsubscribe(identifier);
+                    _transport_unsubscribe(identifier);
             }
 
             forwarder_subscription_identifiers_[subscriber_id].erase(it);
@@ -659,7 +926,7 @@ class InterProcessPortalImplementation
         const std::shared_ptr<const middleware::SerializationSubscriptionRegex>& new_sub)
     {
         if (regex_subscriptions_.empty())
-            zmq_main_.subscribe("/");
+            _transport_subscribe("/");
 
         regex_subscriptions_.insert(std::make_pair(new_sub->subscriber_id(), new_sub));
     }
@@ -718,6 +985,16 @@ class InterProcessPortalImplementation
     InterProcessPortalMainThread zmq_main_;
     InterProcessPortalReadThread zmq_read_thread_;
 
+    // shared memory transport, if the Manager (gobyd) provided a segment
+    std::unique_ptr<SharedMemorySegment> shm_segment_;
+    std::unique_ptr<SharedMemorySubscriber> shm_subscriber_;
+    std::unique_ptr<std::thread> shm_thread_;
+    std::atomic<bool> shm_alive_{true};
+    // fully qualified identifier to channel index (or -1 if unavailable)
+    std::unordered_map<std::string, int> shm_publish_channels_;
+
+    std::unique_ptr<middleware::detail::ProtobufArenaPool> arena_pool_;
+
     // maps identifier to subscription
     std::unordered_multimap<std::string,
                             std::shared_ptr<const middleware::SerializationHandlerBase<>>>
@@ -807,6 +1084,9 @@ class Manager
     std::unique_ptr<zmq::socket_t> subscribe_socket_;
     std::unique_ptr<zmq::socket_t> publish_socket_;
 
+    // created if cfg.shared_memory().enable() and shared with all clients
+    std::unique_ptr<SharedMemorySegment> shared_memory_;
+
     std::string zmq_filter_req_{make_identifier(
         middleware::SerializerParserHelper<
             protobuf::ManagerRequest, middleware::scheme<protobuf::ManagerRequest>()>::type_name(),
@@ -0,0 +1,876 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>  // for min
+#include <atomic>     // for atomic
+#include <cerrno>     // for errno
+#include <climits>    // for INT_MAX
+#include <csignal>    // for kill
+#include <cstring>    // for memcpy, strerror
+#include <fcntl.h>    // for O_CREAT, O_RDWR, posix_fallocate
+#include <limits>     // for numeric_limits
+#include <new>        // for placement new
+#include <stdexcept>  // for runtime_error
+#include <sys/mman.h> // for mmap, shm_open
+#include <sys/stat.h> // for mode constants
+#include <thread>     // for yield, sleep_for
+#include <unistd.h>   // for ftruncate, close, getpid
+#include <vector>     // for vector
+
+#ifdef __linux__
+#include <linux/futex.h> // for FUTEX_WAIT, FUTEX_WAKE
+#include <sys/syscall.h> // for SYS_futex
+#endif
+
+#include "goby/util/debug_logger/flex_ostream.h" // for glog
+
+#include "shared_memory.h"
+
+using goby::glog;
+using namespace goby::util::logger;
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "Shared memory transport requires lock-free atomics");
+
+namespace goby
+{
+namespace zeromq
+{
+namespace detail
+{
+constexpr std::uint64_t shared_memory_magic{0x676f62797368ULL}; // "gobysh"
+constexpr std::uint32_t shared_memory_version{2};
+constexpr std::size_t shared_memory_max_key_size{224};
+// large enough for the name of a shared memory object (NAME_MAX)
+constexpr std::uint32_t shared_memory_min_slot_bytes{256};
+
+struct SharedMemoryHeader
+{
+    std::uint64_t magic;
+    std::uint32_t version;
+    std::uint32_t max_channels;
+    std::uint32_t slots_per_channel;
+    std::uint32_t slot_bytes;
+    std::atomic<std::uint64_t> channel_generation{0};
+    // incremented after each channel becomes READY
+    std::atomic<std::uint32_t> channel_count{0};
+
+    // bit mask of the subscribers to all channels
+    alignas(64) std::atomic<std::uint64_t> all_subscribers{0};
+};
+
+struct alignas(64) SharedMemorySubscriberEntry
+{
+    // process that registered this subscriber, 0 if free
+    std::atomic<std::uint32_t> pid{0};
+    // futex word: incremented after every publication to a channel this subscriber is subscribed to
+    std::atomic<std::uint32_t> doorbell{0};
+    std::atomic<std::uint32_t> waiters{0};
+};
+
+struct SharedMemoryChannel
+{
+    enum State : std::uint32_t
+    {
+        FREE = 0,
+        INITIALIZING = 1,
+        READY = 2
+    };
+    std::atomic<std::uint32_t> state{FREE};
+    std::uint32_t key_size{0};
+    std::uint64_t generation{0};
+    char key[shared_memory_max_key_size];
+    // bit mask of the subscribers to this channel
+    std::atomic<std::uint64_t> subscribers{0};
+
+    // keep the head (written by every publisher) on its own cache line
+    alignas(64) std::atomic<std::uint64_t> head{0};
+};
+
+// followed by slot_bytes of data
+struct alignas(64) SharedMemorySlot
+{
+    // 2 * (seq + 1) when publication seq is complete, 2 * seq + 1 while it is being written
+    std::atomic<std::uint64_t> sequence{0};
+    // 2 * (seq + 1) if publication seq skipped this slot (as it was still being read), leaving the previous contents in place
+    std::atomic<std::uint64_t> skipped{0};
+    // number of subscribers currently reading this slot
+    std::atomic<std::uint32_t> readers{0};
+    // size of the publication (identifier and data)
+    std::uint32_t size{0};
+    // if non-zero, the slot holds the name (of this size) of a shared memory object containing the publication, rather than the publication itself
+    std::uint32_t object{0};
+};
+
+// used to give each shared memory object created by this process a unique name
+std::atomic<std::uint64_t> shared_memory_objects_created{0};
+
+constexpr std::size_t align_up(std::size_t n, std::size_t alignment = 64)
+{
+    return (n + alignment - 1) / alignment * alignment;
+}
+
+// FNV-1a, used to pick the starting position when probing the channel table
+inline std::size_t key_hash(const std::string& key)
+{
+    std::uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : key)
+    {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// reserve the pages up front, so that a full /dev/shm is reported here rather than by SIGBUS on first access
+// returns 0 or an errno value
+inline int allocate(int fd, std::size_t size)
+{
+#ifdef __linux__
+    int error;
+    while ((error = posix_fallocate(fd, 0, size)) == EINTR)
+        ;
+    return error;
+#else
+    return ftruncate(fd, size) == 0 ? 0 : errno;
+#endif
+}
+
+inline void futex_wake(std::atomic<std::uint32_t>* addr)
+{
+#ifdef __linux__
+    // not FUTEX_PRIVATE_FLAG as the waiters are in other processes
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(addr), FUTEX_WAKE, INT_MAX, nullptr,
+            nullptr, 0);
+#else
+    (void)addr;
+#endif
+}
+
+inline void futex_wait(std::atomic<std::uint32_t>* addr, std::uint32_t expected,
+                       std::chrono::milliseconds timeout)
+{
+#ifdef __linux__
+    struct timespec ts;
+    ts.tv_sec = timeout.count() / 1000;
+    ts.tv_nsec = (timeout.count() % 1000) * 1000000;
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(addr), FUTEX_WAIT, expected, &ts, nullptr,
+            0);
+#else
+    // no futex available: fall back to polling the doorbell
+    auto end = std::chrono::steady_clock::now() + timeout;
+    while (addr->load(std::memory_order_acquire) == expected &&
+           std::chrono::steady_clock::now() < end)
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+#endif
+}
+
+} // namespace detail
+} // namespace zeromq
+} // namespace goby
+
+std::unique_ptr<goby::zeromq::SharedMemorySegment>
+goby::zeromq::SharedMemorySegment::create(const protobuf::SharedMemoryConfig& cfg)
+{
+    return std::unique_ptr<SharedMemorySegment>(new SharedMemorySegment(cfg, true));
+}
+
+std::unique_ptr<goby::zeromq::SharedMemorySegment>
+goby::zeromq::SharedMemorySegment::open(const protobuf::SharedMemoryConfig& cfg)
+{
+    return std::unique_ptr<SharedMemorySegment>(new SharedMemorySegment(cfg, false));
+}
+
+goby::zeromq::SharedMemorySegment::SharedMemorySegment(const protobuf::SharedMemoryConfig& cfg,
+                                                       bool owner)
+    : cfg_(cfg), owner_(owner)
+{
+    using detail::SharedMemoryChannel;
+    using detail::SharedMemoryHeader;
+    using detail::SharedMemorySlot;
+
+    if (!cfg_.has_segment_name())
+        throw(std::runtime_error("SharedMemoryConfig segment_name must be set"));
+
+    int fd = -1;
+    if (owner_)
+    {
+        // remove any stale segment from a previous gobyd
+        shm_unlink(cfg_.segment_name().c_str());
+        fd = shm_open(cfg_.segment_name().c_str(), O_CREAT | O_EXCL | O_RDWR, cfg_.mode());
+    }
+    else
+    {
+        fd = shm_open(cfg_.segment_name().c_str(), O_RDWR, 0);
+    }
+
+    if (fd < 0)
+        throw(std::runtime_error("Failed to open shared memory segment " + cfg_.segment_name() +
+                                 ": " + std::strerror(errno)));
+
+    if (owner_)
+    {
+        if (cfg_.slots_per_channel() < 2)
+            cfg_.set_slots_per_channel(2);
+        if (cfg_.max_channels() < 1)
+            cfg_.set_max_channels(1);
+        if (cfg_.slot_bytes() < detail::shared_memory_min_slot_bytes)
+            cfg_.set_slot_bytes(detail::shared_memory_min_slot_bytes);
+    }
+    else
+    {
+        // the layout is defined by the segment header, not our copy of the configuration
+        SharedMemoryHeader existing;
+        if (pread(fd, &existing, sizeof(existing), 0) != sizeof(existing) ||
+            existing.magic != detail::shared_memory_magic ||
+            existing.version != detail::shared_memory_version)
+        {
+            ::close(fd);
+            throw(std::runtime_error("Shared memory segment " + cfg_.segment_name() +
+                                     " is not a compatible Goby segment"));
+        }
+        cfg_.set_max_channels(existing.max_channels);
+        cfg_.set_slots_per_channel(existing.slots_per_channel);
+        cfg_.set_slot_bytes(existing.slot_bytes);
+    }
+
+    channels_offset_ = detail::align_up(sizeof(SharedMemoryHeader));
+    subscribers_offset_ =
+        channels_offset_ + detail::align_up(cfg_.max_channels() * sizeof(SharedMemoryChannel));
+    slots_offset_ = subscribers_offset_ +
+                    detail::align_up(max_subscribers * sizeof(detail::SharedMemorySubscriberEntry));
+    slot_data_offset_ = sizeof(SharedMemorySlot);
+    slot_stride_ = detail::align_up(slot_data_offset_ + cfg_.slot_bytes());
+    size_ = slots_offset_ + static_cast<std::size_t>(cfg_.max_channels()) *
+                                cfg_.slots_per_channel() * slot_stride_;
+
+    if (owner_)
+    {
+        int error = detail::allocate(fd, size_);
+        if (error != 0)
+        {
+            ::close(fd);
+            shm_unlink(cfg_.segment_name().c_str());
+            throw(std::runtime_error("Failed to allocate " + std::to_string(size_) +
+                                     " bytes for shared memory segment " + cfg_.segment_name() +
+                                     ": " + std::strerror(error)));
+        }
+    }
+
+    base_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base_ == MAP_FAILED)
+    {
+        base_ = nullptr;
+        if (owner_)
+            shm_unlink(cfg_.segment_name().c_str());
+        throw(std::runtime_error("Failed to map shared memory segment " + cfg_.segment_name() +
+                                 ": " + std::strerror(errno)));
+    }
+
+    auto* base = static_cast<char*>(base_);
+    if (owner_)
+    {
+        // the pages are zero filled, so only the header and the channel and subscriber tables need construction; slots are constructed lazily (all zeros is a valid initial state)
+        header_ = new (base) SharedMemoryHeader;
+        header_->magic = detail::shared_memory_magic;
+        header_->version = detail::shared_memory_version;
+        header_->max_channels = cfg_.max_channels();
+        header_->slots_per_channel = cfg_.slots_per_channel();
+        header_->slot_bytes = cfg_.slot_bytes();
+        for (int i = 0, n = cfg_.max_channels(); i < n; ++i)
+            new (base + channels_offset_ + i * sizeof(SharedMemoryChannel)) SharedMemoryChannel;
+        for (int i = 0; i < max_subscribers; ++i)
+            new (base + subscribers_offset_ + i * sizeof(detail::SharedMemorySubscriberEntry))
+                detail::SharedMemorySubscriberEntry;
+
+        glog.is(DEBUG1) && glog << "Created shared memory segment " << cfg_.segment_name() << " ("
+                                << size_ << " bytes)" << std::endl;
+    }
+    else
+    {
+        header_ = reinterpret_cast<SharedMemoryHeader*>(base);
+        glog.is(DEBUG2) && glog << "Opened shared memory segment " << cfg_.segment_name()
+                                << std::endl;
+    }
+}
+
+goby::zeromq::SharedMemorySegment::~SharedMemorySegment()
+{
+    if (base_)
+    {
+        // remove the shared memory objects still referenced by the rings
+        if (owner_)
+        {
+            for (int channel = 0, n = cfg_.max_channels(); channel < n; ++channel)
+            {
+                for (std::uint64_t seq = 0; seq < cfg_.slots_per_channel(); ++seq)
+                    release_object(slot_at(channel, seq));
+            }
+        }
+        munmap(base_, size_);
+    }
+    if (owner_)
+        shm_unlink(cfg_.segment_name().c_str());
+}
+
+goby::zeromq::detail::SharedMemoryChannel&
+goby::zeromq::SharedMemorySegment::channel_at(int channel) const
+{
+    return *reinterpret_cast<detail::SharedMemoryChannel*>(
+        static_cast<char*>(base_) + channels_offset_ +
+        channel * sizeof(detail::SharedMemoryChannel));
+}
+
+goby::zeromq::detail::SharedMemorySlot&
+goby::zeromq::SharedMemorySegment::slot_at(int channel, std::uint64_t seq) const
+{
+    std::size_t index = static_cast<std::size_t>(channel) * cfg_.slots_per_channel() +
+                        seq % cfg_.slots_per_channel();
+    return *reinterpret_cast<detail::SharedMemorySlot*>(static_cast<char*>(base_) +
+                                                        slots_offset_ + index * slot_stride_);
+}
+
+goby::zeromq::detail::SharedMemorySubscriberEntry&
+goby::zeromq::SharedMemorySegment::subscriber_at(int subscriber) const
+{
+    return *reinterpret_cast<detail::SharedMemorySubscriberEntry*>(
+        static_cast<char*>(base_) + subscribers_offset_ +
+        subscriber * sizeof(detail::SharedMemorySubscriberEntry));
+}
+
+int goby::zeromq::SharedMemorySegment::channel(const std::string& key)
+{
+    using detail::SharedMemoryChannel;
+    if (key.size() > detail::shared_memory_max_key_size)
+        return -1;
+
+    const int n = cfg_.max_channels();
+    const int start = detail::key_hash(key) % n;
+
+    // open addressing with linear probing; channels are never removed
+    for (int probe = 0; probe < n; ++probe)
+    {
+        int index = (start + probe) % n;
+        auto& c = channel_at(index);
+
+        std::uint32_t state = c.state.load(std::memory_order_acquire);
+        if (state == SharedMemoryChannel::FREE)
+        {
+            if (c.state.compare_exchange_strong(state, SharedMemoryChannel::INITIALIZING,
+                                                std::memory_order_acq_rel))
+            {
+                std::memcpy(c.key, key.data(), key.size());
+                c.key_size = key.size();
+                c.generation = header_->channel_generation.fetch_add(1) + 1;
+                c.state.store(SharedMemoryChannel::READY, std::memory_order_release);
+                header_->channel_count.fetch_add(1, std::memory_order_release);
+                return index;
+            }
+        }
+
+        // another process is creating this channel
+        while (state == SharedMemoryChannel::INITIALIZING)
+        {
+            std::this_thread::yield();
+            state = c.state.load(std::memory_order_acquire);
+        }
+
+        if (c.key_size == key.size() && std::memcmp(c.key, key.data(), key.size()) == 0)
+            return index;
+    }
+    return -1;
+}
+
+std::string goby::zeromq::SharedMemorySegment::create_object(const std::string& identifier,
+                                                             const char* data, std::size_t size)
+{
+    std::string name = cfg_.segment_name() + "." + std::to_string(getpid()) + "." +
+                       std::to_string(++detail::shared_memory_objects_created);
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, cfg_.mode());
+    if (fd < 0 && errno == EEXIST)
+    {
+        // left by an earlier process with the same pid
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, cfg_.mode());
+    }
+    if (fd < 0)
+    {
+        glog.is(WARN) && glog << "Failed to create shared memory object " << name << ": "
+                              << std::strerror(errno) << std::endl;
+        return std::string();
+    }
+
+    const std::size_t object_size = identifier.size() + size;
+    int error = detail::allocate(fd, object_size);
+    void* map = MAP_FAILED;
+    if (error == 0)
+    {
+        map = mmap(nullptr, object_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED)
+            error = errno;
+    }
+    ::close(fd);
+
+    if (error != 0)
+    {
+        shm_unlink(name.c_str());
+        glog.is(WARN) && glog << "Failed to allocate " << object_size
+                              << " bytes for shared memory object " << name << ": "
+                              << std::strerror(error) << std::endl;
+        return std::string();
+    }
+
+    char* dest = static_cast<char*>(map);
+    std::memcpy(dest, identifier.data(), identifier.size());
+    std::memcpy(dest + identifier.size(), data, size);
+    munmap(map, object_size);
+    return name;
+}
+
+void goby::zeromq::SharedMemorySegment::release_object(detail::SharedMemorySlot& slot)
+{
+    if (slot.object == 0)
+        return;
+    shm_unlink(std::string(slot_data(slot), slot.object).c_str());
+    slot.object = 0;
+}
+
+bool goby::zeromq::SharedMemorySegment::publish(int channel, const std::string& identifier,
+                                                const char* data, std::size_t size)
+{
+    const std::size_t bytes = identifier.size() + size;
+    if (bytes > std::numeric_limits<std::uint32_t>::max())
+        return false;
+
+    // too large for a slot: write it to its own object, and put the object's name in the slot
+    std::string object;
+    if (bytes > cfg_.slot_bytes())
+    {
+        object = create_object(identifier, data, size);
+        if (object.empty())
+            return false;
+    }
+
+    auto& c = channel_at(channel);
+    const std::uint64_t slots = cfg_.slots_per_channel();
+    const auto timeout = std::chrono::milliseconds(cfg_.reader_timeout_ms());
+
+    // each slot that is still being read is skipped, so try at most one lap of the ring
+    for (std::uint64_t attempt = 0; attempt < slots; ++attempt)
+    {
+        const std::uint64_t seq = c.head.fetch_add(1, std::memory_order_acq_rel);
+        auto& slot = slot_at(channel, seq);
+        const std::uint64_t complete = 2 * (seq + 1);
+
+        // claim the slot once the previous lap's publisher has finished with it
+        const std::uint64_t previous = seq < slots ? 0 : 2 * (seq - slots + 1);
+        const std::uint64_t writing = 2 * seq + 1;
+        auto start = std::chrono::steady_clock::now();
+        std::uint64_t expected = previous;
+        while (!slot.sequence.compare_exchange_weak(expected, writing))
+        {
+            expected = previous;
+            if (std::chrono::steady_clock::now() - start > timeout)
+            {
+                glog.is(WARN) && glog << "Shared memory publisher timed out waiting for previous "
+                                         "publisher on channel "
+                                      << std::string(c.key, c.key_size) << std::endl;
+                slot.sequence.store(writing);
+                break;
+            }
+            std::this_thread::yield();
+        }
+
+        // a subscriber is still reading the previous contents of this slot (it pinned the slot before we claimed it), so leave them intact and move on to the next slot
+        if (slot.readers.load() != 0)
+        {
+            slot.skipped.store(complete);
+            slot.sequence.store(complete, std::memory_order_release);
+            continue;
+        }
+
+        release_object(slot);
+        char* dest = slot_data(slot);
+        if (object.empty())
+        {
+            std::memcpy(dest, identifier.data(), identifier.size());
+            std::memcpy(dest + identifier.size(), data, size);
+        }
+        else
+        {
+            std::memcpy(dest, object.data(), object.size());
+            slot.object = object.size();
+        }
+        slot.size = bytes;
+        slot.sequence.store(complete, std::memory_order_release);
+
+        ring(channel);
+        return true;
+    }
+
+    if (!object.empty())
+        shm_unlink(object.c_str());
+    glog.is(WARN) && glog << "All shared memory slots are being read on channel "
+                          << std::string(c.key, c.key_size) << std::endl;
+    return false;
+}
+
+void goby::zeromq::SharedMemorySegment::ring(int channel)
+{
+    std::uint64_t subscribers = channel_at(channel).subscribers.load(std::memory_order_acquire) |
+                                header_->all_subscribers.load(std::memory_order_acquire);
+    for (int i = 0; subscribers != 0; ++i, subscribers >>= 1)
+    {
+        if ((subscribers & 1) == 0)
+            continue;
+        auto& entry = subscriber_at(i);
+        entry.doorbell.fetch_add(1, std::memory_order_acq_rel);
+        if (entry.waiters.load() > 0)
+            detail::futex_wake(&entry.doorbell);
+    }
+}
+
+goby::zeromq::SharedMemorySegment::ReadResult goby::zeromq::SharedMemorySegment::read(
+    int channel, std::uint64_t seq, const std::function<void(const char*, const char*)>& f)
+{
+    auto& slot = slot_at(channel, seq);
+    const std::uint64_t complete = 2 * (seq + 1);
+
+    std::uint64_t current = slot.sequence.load(std::memory_order_acquire);
+    if (current < complete)
+        return ReadResult::NOT_READY;
+    else if (current > complete)
+        return ReadResult::OVERWRITTEN;
+
+    // pin the slot, then check that a publisher didn't claim it in the meantime
+    slot.readers.fetch_add(1);
+    if (slot.sequence.load() != complete)
+    {
+        slot.readers.fetch_sub(1);
+        return ReadResult::OVERWRITTEN;
+    }
+
+    struct Unpin
+    {
+        std::atomic<std::uint32_t>& readers;
+        ~Unpin() { readers.fetch_sub(1); }
+    } unpin{slot.readers};
+
+    if (slot.skipped.load() == complete)
+        return ReadResult::SKIPPED;
+
+    const char* begin = slot_data(slot);
+    if (slot.object == 0)
+    {
+        f(begin, begin + slot.size);
+        return ReadResult::READ;
+    }
+
+    // the object is not removed while the slot is pinned
+    std::string name(begin, slot.object);
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        glog.is(WARN) && glog << "Failed to open shared memory object " << name << ": "
+                              << std::strerror(errno) << std::endl;
+        return ReadResult::OVERWRITTEN;
+    }
+    void* map = mmap(nullptr, slot.size, PROT_READ, MAP_SHARED, fd, 0);
+    int error = errno;
+    ::close(fd);
+    if (map == MAP_FAILED)
+    {
+        glog.is(WARN) && glog << "Failed to map shared memory object " << name << ": "
+                              << std::strerror(error) << std::endl;
+        return ReadResult::OVERWRITTEN;
+    }
+
+    struct Unmap
+    {
+        void* map;
+        std::size_t size;
+        ~Unmap() { munmap(map, size); }
+    } unmap{map, slot.size};
+
+    begin = static_cast<const char*>(map);
+    f(begin, begin + slot.size);
+    return ReadResult::READ;
+}
+
+std::uint64_t goby::zeromq::SharedMemorySegment::head(int channel) const
+{
+    return channel_at(channel).head.load(std::memory_order_acquire);
+}
+
+std::uint64_t goby::zeromq::SharedMemorySegment::generation(int channel) const
+{
+    return channel_at(channel).generation;
+}
+
+std::uint64_t goby::zeromq::SharedMemorySegment::latest_generation() const
+{
+    return header_->channel_generation.load(std::memory_order_acquire);
+}
+
+std::uint32_t goby::zeromq::SharedMemorySegment::channel_count() const
+{
+    return header_->channel_count.load(std::memory_order_acquire);
+}
+
+bool goby::zeromq::SharedMemorySegment::channel_exists(int channel) const
+{
+    return channel_at(channel).state.load(std::memory_order_acquire) ==
+           detail::SharedMemoryChannel::READY;
+}
+
+int goby::zeromq::SharedMemorySegment::register_subscriber()
+{
+    const auto pid = static_cast<std::uint32_t>(getpid());
+
+    // first look for a free entry, then for one left by a process that has exited
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (int i = 0; i < max_subscribers; ++i)
+        {
+            auto& entry = subscriber_at(i);
+            std::uint32_t owner = entry.pid.load();
+            bool available =
+                owner == 0 ||
+                (pass == 1 && kill(static_cast<pid_t>(owner), 0) != 0 && errno == ESRCH);
+            if (available && entry.pid.compare_exchange_strong(owner, pid))
+            {
+                // clear any subscriptions of the previous owner
+                set_subscribed_all(i, false);
+                for (int channel = 0, n = cfg_.max_channels(); channel < n; ++channel)
+                    set_subscribed(i, channel, false);
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+void goby::zeromq::SharedMemorySegment::unregister_subscriber(int subscriber)
+{
+    set_subscribed_all(subscriber, false);
+    for (int channel = 0, n = cfg_.max_channels(); channel < n; ++channel)
+        set_subscribed(subscriber, channel, false);
+    subscriber_at(subscriber).pid.store(0);
+}
+
+void goby::zeromq::SharedMemorySegment::set_subscribed(int subscriber, int channel,
+                                                       bool subscribed)
+{
+    const std::uint64_t bit = std::uint64_t(1) << subscriber;
+    if (subscribed)
+        channel_at(channel).subscribers.fetch_or(bit);
+    else
+        channel_at(channel).subscribers.fetch_and(~bit);
+}
+
+void goby::zeromq::SharedMemorySegment::set_subscribed_all(int subscriber, bool subscribed)
+{
+    const std::uint64_t bit = std::uint64_t(1) << subscriber;
+    if (subscribed)
+        header_->all_subscribers.fetch_or(bit);
+    else
+        header_->all_subscribers.fetch_and(~bit);
+}
+
+std::uint32_t goby::zeromq::SharedMemorySegment::doorbell(int subscriber) const
+{
+    return subscriber_at(subscriber).doorbell.load(std::memory_order_acquire);
+}
+
+std::uint32_t goby::zeromq::SharedMemorySegment::wait(int subscriber, std::uint32_t last_doorbell,
+                                                      std::chrono::milliseconds timeout)
+{
+    auto& entry = subscriber_at(subscriber);
+    entry.waiters.fetch_add(1);
+    if (entry.doorbell.load() == last_doorbell)
+        detail::futex_wait(&entry.doorbell, last_doorbell, timeout);
+    entry.waiters.fetch_sub(1);
+    return doorbell(subscriber);
+}
+
+//
+// SharedMemorySubscriber
+//
+
+goby::zeromq::SharedMemorySubscriber::SharedMemorySubscriber(SharedMemorySegment& segment)
+    : segment_(segment), index_(segment.register_subscriber())
+{
+    if (index_ < 0)
+        glog.is(WARN) && glog << "All " << SharedMemorySegment::max_subscribers
+                              << " shared memory subscribers are in use, will poll for "
+                                 "publications instead"
+                              << std::endl;
+}
+
+goby::zeromq::SharedMemorySubscriber::~SharedMemorySubscriber()
+{
+    if (index_ >= 0)
+        segment_.unregister_subscriber(index_);
+}
+
+std::uint32_t goby::zeromq::SharedMemorySubscriber::doorbell() const
+{
+    return index_ >= 0 ? segment_.doorbell(index_) : 0;
+}
+
+std::uint32_t goby::zeromq::SharedMemorySubscriber::wait(std::uint32_t last_doorbell,
+                                                         std::chrono::milliseconds timeout)
+{
+    if (index_ >= 0)
+        return segment_.wait(index_, last_doorbell, timeout);
+
+    std::this_thread::sleep_for(std::min(timeout, std::chrono::milliseconds(1)));
+    return last_doorbell + 1;
+}
+
+void goby::zeromq::SharedMemorySubscriber::subscribe(const std::string& key)
+{
+    int channel = segment_.channel(key);
+    if (channel < 0)
+    {
+        glog.is(WARN) && glog << "No shared memory channel available for [" << key
+                              << "], will only receive publications via ZeroMQ" << std::endl;
+        return;
+    }
+    channels_[key] = channel;
+    if (index_ >= 0)
+        segment_.set_subscribed(index_, channel, true);
+
+    auto it = cursors_.find(channel);
+    if (it == cursors_.end())
+        it = cursors_.insert(std::make_pair(channel, Cursor{segment_.head(channel), true})).first;
+    it->second.explicit_subscription = true;
+}
+
+void goby::zeromq::SharedMemorySubscriber::unsubscribe(const std::string& key)
+{
+    auto channel_it = channels_.find(key);
+    if (channel_it == channels_.end())
+        return;
+
+    if (index_ >= 0)
+        segment_.set_subscribed(index_, channel_it->second, false);
+
+    auto it = cursors_.find(channel_it->second);
+    if (it != cursors_.end())
+    {
+        if (all_)
+            it->second.explicit_subscription = false;
+        else
+            cursors_.erase(it);
+    }
+    channels_.erase(channel_it);
+}
+
+void goby::zeromq::SharedMemorySubscriber::subscribe_all()
+{
+    if (all_)
+        return;
+    all_ = true;
+    if (index_ >= 0)
+        segment_.set_subscribed_all(index_, true);
+    all_generation_ = segment_.latest_generation();
+    update_all_channels();
+}
+
+void goby::zeromq::SharedMemorySubscriber::unsubscribe_all()
+{
+    all_ = false;
+    if (index_ >= 0)
+        segment_.set_subscribed_all(index_, false);
+    for (auto it = cursors_.begin(); it != cursors_.end();)
+    {
+        if (!it->second.explicit_subscription)
+            it = cursors_.erase(it);
+        else
+            ++it;
+    }
+}
+
+void goby::zeromq::SharedMemorySubscriber::update_all_channels()
+{
+    known_channel_count_ = segment_.channel_count();
+    for (int channel = 0, n = segment_.max_channels(); channel < n; ++channel)
+    {
+        if (cursors_.count(channel) || !segment_.channel_exists(channel))
+            continue;
+
+        // channels created since subscribe_all() was called are read from the start
+        std::uint64_t next =
+            segment_.generation(channel) > all_generation_ ? 0 : segment_.head(channel);
+        cursors_.insert(std::make_pair(channel, Cursor{next, false}));
+    }
+}
+
+int goby::zeromq::SharedMemorySubscriber::receive(
+    const std::function<void(const char* begin, const char* end)>& f)
+{
+    if (all_ && segment_.channel_count() != known_channel_count_)
+        update_all_channels();
+
+    // f() may (un)subscribe, so iterate over a copy of the channels
+    std::vector<int> channels;
+    channels.reserve(cursors_.size());
+    for (const auto& p : cursors_) channels.push_back(p.first);
+
+    const std::uint64_t slots = segment_.slots_per_channel();
+    int items = 0;
+    for (int channel : channels)
+    {
+        auto it = cursors_.find(channel);
+        if (it == cursors_.end())
+            continue;
+
+        std::uint64_t head = segment_.head(channel);
+        std::uint64_t next = it->second.next;
+        if (head - next > slots)
+        {
+            dropped_ += head - slots - next;
+            next = head - slots;
+        }
+
+        while (next < head)
+        {
+            auto result = segment_.read(channel, next, f);
+            if (result == SharedMemorySegment::ReadResult::NOT_READY)
+                break;
+            else if (result == SharedMemorySegment::ReadResult::OVERWRITTEN)
+                ++dropped_;
+            else if (result == SharedMemorySegment::ReadResult::READ)
+                ++items;
+            ++next;
+        }
+
+        it = cursors_.find(channel);
+        if (it != cursors_.end())
+            it->second.next = next;
+    }
+    return items;
+}
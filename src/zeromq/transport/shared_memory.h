@@ -0,0 +1,234 @@
+// Copyright 2016-2023:
+//   GobySoft, LLC (2013-)
+//   Community contributors (see AUTHORS file)
+// File authors:
+//   Toby Schneider <toby@gobysoft.org>
+//
+//
+// This file is part of the Goby Underwater Autonomy Project Libraries
+// ("The Goby Libraries").
+//
+// The Goby Libraries are free software: you can redistribute them and/or modify
+// them under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// The Goby Libraries are distributed in the hope that they will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Goby.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GOBY_ZEROMQ_TRANSPORT_SHARED_MEMORY_H
+#define GOBY_ZEROMQ_TRANSPORT_SHARED_MEMORY_H
+
+#include <chrono>        // for milliseconds
+#include <cstddef>       // for size_t
+#include <cstdint>       // for uint32_t, uint64_t
+#include <functional>    // for function
+#include <memory>        // for unique_ptr
+#include <string>        // for string
+#include <unordered_map> // for unordered_map
+
+#include "goby/zeromq/protobuf/interprocess_config.pb.h" // for SharedMemoryConfig
+
+namespace goby
+{
+namespace zeromq
+{
+namespace detail
+{
+struct SharedMemoryHeader;
+struct SharedMemoryChannel;
+struct SharedMemorySlot;
+struct SharedMemorySubscriberEntry;
+} // namespace detail
+
+/// \brief POSIX shared memory segment holding one ring buffer of publications per channel (group/scheme/type identifier), shared by all the clients of a single Manager (gobyd).
+///
+/// Each slot in a ring holds the full identifier (null terminated) followed by the serialized data, i.e. the same layout as the ZeroMQ message used by InterProcessPortal, so that subscribers can parse directly from the mapped memory. Publications larger than a slot are written to their own shared memory object, whose name is stored in the slot instead (so they keep their order within the ring); the object is removed when the slot is reused.
+///
+/// Each subscriber registers for a "doorbell" counter in the segment. Publishers increment (and wake, using a futex on Linux) only the doorbells of the subscribers to the channel they published to.
+class SharedMemorySegment
+{
+  public:
+    /// \brief Create (or recreate) and initialize the segment. Called by the Manager (gobyd), which owns the segment and removes it on destruction.
+    static std::unique_ptr<SharedMemorySegment> create(const protobuf::SharedMemoryConfig& cfg);
+
+    /// \brief Map an existing segment previously created by the Manager (gobyd)
+    static std::unique_ptr<SharedMemorySegment> open(const protobuf::SharedMemoryConfig& cfg);
+
+    ~SharedMemorySegment();
+
+    SharedMemorySegment(const SharedMemorySegment&) = delete;
+    SharedMemorySegment& operator=(const SharedMemorySegment&) = delete;
+
+    /// \brief Default segment name for a given platform
+    static std::string default_name(const std::string& platform)
+    {
+        return "/goby_" + platform + ".shm";
+    }
+
+    /// \brief Find the channel for a given key (identifier with process and thread wildcarded), creating it if necessary
+    ///
+    /// \return channel index, or -1 if the key is too long or the channel table is full
+    int channel(const std::string& key);
+
+    /// \brief Write a publication into the given channel's ring and notify subscribers
+    ///
+    /// Slots still being read by a (slow) subscriber are skipped rather than overwritten.
+    /// \param channel Channel index returned by channel()
+    /// \param identifier Fully qualified identifier, including the trailing null character
+    /// \return false if the publication was not written (no free slot, or its shared memory object could not be created), in which case it must be sent another way
+    bool publish(int channel, const std::string& identifier, const char* data, std::size_t size);
+
+    enum class ReadResult
+    {
+        READ,
+        NOT_READY,
+        OVERWRITTEN,
+        SKIPPED
+    };
+
+    /// \brief Pass the publication with sequence number \c seq to \c f without copying it out of the segment. The slot is pinned (publishers will not overwrite it) while \c f runs.
+    ReadResult read(int channel, std::uint64_t seq,
+                    const std::function<void(const char* begin, const char* end)>& f);
+
+    /// \brief Maximum number of registered subscribers (one per InterProcessPortal)
+    static constexpr int max_subscribers{64};
+
+    /// \brief Claim a subscriber doorbell
+    ///
+    /// \return subscriber index, or -1 if all are in use by running processes
+    int register_subscriber();
+    void unregister_subscriber(int subscriber);
+
+    /// \brief Ring (or stop ringing) this subscriber's doorbell for publications to \c channel
+    void set_subscribed(int subscriber, int channel, bool subscribed);
+
+    /// \brief Ring (or stop ringing) this subscriber's doorbell for publications to any channel
+    void set_subscribed_all(int subscriber, bool subscribed);
+
+    /// \return Number of publications ever written to (or in the process of being written to) this channel
+    std::uint64_t head(int channel) const;
+
+    /// \return Generation (creation order) of this channel
+    std::uint64_t generation(int channel) const;
+
+    /// \return Generation of the most recently created channel
+    std::uint64_t latest_generation() const;
+
+    /// \return Number of channels that have been completely created
+    std::uint32_t channel_count() const;
+
+    /// \return true if a channel exists at this index
+    bool channel_exists(int channel) const;
+
+    std::uint32_t doorbell(int subscriber) const;
+
+    /// \brief Block until the subscriber's doorbell differs from \c last_doorbell or the timeout expires
+    ///
+    /// \return current value of the doorbell
+    std::uint32_t wait(int subscriber, std::uint32_t last_doorbell,
+                       std::chrono::milliseconds timeout);
+
+    std::uint32_t max_channels() const { return cfg_.max_channels(); }
+    std::uint32_t slots_per_channel() const { return cfg_.slots_per_channel(); }
+    const protobuf::SharedMemoryConfig& cfg() const { return cfg_; }
+
+  private:
+    SharedMemorySegment(const protobuf::SharedMemoryConfig& cfg, bool owner);
+
+    detail::SharedMemoryChannel& channel_at(int channel) const;
+    detail::SharedMemorySlot& slot_at(int channel, std::uint64_t seq) const;
+    detail::SharedMemorySubscriberEntry& subscriber_at(int subscriber) const;
+    // write the publication to a new shared memory object, returning its name (empty on failure)
+    std::string create_object(const std::string& identifier, const char* data, std::size_t size);
+    // remove the shared memory object (if any) referenced by a slot
+    void release_object(detail::SharedMemorySlot& slot);
+    void ring(int channel);
+    char* slot_data(detail::SharedMemorySlot& slot) const
+    {
+        return reinterpret_cast<char*>(&slot) + slot_data_offset_;
+    }
+
+  private:
+    protobuf::SharedMemoryConfig cfg_;
+    bool owner_;
+    void* base_{nullptr};
+    std::size_t size_{0};
+    detail::SharedMemoryHeader* header_{nullptr};
+    std::size_t channels_offset_{0};
+    std::size_t subscribers_offset_{0};
+    std::size_t slots_offset_{0};
+    std::size_t slot_stride_{0};
+    std::size_t slot_data_offset_{0};
+    std::uint64_t objects_created_{0};
+};
+
+/// \brief Tracks the read position within each subscribed SharedMemorySegment channel for a single InterProcessPortal
+class SharedMemorySubscriber
+{
+  public:
+    SharedMemorySubscriber(SharedMemorySegment& segment);
+    ~SharedMemorySubscriber();
+
+    SharedMemorySubscriber(const SharedMemorySubscriber&) = delete;
+    SharedMemorySubscriber& operator=(const SharedMemorySubscriber&) = delete;
+
+    /// \brief Subscribe to a channel (key is an identifier with the process and thread wildcarded)
+    void subscribe(const std::string& key);
+    void unsubscribe(const std::string& key);
+
+    /// \brief Subscribe to all channels (current and future), used for regex subscriptions
+    void subscribe_all();
+    void unsubscribe_all();
+
+    /// \brief Pass all new publications on the subscribed channels to \c f (identifier + '\0' + data)
+    ///
+    /// \c f may call subscribe() and unsubscribe()
+    /// \return number of publications passed to \c f
+    int receive(const std::function<void(const char* begin, const char* end)>& f);
+
+    /// \return number of publications that were overwritten before they could be read
+    std::uint64_t dropped() const { return dropped_; }
+
+    /// \return Current value of this subscriber's doorbell
+    std::uint32_t doorbell() const;
+
+    /// \brief Block until a publication is made to one of the subscribed channels (or the timeout expires)
+    ///
+    /// May be called from a different thread than the other methods.
+    /// \return current value of the doorbell
+    std::uint32_t wait(std::uint32_t last_doorbell, std::chrono::milliseconds timeout);
+
+  private:
+    void update_all_channels();
+
+  private:
+    struct Cursor
+    {
+        std::uint64_t next{0};
+        // explicitly subscribed (rather than only via subscribe_all())
+        bool explicit_subscription{false};
+    };
+
+    SharedMemorySegment& segment_;
+    // doorbell index, or -1 if none was available (in which case wait() polls)
+    const int index_;
+    std::unordered_map<int, Cursor> cursors_;
+    std::unordered_map<std::string, int> channels_;
+
+    bool all_{false};
+    // channels created after this generation were created after subscribe_all() so start at the beginning
+    std::uint64_t all_generation_{0};
+    std::uint32_t known_channel_count_{0};
+    std::uint64_t dropped_{0};
+};
+
+} // namespace zeromq
+} // namespace goby
+
+#endif